@@ -304,6 +304,9 @@ list(APPEND INKSCAPE_INCS_SYS ${LIBXML2_INCLUDE_DIR})
 list(APPEND INKSCAPE_LIBS ${LIBXML2_LIBRARIES})
 add_definitions(${LIBXML2_DEFINITIONS})
 
+find_package(Threads REQUIRED)
+list(APPEND INKSCAPE_LIBS ${CMAKE_THREAD_LIBS_INIT})
+
 if(WITH_OPENMP)
     find_package(OpenMP)
     if(OPENMP_FOUND)
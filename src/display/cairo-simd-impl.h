@@ -0,0 +1,404 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Vectorized pixel span kernels, written against a small vector abstraction.
+ *
+ * This file is included by cairo-simd.cpp once for every supported instruction set,
+ * inside a namespace which defines the vector type V, and inside a region where the
+ * compiler is allowed to generate instructions from that set. It therefore has no
+ * include guard and must not be included from anywhere else.
+ *
+ * V provides integer vectors V::I of V::N 32-bit lanes, float vectors V::F, and static
+ * functions for the operations below. V::mul16 multiplies lanes whose values fit in
+ * signed 16 bits, which is cheaper than a full 32-bit multiply on older processors.
+ * The leftover pixels at the end of each span are handled by the scalar kernels.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+using I = V::I;
+using F = V::F;
+
+struct Pixels {
+    I a, r, g, b;
+};
+
+static inline Pixels extract(I px)
+{
+    I const mask = V::set1(0xff);
+    return { V::srli(px, 24),
+             V::bit_and(V::srli(px, 16), mask),
+             V::bit_and(V::srli(px, 8), mask),
+             V::bit_and(px, mask) };
+}
+
+static inline I assemble(Pixels const &p)
+{
+    return V::bit_or(V::bit_or(V::slli(p.a, 24), V::slli(p.r, 16)),
+                     V::bit_or(V::slli(p.g, 8), p.b));
+}
+
+/// Same as premul_alpha() from cairo-utils.h.
+static inline I premul(I c, I a)
+{
+    I t = V::add(V::mul16(c, a), V::set1(128));
+    return V::srli(V::add(t, V::srli(t, 8)), 8);
+}
+
+/**
+ * Same as unpremul_alpha() from cairo-utils.h, for lanes where a is not zero.
+ * The quotient is computed in single precision. Both operands are exact and the correctly
+ * rounded quotient is never closer than 1/a to the next integer, so truncating it gives the
+ * exact result of the integer division.
+ */
+static inline I unpremul(I c, I a, F af)
+{
+    I num = V::add(V::mul16(c, V::set1(255)), V::srli(a, 1));
+    I q = V::cvtt(V::div(V::cvtf(num), af));
+    return V::select(V::cmpgt(a, c), q, V::set1(255));
+}
+
+/// Exact (x + bias) / div for non-negative x, with (x + bias) < 2^24; see unpremul().
+static inline I divide(I x, gint32 bias, float div)
+{
+    return V::cvtt(V::div(V::cvtf(V::add(x, V::set1(bias))), V::setf(div)));
+}
+
+static inline I clamp(I x, I low, I high)
+{
+    return V::min(V::max(x, low), high);
+}
+
+static void premul_alpha(guint32 const *in, guint32 *out, int n)
+{
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        Pixels p = extract(V::load(in + i));
+        p.r = premul(p.r, p.a);
+        p.g = premul(p.g, p.a);
+        p.b = premul(p.b, p.a);
+        V::store(out + i, assemble(p));
+    }
+    scalar::premul_alpha(in + i, out + i, n - i);
+}
+
+static void unpremul_alpha(guint32 const *in, guint32 *out, int n)
+{
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        I px = V::load(in + i);
+        Pixels p = extract(px);
+        F af = V::cvtf(p.a);
+        p.r = unpremul(p.r, p.a, af);
+        p.g = unpremul(p.g, p.a, af);
+        p.b = unpremul(p.b, p.a, af);
+        I transparent = V::cmpeq(p.a, V::set1(0));
+        V::store(out + i, V::select(transparent, px, assemble(p)));
+    }
+    scalar::unpremul_alpha(in + i, out + i, n - i);
+}
+
+static void color_matrix(guint32 const *in, guint32 *out, int n, gint32 const *matrix)
+{
+    // multipliers are known to fit in 16 bits, see ink_span_color_matrix_supported()
+    I m[20];
+    for (int k = 0; k < 20; ++k) {
+        m[k] = V::set1(k % 5 == 4 ? matrix[k] : (matrix[k] & 0xffff));
+    }
+    I const zero = V::set1(0);
+    I const max = V::set1(255 * 255);
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        Pixels p = extract(V::load(in + i));
+        I opaque = V::cmpgt(p.a, zero);
+        F af = V::cvtf(p.a);
+        I r = V::select(opaque, unpremul(p.r, p.a, af), p.r);
+        I g = V::select(opaque, unpremul(p.g, p.a, af), p.g);
+        I b = V::select(opaque, unpremul(p.b, p.a, af), p.b);
+
+        I o[4];
+        for (int k = 0; k < 4; ++k) {
+            I const *row = m + 5 * k;
+            I sum = V::add(V::add(V::mul16(r, row[0]), V::mul16(g, row[1])),
+                           V::add(V::mul16(b, row[2]), V::mul16(p.a, row[3])));
+            o[k] = divide(clamp(V::add(sum, row[4]), zero, max), 127, 255.0f);
+        }
+
+        Pixels result;
+        result.a = o[3];
+        result.r = premul(o[0], o[3]);
+        result.g = premul(o[1], o[3]);
+        result.b = premul(o[2], o[3]);
+        V::store(out + i, assemble(result));
+    }
+    scalar::color_matrix(in + i, out + i, n - i, matrix);
+}
+
+static void hue_rotate(guint32 const *in, guint32 *out, int n, gint32 const *matrix)
+{
+    I m[9];
+    for (int k = 0; k < 9; ++k) {
+        m[k] = V::set1(matrix[k] & 0xffff);
+    }
+    I const zero = V::set1(0);
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        Pixels p = extract(V::load(in + i));
+        I max = V::mul16(p.a, V::set1(255));
+
+        I o[3];
+        for (int k = 0; k < 3; ++k) {
+            I const *row = m + 3 * k;
+            I sum = V::add(V::add(V::mul16(p.r, row[0]), V::mul16(p.g, row[1])),
+                           V::mul16(p.b, row[2]));
+            o[k] = divide(clamp(sum, zero, max), 127, 255.0f);
+        }
+        p.r = o[0];
+        p.g = o[1];
+        p.b = o[2];
+        V::store(out + i, assemble(p));
+    }
+    scalar::hue_rotate(in + i, out + i, n - i, matrix);
+}
+
+/// k[0] * x * y + k[1] * x + k[2] * y + k[3], wrapping around like the scalar version.
+static inline I arithmetic_channel(I x, I y, I const *k)
+{
+    return V::add(V::add(V::mullo(k[0], V::mul16(x, y)), V::mullo(k[1], x)),
+                  V::add(V::mullo(k[2], y), k[3]));
+}
+
+static void arithmetic(guint32 const *in1, guint32 const *in2, guint32 *out, int n,
+                       gint32 k1, gint32 k2, gint32 k3, gint32 k4)
+{
+    I const k[4] = { V::set1(k1), V::set1(k2), V::set1(k3), V::set1(k4) };
+    I const zero = V::set1(0);
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        Pixels p1 = extract(V::load(in1 + i));
+        Pixels p2 = extract(V::load(in2 + i));
+
+        // r, g and b are premultiplied, so they are clamped to the alpha channel
+        I ao = clamp(arithmetic_channel(p1.a, p2.a, k), zero, V::set1(255 * 255 * 255));
+        Pixels result;
+        result.r = clamp(arithmetic_channel(p1.r, p2.r, k), zero, ao);
+        result.g = clamp(arithmetic_channel(p1.g, p2.g, k), zero, ao);
+        result.b = clamp(arithmetic_channel(p1.b, p2.b, k), zero, ao);
+        result.a = divide(ao, 255 * 255 / 2, 255.0f * 255.0f);
+        result.r = divide(result.r, 255 * 255 / 2, 255.0f * 255.0f);
+        result.g = divide(result.g, 255 * 255 / 2, 255.0f * 255.0f);
+        result.b = divide(result.b, 255 * 255 / 2, 255.0f * 255.0f);
+        V::store(out + i, assemble(result));
+    }
+    scalar::arithmetic(in1 + i, in2 + i, out + i, n - i, k1, k2, k3, k4);
+}
+
+static inline F dot(F ax, F ay, F az, F bx, F by, F bz)
+{
+    return V::add(V::add(V::mul(ax, bx), V::mul(ay, by)), V::mul(az, bz));
+}
+
+/// Same as scalar::fast_pow().
+static inline F fast_pow(F x, F e)
+{
+    F const one = V::setf(1.0f);
+    I bits = V::as_int(V::max(x, V::setf(FLT_MIN)));
+    F exponent = V::cvtf(V::add(V::srli(bits, 23), V::set1(-127)));
+    F m = V::as_float(V::bit_or(V::bit_and(bits, V::set1(0x7fffff)), V::set1(0x3f800000)));
+    F big = V::cmpgt(m, V::setf(float(M_SQRT2)));
+    m = V::select(big, V::mul(m, V::setf(0.5f)), m);
+    exponent = V::add(exponent, V::bit_and(big, one));
+    F t = V::div(V::sub(m, one), V::add(m, one));
+    F t2 = V::mul(t, t);
+    F series = V::add(V::setf(LOG2_C[2]), V::mul(t2, V::setf(LOG2_C[3])));
+    series = V::add(V::setf(LOG2_C[1]), V::mul(t2, series));
+    series = V::add(V::setf(LOG2_C[0]), V::mul(t2, series));
+    F log2 = V::add(exponent, V::mul(t, series));
+
+    F y = V::min(V::max(V::mul(e, log2), V::setf(-126.0f)), V::setf(126.0f));
+    I i = V::cvtr(y);
+    F f = V::sub(y, V::cvtf(i));
+    F p = V::add(V::setf(EXP2_C[4]), V::mul(f, V::setf(EXP2_C[5])));
+    for (int k = 3; k >= 0; --k) {
+        p = V::add(V::setf(EXP2_C[k]), V::mul(f, p));
+    }
+    p = V::add(one, V::mul(f, p));
+    return V::mul(p, V::as_float(V::slli(V::add(i, V::set1(127)), 23)));
+}
+
+static inline I to_u8(F v)
+{
+    F clamped = V::min(V::max(v, V::setf(0.0f)), V::setf(255.0f));
+    return V::cvtt(V::add(clamped, V::setf(0.5f)));
+}
+
+static void surface_normals(float const *above, float const *row, float const *below, int n,
+                            float surface_scale, float *nx, float *ny, float *nz)
+{
+    F const f = V::setf(-surface_scale / (255.0f * 4.0f));
+    F const two = V::setf(2.0f);
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        F a0 = V::load(above + i - 1), a1 = V::load(above + i), a2 = V::load(above + i + 1);
+        F r0 = V::load(row + i - 1), r2 = V::load(row + i + 1);
+        F b0 = V::load(below + i - 1), b1 = V::load(below + i), b2 = V::load(below + i + 1);
+
+        F sx = V::add(V::add(V::sub(a2, a0), V::mul(two, V::sub(r2, r0))), V::sub(b2, b0));
+        F sy = V::sub(V::add(V::add(b0, V::mul(two, b1)), b2),
+                      V::add(V::add(a0, V::mul(two, a1)), a2));
+        F x = V::mul(f, sx), y = V::mul(f, sy);
+        F inv = V::div(V::setf(1.0f), V::sqrt(V::add(V::add(V::mul(x, x), V::mul(y, y)),
+                                                      V::setf(1.0f))));
+        V::store(nx + i, V::mul(x, inv));
+        V::store(ny + i, V::mul(y, inv));
+        V::store(nz + i, inv);
+    }
+    scalar::surface_normals(above + i, row + i, below + i, n - i, surface_scale,
+                            nx + i, ny + i, nz + i);
+}
+
+struct LightRays {
+    F x, y, z;  ///< unit vector towards the light
+    F r, g, b;  ///< color of the light
+};
+
+/// Same as scalar::light_ray(), for V::N pixels starting at (x, y).
+static inline LightRays light_rays(InkLighting const &light, int x, int y, F alpha)
+{
+    LightRays rays;
+    if (light.type == InkLighting::DISTANT) {
+        rays.x = V::setf(light.direction[0]);
+        rays.y = V::setf(light.direction[1]);
+        rays.z = V::setf(light.direction[2]);
+        rays.r = V::setf(light.color[0]);
+        rays.g = V::setf(light.color[1]);
+        rays.b = V::setf(light.color[2]);
+        return rays;
+    }
+
+    F lx = V::sub(V::setf(light.position[0]), V::cvtf(V::add(V::set1(x), V::index())));
+    F ly = V::sub(V::setf(light.position[1]), V::setf(y));
+    F lz = V::sub(V::setf(light.position[2]), V::mul(alpha, V::setf(light.surface_scale / 255.0f)));
+    F inv = V::div(V::setf(1.0f), V::sqrt(dot(lx, ly, lz, lx, ly, lz)));
+    rays.x = V::mul(lx, inv);
+    rays.y = V::mul(ly, inv);
+    rays.z = V::mul(lz, inv);
+
+    F factor = V::setf(1.0f);
+    if (light.type == InkLighting::SPOT) {
+        F const zero = V::setf(0.0f);
+        F s = V::sub(zero, dot(rays.x, rays.y, rays.z, V::setf(light.spot_axis[0]),
+                               V::setf(light.spot_axis[1]), V::setf(light.spot_axis[2])));
+        F lit = V::bit_and(V::cmpgt(s, V::setf(light.spot_cos_cone)), V::cmpgt(s, zero));
+        factor = V::select(lit, fast_pow(s, V::setf(light.spot_exponent)), zero);
+    }
+    rays.r = V::mul(V::setf(light.color[0]), factor);
+    rays.g = V::mul(V::setf(light.color[1]), factor);
+    rays.b = V::mul(V::setf(light.color[2]), factor);
+    return rays;
+}
+
+static void diffuse_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                             float const *nx, float const *ny, float const *nz,
+                             guint32 *out, int n)
+{
+    F const kd = V::setf(light.constant);
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        LightRays l = light_rays(light, x + i, y, V::load(alpha + i));
+        F k = V::mul(kd, dot(V::load(nx + i), V::load(ny + i), V::load(nz + i), l.x, l.y, l.z));
+
+        Pixels p;
+        p.a = V::set1(255);
+        p.r = to_u8(V::mul(k, l.r));
+        p.g = to_u8(V::mul(k, l.g));
+        p.b = to_u8(V::mul(k, l.b));
+        V::store(out + i, assemble(p));
+    }
+    scalar::diffuse_lighting(light, x + i, y, alpha + i, nx + i, ny + i, nz + i, out + i, n - i);
+}
+
+static void specular_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                              float const *nx, float const *ny, float const *nz,
+                              guint32 *out, int n)
+{
+    F const ks = V::setf(light.constant);
+    F const exponent = V::setf(light.exponent);
+    F const zero = V::setf(0.0f);
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        LightRays l = light_rays(light, x + i, y, V::load(alpha + i));
+        F hz = V::add(l.z, V::setf(1.0f));
+        F inv = V::div(V::setf(1.0f), V::sqrt(dot(l.x, l.y, hz, l.x, l.y, hz)));
+        F sp = V::mul(dot(V::load(nx + i), V::load(ny + i), V::load(nz + i), l.x, l.y, hz), inv);
+        F k = V::select(V::cmpgt(sp, zero), V::mul(ks, fast_pow(sp, exponent)), zero);
+
+        Pixels p;
+        p.r = to_u8(V::mul(k, l.r));
+        p.g = to_u8(V::mul(k, l.g));
+        p.b = to_u8(V::mul(k, l.b));
+        p.a = V::max(V::max(p.r, p.g), p.b);
+        p.r = premul(p.r, p.a);
+        p.g = premul(p.g, p.a);
+        p.b = premul(p.b, p.a);
+        V::store(out + i, assemble(p));
+    }
+    scalar::specular_lighting(light, x + i, y, alpha + i, nx + i, ny + i, nz + i, out + i, n - i);
+}
+
+static void gouraud(float const *start, float const *step, guint32 *out, int n)
+{
+    F const index = V::cvtf(V::index());
+    F s[4], d[4];
+    for (int c = 0; c < 4; ++c) {
+        s[c] = V::setf(start[c]);
+        d[c] = V::setf(step[c]);
+    }
+
+    int i = 0;
+    for (; i + V::N <= n; i += V::N) {
+        F offset = V::add(V::setf(float(i)), index);
+        Pixels p;
+        p.a = to_u8(V::add(s[0], V::mul(offset, d[0])));
+        p.r = to_u8(V::add(s[1], V::mul(offset, d[1])));
+        p.g = to_u8(V::add(s[2], V::mul(offset, d[2])));
+        p.b = to_u8(V::add(s[3], V::mul(offset, d[3])));
+        V::store(out + i, assemble(p));
+    }
+    float rest[4];
+    for (int c = 0; c < 4; ++c) {
+        rest[c] = start[c] + float(i) * step[c];
+    }
+    scalar::gouraud(rest, step, out + i, n - i);
+}
+
+static Kernels const kernels = {
+    ISA_NAME,
+    premul_alpha,
+    unpremul_alpha,
+    color_matrix,
+    hue_rotate,
+    arithmetic,
+    surface_normals,
+    diffuse_lighting,
+    specular_lighting,
+    gouraud
+};
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
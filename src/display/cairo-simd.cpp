@@ -0,0 +1,594 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Pixel span kernels for the Cairo software filters, with SIMD implementations
+ * selected at runtime.
+ *
+ * Every kernel has a scalar version, which is also used for the pixels left over at the
+ * end of a span, and on x86 an SSE2 and an AVX2 version generated from cairo-simd-impl.h.
+ * The vector versions are compiled for their instruction set regardless of the global
+ * compiler flags, and the best one supported by the processor is chosen on first use.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/cairo-simd.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "display/cairo-utils.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define INK_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+struct Kernels {
+    char const *isa;
+    void (*premul_alpha)(guint32 const *, guint32 *, int);
+    void (*unpremul_alpha)(guint32 const *, guint32 *, int);
+    void (*color_matrix)(guint32 const *, guint32 *, int, gint32 const *);
+    void (*hue_rotate)(guint32 const *, guint32 *, int, gint32 const *);
+    void (*arithmetic)(guint32 const *, guint32 const *, guint32 *, int,
+                       gint32, gint32, gint32, gint32);
+    void (*surface_normals)(float const *, float const *, float const *, int, float,
+                            float *, float *, float *);
+    void (*diffuse_lighting)(InkLighting const &, int, int, float const *,
+                             float const *, float const *, float const *, guint32 *, int);
+    void (*specular_lighting)(InkLighting const &, int, int, float const *,
+                              float const *, float const *, float const *, guint32 *, int);
+    void (*gouraud)(float const *, float const *, guint32 *, int);
+};
+
+// Coefficients of the series for log2 and exp2 in fast_pow(). The first is the series of
+// log2((1 + t) / (1 - t)), which converges quickly for the |t| < 0.18 used there; the second
+// is the Taylor series of 2^f for |f| <= 1/2.
+constexpr float LOG2_C[] = { 2.88539008f, 0.961796694f, 0.577078016f, 0.412198583f };
+constexpr float EXP2_C[] = { 0.693147181f, 0.240226507f, 0.0555041087f, 0.00961812911f,
+                             0.00133335581f, 0.000154035304f };
+
+namespace scalar {
+
+// These are the per-pixel computations of the filter functors, which are the reference
+// for the vector versions.
+
+void premul_alpha(guint32 const *in, guint32 *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        EXTRACT_ARGB32(in[i], a, r, g, b)
+        r = ::premul_alpha(r, a);
+        g = ::premul_alpha(g, a);
+        b = ::premul_alpha(b, a);
+        ASSEMBLE_ARGB32(px, a, r, g, b)
+        out[i] = px;
+    }
+}
+
+void unpremul_alpha(guint32 const *in, guint32 *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        EXTRACT_ARGB32(in[i], a, r, g, b)
+        if (a == 0) {
+            out[i] = in[i];
+            continue;
+        }
+        r = ::unpremul_alpha(r, a);
+        g = ::unpremul_alpha(g, a);
+        b = ::unpremul_alpha(b, a);
+        ASSEMBLE_ARGB32(px, a, r, g, b)
+        out[i] = px;
+    }
+}
+
+void color_matrix(guint32 const *in, guint32 *out, int n, gint32 const *v)
+{
+    for (int i = 0; i < n; ++i) {
+        EXTRACT_ARGB32(in[i], a, r, g, b)
+        if (a != 0) {
+            r = ::unpremul_alpha(r, a);
+            g = ::unpremul_alpha(g, a);
+            b = ::unpremul_alpha(b, a);
+        }
+
+        gint32 ro = r*v[0]  + g*v[1]  + b*v[2]  + a*v[3]  + v[4];
+        gint32 go = r*v[5]  + g*v[6]  + b*v[7]  + a*v[8]  + v[9];
+        gint32 bo = r*v[10] + g*v[11] + b*v[12] + a*v[13] + v[14];
+        gint32 ao = r*v[15] + g*v[16] + b*v[17] + a*v[18] + v[19];
+        ro = (std::clamp(ro, 0, 255*255) + 127) / 255;
+        go = (std::clamp(go, 0, 255*255) + 127) / 255;
+        bo = (std::clamp(bo, 0, 255*255) + 127) / 255;
+        ao = (std::clamp(ao, 0, 255*255) + 127) / 255;
+
+        ro = ::premul_alpha(ro, ao);
+        go = ::premul_alpha(go, ao);
+        bo = ::premul_alpha(bo, ao);
+
+        ASSEMBLE_ARGB32(px, ao, ro, go, bo)
+        out[i] = px;
+    }
+}
+
+void hue_rotate(guint32 const *in, guint32 *out, int n, gint32 const *v)
+{
+    for (int i = 0; i < n; ++i) {
+        EXTRACT_ARGB32(in[i], a, r, g, b)
+        gint32 maxpx = a*255;
+        gint32 ro = r*v[0] + g*v[1] + b*v[2];
+        gint32 go = r*v[3] + g*v[4] + b*v[5];
+        gint32 bo = r*v[6] + g*v[7] + b*v[8];
+        ro = (std::clamp(ro, 0, maxpx) + 127) / 255;
+        go = (std::clamp(go, 0, maxpx) + 127) / 255;
+        bo = (std::clamp(bo, 0, maxpx) + 127) / 255;
+
+        ASSEMBLE_ARGB32(px, a, ro, go, bo)
+        out[i] = px;
+    }
+}
+
+void arithmetic(guint32 const *in1, guint32 const *in2, guint32 *out, int n,
+                gint32 k1, gint32 k2, gint32 k3, gint32 k4)
+{
+    for (int i = 0; i < n; ++i) {
+        EXTRACT_ARGB32(in1[i], aa, ra, ga, ba)
+        EXTRACT_ARGB32(in2[i], ab, rb, gb, bb)
+
+        gint32 ao = k1*aa*ab + k2*aa + k3*ab + k4;
+        gint32 ro = k1*ra*rb + k2*ra + k3*rb + k4;
+        gint32 go = k1*ga*gb + k2*ga + k3*gb + k4;
+        gint32 bo = k1*ba*bb + k2*ba + k3*bb + k4;
+
+        ao = std::clamp(ao, 0, 255*255*255);
+        ro = (std::clamp(ro, 0, ao) + (255*255/2)) / (255*255);
+        go = (std::clamp(go, 0, ao) + (255*255/2)) / (255*255);
+        bo = (std::clamp(bo, 0, ao) + (255*255/2)) / (255*255);
+        ao = (ao + (255*255/2)) / (255*255);
+
+        ASSEMBLE_ARGB32(px, ao, ro, go, bo)
+        out[i] = px;
+    }
+}
+
+// The lighting kernels compute in single precision from the start. The vector versions
+// follow the same steps, so they only differ in the order of a few roundings.
+
+float as_float(guint32 bits)
+{
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+guint32 as_bits(float f)
+{
+    guint32 bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+/// pow(x, e) for x > 0, to about 1e-6 relative to the result, flushing tiny results to 2^-126.
+float fast_pow(float x, float e)
+{
+    // log2(x) from the exponent and the mantissa brought into [sqrt(1/2), sqrt(2)]
+    guint32 bits = as_bits(std::max(x, FLT_MIN));
+    float exponent = gint32(bits >> 23) - 127;
+    float m = as_float((bits & 0x7fffff) | 0x3f800000);
+    if (m > float(M_SQRT2)) {
+        m = m * 0.5f;
+        exponent = exponent + 1.0f;
+    }
+    float t = (m - 1.0f) / (m + 1.0f);
+    float t2 = t * t;
+    float log2 = exponent + t * (LOG2_C[0] + t2 * (LOG2_C[1] + t2 * (LOG2_C[2] + t2 * LOG2_C[3])));
+
+    // 2^y as 2^i * 2^f with i the nearest integer to y
+    float y = std::clamp(e * log2, -126.0f, 126.0f);
+    float i = std::nearbyint(y);
+    float f = y - i;
+    float p = 1.0f + f * (EXP2_C[0] + f * (EXP2_C[1] + f * (EXP2_C[2] + f * (EXP2_C[3]
+                    + f * (EXP2_C[4] + f * EXP2_C[5])))));
+    return p * as_float(guint32(gint32(i) + 127) << 23);
+}
+
+guint32 to_u8(float v)
+{
+    return guint32((v > 0.0f ? std::min(v, 255.0f) : 0.0f) + 0.5f);
+}
+
+void surface_normals(float const *above, float const *row, float const *below, int n,
+                     float surface_scale, float *nx, float *ny, float *nz)
+{
+    float const f = -surface_scale / (255.0f * 4.0f);
+    for (int i = 0; i < n; ++i) {
+        float sx = (above[i+1] - above[i-1]) + 2.0f * (row[i+1] - row[i-1])
+                 + (below[i+1] - below[i-1]);
+        float sy = (below[i-1] + 2.0f * below[i] + below[i+1])
+                 - (above[i-1] + 2.0f * above[i] + above[i+1]);
+        float x = f * sx, y = f * sy;
+        float inv = 1.0f / std::sqrt(x * x + y * y + 1.0f);
+        nx[i] = x * inv;
+        ny[i] = y * inv;
+        nz[i] = inv;
+    }
+}
+
+/// Unit vector from the surface at (x, y) towards the light, and the color of the light there.
+void light_ray(InkLighting const &light, float x, float y, float alpha, float *l, float *color)
+{
+    if (light.type == InkLighting::DISTANT) {
+        std::copy(light.direction, light.direction + 3, l);
+        std::copy(light.color, light.color + 3, color);
+        return;
+    }
+
+    float lx = light.position[0] - x;
+    float ly = light.position[1] - y;
+    float lz = light.position[2] - alpha * (light.surface_scale / 255.0f);
+    float inv = 1.0f / std::sqrt(lx * lx + ly * ly + lz * lz);
+    l[0] = lx * inv;
+    l[1] = ly * inv;
+    l[2] = lz * inv;
+
+    float factor = 1.0f;
+    if (light.type == InkLighting::SPOT) {
+        float s = -(l[0] * light.spot_axis[0] + l[1] * light.spot_axis[1] + l[2] * light.spot_axis[2]);
+        factor = s > light.spot_cos_cone && s > 0.0f ? fast_pow(s, light.spot_exponent) : 0.0f;
+    }
+    for (int c = 0; c < 3; ++c) {
+        color[c] = light.color[c] * factor;
+    }
+}
+
+void diffuse_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                      float const *nx, float const *ny, float const *nz, guint32 *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        float l[3], color[3];
+        light_ray(light, x + i, y, alpha[i], l, color);
+        float k = light.constant * (nx[i] * l[0] + ny[i] * l[1] + nz[i] * l[2]);
+
+        guint32 r = to_u8(k * color[0]);
+        guint32 g = to_u8(k * color[1]);
+        guint32 b = to_u8(k * color[2]);
+        ASSEMBLE_ARGB32(px, 255, r, g, b)
+        out[i] = px;
+    }
+}
+
+void specular_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                       float const *nx, float const *ny, float const *nz, guint32 *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        float l[3], color[3];
+        light_ray(light, x + i, y, alpha[i], l, color);
+        // halfway vector between the light and the eye, which is at (0, 0, 1)
+        float hx = l[0], hy = l[1], hz = l[2] + 1.0f;
+        float inv = 1.0f / std::sqrt(hx * hx + hy * hy + hz * hz);
+        float sp = (nx[i] * hx + ny[i] * hy + nz[i] * hz) * inv;
+        float k = sp > 0.0f ? light.constant * fast_pow(sp, light.exponent) : 0.0f;
+
+        guint32 r = to_u8(k * color[0]);
+        guint32 g = to_u8(k * color[1]);
+        guint32 b = to_u8(k * color[2]);
+        guint32 a = std::max(std::max(r, g), b);
+        r = ::premul_alpha(r, a);
+        g = ::premul_alpha(g, a);
+        b = ::premul_alpha(b, a);
+        ASSEMBLE_ARGB32(px, a, r, g, b)
+        out[i] = px;
+    }
+}
+
+void gouraud(float const *start, float const *step, guint32 *out, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        guint32 a = to_u8(start[0] + float(i) * step[0]);
+        guint32 r = to_u8(start[1] + float(i) * step[1]);
+        guint32 g = to_u8(start[2] + float(i) * step[2]);
+        guint32 b = to_u8(start[3] + float(i) * step[3]);
+        ASSEMBLE_ARGB32(px, a, r, g, b)
+        out[i] = px;
+    }
+}
+
+Kernels const kernels = {
+    "scalar",
+    premul_alpha,
+    unpremul_alpha,
+    color_matrix,
+    hue_rotate,
+    arithmetic,
+    surface_normals,
+    diffuse_lighting,
+    specular_lighting,
+    gouraud
+};
+
+} // namespace scalar
+
+#ifdef INK_SIMD_X86
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#endif
+
+namespace sse2 {
+
+struct V {
+    using I = __m128i;
+    using F = __m128;
+    static constexpr int N = 4;
+
+    static I load(guint32 const *p) { return _mm_loadu_si128(reinterpret_cast<I const *>(p)); }
+    static void store(guint32 *p, I v) { _mm_storeu_si128(reinterpret_cast<I *>(p), v); }
+    static I set1(gint32 x) { return _mm_set1_epi32(x); }
+    static F setf(float x) { return _mm_set1_ps(x); }
+
+    static I bit_and(I a, I b) { return _mm_and_si128(a, b); }
+    static I bit_or(I a, I b) { return _mm_or_si128(a, b); }
+    static I srli(I a, int n) { return _mm_srli_epi32(a, n); }
+    static I slli(I a, int n) { return _mm_slli_epi32(a, n); }
+
+    static I add(I a, I b) { return _mm_add_epi32(a, b); }
+    static I mul16(I a, I b) { return _mm_madd_epi16(a, b); }
+    static I mullo(I a, I b) {
+        // SSE2 has no 32-bit multiply with a 32-bit result; multiply even and odd lanes
+        I even = _mm_mul_epu32(a, b);
+        I odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    static I cmpeq(I a, I b) { return _mm_cmpeq_epi32(a, b); }
+    static I cmpgt(I a, I b) { return _mm_cmpgt_epi32(a, b); }
+    static I select(I mask, I a, I b) {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+    static I min(I a, I b) { return select(cmpgt(a, b), b, a); }
+    static I max(I a, I b) { return select(cmpgt(a, b), a, b); }
+
+    static I index() { return _mm_setr_epi32(0, 1, 2, 3); }
+
+    static F load(float const *p) { return _mm_loadu_ps(p); }
+    static void store(float *p, F v) { _mm_storeu_ps(p, v); }
+    static F as_float(I a) { return _mm_castsi128_ps(a); }
+    static I as_int(F a) { return _mm_castps_si128(a); }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F sqrt(F a) { return _mm_sqrt_ps(a); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F cmpgt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static F bit_and(F a, F b) { return _mm_and_ps(a, b); }
+    static F select(F mask, F a, F b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+    static F cvtf(I a) { return _mm_cvtepi32_ps(a); }
+    static I cvtt(F a) { return _mm_cvttps_epi32(a); }
+    static I cvtr(F a) { return _mm_cvtps_epi32(a); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+};
+
+#define ISA_NAME "SSE2"
+#include "display/cairo-simd-impl.h"
+#undef ISA_NAME
+
+} // namespace sse2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace avx2 {
+
+struct V {
+    using I = __m256i;
+    using F = __m256;
+    static constexpr int N = 8;
+
+    static I load(guint32 const *p) { return _mm256_loadu_si256(reinterpret_cast<I const *>(p)); }
+    static void store(guint32 *p, I v) { _mm256_storeu_si256(reinterpret_cast<I *>(p), v); }
+    static I set1(gint32 x) { return _mm256_set1_epi32(x); }
+    static F setf(float x) { return _mm256_set1_ps(x); }
+
+    static I bit_and(I a, I b) { return _mm256_and_si256(a, b); }
+    static I bit_or(I a, I b) { return _mm256_or_si256(a, b); }
+    static I srli(I a, int n) { return _mm256_srli_epi32(a, n); }
+    static I slli(I a, int n) { return _mm256_slli_epi32(a, n); }
+
+    static I add(I a, I b) { return _mm256_add_epi32(a, b); }
+    static I mul16(I a, I b) { return _mm256_madd_epi16(a, b); }
+    static I mullo(I a, I b) { return _mm256_mullo_epi32(a, b); }
+
+    static I cmpeq(I a, I b) { return _mm256_cmpeq_epi32(a, b); }
+    static I cmpgt(I a, I b) { return _mm256_cmpgt_epi32(a, b); }
+    static I select(I mask, I a, I b) { return _mm256_blendv_epi8(b, a, mask); }
+    static I min(I a, I b) { return _mm256_min_epi32(a, b); }
+    static I max(I a, I b) { return _mm256_max_epi32(a, b); }
+
+    static I index() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+
+    static F load(float const *p) { return _mm256_loadu_ps(p); }
+    static void store(float *p, F v) { _mm256_storeu_ps(p, v); }
+    static F as_float(I a) { return _mm256_castsi256_ps(a); }
+    static I as_int(F a) { return _mm256_castps_si256(a); }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F sqrt(F a) { return _mm256_sqrt_ps(a); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F cmpgt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static F bit_and(F a, F b) { return _mm256_and_ps(a, b); }
+    static F select(F mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+
+    static F cvtf(I a) { return _mm256_cvtepi32_ps(a); }
+    static I cvtt(F a) { return _mm256_cvttps_epi32(a); }
+    static I cvtr(F a) { return _mm256_cvtps_epi32(a); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+};
+
+#define ISA_NAME "AVX2"
+#include "display/cairo-simd-impl.h"
+#undef ISA_NAME
+
+} // namespace avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif // INK_SIMD_X86
+
+bool supported(Kernels const &k)
+{
+#ifdef INK_SIMD_X86
+    __builtin_cpu_init();
+    if (&k == &avx2::kernels) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (&k == &sse2::kernels) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return &k == &scalar::kernels;
+}
+
+/// All kernels, the best first.
+Kernels const *const all_kernels[] = {
+#ifdef INK_SIMD_X86
+    &avx2::kernels,
+    &sse2::kernels,
+#endif
+    &scalar::kernels
+};
+
+Kernels const *&selected_kernels()
+{
+    static Kernels const *selected = [] {
+        for (auto k : all_kernels) {
+            if (supported(*k)) {
+                return k;
+            }
+        }
+        return &scalar::kernels;
+    }();
+    return selected;
+}
+
+Kernels const &kernels()
+{
+    return *selected_kernels();
+}
+
+} // namespace
+
+void ink_span_premul_alpha(guint32 const *in, guint32 *out, int n)
+{
+    kernels().premul_alpha(in, out, n);
+}
+
+void ink_span_unpremul_alpha(guint32 const *in, guint32 *out, int n)
+{
+    kernels().unpremul_alpha(in, out, n);
+}
+
+/// The vector versions need the multipliers of the matrix to fit in 16 bits.
+bool ink_span_color_matrix_supported(gint32 const *matrix)
+{
+    for (int k = 0; k < 20; ++k) {
+        if (k % 5 != 4 && (matrix[k] < G_MININT16 || matrix[k] > G_MAXINT16)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ink_span_color_matrix(guint32 const *in, guint32 *out, int n, gint32 const *matrix)
+{
+    kernels().color_matrix(in, out, n, matrix);
+}
+
+void ink_span_hue_rotate(guint32 const *in, guint32 *out, int n, gint32 const *matrix)
+{
+    kernels().hue_rotate(in, out, n, matrix);
+}
+
+void ink_span_arithmetic(guint32 const *in1, guint32 const *in2, guint32 *out, int n,
+                         gint32 k1, gint32 k2, gint32 k3, gint32 k4)
+{
+    kernels().arithmetic(in1, in2, out, n, k1, k2, k3, k4);
+}
+
+void ink_span_surface_normals(float const *above, float const *row, float const *below, int n,
+                              float surface_scale, float *nx, float *ny, float *nz)
+{
+    kernels().surface_normals(above, row, below, n, surface_scale, nx, ny, nz);
+}
+
+void ink_span_diffuse_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                               float const *nx, float const *ny, float const *nz,
+                               guint32 *out, int n)
+{
+    kernels().diffuse_lighting(light, x, y, alpha, nx, ny, nz, out, n);
+}
+
+void ink_span_specular_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                                float const *nx, float const *ny, float const *nz,
+                                guint32 *out, int n)
+{
+    kernels().specular_lighting(light, x, y, alpha, nx, ny, nz, out, n);
+}
+
+void ink_span_gouraud(float const *start, float const *step, guint32 *out, int n)
+{
+    kernels().gouraud(start, step, out, n);
+}
+
+char const *ink_span_isa()
+{
+    return kernels().isa;
+}
+
+bool ink_span_set_isa(char const *isa)
+{
+    for (auto k : all_kernels) {
+        if (std::strcmp(k->isa, isa) == 0 && supported(*k)) {
+            selected_kernels() = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
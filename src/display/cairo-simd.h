@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Pixel span kernels for the Cairo software filters, with SIMD implementations
+ * selected at runtime.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_CAIRO_SIMD_H
+#define SEEN_INKSCAPE_DISPLAY_CAIRO_SIMD_H
+
+#include <glib.h>
+
+/*
+ * All functions below process n premultiplied ARGB32 pixels and give exactly the same
+ * results as the per-pixel functors they replace. The input and output may be the same
+ * buffer, but must not overlap otherwise.
+ */
+
+/// Multiply the color channels by alpha.
+void ink_span_premul_alpha(guint32 const *in, guint32 *out, int n);
+/// Divide the color channels by alpha; pixels with zero alpha are left unchanged.
+void ink_span_unpremul_alpha(guint32 const *in, guint32 *out, int n);
+
+bool ink_span_color_matrix_supported(gint32 const *matrix);
+/**
+ * Apply the feColorMatrix matrix to unpremultiplied colors.
+ * The matrix is in the fixed-point format of FilterColorMatrix::ColorMatrixMatrix:
+ * 20 values, multipliers scaled by 255 and offsets by 255*255. Only matrices for which
+ * ink_span_color_matrix_supported() returns true can be used.
+ */
+void ink_span_color_matrix(guint32 const *in, guint32 *out, int n, gint32 const *matrix);
+/// Apply the 3x3 feColorMatrix hueRotate matrix, with values scaled by 255.
+void ink_span_hue_rotate(guint32 const *in, guint32 *out, int n, gint32 const *matrix);
+/// feComposite arithmetic, with k1 scaled by 255, k2 and k3 by 255^2 and k4 by 255^3.
+void ink_span_arithmetic(guint32 const *in1, guint32 const *in2, guint32 *out, int n,
+                         gint32 k1, gint32 k2, gint32 k3, gint32 k4);
+
+/*
+ * The lighting kernels below work in single precision and use an approximation of pow(),
+ * so their results can differ from the feDiffuseLighting and feSpecularLighting functors
+ * by one level.
+ */
+
+/// Light source and surface of the lighting kernels, with positions in pixels.
+struct InkLighting {
+    enum Type { DISTANT, POINT, SPOT };
+
+    Type type;
+    float direction[3];   ///< unit vector towards a distant light
+    float position[3];    ///< position of a point or spot light
+    float spot_axis[3];   ///< unit vector in the direction a spot light points at
+    float spot_cos_cone;  ///< cosine of the limiting cone angle of a spot light
+    float spot_exponent;  ///< specular exponent of a spot light
+    float color[3];       ///< red, green and blue of the lighting color, from 0 to 255
+    float surface_scale;  ///< height of the surface where alpha is 255
+    float constant;       ///< diffuse or specular constant
+    float exponent;       ///< specular exponent of the surface
+};
+
+/**
+ * Compute the unit surface normals of n pixels of a row from alpha values in [0, 255], with
+ * the Sobel kernels of the lighting filters for interior pixels. Normal i uses elements i-1
+ * to i+1 of the row and the rows above and below it.
+ */
+void ink_span_surface_normals(float const *above, float const *row, float const *below, int n,
+                              float surface_scale, float *nx, float *ny, float *nz);
+/**
+ * Light n pixels starting at (x, y), given their alpha values and unit surface normals.
+ * The output is opaque, like the result of feDiffuseLighting.
+ */
+void ink_span_diffuse_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                               float const *nx, float const *ny, float const *nz,
+                               guint32 *out, int n);
+/// Same as ink_span_diffuse_lighting(), for feSpecularLighting.
+void ink_span_specular_lighting(InkLighting const &light, int x, int y, float const *alpha,
+                                float const *nx, float const *ny, float const *nz,
+                                guint32 *out, int n);
+
+/**
+ * Fill n pixels with colors interpolated linearly along the span, for Gouraud shading.
+ * Channel c of pixel i is start[c] + i * step[c], rounded and clamped to [0, 255], with the
+ * channels in the order alpha, red, green, blue. The colors are taken to be premultiplied.
+ */
+void ink_span_gouraud(float const *start, float const *step, guint32 *out, int n);
+
+/// Name of the instruction set used by the span kernels, for diagnostics.
+char const *ink_span_isa();
+/**
+ * Use the kernels for the instruction set named @a isa, as returned by ink_span_isa(), or
+ * "scalar". Returns false if the processor does not support it. For testing; this must not be
+ * called while other threads use the kernels.
+ */
+bool ink_span_set_isa(char const *isa);
+
+#endif // SEEN_INKSCAPE_DISPLAY_CAIRO_SIMD_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -19,18 +19,65 @@
 
 #include <glib.h>
 
-#ifdef HAVE_OPENMP
-#include <omp.h>
-#include "preferences.h"
-// single-threaded operation if the number of pixels is below this threshold
-static const int OPENMP_THRESHOLD = 2048;
-#endif
-
 #include <algorithm>
 #include <cairo.h>
 #include <cmath>
+#include <type_traits>
 #include "display/nr-3dutils.h"
 #include "display/cairo-utils.h"
+#include "display/dispatch-pool.h"
+
+// single-threaded operation if the number of pixels is below this threshold
+static const int PARALLEL_THRESHOLD = 2048;
+
+/*
+ * Functors can provide a span version of their per-pixel operator(), which processes
+ * a row of ARGB32 pixels at once, usually with SIMD instructions (see cairo-simd.h).
+ * It is used instead of operator() whenever the input and output are ARGB32:
+ *     void filterSpan(guint32 const *in, guint32 *out, int n);
+ *     void blendSpan(guint32 const *in1, guint32 const *in2, guint32 *out, int n);
+ */
+
+// number of pixels passed to a span function at once in the stride-less case
+static const int SPAN_BLOCK = 1024;
+
+template <typename Filter, typename = void>
+struct ink_has_filter_span : std::false_type {};
+template <typename Filter>
+struct ink_has_filter_span<Filter, std::void_t<decltype(std::declval<Filter &>().filterSpan(
+    std::declval<guint32 const *>(), std::declval<guint32 *>(), 0))>> : std::true_type {};
+
+template <typename Blend, typename = void>
+struct ink_has_blend_span : std::false_type {};
+template <typename Blend>
+struct ink_has_blend_span<Blend, std::void_t<decltype(std::declval<Blend &>().blendSpan(
+    std::declval<guint32 const *>(), std::declval<guint32 const *>(),
+    std::declval<guint32 *>(), 0))>> : std::true_type {};
+
+template <typename Filter>
+inline void ink_filter_span(Filter &filter, guint32 const *in, guint32 *out, int n)
+{
+    if constexpr (ink_has_filter_span<Filter>::value) {
+        filter.filterSpan(in, out, n);
+    } else {
+        for (int i = 0; i < n; ++i) {
+            out[i] = filter(in[i]);
+        }
+    }
+}
+
+template <typename Blend>
+inline void ink_blend_span(Blend &blend, guint32 const *in1, guint32 const *in2, guint32 *out,
+                           int n)
+{
+    if constexpr (ink_has_blend_span<Blend>::value) {
+        blend.blendSpan(in1, in2, out, n);
+    } else {
+        for (int i = 0; i < n; ++i) {
+            out[i] = blend(in1[i], in2[i]);
+        }
+    }
+}
 
 /**
  * Blend two surfaces using the supplied functor.
@@ -72,45 +119,27 @@ void ink_cairo_surface_blend(cairo_surface_t *in1, cairo_surface_t *in2, cairo_s
     guint32 *const in2_data = reinterpret_cast<guint32*>(cairo_image_surface_get_data(in2));
     guint32 *const out_data = reinterpret_cast<guint32*>(cairo_image_surface_get_data(out));
 
-    // NOTE
-    // OpenMP probably doesn't help much here.
-    // It would be better to render more than 1 tile at a time.
-    #if HAVE_OPENMP
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    int numOfThreads = prefs->getIntLimited("/options/threading/numthreads", omp_get_num_procs(), 1, 256);
-    if (numOfThreads){} // inform compiler we are using it.
-    #endif
-
     // The number of code paths here is evil.
     if (bpp1 == 4) {
         if (bpp2 == 4) {
             if (fast_path) {
-                #if HAVE_OPENMP
-                #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-                #endif
-                for (int i = 0; i < limit; ++i) {
-                    *(out_data + i) = blend(*(in1_data + i), *(in2_data + i));
-                }
+                int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+                Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int i, int) {
+                    int start = i * SPAN_BLOCK;
+                    ink_blend_span(blend, in1_data + start, in2_data + start, out_data + start,
+                                   std::min(SPAN_BLOCK, limit - start));
+                });
             } else {
-                #if HAVE_OPENMP
-                #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-                #endif
-                for (int i = 0; i < h; ++i) {
+                Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                     guint32 *in1_p = in1_data + i * stride1/4;
                     guint32 *in2_p = in2_data + i * stride2/4;
                     guint32 *out_p = out_data + i * strideout/4;
-                    for (int j = 0; j < w; ++j) {
-                        *out_p = blend(*in1_p, *in2_p);
-                        ++in1_p; ++in2_p; ++out_p;
-                    }
-                }
+                    ink_blend_span(blend, in1_p, in2_p, out_p, w);
+                });
             }
         } else {
             // bpp2 == 1
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < h; ++i) {
+            Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                 guint32 *in1_p = in1_data + i * stride1/4;
                 guint8  *in2_p = reinterpret_cast<guint8*>(in2_data) + i * stride2;
                 guint32 *out_p = out_data + i * strideout/4;
@@ -120,15 +149,12 @@ void ink_cairo_surface_blend(cairo_surface_t *in1, cairo_surface_t *in2, cairo_s
                     *out_p = blend(*in1_p, in2_px);
                     ++in1_p; ++in2_p; ++out_p;
                 }
-            }
+            });
         }
     } else {
         if (bpp2 == 4) {
             // bpp1 == 1
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < h; ++i) {
+            Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                 guint8  *in1_p = reinterpret_cast<guint8*>(in1_data) + i * stride1;
                 guint32 *in2_p = in2_data + i * stride2/4;
                 guint32 *out_p = out_data + i * strideout/4;
@@ -138,27 +164,25 @@ void ink_cairo_surface_blend(cairo_surface_t *in1, cairo_surface_t *in2, cairo_s
                     *out_p = blend(in1_px, *in2_p);
                     ++in1_p; ++in2_p; ++out_p;
                 }
-            }
+            });
         } else {
             // bpp1 == 1 && bpp2 == 1
             if (fast_path) {
-                #if HAVE_OPENMP
-                #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-                #endif
-                for (int i = 0; i < limit; ++i) {
-                    guint8 *in1_p = reinterpret_cast<guint8*>(in1_data) + i;
-                    guint8 *in2_p = reinterpret_cast<guint8*>(in2_data) + i;
-                    guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i;
-                    guint32 in1_px = *in1_p; in1_px <<= 24;
-                    guint32 in2_px = *in2_p; in2_px <<= 24;
-                    guint32 out_px = blend(in1_px, in2_px);
-                    *out_p = out_px >> 24;
-                }
+                int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+                Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int b, int) {
+                    int end = std::min(limit, (b + 1) * SPAN_BLOCK);
+                    for (int i = b * SPAN_BLOCK; i < end; ++i) {
+                        guint8 *in1_p = reinterpret_cast<guint8*>(in1_data) + i;
+                        guint8 *in2_p = reinterpret_cast<guint8*>(in2_data) + i;
+                        guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i;
+                        guint32 in1_px = *in1_p; in1_px <<= 24;
+                        guint32 in2_px = *in2_p; in2_px <<= 24;
+                        guint32 out_px = blend(in1_px, in2_px);
+                        *out_p = out_px >> 24;
+                    }
+                });
             } else {
-                #if HAVE_OPENMP
-                #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-                #endif
-                for (int i = 0; i < h; ++i) {
+                Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                     guint8 *in1_p = reinterpret_cast<guint8*>(in1_data) + i * stride1;
                     guint8 *in2_p = reinterpret_cast<guint8*>(in2_data) + i * stride2;
                     guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i * strideout;
@@ -169,7 +193,7 @@ void ink_cairo_surface_blend(cairo_surface_t *in1, cairo_surface_t *in2, cairo_s
                         *out_p = out_px >> 24;
                         ++in1_p; ++in2_p; ++out_p;
                     }
-                }
+                });
             }
         }
     }
@@ -203,31 +227,26 @@ void ink_cairo_surface_filter(cairo_surface_t *in, cairo_surface_t *out, Filter
     guint32 *const in_data  = reinterpret_cast<guint32*>(cairo_image_surface_get_data(in));
     guint32 *const out_data = reinterpret_cast<guint32*>(cairo_image_surface_get_data(out));
 
-    #if HAVE_OPENMP
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    int numOfThreads = prefs->getIntLimited("/options/threading/numthreads", omp_get_num_procs(), 1, 256);
-    if (numOfThreads){} // inform compiler we are using it.
-    #endif
-
     // this is provided just in case, to avoid problems with strict aliasing rules
     if (in == out) {
         if (bppin == 4) {
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < limit; ++i) {
-                *(in_data + i) = filter(*(in_data + i));
-            }
+            int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+            Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int i, int) {
+                int start = i * SPAN_BLOCK;
+                ink_filter_span(filter, in_data + start, in_data + start,
+                                std::min(SPAN_BLOCK, limit - start));
+            });
         } else {
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < limit; ++i) {
-                guint8 *in_p = reinterpret_cast<guint8*>(in_data) + i;
-                guint32 in_px = *in_p; in_px <<= 24;
-                guint32 out_px = filter(in_px);
-                *in_p = out_px >> 24;
-            }
+            int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+            Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int b, int) {
+                int end = std::min(limit, (b + 1) * SPAN_BLOCK);
+                for (int i = b * SPAN_BLOCK; i < end; ++i) {
+                    guint8 *in_p = reinterpret_cast<guint8*>(in_data) + i;
+                    guint32 in_px = *in_p; in_px <<= 24;
+                    guint32 out_px = filter(in_px);
+                    *in_p = out_px >> 24;
+                }
+            });
         }
         cairo_surface_mark_dirty(out);
         return;
@@ -237,32 +256,23 @@ void ink_cairo_surface_filter(cairo_surface_t *in, cairo_surface_t *out, Filter
         if (bppout == 4) {
             // bppin == 4, bppout == 4
             if (fast_path) {
-                #if HAVE_OPENMP
-                #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-                #endif
-                for (int i = 0; i < limit; ++i) {
-                    *(out_data + i) = filter(*(in_data + i));
-                }
+                int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+                Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int i, int) {
+                    int start = i * SPAN_BLOCK;
+                    ink_filter_span(filter, in_data + start, out_data + start,
+                                    std::min(SPAN_BLOCK, limit - start));
+                });
             } else {
-                #if HAVE_OPENMP
-                #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-                #endif
-                for (int i = 0; i < h; ++i) {
+                Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                     guint32 *in_p = in_data + i * stridein/4;
                     guint32 *out_p = out_data + i * strideout/4;
-                    for (int j = 0; j < w; ++j) {
-                        *out_p = filter(*in_p);
-                        ++in_p; ++out_p;
-                    }
-                }
+                    ink_filter_span(filter, in_p, out_p, w);
+                });
             }
         } else {
             // bppin == 4, bppout == 1
             // we use this path with COLORMATRIX_LUMINANCETOALPHA
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < h; ++i) {
+            Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                 guint32 *in_p = in_data + i * stridein/4;
                 guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i * strideout;
                 for (int j = 0; j < w; ++j) {
@@ -270,26 +280,24 @@ void ink_cairo_surface_filter(cairo_surface_t *in, cairo_surface_t *out, Filter
                     *out_p = out_px >> 24;
                     ++in_p; ++out_p;
                 }
-            }
+            });
         }
     } else if (bppout == 1) {
         // bppin == 1, bppout == 1
         if (fast_path) {
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < limit; ++i) {
-                guint8 *in_p = reinterpret_cast<guint8*>(in_data) + i;
-                guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i;
-                guint32 in_px = *in_p; in_px <<= 24;
-                guint32 out_px = filter(in_px);
-                *out_p = out_px >> 24;
-            }
+            int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+            Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int b, int) {
+                int end = std::min(limit, (b + 1) * SPAN_BLOCK);
+                for (int i = b * SPAN_BLOCK; i < end; ++i) {
+                    guint8 *in_p = reinterpret_cast<guint8*>(in_data) + i;
+                    guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i;
+                    guint32 in_px = *in_p; in_px <<= 24;
+                    guint32 out_px = filter(in_px);
+                    *out_p = out_px >> 24;
+                }
+            });
         } else {
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < h; ++i) {
+            Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                 guint8 *in_p = reinterpret_cast<guint8*>(in_data) + i * stridein;
                 guint8 *out_p = reinterpret_cast<guint8*>(out_data) + i * strideout;
                 for (int j = 0; j < w; ++j) {
@@ -298,30 +306,28 @@ void ink_cairo_surface_filter(cairo_surface_t *in, cairo_surface_t *out, Filter
                     *out_p = out_px >> 24;
                     ++in_p; ++out_p;
                 }
-            }
+            });
         }
     } else {
         // bppin == 1, bppout == 4
         // used in COLORMATRIX_MATRIX when in is NR_FILTER_SOURCEALPHA
         if (fast_path) {
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < limit; ++i) {
-                guint8 in_p = reinterpret_cast<guint8*>(in_data)[i];
-                out_data[i] = filter(guint32(in_p) << 24);
-            }
+            int blocks = (limit + SPAN_BLOCK - 1) / SPAN_BLOCK;
+            Inkscape::dispatch_threshold(blocks, limit > PARALLEL_THRESHOLD, [&](int b, int) {
+                int end = std::min(limit, (b + 1) * SPAN_BLOCK);
+                for (int i = b * SPAN_BLOCK; i < end; ++i) {
+                    guint8 in_p = reinterpret_cast<guint8*>(in_data)[i];
+                    out_data[i] = filter(guint32(in_p) << 24);
+                }
+            });
         } else {
-            #if HAVE_OPENMP
-            #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-            #endif
-            for (int i = 0; i < h; ++i) {
+            Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
                 guint8 *in_p = reinterpret_cast<guint8*>(in_data) + i * stridein;
                 guint32 *out_p = out_data + i * strideout/4;
                 for (int j = 0; j < w; ++j) {
                     out_p[j] = filter(guint32(in_p[j]) << 24);
                 }
-            }
+            });
         }
     }
     cairo_surface_mark_dirty(out);
@@ -351,37 +357,29 @@ void ink_cairo_surface_synthesize(cairo_surface_t *out, cairo_rectangle_t const
 
     unsigned char *out_data = cairo_image_surface_get_data(out);
 
-    #if HAVE_OPENMP
     int limit = w * h;
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    int numOfThreads = prefs->getIntLimited("/options/threading/numthreads", omp_get_num_procs(), 1, 256);
-    if (numOfThreads){} // inform compiler we are using it.
-    #endif
+    int y0 = out_area.y;
 
     if (bppout == 4) {
-        #if HAVE_OPENMP
-        #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-        #endif
-        for (int i = out_area.y; i < h; ++i) {
+        Inkscape::dispatch_threshold(h - y0, limit > PARALLEL_THRESHOLD, [&](int k, int) {
+            int i = y0 + k;
             guint32 *out_p = reinterpret_cast<guint32*>(out_data + i * strideout);
             for (int j = out_area.x; j < w; ++j) {
                 *out_p = synth(j, i);
                 ++out_p;
             }
-        }
+        });
     } else {
         // bppout == 1
-        #if HAVE_OPENMP
-        #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-        #endif
-        for (int i = out_area.y; i < h; ++i) {
+        Inkscape::dispatch_threshold(h - y0, limit > PARALLEL_THRESHOLD, [&](int k, int) {
+            int i = y0 + k;
             guint8 *out_p = out_data + i * strideout;
             for (int j = out_area.x; j < w; ++j) {
                 guint32 out_px = synth(j, i);
                 *out_p = out_px >> 24;
                 ++out_p;
             }
-        }
+        });
     }
     cairo_surface_mark_dirty(out);
 }
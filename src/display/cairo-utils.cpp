@@ -11,6 +11,8 @@
 
 #include "display/cairo-utils.h"
 
+#include <array>
+#include <cmath>
 #include <stdexcept>
 
 #include <glib/gstdio.h>
@@ -34,6 +36,8 @@
 #include "document.h"
 #include "preferences.h"
 #include "util/units.h"
+#include "display/cairo-simd.h"
+#include "display/surface-pool.h"
 #include "helper/pixbuf-ops.h"
 
 
@@ -543,6 +547,7 @@ guchar *Pixbuf::pixels() {
 }
 void Pixbuf::markDirty() {
     cairo_surface_mark_dirty(_surface);
+    ++_generation;
 }
 
 void Pixbuf::_forceAlpha()
@@ -588,6 +593,7 @@ void Pixbuf::ensurePixelFormat(PixelFormat fmt)
                 gdk_pixbuf_get_height(_pixbuf),
                 gdk_pixbuf_get_rowstride(_pixbuf));
             _pixel_format = fmt;
+            ++_generation;
             return;
         }
         g_assert_not_reached();
@@ -600,6 +606,7 @@ void Pixbuf::ensurePixelFormat(PixelFormat fmt)
                 gdk_pixbuf_get_height(_pixbuf),
                 gdk_pixbuf_get_rowstride(_pixbuf));
             _pixel_format = fmt;
+            ++_generation;
             return;
         }
         if (fmt == PF_CAIRO) {
@@ -834,6 +841,99 @@ feed_pathvector_to_cairo (cairo_t *ct, Geom::PathVector const &pathv)
     }
 }
 
+namespace Inkscape {
+
+/**
+ * Record the path vector as cairo path data.
+ * Returns nullptr if the path contains elliptical arcs, which cairo approximates depending
+ * on the device transform; such paths have to be fed to the context every time.
+ */
+std::unique_ptr<CairoPath>
+CairoPath::create(Geom::PathVector const &pathv)
+{
+    std::unique_ptr<CairoPath> result(new CairoPath());
+    for (auto const &path : pathv) {
+        if (path.empty()) {
+            continue;
+        }
+        result->_add(CAIRO_PATH_MOVE_TO, {path.initialPoint()});
+        for (auto cit = path.begin(); cit != path.end_open(); ++cit) {
+            if (!result->_addCurve(*cit)) {
+                return nullptr;
+            }
+        }
+        if (path.closed()) {
+            result->_add(CAIRO_PATH_CLOSE_PATH, {});
+        }
+    }
+
+    result->_path.status = CAIRO_STATUS_SUCCESS;
+    result->_path.data = result->_data.data();
+    result->_path.num_data = result->_data.size();
+    return result;
+}
+
+/// Record a single curve, converting it the same way as feed_curve_to_cairo().
+bool
+CairoPath::_addCurve(Geom::Curve const &c)
+{
+    unsigned order = 0;
+    if (auto b = dynamic_cast<Geom::BezierCurve const *>(&c)) {
+        order = b->order();
+    }
+
+    switch (order) {
+    case 1:
+        _add(CAIRO_PATH_LINE_TO, {c.finalPoint()});
+        break;
+    case 2: {
+        auto const &q = static_cast<Geom::QuadraticBezier const &>(c);
+        // degree-elevate to cubic Bezier, since Cairo doesn't do quadratic Beziers
+        Geom::Point b1 = q[0] + (2./3) * (q[1] - q[0]);
+        Geom::Point b2 = b1 + (1./3) * (q[2] - q[0]);
+        _add(CAIRO_PATH_CURVE_TO, {b1, b2, q[2]});
+        break;
+    }
+    case 3: {
+        auto const &cb = static_cast<Geom::CubicBezier const &>(c);
+        _add(CAIRO_PATH_CURVE_TO, {cb[1], cb[2], cb[3]});
+        break;
+    }
+    default:
+        if (auto arc = dynamic_cast<Geom::EllipticalArc const *>(&c)) {
+            if (!arc->isChord()) {
+                return false;
+            }
+            _add(CAIRO_PATH_LINE_TO, {arc->finalPoint()});
+        } else {
+            for (auto const &iter : Geom::cubicbezierpath_from_sbasis(c.toSBasis(), 0.1)) {
+                if (!_addCurve(iter)) {
+                    return false;
+                }
+            }
+        }
+        break;
+    }
+    return true;
+}
+
+void
+CairoPath::_add(cairo_path_data_type_t type, std::initializer_list<Geom::Point> points)
+{
+    cairo_path_data_t header;
+    header.header.type = type;
+    header.header.length = points.size() + 1;
+    _data.push_back(header);
+    for (auto const &p : points) {
+        cairo_path_data_t point;
+        point.point.x = p[Geom::X];
+        point.point.y = p[Geom::Y];
+        _data.push_back(point);
+    }
+}
+
+} // namespace Inkscape
+
 SPColorInterpolation
 get_cairo_surface_ci(cairo_surface_t *surface) {
     void* data = cairo_surface_get_user_data( surface, &ink_color_interpolation_key );
@@ -961,6 +1061,31 @@ ink_cairo_surface_copy(cairo_surface_t *s)
     return ns;
 }
 
+/// Key for the surface whose pixels a view created by ink_cairo_surface_create_view() uses.
+static cairo_user_data_key_t ink_view_parent_key;
+
+/**
+ * Create an image surface which uses the pixels within @a area of the image surface @a s,
+ * given in pixels, without copying them. The view keeps a reference to @a s.
+ * After drawing to the view, call cairo_surface_mark_dirty() on @a s.
+ */
+cairo_surface_t *
+ink_cairo_surface_create_view(cairo_surface_t *s, Geom::IntRect const &area)
+{
+    cairo_surface_flush(s);
+    cairo_format_t format = cairo_image_surface_get_format(s);
+    int stride = cairo_image_surface_get_stride(s);
+    int bpp = format == CAIRO_FORMAT_A8 ? 1 : 4;
+    unsigned char *data = cairo_image_surface_get_data(s) + area.top() * stride + area.left() * bpp;
+
+    cairo_surface_t *view = cairo_image_surface_create_for_data(data, format, area.width(),
+                                                                area.height(), stride);
+    cairo_surface_set_user_data(view, &ink_view_parent_key, cairo_surface_reference(s),
+                                reinterpret_cast<cairo_destroy_func_t>(cairo_surface_destroy));
+    copy_cairo_surface_ci(s, view);
+    return view;
+}
+
 /**
  * Create an exact copy of an image surface.
  */
@@ -1005,9 +1130,38 @@ ink_cairo_surface_create_same_size(cairo_surface_t *s, cairo_content_t c)
     assert (y_scale > 0);
 
     cairo_surface_t *ns =
-        cairo_surface_create_similar(s, c,
-                                     ink_cairo_surface_get_width(s)/x_scale,
-                                     ink_cairo_surface_get_height(s)/y_scale);
+        ink_cairo_surface_create_similar(s, c,
+                                         ink_cairo_surface_get_width(s)/x_scale,
+                                         ink_cairo_surface_get_height(s)/y_scale);
+    return ns;
+}
+
+/**
+ * Same as cairo_surface_create_similar(), but image surfaces get their memory
+ * from the surface pool, which avoids allocating fresh memory on every render.
+ */
+cairo_surface_t *
+ink_cairo_surface_create_similar(cairo_surface_t *s, cairo_content_t c, int width, int height)
+{
+    if (cairo_surface_get_type(s) != CAIRO_SURFACE_TYPE_IMAGE) {
+        return cairo_surface_create_similar(s, c, width, height);
+    }
+
+    double x_scale = 0;
+    double y_scale = 0;
+    cairo_surface_get_device_scale(s, &x_scale, &y_scale);
+
+    cairo_format_t format = CAIRO_FORMAT_ARGB32;
+    if (c == CAIRO_CONTENT_ALPHA) {
+        format = CAIRO_FORMAT_A8;
+    } else if (c == CAIRO_CONTENT_COLOR) {
+        format = CAIRO_FORMAT_RGB24;
+    }
+
+    cairo_surface_t *ns = Inkscape::SurfacePool::get().create(format,
+                                                               std::ceil(width * x_scale),
+                                                               std::ceil(height * y_scale));
+    cairo_surface_set_device_scale(ns, x_scale, y_scale);
     return ns;
 }
 
@@ -1183,56 +1337,65 @@ void ink_cairo_surface_average_color_premul(cairo_surface_t *surface, double &r,
     a = CLAMP(a, 0.0, 1.0);
 }
 
-static guint32 srgb_to_linear( const guint32 c, const guint32 a ) {
-
-    const guint32 c1 = unpremul_alpha( c, a );
-
-    double cc = c1/255.0;
-
-    if( cc < 0.04045 ) {
-        cc /= 12.92;
-    } else {
-        cc = pow( (cc+0.055)/1.055, 2.4 );
-    }
-    cc *= 255.0;
-
-    const guint32 c2 = (int)cc;
-
-    return premul_alpha( c2, a );
-}
-
-static guint32 linear_to_srgb( const guint32 c, const guint32 a ) {
-
-    const guint32 c1 = unpremul_alpha( c, a );
-
-    double cc = c1/255.0;
-
-    if( cc < 0.0031308 ) {
-        cc *= 12.92;
-    } else {
-        cc = pow( cc, 1.0/2.4 )*1.055-0.055;
-    }
-    cc *= 255.0;
-
-    const guint32 c2 = (int)cc;
-
-    return premul_alpha( c2, a );
-}
+/**
+ * Converts the color of premultiplied pixels between sRGB and linearRGB, using a table of the
+ * conversion of every unpremultiplied component value.
+ */
+struct SurfaceColorSpaceLUT {
+    using Table = std::array<guint8, 256>;
 
-struct SurfaceSrgbToLinear {
+    explicit SurfaceColorSpaceLUT(Table const &lut) : _lut(lut) {}
 
-    guint32 operator()(guint32 in) {
+    guint32 operator()(guint32 in) const {
         EXTRACT_ARGB32(in, a,r,g,b)    ; // Unneeded semi-colon for indenting
         if( a != 0 ) {
-            r = srgb_to_linear( r, a );
-            g = srgb_to_linear( g, a );
-            b = srgb_to_linear( b, a );
+            r = premul_alpha( _lut[unpremul_alpha( r, a )], a );
+            g = premul_alpha( _lut[unpremul_alpha( g, a )], a );
+            b = premul_alpha( _lut[unpremul_alpha( b, a )], a );
         }
         ASSEMBLE_ARGB32(out, a,r,g,b);
         return out;
     }
+    void filterSpan(guint32 const *in, guint32 *out, int n) const {
+        // work in chunks which stay in the cache between the three steps
+        guint32 buf[256];
+        for (int i = 0; i < n; i += 256) {
+            int len = std::min(n - i, 256);
+            ink_span_unpremul_alpha(in + i, buf, len);
+            for (int j = 0; j < len; ++j) {
+                guint32 px = buf[j];
+                buf[j] = (px & 0xff000000) | (guint32(_lut[(px >> 16) & 0xff]) << 16) |
+                         (guint32(_lut[(px >> 8) & 0xff]) << 8) | guint32(_lut[px & 0xff]);
+            }
+            ink_span_premul_alpha(buf, out + i, len);
+        }
+    }
+
+    /// Conversion tables, with the components rounded to the nearest value.
+    static Table const &srgb_to_linear() {
+        static Table const table = make_table([] (double c) {
+            return c < 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4);
+        });
+        return table;
+    }
+    static Table const &linear_to_srgb() {
+        static Table const table = make_table([] (double c) {
+            return c < 0.0031308 ? c * 12.92 : pow(c, 1.0 / 2.4) * 1.055 - 0.055;
+        });
+        return table;
+    }
+
 private:
-    /* None */
+    template <typename Convert>
+    static Table make_table(Convert convert) {
+        Table table;
+        for (unsigned i = 0; i < 256; ++i) {
+            table[i] = CLAMP(std::lround(convert(i / 255.0) * 255.0), 0, 255);
+        }
+        return table;
+    }
+
+    Table const &_lut;
 };
 
 int ink_cairo_surface_srgb_to_linear(cairo_surface_t *surface)
@@ -1243,7 +1406,8 @@ int ink_cairo_surface_srgb_to_linear(cairo_surface_t *surface)
     // int stride = cairo_image_surface_get_stride(surface);
     // unsigned char *data = cairo_image_surface_get_data(surface);
 
-    ink_cairo_surface_filter( surface, surface, SurfaceSrgbToLinear() );
+    ink_cairo_surface_filter( surface, surface,
+                              SurfaceColorSpaceLUT(SurfaceColorSpaceLUT::srgb_to_linear()) );
 
     /* TODO convert this to OpenMP somehow */
     // for (int y = 0; y < height; ++y, data += stride) {
@@ -1262,22 +1426,6 @@ int ink_cairo_surface_srgb_to_linear(cairo_surface_t *surface)
     return width * height;
 }
 
-struct SurfaceLinearToSrgb {
-
-    guint32 operator()(guint32 in) {
-        EXTRACT_ARGB32(in, a,r,g,b)    ; // Unneeded semi-colon for indenting
-        if( a != 0 ) {
-            r = linear_to_srgb( r, a );
-            g = linear_to_srgb( g, a );
-            b = linear_to_srgb( b, a );
-        }
-        ASSEMBLE_ARGB32(out, a,r,g,b);
-        return out;
-    }
-private:
-    /* None */
-};
-
 SPBlendMode ink_cairo_operator_to_css_blend(cairo_operator_t cairo_operator)
 {
     // All of the blend modes are implemented in Cairo as of 1.10.
@@ -1410,7 +1558,8 @@ int ink_cairo_surface_linear_to_srgb(cairo_surface_t *surface)
     // int stride = cairo_image_surface_get_stride(surface);
     // unsigned char *data = cairo_image_surface_get_data(surface);
 
-    ink_cairo_surface_filter( surface, surface, SurfaceLinearToSrgb() );
+    ink_cairo_surface_filter( surface, surface,
+                              SurfaceColorSpaceLUT(SurfaceColorSpaceLUT::linear_to_srgb()) );
 
     // /* TODO convert this to OpenMP somehow */
     // for (int y = 0; y < height; ++y, data += stride) {
@@ -1429,6 +1578,18 @@ int ink_cairo_surface_linear_to_srgb(cairo_surface_t *surface)
     return width * height;
 }
 
+/// Same as ink_cairo_surface_srgb_to_linear(), for @a n premultiplied ARGB32 pixels.
+void ink_pixels_srgb_to_linear(guint32 *px, int n)
+{
+    SurfaceColorSpaceLUT(SurfaceColorSpaceLUT::srgb_to_linear()).filterSpan(px, px, n);
+}
+
+/// Same as ink_cairo_surface_linear_to_srgb(), for @a n premultiplied ARGB32 pixels.
+void ink_pixels_linear_to_srgb(guint32 *px, int n)
+{
+    SurfaceColorSpaceLUT(SurfaceColorSpaceLUT::linear_to_srgb()).filterSpan(px, px, n);
+}
+
 cairo_pattern_t *
 ink_cairo_pattern_create_checkerboard(guint32 rgba, bool use_alpha)
 {
@@ -13,6 +13,8 @@
 #ifndef SEEN_INKSCAPE_DISPLAY_CAIRO_UTILS_H
 #define SEEN_INKSCAPE_DISPLAY_CAIRO_UTILS_H
 
+#include <memory>
+#include <vector>
 #include <2geom/forward.h>
 #include <cairomm/cairomm.h>
 #include "style.h"
@@ -51,6 +53,8 @@ public:
     guchar const *pixels() const;
     guchar *pixels();
     void markDirty();
+    /// Changes whenever the pixels are modified in place, for data derived from them.
+    unsigned generation() const { return _generation; }
 
     bool hasMimeData() const;
     guchar const *getMimeData(gsize &len, std::string &mimetype) const;
@@ -79,6 +83,30 @@ public:
     std::string _path;
     PixelFormat _pixel_format;
     bool _cairo_store;
+    unsigned _generation = 0;
+};
+
+/** Cairo path data recorded from a path vector.
+ * Appending it to a context is much cheaper than feeding the path vector again,
+ * so it is kept by drawing items which render the same path many times.
+ * The data is in the coordinates of the path vector, so it stays valid when the
+ * transform of the context changes. */
+class CairoPath {
+public:
+    static std::unique_ptr<CairoPath> create(Geom::PathVector const &pathv);
+
+    CairoPath(CairoPath const &) = delete;
+    CairoPath &operator=(CairoPath const &) = delete;
+
+    cairo_path_t const *get() const { return &_path; }
+
+  private:
+    CairoPath() = default;
+    bool _addCurve(Geom::Curve const &c);
+    void _add(cairo_path_data_type_t type, std::initializer_list<Geom::Point> points);
+
+    std::vector<cairo_path_data_t> _data;
+    cairo_path_t _path;
 };
 
 } // namespace Inkscape
@@ -104,7 +132,9 @@ SPBlendMode ink_cairo_operator_to_css_blend(cairo_operator_t cairo_operator);
 cairo_surface_t *ink_cairo_surface_copy(cairo_surface_t *s);
 Cairo::RefPtr<Cairo::ImageSurface> ink_cairo_surface_copy(Cairo::RefPtr<Cairo::ImageSurface> surface);
 cairo_surface_t *ink_cairo_surface_create_identical(cairo_surface_t *s);
+cairo_surface_t *ink_cairo_surface_create_view(cairo_surface_t *s, Geom::IntRect const &area);
 cairo_surface_t *ink_cairo_surface_create_same_size(cairo_surface_t *s, cairo_content_t c);
+cairo_surface_t *ink_cairo_surface_create_similar(cairo_surface_t *s, cairo_content_t c, int width, int height);
 cairo_surface_t *ink_cairo_extract_alpha(cairo_surface_t *s);
 cairo_surface_t *ink_cairo_surface_create_output(cairo_surface_t *image, cairo_surface_t *bg);
 void ink_cairo_surface_blit(cairo_surface_t *src, cairo_surface_t *dest);
@@ -118,6 +148,8 @@ void ink_cairo_surface_average_color_premul(cairo_surface_t *surface, double &r,
 double srgb_to_linear( const double c );
 int ink_cairo_surface_srgb_to_linear(cairo_surface_t *surface);
 int ink_cairo_surface_linear_to_srgb(cairo_surface_t *surface);
+void ink_pixels_srgb_to_linear(guint32 *px, int n);
+void ink_pixels_linear_to_srgb(guint32 *px, int n);
 
 cairo_pattern_t *ink_cairo_pattern_create_checkerboard(guint32 rgba = 0xC4C4C4FF, bool use_alpha = false);
 // draw drop shadow around the 'rect' with given 'size' and 'color'; shadow extends to the right and bottom of rect
@@ -20,6 +20,7 @@
 
 #include <2geom/rect.h>
 #include <cairomm/context.h>
+#include <cairomm/surface.h>
 #include "display/rendermode.h"
 
 namespace Inkscape {
@@ -32,6 +33,7 @@ struct CanvasItemBuffer {
     int device_scale; // For high DPI monitors.
     bool outline_overlay_pass; // Hack for not painting page colour in outline overlay mode
     Cairo::RefPtr<Cairo::Context> cr;
+    Cairo::RefPtr<Cairo::ImageSurface> drawing; // Drawing already rendered for rect, e.g. by a render thread.
 };
 
 } // Namespace Inkscape
@@ -48,6 +48,8 @@ struct CachePref2Observer : public Inkscape::Preferences::Observer {
         Glib::ustring name = v.getEntryName();
         if (name == "size") {
             _canvas_item_drawing->get_drawing()->setCacheBudget((1 << 20) * v.getIntLimited(64, 0, 4096));
+        } else if (name == "glyphs") {
+            _canvas_item_drawing->get_drawing()->setGlyphAtlas(v.getBool(true));
         }
     }
     Inkscape::CanvasItemDrawing *_canvas_item_drawing;
@@ -185,6 +187,18 @@ void CanvasItemDrawing::render(Inkscape::CanvasItemBuffer *buf)
         return;
     }
 
+    if (buf->drawing) {
+        // Composite the content rendered in advance.
+        buf->cr->save();
+        buf->cr->set_source(buf->drawing, 0, 0);
+        buf->cr->paint();
+        buf->cr->restore();
+        // The color mode applies to the page background below as well.
+        Inkscape::DrawingContext dc(buf->cr->cobj(), buf->rect.min());
+        _drawing->applyColorMode(dc);
+        return;
+    }
+
     Inkscape::DrawingContext dc(buf->cr->cobj(), buf->rect.min());
     _drawing->update();
     _drawing->render(dc, buf->rect);
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Fixed-size pool of threads for running data-parallel rendering work.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/dispatch-pool.h"
+
+#include <algorithm>
+
+#include "preferences.h"
+
+namespace Inkscape {
+
+namespace {
+
+/// The pool whose work the current thread is taking part in, if any.
+thread_local DispatchPool const *current_pool = nullptr;
+
+} // namespace
+
+DispatchPool::DispatchPool(int size)
+{
+    for (int i = 1; i < size; i++) {
+        _threads.emplace_back([this, i] { _run(i); });
+    }
+}
+
+DispatchPool::~DispatchPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _shutdown = true;
+    }
+    _work_cond.notify_all();
+    for (auto &t : _threads) {
+        t.join();
+    }
+}
+
+/**
+ * Call @a function for every index in [0, count), spread over the threads of the pool,
+ * and wait for all calls to finish.
+ */
+void
+DispatchPool::dispatch(int count, Function function)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // A nested dispatch would deadlock, and waiting for another caller to finish is slower
+    // than doing the work here, since that caller already keeps all the workers busy.
+    std::unique_lock<std::mutex> dispatch_lock(_dispatch_mutex, std::defer_lock);
+    if (current_pool == this || _threads.empty() || count == 1 || !dispatch_lock.try_lock()) {
+        for (int i = 0; i < count; i++) {
+            function(i, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _function = std::move(function);
+        _count = count;
+        _next = 0;
+        _busy = _threads.size();
+        _generation++;
+    }
+    _work_cond.notify_all();
+
+    current_pool = this;
+    _work(0);
+    current_pool = nullptr;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cond.wait(lock, [this] { return _busy == 0; });
+    _function = nullptr;
+}
+
+/// Main loop of a worker thread.
+void
+DispatchPool::_run(int thread)
+{
+    current_pool = this;
+    unsigned generation = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true) {
+        _work_cond.wait(lock, [&] { return _shutdown || _generation != generation; });
+        if (_shutdown) {
+            return;
+        }
+        generation = _generation;
+
+        lock.unlock();
+        _work(thread);
+        lock.lock();
+
+        if (--_busy == 0) {
+            _done_cond.notify_one();
+        }
+    }
+}
+
+/// Process indices of the current dispatch until there are none left.
+void
+DispatchPool::_work(int thread)
+{
+    for (int i = _next++; i < _count; i = _next++) {
+        _function(i, thread);
+    }
+}
+
+namespace {
+
+std::mutex global_pool_mutex;
+std::shared_ptr<DispatchPool> global_pool;
+int global_pool_size = 0; ///< 0 until init_global_dispatch_pool() runs
+
+} // namespace
+
+void init_global_dispatch_pool()
+{
+    // Never destroyed, so that it does not outlive the preferences at exit.
+    static Pref<int> *num_threads = nullptr;
+
+    if (num_threads) {
+        return;
+    }
+
+    int const procs = std::max<int>(std::thread::hardware_concurrency(), 1);
+    num_threads = new Pref<int>("/options/threading/numthreads", procs, 1, 256);
+    num_threads->action = [] {
+        std::lock_guard<std::mutex> lock(global_pool_mutex);
+        global_pool_size = *num_threads;
+        global_pool.reset();
+    };
+
+    std::lock_guard<std::mutex> lock(global_pool_mutex);
+    global_pool_size = *num_threads;
+    global_pool.reset();
+}
+
+std::shared_ptr<DispatchPool> get_global_dispatch_pool()
+{
+    std::lock_guard<std::mutex> lock(global_pool_mutex);
+
+    if (!global_pool) {
+        int size = global_pool_size;
+        if (size <= 0) {
+            size = std::max<int>(std::thread::hardware_concurrency(), 1);
+        }
+        global_pool = std::make_shared<DispatchPool>(size);
+    }
+
+    return global_pool;
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
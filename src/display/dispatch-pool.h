@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Fixed-size pool of threads for running data-parallel rendering work.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_DISPATCH_POOL_H
+#define SEEN_INKSCAPE_DISPLAY_DISPATCH_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Inkscape {
+
+/**
+ * A pool of worker threads which execute a function over a range of indices.
+ *
+ * The calling thread takes part in the work, so a pool of size N starts N - 1 threads.
+ * Indices are handed out one at a time, so jobs of uneven cost are balanced automatically.
+ * Only one dispatch can run at a time; dispatch() blocks until all indices have been processed.
+ * A dispatch issued while the pool is already busy, for example from one of its own workers
+ * or from a thread of another pool, runs on the calling thread instead of waiting.
+ */
+class DispatchPool
+{
+public:
+    /// Function called with the index to process and the number of the thread running it.
+    using Function = std::function<void(int /*index*/, int /*thread*/)>;
+
+    explicit DispatchPool(int size);
+    ~DispatchPool();
+
+    DispatchPool(DispatchPool const &) = delete;
+    DispatchPool &operator=(DispatchPool const &) = delete;
+
+    /// Number of threads working on a dispatch, including the calling thread.
+    int size() const { return _threads.size() + 1; }
+
+    void dispatch(int count, Function function);
+
+private:
+    void _run(int thread);
+    void _work(int thread);
+
+    std::vector<std::thread> _threads;
+
+    std::mutex _dispatch_mutex;           ///< serializes calls to dispatch()
+    std::mutex _mutex;                    ///< guards the state below
+    std::condition_variable _work_cond;   ///< signalled when new work is available
+    std::condition_variable _done_cond;   ///< signalled when the last worker finishes
+    Function _function;
+    int _count = 0;
+    unsigned _generation = 0;             ///< incremented for each dispatch
+    int _busy = 0;                        ///< workers still processing the current dispatch
+    bool _shutdown = false;
+
+    std::atomic<int> _next{0};            ///< next index to hand out
+};
+
+/**
+ * Start following the preference /options/threading/numthreads for the size of the global
+ * pool. Must be called on the main thread, since it registers a preference observer;
+ * the application does this at startup.
+ */
+void init_global_dispatch_pool();
+
+/**
+ * The pool used by the pixel processing code in display/ and trace/, created on first use.
+ * Safe to call from any thread. Its size is given by the preference
+ * /options/threading/numthreads, or the number of processors before
+ * init_global_dispatch_pool() has run; when the preference changes, a new pool is
+ * created, while callers still holding the old one can finish their work.
+ */
+std::shared_ptr<DispatchPool> get_global_dispatch_pool();
+
+/**
+ * Call @a function(index, thread) for every index in [0, count), on the global pool
+ * if @a threshold is true, and on the calling thread otherwise.
+ * The threshold should be false for work that is too small to be worth splitting.
+ */
+template <typename F>
+void dispatch_threshold(int count, bool threshold, F &&function)
+{
+    if (threshold) {
+        get_global_dispatch_pool()->dispatch(count, std::forward<F>(function));
+    } else {
+        for (int i = 0; i < count; i++) {
+            function(i, 0);
+        }
+    }
+}
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_DISPATCH_POOL_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -121,6 +121,10 @@ void DrawingContext::path(Geom::PathVector const &pv) {
     feed_pathvector_to_cairo(_ct, pv);
 }
 
+void DrawingContext::path(CairoPath const &cp) {
+    cairo_append_path(_ct, cp.get());
+}
+
 void DrawingContext::paint(double alpha) {
     if (alpha == 1.0) cairo_paint(_ct);
     else cairo_paint_with_alpha(_ct, alpha);
@@ -21,7 +21,9 @@ typedef unsigned int guint32;
 
 namespace Inkscape {
 
+class CairoPath;
 class DrawingSurface;
+class OutlineBatch;
 
 class DrawingContext
     : boost::noncopyable
@@ -87,6 +89,7 @@ public:
     void newPath() { cairo_new_path(_ct); }
     void newSubpath() { cairo_new_sub_path(_ct); }
     void path(Geom::PathVector const &pv);
+    void path(CairoPath const &cp);
 
     void paint(double alpha = 1.0);
     void fill() { cairo_fill(_ct); }
@@ -94,6 +97,7 @@ public:
     void stroke() { cairo_stroke(_ct); }
     void strokePreserve() { cairo_stroke_preserve(_ct); }
     void clip() { cairo_clip(_ct); }
+    void clipPreserve() { cairo_clip_preserve(_ct); }
 
     void setLineWidth(double w) { cairo_set_line_width(_ct, w); }
     void setHairline();
@@ -127,6 +131,15 @@ public:
 
     DrawingSurface *surface() { return _surface; } // Needed to find scale in drawing-item.cpp
 
+    /// Outlines drawn in outline mode are added to this batch if set, instead of stroked.
+    OutlineBatch *outlineBatch() const { return _outline_batch; }
+    void setOutlineBatch(OutlineBatch *batch) { _outline_batch = batch; }
+
+    /// Opacity which the item being rendered applies while painting, instead of the
+    /// item it was pushed down from compositing an intermediate surface with it.
+    double opacity() const { return _opacity; }
+    void setOpacity(double opacity) { _opacity = opacity; }
+
 private:
     DrawingContext(cairo_t *ct, DrawingSurface *surface, bool destroy);
 
@@ -134,6 +147,8 @@ private:
     DrawingSurface *_surface;
     bool _delete_surface;
     bool _restore_context;
+    OutlineBatch *_outline_batch = nullptr;
+    double _opacity = 1.0;
 
     friend class DrawingSurface;
 };
@@ -10,6 +10,11 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <algorithm>
+#include <iterator>
+#include <boost/geometry.hpp>
+#include <boost/geometry/index/rtree.hpp>
+
 #include "display/drawing-group.h"
 #include "display/cairo-utils.h"
 #include "display/drawing-context.h"
@@ -21,6 +26,59 @@
 
 namespace Inkscape {
 
+namespace bg = boost::geometry;
+namespace bgi = boost::geometry::index;
+
+/**
+ * Spatial index of the children of a large group.
+ *
+ * Children are stored in an R-tree under the union of their geometric and visual bounds,
+ * together with their position in the children list, so that rendering and picking can
+ * visit only the children near the requested area and still process them in z-order.
+ * The index is rebuilt after children are added, removed or reordered, and updated
+ * incrementally when the bounds of a child change. It is only modified outside of rendering,
+ * so it can be queried concurrently while rendering.
+ */
+struct DrawingGroup::ChildIndex
+{
+    using Point = bg::model::point<int, 2, bg::cs::cartesian>;
+    using Box = bg::model::box<Point>;
+    using Value = std::pair<Box, unsigned>;
+
+    /// Groups with at least this many children are indexed.
+    static constexpr unsigned THRESHOLD = 64;
+
+    static Box toBox(Geom::IntRect const &r)
+    {
+        return Box(Point(r.left(), r.top()), Point(r.right(), r.bottom()));
+    }
+
+    bgi::rtree<Value, bgi::rstar<16>> tree;
+    std::vector<DrawingItem *> items;    ///< children in z-order
+    std::vector<Geom::OptIntRect> boxes; ///< bounds under which each child is currently indexed
+    bool valid = false;                  ///< false after the children list has changed
+};
+
+namespace {
+
+/// Bounds of a child used for indexing; covers all areas where it can be rendered or picked.
+Geom::OptIntRect index_bounds(DrawingItem const &item)
+{
+    Geom::OptIntRect box = item.geometricBounds();
+    box.unionWith(item.visualBounds());
+    if (box) {
+        if (auto glyphs = dynamic_cast<DrawingGlyphs const *>(&item)) {
+            box.unionWith(glyphs->getPickBox());
+        }
+    }
+    return box;
+}
+
+/// Children of larger groups are not checked for overlaps, see _canPaintDirectly().
+unsigned const DIRECT_PAINT_LIMIT = 16;
+
+} // namespace
+
 DrawingGroup::DrawingGroup(Drawing &drawing)
     : DrawingItem(drawing)
     , _child_transform(nullptr)
@@ -78,6 +136,7 @@ DrawingGroup::_updateItem(Geom::IntRect const &area, UpdateContext const &ctx, u
         child_ctx.ctm = *_child_transform * ctx.ctm;
     }
     for (auto & i : _children) {
+        i.setAntialiasing(_antialias); // propagate antialias setting
         i.update(area, child_ctx, flags, reset);
     }
     if (beststate & STATE_BBOX) {
@@ -88,16 +147,102 @@ DrawingGroup::_updateItem(Geom::IntRect const &area, UpdateContext const &ctx, u
             }
         }
     }
+    _updateIndex();
     return beststate;
 }
 
+/// Build, refresh or drop the spatial index of children after they have been updated.
+void
+DrawingGroup::_updateIndex()
+{
+    unsigned count = _children.size();
+    if (count < ChildIndex::THRESHOLD / 2 || (!_index && count < ChildIndex::THRESHOLD)) {
+        _index.reset();
+        return;
+    }
+    if (!_index) {
+        _index = std::make_unique<ChildIndex>();
+    }
+
+    auto &index = *_index;
+    if (!index.valid) {
+        index.items.clear();
+        index.boxes.clear();
+        std::vector<ChildIndex::Value> values;
+        values.reserve(count);
+        for (auto &i : _children) {
+            Geom::OptIntRect box = index_bounds(i);
+            if (box) {
+                values.emplace_back(ChildIndex::toBox(*box), index.items.size());
+            }
+            index.items.push_back(&i);
+            index.boxes.push_back(box);
+        }
+        // the range constructor uses bulk loading, which is much faster than insertion
+        index.tree = decltype(index.tree)(values.begin(), values.end());
+        index.valid = true;
+        return;
+    }
+
+    unsigned n = 0;
+    for (auto &i : _children) {
+        Geom::OptIntRect box = index_bounds(i);
+        if (box != index.boxes[n]) {
+            if (index.boxes[n]) {
+                index.tree.remove(ChildIndex::Value(ChildIndex::toBox(*index.boxes[n]), n));
+            }
+            if (box) {
+                index.tree.insert(ChildIndex::Value(ChildIndex::toBox(*box), n));
+            }
+            index.boxes[n] = box;
+        }
+        ++n;
+    }
+}
+
+/**
+ * Find the children whose bounds intersect @a area, in z-order.
+ * Returns false if the group is not indexed, in which case all children have to be visited.
+ */
+bool
+DrawingGroup::_queryIndex(Geom::IntRect const &area, std::vector<DrawingItem *> &result) const
+{
+    if (!_index || !_index->valid) {
+        return false;
+    }
+
+    std::vector<ChildIndex::Value> hits;
+    _index->tree.query(bgi::intersects(ChildIndex::toBox(area)), std::back_inserter(hits));
+    std::sort(hits.begin(), hits.end(),
+              [](ChildIndex::Value const &a, ChildIndex::Value const &b) { return a.second < b.second; });
+
+    result.reserve(hits.size());
+    for (auto &hit : hits) {
+        result.push_back(_index->items[hit.second]);
+    }
+    return true;
+}
+
+void
+DrawingGroup::_childrenChanged()
+{
+    if (_index) {
+        _index->valid = false;
+    }
+}
+
 unsigned
 DrawingGroup::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigned flags, DrawingItem *stop_at)
 {
-    if (stop_at == nullptr) {
+    std::vector<DrawingItem *> visible;
+    if (stop_at == nullptr && _queryIndex(area, visible)) {
+        // normal rendering of a large group, only children near the area
+        for (auto i : visible) {
+            i->render(dc, area, flags, stop_at);
+        }
+    } else if (stop_at == nullptr) {
         // normal rendering
         for (auto &i : _children) {
-            i.setAntialiasing(_antialias);
             i.render(dc, area, flags, stop_at);
         }
     } else {
@@ -107,11 +252,9 @@ DrawingGroup::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigne
                 return RENDER_OK; // do not render the stop_at item at all
             if (i.isAncestorOf(stop_at)) {
                 // render its ancestors without masks, opacity or filters
-                i.setAntialiasing(_antialias);
                 i.render(dc, area, flags | RENDER_FILTER_BACKGROUND, stop_at);
                 return RENDER_OK;
             } else {
-                i.setAntialiasing(_antialias);
                 i.render(dc, area, flags, stop_at);
             }
         }
@@ -122,8 +265,14 @@ DrawingGroup::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigne
 void
 DrawingGroup::_clipItem(DrawingContext &dc, Geom::IntRect const &area)
 {
+    std::vector<DrawingItem *> visible;
+    if (_queryIndex(area, visible)) {
+        for (auto i : visible) {
+            i->clip(dc, area);
+        }
+        return;
+    }
     for (auto & i : _children) {
-        i.setAntialiasing(_antialias);
         i.clip(dc, area);
     }
 }
@@ -131,6 +280,19 @@ DrawingGroup::_clipItem(DrawingContext &dc, Geom::IntRect const &area)
 DrawingItem *
 DrawingGroup::_pickItem(Geom::Point const &p, double delta, unsigned flags)
 {
+    Geom::Rect pick_area(p, p);
+    pick_area.expandBy(delta);
+    std::vector<DrawingItem *> candidates;
+    if (_queryIndex(pick_area.roundOutwards(), candidates)) {
+        for (auto i : candidates) {
+            DrawingItem *picked = i->pick(p, delta, flags);
+            if (picked) {
+                return _pick_children ? picked : this;
+            }
+        }
+        return nullptr;
+    }
+
     for (auto & i : _children) {
         DrawingItem *picked = i.pick(p, delta, flags);
         if (picked) {
@@ -146,6 +308,42 @@ DrawingGroup::_canClip()
     return true;
 }
 
+bool
+DrawingGroup::_clipContextItem(DrawingContext &dc)
+{
+    if (_children.size() != 1) {
+        return false;
+    }
+    return _children.front().clipContext(dc);
+}
+
+bool
+DrawingGroup::_canPaintDirectly()
+{
+    // The opacity pushed down to the children is applied by each of them, which only gives
+    // the same result as applying it to the whole group if they don't overlap.
+    if (_children.size() > DIRECT_PAINT_LIMIT) {
+        return false;
+    }
+    std::vector<Geom::IntRect> boxes;
+    for (auto &i : _children) {
+        if (!i.visible() || !i.visualBounds()) {
+            continue;
+        }
+        // blending with the backdrop differs from blending inside the group
+        if (i.blendMode() != SP_CSS_BLEND_NORMAL) {
+            return false;
+        }
+        for (auto const &box : boxes) {
+            if (box.intersects(*i.visualBounds())) {
+                return false;
+            }
+        }
+        boxes.push_back(*i.visualBounds());
+    }
+    return true;
+}
+
 bool is_drawing_group(DrawingItem *item)
 {
     return dynamic_cast<DrawingGroup *>(item) != nullptr;
@@ -13,6 +13,9 @@
 #ifndef SEEN_INKSCAPE_DISPLAY_DRAWING_GROUP_H
 #define SEEN_INKSCAPE_DISPLAY_DRAWING_GROUP_H
 
+#include <memory>
+#include <vector>
+
 #include "display/drawing-item.h"
 
 namespace Inkscape {
@@ -37,8 +40,19 @@ protected:
     void _clipItem(DrawingContext &dc, Geom::IntRect const &area) override;
     DrawingItem *_pickItem(Geom::Point const &p, double delta, unsigned flags) override;
     bool _canClip() override;
+    bool _clipContextItem(DrawingContext &dc) override;
+    bool _canPaintDirectly() override;
+    void _childrenChanged() override;
 
     Geom::Affine *_child_transform;
+
+private:
+    struct ChildIndex;
+
+    void _updateIndex();
+    bool _queryIndex(Geom::IntRect const &area, std::vector<DrawingItem *> &result) const;
+
+    std::unique_ptr<ChildIndex> _index; ///< spatial index of children, only for large groups
 };
 
 bool is_drawing_group(DrawingItem *item);
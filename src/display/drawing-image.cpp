@@ -10,17 +10,27 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <algorithm>
 #include <2geom/bezier-curve.h>
 
 #include "display/drawing.h"
 #include "display/drawing-context.h"
 #include "display/drawing-image.h"
-#include "preferences.h"
+#include "display/drawing-surface.h"
+#include "display/image-mipmap.h"
+#include "display/outline-batch.h"
 
 #include "display/cairo-utils.h"
 
 namespace Inkscape {
 
+namespace {
+
+// Images with fewer pixels are drawn at full resolution at all scales.
+int const MIPMAP_MIN_PIXELS = 1024 * 1024;
+
+} // namespace
+
 DrawingImage::DrawingImage(Drawing &drawing)
     : DrawingItem(drawing)
     , _pixbuf(nullptr)
@@ -35,6 +45,7 @@ void
 DrawingImage::setPixbuf(Inkscape::Pixbuf *pb)
 {
     _pixbuf = pb;
+    _mipmap.reset();
 
     _markForUpdate(STATE_ALL, false);
 }
@@ -84,8 +95,22 @@ DrawingImage::_updateItem(Geom::IntRect const &, UpdateContext const &, unsigned
 
     // Calculate bbox
     if (_pixbuf) {
+        // Convert to Cairo's pixel format now rather than on first render,
+        // which may happen on a render thread.
+        _pixbuf->ensurePixelFormat(Inkscape::Pixbuf::PF_CAIRO);
         Geom::Rect r = bounds() * _ctm;
         _bbox = r.roundOutwards();
+
+        // Large images drawn at less than half their size are drawn from reduced copies,
+        // which are built once the image is first seen at such a scale. Exact renderings,
+        // like exports, don't use them, since they become ready at an unpredictable time.
+        Geom::Affine pixel = _scale * _ctm;
+        double scale = std::max(pixel.expansionX(), pixel.expansionY());
+        if (scale < 0.5 && !_drawing.getExact() && _pixbuf->width() * _pixbuf->height() >= MIPMAP_MIN_PIXELS &&
+            (!_mipmap || _mipmap->generation() != _pixbuf->generation()))
+        {
+            _mipmap = ImageMipmap::create(*_pixbuf);
+        }
     } else {
         _bbox = Geom::OptIntRect();
     }
@@ -96,9 +121,12 @@ DrawingImage::_updateItem(Geom::IntRect const &, UpdateContext const &, unsigned
 unsigned DrawingImage::_renderItem(DrawingContext &dc, Geom::IntRect const &/*area*/, unsigned /*flags*/, DrawingItem * /*stop_at*/)
 {
     bool outline = _drawing.outline();
+    bool imgoutline = _drawing.imageOutline();
 
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    bool imgoutline = prefs->getBool("/options/rendering/imageinoutlinemode", false);
+    // the image and its outline are drawn directly, so the outlines batched so far go first
+    if (auto batch = dc.outlineBatch()) {
+        batch->flush(dc);
+    }
 
     if (!outline || imgoutline) {
         if (!_pixbuf) return RENDER_OK;
@@ -111,7 +139,26 @@ unsigned DrawingImage::_renderItem(DrawingContext &dc, Geom::IntRect const &/*ar
 
         dc.translate(_origin);
         dc.scale(_scale);
-        dc.setSource(_pixbuf->getSurfaceRaw(), 0, 0);
+
+        int halvings = 0;
+        cairo_surface_t *level = nullptr;
+        if (_mipmap && _mipmap->generation() == _pixbuf->generation() && !_drawing.getExact()) {
+            // device pixels per image pixel, along the axis where the image is drawn larger
+            cairo_matrix_t matrix;
+            cairo_get_matrix(dc.raw(), &matrix);
+            Geom::Affine pixel;
+            ink_matrix_to_2geom(pixel, matrix);
+            double scale = std::max(pixel.expansionX(), pixel.expansionY());
+            level = _mipmap->level(scale * dc.surface()->device_scale(), halvings);
+        }
+        if (level) {
+            double factor = 1 << halvings;
+            dc.scale(factor, factor);
+            dc.setSource(level, 0, 0);
+            cairo_surface_destroy(level); // referenced by the source
+        } else {
+            dc.setSource(_pixbuf->getSurfaceRaw(), 0, 0);
+        }
         dc.patternSetExtend(CAIRO_EXTEND_PAD);
 
         if (_style) {
@@ -138,11 +185,11 @@ unsigned DrawingImage::_renderItem(DrawingContext &dc, Geom::IntRect const &/*ar
             }
         }
 
-        dc.paint(1);
+        dc.paint(dc.opacity());
 
     } else { // outline; draw a rect instead
 
-        guint32 rgba = prefs->getInt("/options/wireframecolors/images", 0xff0000ff);
+        guint32 rgba = _drawing.colors().images;
 
         {   Inkscape::DrawingContext::Save save(dc);
             dc.transform(_ctm);
@@ -13,6 +13,7 @@
 #ifndef SEEN_INKSCAPE_DISPLAY_DRAWING_IMAGE_H
 #define SEEN_INKSCAPE_DISPLAY_DRAWING_IMAGE_H
 
+#include <memory>
 #include <cairo.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <2geom/transforms.h>
@@ -20,6 +21,7 @@
 #include "display/drawing-item.h"
 
 namespace Inkscape {
+class ImageMipmap;
 class Pixbuf;
 
 class DrawingImage
@@ -41,8 +43,10 @@ protected:
     unsigned _renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigned flags,
                                  DrawingItem *stop_at) override;
     DrawingItem *_pickItem(Geom::Point const &p, double delta, unsigned flags) override;
+    bool _canPaintDirectly() override { return true; }
 
     Inkscape::Pixbuf *_pixbuf;
+    std::shared_ptr<ImageMipmap> _mipmap; ///< for drawing large images at small scales
 
     // TODO: the following three should probably be merged into a new Geom::Viewbox object
     Geom::Rect _clipbox; ///< for preserveAspectRatio
@@ -19,6 +19,7 @@
 #include "display/drawing-surface.h"
 #include "display/drawing-text.h"
 #include "display/drawing.h"
+#include "display/render-profiler.h"
 
 #include "display/cairo-utils.h"
 #include "display/cairo-templates.h"
@@ -34,6 +35,31 @@
 #include "object/sp-item.h"
 
 namespace Inkscape {
+
+namespace {
+
+/// Takes the opacity pushed down to an item from the context, and puts it back for the next
+/// item when the item is done rendering.
+class PushedOpacity
+{
+public:
+    PushedOpacity(DrawingContext &dc)
+        : _dc(dc)
+        , _opacity(dc.opacity())
+    {
+        dc.setOpacity(1.0);
+    }
+    ~PushedOpacity() { _dc.setOpacity(_opacity); }
+
+    double value() const { return _opacity; }
+
+private:
+    DrawingContext &_dc;
+    double _opacity;
+};
+
+} // namespace
+
 /**
  * @class DrawingItem
  * SVG drawing item for display.
@@ -115,6 +141,7 @@ DrawingItem::~DrawingItem()
     case CHILD_NORMAL: {
         ChildrenList::iterator ithis = _parent->_children.iterator_to(*this);
         _parent->_children.erase(ithis);
+        _parent->_childrenChanged();
         } break;
     case CHILD_CLIP:
         // we cannot call setClip(NULL) or setMask(NULL),
@@ -145,6 +172,9 @@ DrawingItem::~DrawingItem()
     delete _fill_pattern;
     delete _clip;
     delete _mask;
+    if (_filter) {
+        _drawing._filter_count--;
+    }
     delete _filter;
     if(_style)
         sp_style_unref(_style);
@@ -175,6 +205,7 @@ DrawingItem::appendChild(DrawingItem *item)
     assert(item->_child_type == CHILD_ORPHAN);
     item->_child_type = CHILD_NORMAL;
     _children.push_back(*item);
+    _childrenChanged();
 
     // This ensures that _markForUpdate() called on the child will recurse to this item
     item->_state = STATE_ALL;
@@ -192,6 +223,7 @@ DrawingItem::prependChild(DrawingItem *item)
     assert(item->_child_type == CHILD_ORPHAN);
     item->_child_type = CHILD_NORMAL;
     _children.push_front(*item);
+    _childrenChanged();
     // See appendChild for explanation
     item->_state = STATE_ALL;
     item->_markForUpdate(STATE_ALL, true);
@@ -212,6 +244,7 @@ DrawingItem::clearChildren()
         i._child_type = CHILD_ORPHAN;
     }
     _children.clear_and_dispose(DeleteDisposer());
+    _childrenChanged();
     _markForUpdate(STATE_ALL, false);
 }
 
@@ -252,6 +285,8 @@ DrawingItem::setAntialiasing(unsigned a)
     if (_antialias != a) {
         _antialias = a;
         _markForRendering();
+        // the setting is propagated to children during the update
+        _markForUpdate(STATE_ALL, true);
     }
 }
 
@@ -336,12 +371,14 @@ DrawingItem::setStyle(SPStyle *style, SPStyle *context_style)
         if (!_filter) {
             int primitives = style->getFilter()->primitive_count();
             _filter = new Inkscape::Filters::Filter(primitives);
+            _drawing._filter_count++;
         }
         style->getFilter()->build_renderer(_filter);
-    } else {
+    } else if (_filter) {
         // no filter set for this group
         delete _filter;
         _filter = nullptr;
+        _drawing._filter_count--;
     }
 
     if (style && style->enable_background.set) {
@@ -453,6 +490,7 @@ DrawingItem::setZOrder(unsigned z)
     ChildrenList::iterator i = _parent->_children.begin();
     std::advance(i, std::min(z, unsigned(_parent->_children.size())));
     _parent->_children.insert(i, *this);
+    _parent->_childrenChanged();
     _markForRendering();
 }
 
@@ -494,9 +532,13 @@ DrawingItem::update(Geom::IntRect const &area, UpdateContext const &ctx, unsigne
         return;
     }
 
+    RenderProfiler::Scope profile(RenderProfiler::UPDATE, this);
     bool render_filters = _drawing.renderFilters();
     bool outline = _drawing.outline() || _drawing.outlineOverlay();
 
+    // Whether this item was changed, as opposed to just being updated along with the whole drawing
+    bool changed = !(_state & STATE_RENDER);
+
     // Set reset flags according to propagation status
     reset |= _propagate_state;
     _propagate_state = 0;
@@ -555,6 +597,23 @@ DrawingItem::update(Geom::IntRect const &area, UpdateContext const &ctx, unsigne
     /* Remember the transformation matrix */
     Geom::Affine ctm_change = _ctm.inverse() * child_ctx.ctm;
     _ctm = child_ctx.ctm;
+    if (_child_type == CHILD_ROOT) {
+        _drawing._root_ctm_change = ctm_change;
+    }
+
+    // This must be done before updating children, which mark parts of the cache dirty.
+    if (_cache) {
+        _cache->scheduleTransform(ctm_change);
+    }
+
+    // Propagate antialiasing setting. This is done here rather than during rendering,
+    // so that rendering does not have to modify the tree.
+    if (_clip) {
+        _clip->setAntialiasing(_antialias);
+    }
+    if (_mask) {
+        _mask->setAntialiasing(_antialias);
+    }
 
     // update _bbox and call this function for children
     _state = _updateItem(area, child_ctx, flags, reset);
@@ -607,6 +666,10 @@ DrawingItem::update(Geom::IntRect const &area, UpdateContext const &ctx, unsigne
             // if _cacheRect() is empty, a negative score will be returned from _cacheScore(),
             // so this will not execute (cache score threshold must be positive)
             cr.cache_size = _cacheRect()->area() * 4;
+            if (_cache) {
+                // contents kept from earlier zoom levels count against the budget too
+                cr.cache_size += _cache->levelBytes();
+            }
             cr.item = this;
             auto it = std::lower_bound(_drawing._candidate_items.begin(), _drawing._candidate_items.end(), cr,
                                        std::greater<CacheRecord>());
@@ -623,8 +686,8 @@ DrawingItem::update(Geom::IntRect const &area, UpdateContext const &ctx, unsigne
         if (_cache) {
             Geom::OptIntRect cl = _cacheRect();
             if (_visible && cl && _has_cache_iterator) { // never create cache for invisible items
-                // this takes care of invalidation on transform
-                _cache->scheduleTransform(*cl, ctm_change);
+                // the transform was already scheduled above
+                _cache->scheduleResize(*cl);
             } else {
                 // Destroy cache for this item - outside of canvas or invisible.
                 // The opposite transition (invisible -> visible or object
@@ -644,7 +707,11 @@ DrawingItem::update(Geom::IntRect const &area, UpdateContext const &ctx, unsigne
             _stroke_pattern->update(area, child_ctx, flags, reset);
         }
         if (!is_drawing_group(this) || (_filter && render_filters)) {
-            _markForRendering();
+            // If the item only moved together with the whole drawing, e.g. when zooming,
+            // cached renderings of it and its ancestors are still valid.
+            bool moved_with_drawing = !changed && !ctm_change.isIdentity()
+                                   && Geom::are_near(ctm_change, _drawing._root_ctm_change);
+            _markForRendering(!moved_with_drawing);
         }
     }
 }
@@ -675,7 +742,10 @@ unsigned
 DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flags, DrawingItem *stop_at)
 {
     bool outline = _drawing.outline();
-    bool render_filters = _drawing.renderFilters();
+    // Drafts leave out filters, and render cached items without creating or updating caches,
+    // so that the caches still hold the full quality rendering afterwards.
+    bool draft = _drawing.draft();
+    bool render_filters = _drawing.renderFilters() && !draft;
     // stop_at is handled in DrawingGroup, but this check is required to handle the case
     // where a filtered item with background-accessing filter has enable-background: new
     if (this == stop_at) {
@@ -691,6 +761,10 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
         return RENDER_OK;
     }
 
+    RenderProfiler::Scope profile(RenderProfiler::RENDER, this);
+    // Opacity of ancestors which rendered this item without an intermediate surface.
+    PushedOpacity pushed_opacity(dc);
+
     // TODO convert outline rendering to a separate virtual function
     if (outline) {
         _renderOutline(dc, area, flags);
@@ -708,25 +782,18 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
     //         (incomplete filter dependence region).
     // Note 2: We only need to render carea of clip and mask, but
     //         iarea of the object.
-    
+
+    // The cache state below may be shared by several threads rendering this drawing.
+    std::unique_lock<std::mutex> cache_lock(_drawing._cache_mutex);
+
     Geom::OptIntRect iarea = carea;
-    // expand carea to contain the dependent area of filters.
+    // the area of a new cache
+    Geom::OptIntRect cache_area = carea;
     if (_filter && render_filters) {
-        iarea = _cacheRect();
-        if (!iarea) {
-            iarea = carea;
-            _filter->area_enlarge(*iarea, this);
-            iarea.intersectWith(_drawbox);
-            setCached(false, true);
-        } else {
-            setCached(true, true);
-        }
+        cache_area = _cacheRect();
+        setCached(bool(cache_area), true);
     }
 
-    if (!iarea) {
-        return RENDER_OK;
-    }
-    
     // Device scale for HiDPI screens (typically 1 or 2)
     int device_scale = dc.surface()->device_scale();
 
@@ -743,7 +810,8 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
         if (_cache) {
             _cache->prepare();
             dc.setOperator(ink_css_blend_to_cairo_operator(_mix_blend_mode));
-            _cache->paintFromCache(dc, carea, _filter && render_filters);
+            _cache->paintFromCache(dc, carea, pushed_opacity.value());
+            RenderProfiler::get().countCache(!carea);
             if (!carea) {
                 dc.setSource(0, 0, 0, 0);
                 return RENDER_OK;
@@ -752,8 +820,9 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
             // There is no cache. This could be because caching of this item
             // was just turned on after the last update phase, or because
             // we were previously outside of the canvas.
-            if (iarea) {
-                _cache = new DrawingCache(*iarea, device_scale);
+            if (cache_area && !draft) {
+                _cache = new DrawingCache(*cache_area, device_scale);
+                RenderProfiler::get().countCache(false);
             }
         }
     } else {
@@ -761,6 +830,14 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
         // deleted in setCached()
     }
 
+    // Expand carea to contain the dependent area of filters. Filtered items are only rendered
+    // where needed, and when cached, carea is now the part of the cache which is not clean.
+    if (_filter && render_filters) {
+        iarea = carea;
+        _filter->area_enlarge(*iarea, this);
+        iarea.intersectWith(_drawbox);
+    }
+
     // determine whether this shape needs intermediate rendering.
     bool needs_intermediate_rendering = false;
     bool &nir = needs_intermediate_rendering;
@@ -774,11 +851,18 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
     nir |= (_mix_blend_mode != SP_CSS_BLEND_NORMAL); // 5. it has blend mode           
     nir |= (_isolation == SP_CSS_ISOLATION_ISOLATE); // 6. it is isolated    
     nir |= !parent();                                // 7. is root, need isolation from background
-    if (_prev_nir && !needs_intermediate_rendering) {
-        setCached(false, true);
+    if (!draft) {
+        if (_prev_nir && !needs_intermediate_rendering) {
+            setCached(false, true);
+        }
+        _prev_nir = needs_intermediate_rendering;
     }
-    _prev_nir = needs_intermediate_rendering;
     nir |= (_cache != nullptr);                      // 5. it is to be cached
+    bool const has_cache = (_cache != nullptr);
+    cache_lock.unlock();
+
+    double const opacity = _opacity * pushed_opacity.value();
+    nir |= (pushed_opacity.value() < 0.995);
 
     /* How the rendering is done.
      *
@@ -802,6 +886,22 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
         return _renderItem(dc, *iarea, flags & ~RENDER_FILTER_BACKGROUND, stop_at);
     }
 
+    // When the item paints each pixel only once, its opacity can be applied while painting, and a
+    // clipping path of a single shape can be set as the clip of the context. This gives the same
+    // result as compositing an intermediate rendering, without allocating it.
+    // The opacity is pushed down to the children of groups, see DrawingGroup::_canPaintDirectly().
+    if (!_mask && !(_filter && render_filters) && _mix_blend_mode == SP_CSS_BLEND_NORMAL &&
+        _isolation != SP_CSS_ISOLATION_ISOLATE && parent() && !has_cache && !stop_at &&
+        _canPaintDirectly())
+    {
+        Inkscape::DrawingContext::Save save(dc);
+        if (!_clip || _clip->clipContext(dc)) {
+            dc.setOperator(CAIRO_OPERATOR_OVER);
+            dc.setOpacity(opacity);
+            return _renderItem(dc, *iarea, flags, stop_at);
+        }
+    }
+
 
     DrawingSurface intermediate(*iarea, device_scale);
     DrawingContext ict(intermediate);
@@ -827,7 +927,6 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
     ict.paint();
     if (_clip) {
         ict.pushGroup();
-        _clip->setAntialiasing(_antialias); // propagate antialias setting
         _clip->clip(ict, *carea);
         ict.popGroupToSource();
         ict.setOperator(CAIRO_OPERATOR_IN);
@@ -838,7 +937,6 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
     // 2. Render the mask if present and compose it with the clipping path + opacity.
     if (_mask) {
         ict.pushGroup();
-        _mask->setAntialiasing(_antialias); // propagate antialias setting
         _mask->render(ict, *carea, flags);
 
         cairo_surface_t *mask_s = ict.rawTarget();
@@ -866,12 +964,12 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
                 DrawingSurface bg(*iarea, device_scale);
                 DrawingContext bgdc(bg);
                 bg_root->render(bgdc, *iarea, flags | RENDER_FILTER_BACKGROUND, this);
-                _filter->render(this, ict, &bgdc);
+                _filter->render(this, ict, &bgdc, *carea);
                 rendered = true;
             }
         }
         if (!rendered) {
-            _filter->render(this, ict, nullptr);
+            _filter->render(this, ict, nullptr, *carea);
         }
         // Note that because the object was rendered to a group,
         // the internals of the filter need to use cairo_get_group_target()
@@ -884,25 +982,31 @@ DrawingItem::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flag
     ict.paint();
 
     // 6. Paint the completed rendering onto the base context (or into cache)
-    if (_cached && _cache) {
+    cache_lock.lock();
+    if (_cached && _cache && !draft) {
+        // the filter result is only complete in carea
+        Geom::IntRect const clean = _filter && render_filters ? *carea : *iarea;
         DrawingContext cachect(*_cache);
-        cachect.rectangle(*iarea);
+        cachect.rectangle(clean);
         cachect.setOperator(CAIRO_OPERATOR_SOURCE);
         cachect.setSource(&intermediate);
         cachect.fill();
-        Geom::OptIntRect cl = _cacheRect();
-        if (_filter && render_filters && cl) {
-            _cache->markClean(*cl);
-        } else {
-            _cache->markClean(*iarea);
-        }
+        _cache->markClean(clean);
     }
+    cache_lock.unlock();
 
     dc.rectangle(*carea);
     dc.setSource(&intermediate);
     // 7. Render blend mode
     dc.setOperator(ink_css_blend_to_cairo_operator(_mix_blend_mode));
-    dc.fill();
+    if (pushed_opacity.value() < 0.995) {
+        // The intermediate rendering and cache hold only the opacity of this item.
+        Inkscape::DrawingContext::Save save(dc);
+        dc.clip();
+        dc.paint(pushed_opacity.value());
+    } else {
+        dc.fill();
+    }
     dc.setSource(0,0,0,0);
     // Web isolation only works if parent doesn't have transform
 
@@ -925,19 +1029,29 @@ DrawingItem::_renderOutline(DrawingContext &dc, Geom::IntRect const &area, unsig
     _renderItem(dc, *carea, flags, nullptr);
 
     // render clip and mask, if any
-    guint32 saved_rgba = _drawing.outlinecolor; // save current outline color
     // render clippath as an object, using a different color
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
     if (_clip) {
-        _drawing.outlinecolor = prefs->getInt("/options/wireframecolors/clips", 0x00ff00ff); // green clips
-        _clip->render(dc, *carea, flags);
+        _clip->render(dc, *carea, (flags & ~RENDER_OUTLINE_MASK) | RENDER_OUTLINE_CLIP);
     }
     // render mask as an object, using a different color
     if (_mask) {
-        _drawing.outlinecolor = prefs->getInt("/options/wireframecolors/masks", 0x0000ffff); // blue masks
-        _mask->render(dc, *carea, flags);
+        _mask->render(dc, *carea, (flags & ~RENDER_OUTLINE_CLIP) | RENDER_OUTLINE_MASK);
     }
-    _drawing.outlinecolor = saved_rgba; // restore outline color
+}
+
+/**
+ * Color used to draw an item in outline mode. Clipping paths and masks
+ * are drawn in a different color, selected by the render flags.
+ */
+unsigned
+DrawingItem::_outlineColor(unsigned flags) const
+{
+    if (flags & RENDER_OUTLINE_CLIP) {
+        return _drawing.colors().clippaths;
+    } else if (flags & RENDER_OUTLINE_MASK) {
+        return _drawing.colors().masks;
+    }
+    return _drawing.colors().paths;
 }
 
 /**
@@ -978,6 +1092,21 @@ DrawingItem::clip(Inkscape::DrawingContext &dc, Geom::IntRect const &area)
     dc.setSource(0,0,0,0);
 }
 
+/**
+ * Intersect the clip region of the context with the clipping path, instead of rasterizing it.
+ * This is only possible when the clipping path is a single shape, since the clip region of a
+ * context can only be narrowed. Returns false, leaving the context as it was, otherwise.
+ */
+bool
+DrawingItem::clipContext(Inkscape::DrawingContext &dc)
+{
+    // A clipping path which is itself clipped would need the intersection of both.
+    if (!_canClip() || !_visible || _clip) {
+        return false;
+    }
+    return _clipContextItem(dc);
+}
+
 /**
  * Get the item under the specified point.
  * Searches the tree for the first item in the Z-order which is closer than
@@ -1080,7 +1209,7 @@ DrawingItem::recursivePrintTree( unsigned level )
  * _markForUpdate() also needs to be called.
  */
 void
-DrawingItem::_markForRendering()
+DrawingItem::_markForRendering(bool dirty_caches)
 {
     // TODO: this function does too much work when a large subtree
     // is invalidated - fix
@@ -1093,10 +1222,13 @@ DrawingItem::_markForRendering()
     DrawingItem *bkg_root = nullptr;
 
     for (DrawingItem *i = this; i; i = i->_parent) {
+        if (i != this) {
+            i->_descendantMarkedForRendering();
+        }
         if (i != this && i->_filter) {
             i->_filter->area_enlarge(*dirty, i);
         }
-        if (i->_cache) {
+        if (i->_cache && dirty_caches) {
             i->_cache->markDirty(*dirty);
         }
         if (i->_background_accumulate) {
@@ -76,7 +76,9 @@ public:
         RENDER_DEFAULT = 0,
         RENDER_CACHE_ONLY = 1,
         RENDER_BYPASS_CACHE = 2,
-        RENDER_FILTER_BACKGROUND = 4
+        RENDER_FILTER_BACKGROUND = 4,
+        RENDER_OUTLINE_CLIP = 8,  // outline mode: render as a clipping path
+        RENDER_OUTLINE_MASK = 16  // outline mode: render as a mask
     };
     enum StateFlags {
         STATE_NONE = 0,
@@ -122,6 +124,7 @@ public:
     void setAntialiasing(unsigned a);
     void setIsolation(bool isolation); // CSS Compositing and Blending
     void setBlendMode(SPBlendMode blend_mode);
+    SPBlendMode blendMode() const { return _mix_blend_mode; }
     void setTransform(Geom::Affine const &trans);
     void setClip(DrawingItem *item);
     void setMask(DrawingItem *item);
@@ -140,6 +143,7 @@ public:
     void update(Geom::IntRect const &area = Geom::IntRect::infinite(), UpdateContext const &ctx = UpdateContext(), unsigned flags = STATE_ALL, unsigned reset = 0);
     unsigned render(DrawingContext &dc, Geom::IntRect const &area, unsigned flags = 0, DrawingItem *stop_at = nullptr);
     void clip(DrawingContext &dc, Geom::IntRect const &area);
+    bool clipContext(DrawingContext &dc);
     DrawingItem *pick(Geom::Point const &p, double delta, unsigned flags = 0);
 
     virtual Glib::ustring name(); // For debugging
@@ -160,8 +164,9 @@ protected:
         RENDER_STOP = 1
     };
     void _renderOutline(DrawingContext &dc, Geom::IntRect const &area, unsigned flags);
+    unsigned _outlineColor(unsigned flags) const;
     void _markForUpdate(unsigned state, bool propagate);
-    void _markForRendering();
+    void _markForRendering(bool dirty_caches = true);
     void _invalidateFilterBackground(Geom::IntRect const &area);
     double _cacheScore();
     Geom::OptIntRect _cacheRect();
@@ -172,6 +177,14 @@ protected:
     virtual void _clipItem(DrawingContext &/*dc*/, Geom::IntRect const &/*area*/) {}
     virtual DrawingItem *_pickItem(Geom::Point const &/*p*/, double /*delta*/, unsigned /*flags*/) { return nullptr; }
     virtual bool _canClip() { return false; }
+    virtual bool _clipContextItem(DrawingContext &/*dc*/) { return false; }
+    /// Whether _renderItem() paints each pixel at most once, so that the opacity and clip of
+    /// this item can be applied while painting instead of on an intermediate surface.
+    virtual bool _canPaintDirectly() { return false; }
+    /// Called after regular children were added, removed or reordered.
+    virtual void _childrenChanged() {}
+    /// Called when an item below this one was marked for rendering, i.e. its appearance changed.
+    virtual void _descendantMarkedForRendering() {}
 
     // static functions start here
 
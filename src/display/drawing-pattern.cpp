@@ -14,6 +14,7 @@
 #include "display/drawing-context.h"
 #include "display/drawing-pattern.h"
 #include "display/drawing-surface.h"
+#include "display/pattern-tile-cache.h"
 
 namespace Inkscape {
 
@@ -22,6 +23,7 @@ DrawingPattern::DrawingPattern(Drawing &drawing, bool debug)
     , _pattern_to_user(nullptr)
     , _overflow_steps(1)
     , _debug(debug)
+    , _tile_owner(nullptr)
 {
 }
 
@@ -62,9 +64,13 @@ DrawingPattern::setOverflow(Geom::Affine initial_transform, int steps, Geom::Aff
     _overflow_step_transform = step_transform;
 }
 
+void
+DrawingPattern::setTileOwner(void const *owner) {
+    _tile_owner = owner;
+}
+
 cairo_pattern_t *
 DrawingPattern::renderPattern(float opacity) {
-    bool needs_opacity = (1.0 - opacity) >= 1e-3;
     bool visible = opacity >= 1e-3;
 
     if (!visible) {
@@ -81,14 +87,51 @@ DrawingPattern::renderPattern(float opacity) {
     // The DrawingSurface class handles the mapping from "logical space"
     // (coordinates in the rendering) to "physical space" (surface pixels).
     // An oversampling is done as the pattern may not pixel align with the final surface.
-    // The cairo surface is created when the DrawingContext is declared.
     // Create drawing surface with size of pattern tile (in pattern space) but with number of pixels
     // based on required resolution (c).
     Inkscape::DrawingSurface pattern_surface(pattern_tile, _pattern_resolution);
+
+    bool use_cache = _tile_owner && !_debug;
+    PatternTileCache::Key key{ _tile_owner, pattern_tile,
+                               _child_transform ? *_child_transform : Geom::identity(),
+                               _pattern_resolution, opacity };
+    cairo_surface_t *tile = use_cache ? PatternTileCache::get().lookup(key) : nullptr;
+    if (!tile) {
+        tile = _renderTile(pattern_surface, opacity);
+        if (use_cache) {
+            PatternTileCache::get().insert(key, tile);
+        }
+    }
+
+    cairo_pattern_t *cp = cairo_pattern_create_for_surface(tile);
+    cairo_surface_destroy(tile);
+
+    // Apply transformation to user space. Also compensate for oversampling.
+    if (_pattern_to_user) {
+        ink_cairo_pattern_set_matrix(cp, _pattern_to_user->inverse() * pattern_surface.drawingTransform());
+    } else {
+        ink_cairo_pattern_set_matrix(cp, pattern_surface.drawingTransform());
+    }
+
+    if (_debug) {
+        cairo_pattern_set_extend(cp, CAIRO_EXTEND_NONE);
+    } else {
+        cairo_pattern_set_extend(cp, CAIRO_EXTEND_REPEAT);
+    }
+
+    return cp;
+}
+
+/// Render the tile into @a pattern_surface and return a new reference to its surface.
+cairo_surface_t *
+DrawingPattern::_renderTile(DrawingSurface &pattern_surface, float opacity) {
+    bool needs_opacity = (1.0 - opacity) >= 1e-3;
+
+    // The cairo surface is created when the DrawingContext is declared.
     Inkscape::DrawingContext dc(pattern_surface);
     dc.transform( pattern_surface.drawingTransform().inverse() );
 
-    pattern_tile *= pattern_surface.drawingTransform();
+    Geom::Rect pattern_tile = *_tile_rect * pattern_surface.drawingTransform();
     Geom::IntRect one_tile = pattern_tile.roundOutwards();
 
     // Render pattern.
@@ -136,21 +179,7 @@ DrawingPattern::renderPattern(float opacity) {
         dc.paint(opacity); // apply opacity
     }
 
-    cairo_pattern_t *cp = cairo_pattern_create_for_surface(pattern_surface.raw());
-    // Apply transformation to user space. Also compensate for oversampling.
-    if (_pattern_to_user) {
-        ink_cairo_pattern_set_matrix(cp, _pattern_to_user->inverse() * pattern_surface.drawingTransform());
-    } else {
-        ink_cairo_pattern_set_matrix(cp, pattern_surface.drawingTransform());
-    }
-
-    if (_debug) {
-        cairo_pattern_set_extend(cp, CAIRO_EXTEND_NONE);
-    } else {
-        cairo_pattern_set_extend(cp, CAIRO_EXTEND_REPEAT);
-    }
-
-    return cp;
+    return cairo_surface_reference(pattern_surface.raw());
 }
 
 // TODO investigate if area should be used.
@@ -167,7 +196,9 @@ unsigned DrawingPattern::_updateItem(Geom::IntRect const &area, UpdateContext co
     Geom::Coord det_ps2user = _pattern_to_user ? _pattern_to_user->descrim() : 1.0;
     Geom::Coord det_child_transform = _child_transform ? _child_transform->descrim() : 1.0;
     const double oversampling = 2.0;
-    double scale = det_ctm*det_ps2user*det_child_transform * oversampling;
+    // Rounded up to the steps of the tile cache, so that the tile survives small zoom changes.
+    double scale = PatternTileCache::quantizeScale(
+        det_ctm*det_ps2user*det_child_transform * oversampling);
     //FIXME: When scale is too big (zooming in a hatch), cairo doesn't render the pattern
     //More precisely it fails when setting pattern matrix in DrawingPattern::renderPattern
     //Fully correct solution should make use of visible area bbox and change hatch tile rect
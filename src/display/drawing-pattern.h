@@ -19,6 +19,8 @@ typedef struct _cairo_pattern cairo_pattern_t;
 
 namespace Inkscape {
 
+class DrawingSurface;
+
 /**
  * @brief Drawing tree node used for rendering paints.
  *
@@ -50,6 +52,14 @@ public:
      * a translation transform is applied.
      */
     void setOverflow(Geom::Affine initial_transform, int steps, Geom::Affine step_transform);
+    /**
+     * Share rendered tiles with the other patterns of @a owner through PatternTileCache.
+     *
+     * Tiles are told apart by the tile rect, the child transform and the resolution, so the
+     * overflow must follow from these. The owner must invalidate its tiles when the contents
+     * change. Without an owner, the tile is rendered anew every time.
+     */
+    void setTileOwner(void const *owner);
     /**
      * Render the pattern.
      *
@@ -57,6 +67,7 @@ public:
      */
     cairo_pattern_t *renderPattern(float opacity);
 protected:
+    cairo_surface_t *_renderTile(DrawingSurface &pattern_surface, float opacity);
     unsigned _updateItem(Geom::IntRect const &area, UpdateContext const &ctx,
                                      unsigned flags, unsigned reset) override;
 
@@ -67,6 +78,7 @@ protected:
     Geom::OptRect _tile_rect;
     bool _debug;
     Geom::IntPoint _pattern_resolution;
+    void const *_tile_owner;
 };
 
 bool is_drawing_group(DrawingItem *item);
@@ -26,6 +26,7 @@
 #include "display/drawing.h"
 #include "display/drawing-context.h"
 #include "display/drawing-group.h"
+#include "display/outline-batch.h"
 #include "display/control/canvas-item-drawing.h"
 
 #include "helper/geom-curves.h"
@@ -36,6 +37,13 @@
 
 namespace Inkscape {
 
+namespace {
+
+// Shapes with at least this many markers draw them from sprites.
+std::size_t const MARKER_SPRITE_MIN = 8;
+
+} // namespace
+
 DrawingShape::DrawingShape(Drawing &drawing)
     : DrawingItem(drawing)
     , _curve(nullptr)
@@ -43,9 +51,7 @@ DrawingShape::DrawingShape(Drawing &drawing)
     , _repick_after(0)
 {}
 
-DrawingShape::~DrawingShape()
-{
-}
+DrawingShape::~DrawingShape() = default;
 
 void
 DrawingShape::setPath(SPCurve *curve)
@@ -53,6 +59,8 @@ DrawingShape::setPath(SPCurve *curve)
     _markForRendering();
 
     _curve = curve ? curve->ref() : nullptr;
+    _cairo_path.reset();
+    _cairo_path_recorded = false;
 
     _markForUpdate(STATE_ALL, false);
 }
@@ -108,6 +116,12 @@ DrawingShape::_updateItem(Geom::IntRect const &area, UpdateContext const &ctx, u
 
     // clear Cairo data to force update
     _nrstyle.update();
+    if (_nrstyle.fill.type != NRStyle::PAINT_SERVER) {
+        _fill_mesh.clear();
+    }
+    if (_nrstyle.stroke.type != NRStyle::PAINT_SERVER) {
+        _stroke_mesh.clear();
+    }
 
     if (_curve) {
         boundingbox = bounds_exact_transformed(_curve->get_pathvector(), ctx.ctm);
@@ -131,6 +145,14 @@ DrawingShape::_updateItem(Geom::IntRect const &area, UpdateContext const &ctx, u
 
     _bbox = boundingbox ? boundingbox->roundOutwards() : Geom::OptIntRect();
 
+    // Record the path once here rather than on every render, where it would have to be
+    // done separately for each tile. Rendering may happen on several threads.
+    // Paths which can't be recorded, e.g. with elliptical arcs, are only tried once.
+    if (_curve && !_cairo_path_recorded) {
+        _cairo_path = CairoPath::create(_curve->get_pathvector());
+        _cairo_path_recorded = true;
+    }
+
     if (!_curve || 
         !_style ||
         _curve->is_empty())
@@ -146,8 +168,32 @@ DrawingShape::_updateItem(Geom::IntRect const &area, UpdateContext const &ctx, u
     return STATE_ALL;
 }
 
+/// Append the path of the shape to the context, using the recorded path when available.
 void
-DrawingShape::_renderFill(DrawingContext &dc)
+DrawingShape::_feedPath(DrawingContext &dc)
+{
+    if (_cairo_path) {
+        dc.path(*_cairo_path);
+    } else {
+        dc.path(_curve->get_pathvector());
+    }
+}
+
+/// Fill the current path, with the opacity pushed down to this shape if there is one.
+void
+DrawingShape::_fillPreserve(DrawingContext &dc)
+{
+    if (dc.opacity() < 0.995) {
+        Inkscape::DrawingContext::Save save(dc);
+        dc.clipPreserve();
+        dc.paint(dc.opacity());
+    } else {
+        dc.fillPreserve();
+    }
+}
+
+void
+DrawingShape::_renderFill(DrawingContext &dc, Geom::IntRect const &area)
 {
     Inkscape::DrawingContext::Save save(dc);
     dc.transform(_ctm);
@@ -155,15 +201,16 @@ DrawingShape::_renderFill(DrawingContext &dc)
     bool has_fill =  _nrstyle.prepareFill(dc, _item_bbox, _fill_pattern);
 
     if( has_fill ) {
-        dc.path(_curve->get_pathvector());
+        _feedPath(dc);
         _nrstyle.applyFill(dc);
-        dc.fillPreserve();
+        _fill_mesh.apply(dc, _ctm, *_bbox, area);
+        _fillPreserve(dc);
         dc.newPath(); // clear path
     }
 }
 
 void
-DrawingShape::_renderStroke(DrawingContext &dc)
+DrawingShape::_renderStroke(DrawingContext &dc, Geom::IntRect const &area)
 {
     Inkscape::DrawingContext::Save save(dc);
     dc.transform(_ctm);
@@ -175,12 +222,13 @@ DrawingShape::_renderStroke(DrawingContext &dc)
 
     if( has_stroke ) {
         // TODO: remove segments outside of bbox when no dashes present
-        dc.path(_curve->get_pathvector());
+        _feedPath(dc);
         if (_style && _style->vector_effect.stroke) {
             dc.restore();
             dc.save();
         }
         _nrstyle.applyStroke(dc);
+        _strokeMesh(dc, area);
 
         // If the stroke is a hairline, set it to exactly 1px on screen.
         // If visible hairline mode is on, make sure the line is at least 1px.
@@ -197,11 +245,26 @@ DrawingShape::_renderStroke(DrawingContext &dc)
     }
 }
 
+void
+DrawingShape::_strokeMesh(DrawingContext &dc, Geom::IntRect const &area)
+{
+    // non-scaling strokes are drawn in drawing coordinates
+    bool const vector_effect = _style && _style->vector_effect.stroke;
+    _stroke_mesh.apply(dc, vector_effect ? Geom::identity() : _ctm, *_bbox, area);
+}
+
 void
 DrawingShape::_renderMarkers(DrawingContext &dc, Geom::IntRect const &area, unsigned flags, DrawingItem *stop_at)
 {
     // marker rendering
+    // Most markers of a shape with many of them only differ in position, so they are copied
+    // from sprites rendered once, except while rendering backgrounds, caches or outlines.
+    bool const sprites = !stop_at && !(flags & RENDER_CACHE_ONLY) && !_drawing.outline() &&
+                         _children.size() >= MARKER_SPRITE_MIN;
     for (auto & i : _children) {
+        if (sprites && _marker_sprites.render(dc, i, area, flags)) {
+            continue;
+        }
         i.render(dc, area, flags, stop_at);
     }
 }
@@ -215,12 +278,17 @@ DrawingShape::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigne
     bool outline = _drawing.outline();
 
     if (outline) {
-        guint32 rgba = _drawing.outlinecolor;
+        guint32 rgba = _outlineColor(flags);
 
         // paint-order doesn't matter
+        if (auto batch = dc.outlineBatch()) {
+            batch->addPath(dc, _curve->get_pathvector(), _ctm, rgba);
+            _renderMarkers(dc, area, flags, stop_at);
+            return RENDER_OK;
+        }
         {   Inkscape::DrawingContext::Save save(dc);
             dc.transform(_ctm);
-            dc.path(_curve->get_pathvector());
+            _feedPath(dc);
         }
         {   Inkscape::DrawingContext::Save save(dc);
             dc.setSource(rgba);
@@ -250,11 +318,12 @@ DrawingShape::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigne
             bool has_stroke = _nrstyle.prepareStroke(dc, _item_bbox, _stroke_pattern);
             has_stroke &= (_nrstyle.stroke_width != 0 || _nrstyle.hairline == true);
             if (has_fill || has_stroke) {
-                dc.path(_curve->get_pathvector());
+                _feedPath(dc);
                 // TODO: remove segments outside of bbox when no dashes present
                 if (has_fill) {
                     _nrstyle.applyFill(dc);
-                    dc.fillPreserve();
+                    _fill_mesh.apply(dc, _ctm, *_bbox, area);
+                    _fillPreserve(dc);
                 }
                 if (_style && _style->vector_effect.stroke) {
                     dc.restore();
@@ -262,6 +331,7 @@ DrawingShape::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigne
                 }
                 if (has_stroke) {
                     _nrstyle.applyStroke(dc);
+                    _strokeMesh(dc, area);
 
                     // If the draw mode is set to visible hairlines, don't let anything get smaller
                     // than half a pixel.
@@ -287,10 +357,10 @@ DrawingShape::_renderItem(DrawingContext &dc, Geom::IntRect const &area, unsigne
     for (auto & i : _nrstyle.paint_order_layer) {
         switch (i) {
             case NRStyle::PAINT_ORDER_FILL:
-                _renderFill(dc);
+                _renderFill(dc, area);
                 break;
             case NRStyle::PAINT_ORDER_STROKE:
-                _renderStroke(dc);
+                _renderStroke(dc, area);
                 break;
             case NRStyle::PAINT_ORDER_MARKER:
                 _renderMarkers(dc, area, flags, stop_at);
@@ -317,7 +387,7 @@ void DrawingShape::_clipItem(DrawingContext &dc, Geom::IntRect const & /*area*/)
         }
     }
     dc.transform(_ctm);
-    dc.path(_curve->get_pathvector());
+    _feedPath(dc);
     dc.fill();
 }
 
@@ -424,6 +494,52 @@ DrawingShape::_canClip()
     return true;
 }
 
+bool
+DrawingShape::_clipContextItem(DrawingContext &dc)
+{
+    if (!_curve) return false;
+
+    cairo_t *ct = dc.raw();
+    cairo_fill_rule_t fill_rule = cairo_get_fill_rule(ct);
+    cairo_antialias_t antialias = cairo_get_antialias(ct);
+    _applyAntialias(dc, _antialias);
+    if (_style) {
+        if (_style->clip_rule.computed == SP_WIND_RULE_EVENODD) {
+            dc.setFillRule(CAIRO_FILL_RULE_EVEN_ODD);
+        } else {
+            dc.setFillRule(CAIRO_FILL_RULE_WINDING);
+        }
+    }
+    {   Inkscape::DrawingContext::Save save(dc);
+        dc.transform(_ctm);
+        _feedPath(dc);
+    }
+    dc.clip();
+    // the clip stays, but the item is rendered with its own settings
+    dc.setFillRule(fill_rule);
+    cairo_set_antialias(ct, antialias);
+    return true;
+}
+
+bool
+DrawingShape::_canPaintDirectly()
+{
+    // Strokes and markers are painted over the fill.
+    return _nrstyle.stroke.type == NRStyle::PAINT_NONE && _children.empty();
+}
+
+void
+DrawingShape::_childrenChanged()
+{
+    _marker_sprites.clear();
+}
+
+void
+DrawingShape::_descendantMarkedForRendering()
+{
+    _marker_sprites.clear();
+}
+
 } // end namespace Inkscape
 
 /*
@@ -14,6 +14,8 @@
 #define SEEN_INKSCAPE_DISPLAY_DRAWING_SHAPE_H
 
 #include "display/drawing-item.h"
+#include "display/marker-sprites.h"
+#include "display/mesh-raster.h"
 #include "display/nr-style.h"
 
 #include <memory>
@@ -23,6 +25,8 @@ class SPCurve;
 
 namespace Inkscape {
 
+class CairoPath;
+
 class DrawingShape
     : public DrawingItem
 {
@@ -42,14 +46,26 @@ protected:
     void _clipItem(DrawingContext &dc, Geom::IntRect const &area) override;
     DrawingItem *_pickItem(Geom::Point const &p, double delta, unsigned flags) override;
     bool _canClip() override;
+    bool _clipContextItem(DrawingContext &dc) override;
+    bool _canPaintDirectly() override;
+    void _childrenChanged() override;
+    void _descendantMarkedForRendering() override;
 
-    void _renderFill(DrawingContext &dc);
-    void _renderStroke(DrawingContext &dc);
+    void _feedPath(DrawingContext &dc);
+    void _fillPreserve(DrawingContext &dc);
+    void _renderFill(DrawingContext &dc, Geom::IntRect const &area);
+    void _renderStroke(DrawingContext &dc, Geom::IntRect const &area);
+    void _strokeMesh(DrawingContext &dc, Geom::IntRect const &area);
     void _renderMarkers(DrawingContext &dc, Geom::IntRect const &area, unsigned flags,
                         DrawingItem *stop_at);
 
     std::unique_ptr<SPCurve> _curve;
+    std::unique_ptr<CairoPath> _cairo_path; ///< _curve recorded for cairo, created on update
+    bool _cairo_path_recorded = false;      ///< whether recording _curve was attempted
     NRStyle _nrstyle;
+    MeshRaster _fill_mesh;   ///< images of mesh gradient paint
+    MeshRaster _stroke_mesh;
+    MarkerSprites _marker_sprites;
 
     DrawingItem *_last_pick;
     unsigned _repick_after;
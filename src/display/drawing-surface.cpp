@@ -11,14 +11,16 @@
  */
 
 //#include <iostream>
+#include <algorithm>
+#include <cmath>
 #ifdef  WITH_PATCHED_CAIRO
 #include "3rdparty/cairo/src/cairo.h"
 #endif
 
-#include "preferences.h"
 #include "display/drawing-surface.h"
 #include "display/drawing-context.h"
 #include "display/cairo-utils.h"
+#include "display/surface-pool.h"
 
 
 namespace Inkscape {
@@ -26,6 +28,8 @@ namespace Inkscape {
 using Geom::X;
 using Geom::Y;
 
+std::atomic<bool> DrawingSurface::_dither{true};
+
 
 /**
  * @class DrawingSurface
@@ -183,14 +187,14 @@ DrawingSurface::createRawContext()
 {
     // deferred allocation
     if (!_surface) {
-        _surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                              _pixels[X] * _device_scale,
-                                              _pixels[Y] * _device_scale);
+        _surface = Inkscape::SurfacePool::get().create(CAIRO_FORMAT_ARGB32,
+                                                       _pixels[X] * _device_scale,
+                                                       _pixels[Y] * _device_scale);
         cairo_surface_set_device_scale(_surface, _device_scale, _device_scale);
 #ifdef CAIRO_HAS_DITHER
-        Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-        if(prefs->getBool("/options/dithering/value", true))
+        if (_dither) {
             cairo_image_surface_set_dither(_surface, CAIRO_DITHER_BEST);
+        }
 #endif
     }
     cairo_t *ct = cairo_create(_surface);
@@ -219,6 +223,10 @@ DrawingCache::DrawingCache(Geom::IntRect const &area, int device_scale)
 DrawingCache::~DrawingCache()
 {
     cairo_region_destroy(_clean_region);
+    for (auto &level : _levels) {
+        cairo_surface_destroy(level.surface);
+        cairo_region_destroy(level.clean_region);
+    }
 }
 
 void
@@ -226,6 +234,15 @@ DrawingCache::markDirty(Geom::IntRect const &area)
 {
     cairo_rectangle_int_t dirty = _convertRect(area);
     cairo_region_subtract_rectangle(_clean_region, &dirty);
+
+    for (auto &level : _levels) {
+        Geom::OptRect level_dirty = Geom::Rect(level.area) * level.transform;
+        level_dirty.intersectWith(Geom::Rect(area));
+        if (level_dirty) {
+            dirty = _convertRect((*level_dirty * level.transform.inverse()).roundOutwards());
+            cairo_region_subtract_rectangle(level.clean_region, &dirty);
+        }
+    }
 }
 void
 DrawingCache::markClean(Geom::IntRect const &area)
@@ -236,12 +253,113 @@ DrawingCache::markClean(Geom::IntRect const &area)
     cairo_region_union_rectangle(_clean_region, &clean);
 }
 
-/// Call this during the update phase to schedule a transformation of the cache.
+/**
+ * Call this during the update phase, before children are updated,
+ * to schedule a transformation of the cache.
+ *
+ * Integer translations are carried out by prepare(). Other transforms make
+ * the contents unusable; they are then kept as a level of the cache, so that
+ * they can be used again if the transform is undone later, e.g. when zooming
+ * back to a previous zoom level.
+ */
 void
-DrawingCache::scheduleTransform(Geom::IntRect const &new_area, Geom::Affine const &trans)
+DrawingCache::scheduleTransform(Geom::Affine const &trans)
 {
-    _pending_area = new_area;
+    if (trans.isIdentity()) return;
+
     _pending_transform *= trans;
+    for (auto &level : _levels) {
+        level.transform *= trans;
+    }
+
+    if (!_isIntegerTranslation(_pending_transform)) {
+        _storeLevel();
+        _restoreLevel();
+    }
+}
+
+/// Call this during the update phase to schedule a change of the cached area.
+void
+DrawingCache::scheduleResize(Geom::IntRect const &new_area)
+{
+    _pending_area = new_area;
+}
+
+/// Keep the current contents as a level and start over with an empty cache.
+void
+DrawingCache::_storeLevel()
+{
+    static int const max_levels = 3;
+    static int const max_octaves = 2;
+
+    if (_surface && !cairo_region_is_empty(_clean_region)) {
+        _levels.insert(_levels.begin(), Level{_surface, _clean_region, pixelArea(), _pending_transform});
+    } else {
+        cairo_surface_destroy(_surface);
+        cairo_region_destroy(_clean_region);
+    }
+    _surface = nullptr;
+    _clean_region = cairo_region_create();
+    _pending_transform.setIdentity();
+
+    // Keep at most one level per octave of scale, and only those close to the current scale.
+    std::vector<int> octaves;
+    for (auto it = _levels.begin(); it != _levels.end(); ) {
+        double expansion = it->transform.descrim();
+        int octave = expansion > 1e-3 ? std::round(std::log2(expansion)) : max_octaves + 1;
+        bool keep = std::abs(octave) <= max_octaves
+                 && (int)octaves.size() < max_levels
+                 && std::find(octaves.begin(), octaves.end(), octave) == octaves.end();
+        if (keep) {
+            octaves.push_back(octave);
+            ++it;
+        } else {
+            cairo_surface_destroy(it->surface);
+            cairo_region_destroy(it->clean_region);
+            it = _levels.erase(it);
+        }
+    }
+}
+
+size_t
+DrawingCache::levelBytes() const
+{
+    size_t bytes = 0;
+    for (auto const &level : _levels) {
+        bytes += (size_t)cairo_image_surface_get_stride(level.surface)
+               * cairo_image_surface_get_height(level.surface);
+    }
+    return bytes;
+}
+
+/// Replace the (empty) current contents with a level rendered at the current transform, if any.
+void
+DrawingCache::_restoreLevel()
+{
+    for (auto it = _levels.begin(); it != _levels.end(); ++it) {
+        if (_isIntegerTranslation(it->transform)) {
+            Geom::IntPoint t = it->transform.translation().round();
+            cairo_region_translate(it->clean_region, t[X], t[Y]);
+
+            cairo_surface_destroy(_surface);
+            cairo_region_destroy(_clean_region);
+            _surface = it->surface;
+            _clean_region = it->clean_region;
+            _origin = Geom::Point(it->area.min() + t);
+            _pixels = it->area.dimensions();
+
+            _levels.erase(it);
+            return;
+        }
+    }
+}
+
+bool
+DrawingCache::_isIntegerTranslation(Geom::Affine const &trans)
+{
+    if (!trans.isTranslation()) return false;
+    Geom::Point t = trans.translation();
+    return Geom::are_near(Geom::Point(t.round()), t);
 }
 
 /// Transforms the cache according to the transform specified during the update phase.
@@ -279,7 +397,7 @@ DrawingCache::prepare()
     _pixels = _pending_area.dimensions();
     _origin = _pending_area.min();
 
-    if (is_integer_translation) {
+    if (is_integer_translation && old_surface) {
         // transform the cache only for integer translations and identities
         cairo_t *ct = createRawContext();
         if (!is_identity) {
@@ -305,10 +423,10 @@ DrawingCache::prepare()
 }
 
 /**
- * Paints the clean area from cache and modifies the @a area
+ * Paints the clean area from cache with the given @a opacity and modifies the @a area
  * parameter to the bounds of the region that must be repainted.
  */
-void DrawingCache::paintFromCache(DrawingContext &dc, Geom::OptIntRect &area, bool is_filter)
+void DrawingCache::paintFromCache(DrawingContext &dc, Geom::OptIntRect &area, double opacity)
 {
     if (!area) return;
 
@@ -322,9 +440,6 @@ void DrawingCache::paintFromCache(DrawingContext &dc, Geom::OptIntRect &area, bo
     cairo_region_t *cache_region = cairo_region_copy(dirty_region);
     cairo_region_subtract(dirty_region, _clean_region);
 
-    if (is_filter && !cairo_region_is_empty(dirty_region)) { // To allow fast panning on high zoom on filters
-        return;
-    }
     if (cairo_region_is_empty(dirty_region)) {
         area = Geom::OptIntRect();
     } else {
@@ -344,7 +459,13 @@ void DrawingCache::paintFromCache(DrawingContext &dc, Geom::OptIntRect &area, bo
             dc.rectangle(_convertRect(tmp));
         }
         dc.setSource(this);
-        dc.fill();
+        if (opacity < 0.995) {
+            Inkscape::DrawingContext::Save save(dc);
+            dc.clip();
+            dc.paint(opacity);
+        } else {
+            dc.fill();
+        }
     }
     cairo_region_destroy(cache_region);
 }
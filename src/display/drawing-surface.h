@@ -17,6 +17,8 @@
 #include <2geom/affine.h>
 #include <2geom/rect.h>
 #include <2geom/transforms.h>
+#include <atomic>
+#include <vector>
 
 extern "C" {
 typedef struct _cairo cairo_t;
@@ -48,6 +50,9 @@ public:
     cairo_surface_t *raw() { return _surface; }
     cairo_t *createRawContext();
 
+    /// Whether new surfaces dither gradients; set from the preferences on the main thread.
+    static void setDither(bool dither) { _dither = dither; }
+
 protected:
     Geom::IntRect pixelArea() const;
 
@@ -58,6 +63,8 @@ protected:
     int _device_scale; // To support HiDPI screens
     bool _has_context;
 
+    static std::atomic<bool> _dither;
+
     friend class DrawingContext;
 };
 
@@ -70,16 +77,31 @@ public:
 
     void markDirty(Geom::IntRect const &area = Geom::IntRect::infinite());
     void markClean(Geom::IntRect const &area = Geom::IntRect::infinite());
-    void scheduleTransform(Geom::IntRect const &new_area, Geom::Affine const &trans);
+    void scheduleTransform(Geom::Affine const &trans);
+    void scheduleResize(Geom::IntRect const &new_area);
     void prepare();
-    void paintFromCache(DrawingContext &dc, Geom::OptIntRect &area, bool is_filter);
+    /// Memory used by the contents kept from earlier transforms, in bytes.
+    size_t levelBytes() const;
+    void paintFromCache(DrawingContext &dc, Geom::OptIntRect &area, double opacity = 1.0);
 
   protected:
+    /// Contents rendered at an earlier transform, kept in case that transform returns.
+    struct Level {
+        cairo_surface_t *surface;
+        cairo_region_t *clean_region;
+        Geom::IntRect area;     ///< pixel area in the coordinates of the level
+        Geom::Affine transform; ///< from the coordinates of the level to the current ones
+    };
+
     cairo_region_t *_clean_region;
     Geom::IntRect _pending_area;
     Geom::Affine _pending_transform;
+    std::vector<Level> _levels; ///< most recent first
 private:
+    void _storeLevel();
+    void _restoreLevel();
     void _dumpCache(Geom::OptIntRect const &area);
+    static bool _isIntegerTranslation(Geom::Affine const &trans);
     static cairo_rectangle_int_t _convertRect(Geom::IntRect const &r);
     static Geom::IntRect _convertRect(cairo_rectangle_int_t const &r);
 };
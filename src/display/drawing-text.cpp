@@ -10,7 +10,11 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <utility>
+#include <vector>
+
 #include "2geom/pathvector.h"
+#include "2geom/transforms.h"
 
 #include "style.h"
 
@@ -19,6 +23,9 @@
 #include "display/drawing-surface.h"
 #include "display/drawing-text.h"
 #include "display/drawing.h"
+#include "display/glyph-atlas.h"
+#include "display/outline-batch.h"
+#include "display/surface-pool.h"
 
 #include "helper/geom.h"
 
@@ -101,6 +108,12 @@ unsigned DrawingGlyphs::_updateItem(Geom::IntRect const &/*area*/, UpdateContext
 
     Geom::Rect b;
     if (_drawable) {
+        if (_font->FontHasSVG()) {
+            // Load the SVG glyph here, since rendering may happen on a render thread.
+            if (auto pixbuf = _font->PixBuf(_glyph)) {
+                pixbuf->ensurePixelFormat(Inkscape::Pixbuf::PF_CAIRO);
+            }
+        }
         Geom::OptRect tiltb = bounds_exact(*_font->PathVector(_glyph));
         if (tiltb) {
             Geom::Rect bigbox(Geom::Point(tiltb->left(),-_dsc*scale_bigbox*1.1),Geom::Point(tiltb->right(),_asc*scale_bigbox*1.1));
@@ -225,6 +238,7 @@ DrawingText::clear()
 {
     _markForRendering();
     _children.clear_and_dispose(DeleteDisposer());
+    _childrenChanged();
 }
 
 bool
@@ -456,10 +470,14 @@ void DrawingText::decorateItem(DrawingContext &dc, double phase_length, bool und
     }
 }
 
-unsigned DrawingText::_renderItem(DrawingContext &dc, Geom::IntRect const &/*area*/, unsigned /*flags*/, DrawingItem * /*stop_at*/)
+unsigned DrawingText::_renderItem(DrawingContext &dc, Geom::IntRect const &/*area*/, unsigned flags, DrawingItem * /*stop_at*/)
 {
     if (_drawing.outline()) {
-        guint32 rgba = _drawing.outlinecolor;
+        // stroke the outlines batched so far, so that they stay below the glyphs
+        if (auto batch = dc.outlineBatch()) {
+            batch->flush(dc);
+        }
+        guint32 rgba = _outlineColor(flags);
         Inkscape::DrawingContext::Save save(dc);
         dc.setSource(rgba);
         dc.setTolerance(0.5); // low quality, but good enough for outline mode
@@ -593,6 +611,58 @@ unsigned DrawingText::_renderItem(DrawingContext &dc, Geom::IntRect const &/*are
             dc.newPath(); // Clear text-decoration path
         }
 
+        // Glyphs filled with a solid color are drawn with masks from the glyph atlas, unless
+        // they also need their outline for a stroke. The masks are placed in device pixels.
+        bool use_atlas = has_fill && !has_stroke && _drawing.glyphAtlas()
+                      && _nrstyle.fill.type == NRStyle::PAINT_COLOR;
+        std::vector<std::pair<cairo_surface_t *, Geom::IntPoint>> glyph_masks;
+        double device_scale_x = 1.0, device_scale_y = 1.0;
+        Geom::Affine to_device;
+        if (use_atlas) {
+            cairo_matrix_t ctm;
+            cairo_get_matrix(dc.raw(), &ctm);
+            ink_matrix_to_2geom(to_device, ctm);
+            cairo_surface_get_device_scale(cairo_get_group_target(dc.raw()),
+                                           &device_scale_x, &device_scale_y);
+            to_device *= Geom::Scale(device_scale_x, device_scale_y);
+        }
+        // The masks are combined into one before painting, so that where glyphs overlap the
+        // color is only painted once, and touching glyphs leave no seams. Their coverage is
+        // added up for the nonzero fill rule, and xor-ed for evenodd. This only approximates
+        // a fill of the path of all the glyphs: where glyphs overlap, the coverage of
+        // antialiased pixels can differ slightly from that of the combined path, and for
+        // evenodd the overlap of two glyphs is only left out where both cover it fully.
+        auto paint_glyph_masks = [&] {
+            if (glyph_masks.empty()) return;
+            Geom::OptIntRect bounds;
+            for (auto const &mask : glyph_masks) {
+                bounds.unionWith(Geom::IntRect::from_xywh(mask.second,
+                    Geom::IntPoint(cairo_image_surface_get_width(mask.first),
+                                   cairo_image_surface_get_height(mask.first))));
+            }
+            cairo_surface_t *combined;
+            if (glyph_masks.size() == 1) {
+                combined = cairo_surface_reference(glyph_masks.front().first);
+            } else {
+                combined = SurfacePool::get().create(CAIRO_FORMAT_A8, bounds->width(), bounds->height());
+                cairo_t *ct = cairo_create(combined);
+                cairo_set_operator(ct, _nrstyle.fill_rule == CAIRO_FILL_RULE_EVEN_ODD
+                                           ? CAIRO_OPERATOR_XOR : CAIRO_OPERATOR_ADD);
+                for (auto const &mask : glyph_masks) {
+                    cairo_set_source_surface(ct, mask.first, mask.second.x() - bounds->left(),
+                                             mask.second.y() - bounds->top());
+                    cairo_paint(ct);
+                }
+                cairo_destroy(ct);
+            }
+
+            Inkscape::DrawingContext::Save save(dc);
+            cairo_identity_matrix(dc.raw());
+            cairo_scale(dc.raw(), 1.0 / device_scale_x, 1.0 / device_scale_y);
+            cairo_mask_surface(dc.raw(), combined, bounds->left(), bounds->top());
+            cairo_surface_destroy(combined);
+        };
+
         // Accumulate the path that represents the glyphs and/or draw SVG glyphs.
         for (auto & i : _children) {
             DrawingGlyphs *g = dynamic_cast<DrawingGlyphs *>(&i);
@@ -628,7 +698,16 @@ unsigned DrawingText::_renderItem(DrawingContext &dc, Geom::IntRect const &/*are
                         dc.path(*g->_font->PathVector(g->_glyph));
                     }
                 } else {
-                    dc.path(*g->_font->PathVector(g->_glyph));
+                    Geom::IntPoint origin;
+                    cairo_surface_t *mask = !use_atlas ? nullptr :
+                        GlyphAtlas::get().mask(g->_font, g->_glyph, g->_ctm * to_device,
+                                               _nrstyle.fill_rule, cairo_get_antialias(dc.raw()),
+                                               origin);
+                    if (mask) {
+                        glyph_masks.emplace_back(mask, origin);
+                    } else {
+                        dc.path(*g->_font->PathVector(g->_glyph));
+                    }
                 }
             }
         }
@@ -640,6 +719,7 @@ unsigned DrawingText::_renderItem(DrawingContext &dc, Geom::IntRect const &/*are
             if (has_fill && fill_first) {
                 _nrstyle.applyFill(dc);
                 dc.fillPreserve();
+                paint_glyph_masks();
             }
         }
         {
@@ -669,9 +749,13 @@ unsigned DrawingText::_renderItem(DrawingContext &dc, Geom::IntRect const &/*are
             if (has_fill && !fill_first) {
                 _nrstyle.applyFill(dc);
                 dc.fillPreserve();
+                paint_glyph_masks();
             }
         }
         dc.newPath(); // Clear glyphs path
+        for (auto const &mask : glyph_masks) {
+            cairo_surface_destroy(mask.first);
+        }
 
         // Draw text decorations that go OVER the text (line through, blink)
         if (decorate) {
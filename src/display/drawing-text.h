@@ -70,6 +70,8 @@ protected:
     void _clipItem(DrawingContext &dc, Geom::IntRect const &area) override;
     DrawingItem *_pickItem(Geom::Point const &p, double delta, unsigned flags) override;
     bool _canClip() override;
+    bool _clipContextItem(DrawingContext &/*dc*/) override { return false; }
+    bool _canPaintDirectly() override { return false; }
 
     void decorateItem(DrawingContext &dc, double phase_length, bool under);
     void decorateStyle(DrawingContext &dc, double vextent, double xphase, Geom::Point const &p1, Geom::Point const &p2, double thickness);
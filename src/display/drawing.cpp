@@ -13,12 +13,17 @@
 
 #include "display/drawing.h"
 #include "display/control/canvas-item-drawing.h"
+#include "mesh-raster.h"
 #include "nr-filter-gaussian.h"
 #include "nr-filter-types.h"
+#include "outline-batch.h"
+#include "pattern-tile-cache.h"
+#include "preferences.h"
 
 //grayscale colormode:
 #include "cairo-templates.h"
 #include "drawing-context.h"
+#include "drawing-surface.h"
 
 
 namespace Inkscape {
@@ -152,6 +157,23 @@ Drawing::setCacheBudget(size_t bytes)
 {
     _cache_budget = bytes;
     _pickItemsForCaching();
+    // Pattern tiles and mesh gradient images are shared between drawings and take a part of
+    // the budget.
+    PatternTileCache::get().setBudget(bytes / 4);
+    MeshRaster::setBudget(bytes / 4);
+}
+
+bool
+Drawing::glyphAtlas() const
+{
+    // glyph masks are placed to a fraction of a pixel, which is not good enough for exports
+    return _glyph_atlas && !_exact;
+}
+
+void
+Drawing::setGlyphAtlas(bool enabled)
+{
+    _glyph_atlas = enabled;
 }
 
 void
@@ -163,6 +185,17 @@ Drawing::setGrayscaleMatrix(gdouble value_matrix[20]) {
 void
 Drawing::update(Geom::IntRect const &area, unsigned flags, unsigned reset)
 {
+    // Settings consulted during rendering are read here, so that rendering itself
+    // never has to modify the drawing and can run on several threads at once.
+    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
+    setFilterQuality(prefs->getInt("/options/filterquality/value", 0));
+    setBlurQuality(prefs->getInt("/options/blurquality/value", 0));
+    _colors.clippaths = prefs->getInt("/options/wireframecolors/clips", 0x00ff00ff); // green clips
+    _colors.masks = prefs->getInt("/options/wireframecolors/masks", 0x0000ffff);     // blue masks
+    _colors.images = prefs->getInt("/options/wireframecolors/images", 0xff0000ff);   // red images
+    _image_outline = prefs->getBool("/options/rendering/imageinoutlinemode", false);
+    DrawingSurface::setDither(prefs->getBool("/options/dithering/value", true));
+
     if (_root) {
         auto ctx = _canvas_item_drawing ? _canvas_item_drawing->get_context() : UpdateContext();
         _root->update(area, ctx, flags, reset);
@@ -177,13 +210,35 @@ void
 Drawing::render(DrawingContext &dc, Geom::IntRect const &area, unsigned flags, int antialiasing)
 {
     if (_root) {
-        int prev_a = _root->_antialias;
-        if(antialiasing >= 0)
+        if (antialiasing >= 0 && unsigned(antialiasing) != _root->_antialias) {
+            // The setting reaches the items during the update, since rendering doesn't modify
+            // them. It is kept for later renderings.
             _root->setAntialiasing(antialiasing);
-        _root->render(dc, area, flags);
-        _root->setAntialiasing(prev_a);
+            update(area);
+        }
+        if (outline()) {
+            // stroke the outlines of all shapes together, one path per color
+            OutlineBatch batch(dc, area);
+            dc.setOutlineBatch(&batch);
+            _root->render(dc, area, flags);
+            dc.setOutlineBatch(nullptr);
+            batch.flush(dc);
+        } else {
+            _root->render(dc, area, flags);
+        }
     }
 
+    applyColorMode(dc);
+}
+
+/**
+ * Apply the color mode to everything already drawn on the target of @a dc.
+ * This is the last step of render(), for callers that composite the rendered drawing
+ * over other content first.
+ */
+void
+Drawing::applyColorMode(DrawingContext &dc)
+{
     if (colorMode() == ColorMode::GRAYSCALE) {
         // apply grayscale filter on top of everything
         cairo_surface_t *input = dc.rawTarget();
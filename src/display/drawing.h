@@ -16,6 +16,7 @@
 #include <2geom/rect.h>
 #include <boost/operators.hpp>
 #include <boost/utility.hpp>
+#include <mutex>
 #include <set>
 #include <sigc++/sigc++.h>
 
@@ -55,6 +56,8 @@ public:
     bool visibleHairlines() const;
     bool outlineOverlay() const;
     bool renderFilters() const;
+    /// Whether any item of the drawing has a filter.
+    bool hasFilters() const { return _filter_count > 0; }
     int blurQuality() const;
     int filterQuality() const;
     void setRenderMode(RenderMode mode);
@@ -63,14 +66,22 @@ public:
     void setFilterQuality(int q);
     void setExact(bool e);
     bool getExact() const { return _exact; };
+    /// Whether rendering is a quick preview, which leaves out filters and doesn't touch caches.
+    bool draft() const { return _draft; }
+    void setDraft(bool draft) { _draft = draft; }
     void setOutlineSensitive(bool e);
     bool getOutlineSensitive() const { return _outline_sensitive; };
 
     Geom::OptIntRect const &cacheLimit() const;
     void setCacheLimit(Geom::OptIntRect const &r, bool update_cache = true);
     void setCacheBudget(size_t bytes);
+    /// Whether text in a solid color is drawn with glyph masks from GlyphAtlas.
+    bool glyphAtlas() const;
+    void setGlyphAtlas(bool enabled);
 
     OutlineColors const &colors() const { return _colors; }
+    /// Whether images are shown in outline mode, rather than only their frame.
+    bool imageOutline() const { return _image_outline; }
 
     void setGrayscaleMatrix(double value_matrix[20]);
 
@@ -78,6 +89,7 @@ public:
                 unsigned reset = 0);
 
     void render(DrawingContext &dc, Geom::IntRect const &area, unsigned flags = 0, int antialiasing = -1);
+    void applyColorMode(DrawingContext &dc);
     DrawingItem *pick(Geom::Point const &p, double delta, unsigned flags);
 
     void average_color(Geom::IntRect const &area, double &R, double &G, double &B, double &A);
@@ -93,11 +105,11 @@ private:
 
 public:
     // TODO: remove these temporarily public members
-    guint32 outlinecolor = 0x000000ff;
     double delta = 0;
 
 private:
     bool _exact = false;  // if true then rendering must be exact
+    bool _draft = false;
     RenderMode _rendermode = RenderMode::NORMAL;
     ColorMode _colormode = ColorMode::NORMAL;
     int _blur_quality = BLUR_QUALITY_BEST;
@@ -106,8 +118,13 @@ private:
 
     double _cache_score_threshold = 50000.0; ///< do not consider objects for caching below this score
     size_t _cache_budget = 0;                ///< maximum allowed size of cache
+    bool _glyph_atlas = true;
+    int _filter_count = 0; ///< number of items with a filter, kept by DrawingItem
 
-    OutlineColors _colors;
+    OutlineColors _colors = {0x000000ff, 0x00ff00ff, 0x0000ffff, 0xff0000ff};
+    bool _image_outline = false;
+    std::mutex _cache_mutex;               ///< guards cache state when rendering from several threads
+    Geom::Affine _root_ctm_change;         ///< change of the root transform in the last update
     Filters::FilterColorMatrix::ColorMatrixMatrix _grayscale_colormatrix;
     Inkscape::CanvasItemDrawing *_canvas_item_drawing = nullptr;
 
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Cache of rasterized glyphs, drawn as masks instead of filling their outlines.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/glyph-atlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include <2geom/pathvector.h>
+#include <2geom/rect.h>
+#include <2geom/transforms.h>
+
+#include "display/cairo-utils.h"
+#include "libnrtype/font-instance.h"
+
+namespace Inkscape {
+
+namespace {
+
+// Maximum total size of the masks.
+std::size_t const ATLAS_LIMIT = 16 << 20;
+// Steps of the scale per pixel per em.
+double const SCALE_STEPS = 256.0;
+// Steps of the translation per pixel.
+int const SUBPIXEL_STEPS = 4;
+// Larger glyphs are few and expensive to keep, so they are filled as paths.
+double const MAX_SCALE = 256.0;
+
+/// Split a coordinate into whole pixels and a rounded fraction in subpixel steps.
+void split_subpixel(double coord, int &pixel, int &subpixel)
+{
+    double whole = std::floor(coord);
+    subpixel = static_cast<int>(std::lround((coord - whole) * SUBPIXEL_STEPS));
+    if (subpixel == SUBPIXEL_STEPS) {
+        whole += 1;
+        subpixel = 0;
+    }
+    pixel = static_cast<int>(whole);
+}
+
+} // namespace
+
+bool
+GlyphAtlas::Key::operator==(Key const &other) const
+{
+    return font == other.font && glyph == other.glyph
+        && scale_x == other.scale_x && scale_y == other.scale_y
+        && subpixel_x == other.subpixel_x && subpixel_y == other.subpixel_y
+        && fill_rule == other.fill_rule && antialias == other.antialias;
+}
+
+std::size_t
+GlyphAtlas::KeyHash::operator()(Key const &key) const
+{
+    std::size_t h = std::hash<void const *>()(key.font);
+    for (int v : { key.glyph, key.scale_x, key.scale_y, key.subpixel_x, key.subpixel_y,
+                   static_cast<int>(key.fill_rule), static_cast<int>(key.antialias) })
+    {
+        h ^= std::hash<int>()(v) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    }
+    return h;
+}
+
+GlyphAtlas &
+GlyphAtlas::get()
+{
+    // Never destroyed, since fonts can still be released while static objects are destroyed.
+    static GlyphAtlas *atlas = new GlyphAtlas();
+    return *atlas;
+}
+
+cairo_surface_t *
+GlyphAtlas::mask(font_instance *font, int glyph, Geom::Affine const &device,
+                 cairo_fill_rule_t fill_rule, cairo_antialias_t antialias, Geom::IntPoint &origin)
+{
+    double const sx = device[0];
+    double const sy = device[3];
+    double const limit = 1e-6 * std::max(std::abs(sx), std::abs(sy));
+    if (std::abs(device[1]) > limit || std::abs(device[2]) > limit
+        || std::abs(sx) > MAX_SCALE || std::abs(sy) > MAX_SCALE)
+    {
+        return nullptr;
+    }
+
+    Key key;
+    key.font = font;
+    key.glyph = glyph;
+    key.scale_x = static_cast<int>(std::lround(sx * SCALE_STEPS));
+    key.scale_y = static_cast<int>(std::lround(sy * SCALE_STEPS));
+    key.fill_rule = fill_rule;
+    key.antialias = antialias;
+    if (key.scale_x == 0 || key.scale_y == 0) {
+        return nullptr;
+    }
+
+    Geom::IntPoint pixel;
+    split_subpixel(device[4], pixel[Geom::X], key.subpixel_x);
+    split_subpixel(device[5], pixel[Geom::Y], key.subpixel_y);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _index.find(key);
+        if (found != _index.end()) {
+            _entries.splice(_entries.begin(), _entries, found->second);
+            origin = pixel + found->second->offset;
+            return cairo_surface_reference(found->second->mask);
+        }
+    }
+
+    // The outlines are loaded when the text is laid out, so this only reads them.
+    Geom::PathVector const *path = font->PathVector(glyph);
+    Geom::OptRect bounds = path ? path->boundsExact() : Geom::OptRect();
+    if (!bounds) {
+        return nullptr;
+    }
+
+    Geom::Affine raster = Geom::Scale(key.scale_x / SCALE_STEPS, key.scale_y / SCALE_STEPS)
+                        * Geom::Translate(double(key.subpixel_x) / SUBPIXEL_STEPS,
+                                          double(key.subpixel_y) / SUBPIXEL_STEPS);
+    Geom::IntRect area = (*bounds * raster).roundOutwards();
+    area.expandBy(1);
+
+    cairo_surface_t *mask =
+        cairo_image_surface_create(CAIRO_FORMAT_A8, area.width(), area.height());
+    cairo_t *ct = cairo_create(mask);
+    cairo_set_antialias(ct, antialias);
+    cairo_set_fill_rule(ct, fill_rule);
+    ink_cairo_transform(ct, raster * Geom::Translate(-Geom::Point(area.min())));
+    feed_pathvector_to_cairo(ct, *path);
+    cairo_fill(ct);
+    cairo_destroy(ct);
+    cairo_surface_flush(mask);
+
+    Entry entry{ key, mask, area.min(),
+                 static_cast<std::size_t>(cairo_image_surface_get_stride(mask)) * area.height() };
+    std::vector<cairo_surface_t *> evicted;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto found = _index.find(key);
+        if (found != _index.end()) {
+            // rasterized by another thread in the meantime
+            evicted.push_back(mask);
+            mask = found->second->mask;
+        } else {
+            _entries.push_front(entry);
+            _index.emplace(key, _entries.begin());
+            _size += entry.size;
+            while (_size > ATLAS_LIMIT && _entries.size() > 1) {
+                Entry &last = _entries.back();
+                _size -= last.size;
+                _index.erase(last.key);
+                evicted.push_back(last.mask);
+                _entries.pop_back();
+            }
+        }
+        cairo_surface_reference(mask);
+    }
+
+    for (auto surface : evicted) {
+        cairo_surface_destroy(surface);
+    }
+    origin = pixel + entry.offset;
+    return mask;
+}
+
+void
+GlyphAtlas::invalidate(font_instance const *font)
+{
+    std::vector<cairo_surface_t *> evicted;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            if (it->key.font == font) {
+                _size -= it->size;
+                _index.erase(it->key);
+                evicted.push_back(it->mask);
+                it = _entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (auto surface : evicted) {
+        cairo_surface_destroy(surface);
+    }
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
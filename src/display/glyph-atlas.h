@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Cache of rasterized glyphs, drawn as masks instead of filling their outlines.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_GLYPH_ATLAS_H
+#define SEEN_INKSCAPE_DISPLAY_GLYPH_ATLAS_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <2geom/affine.h>
+#include <2geom/int-point.h>
+#include <cairo.h>
+
+class font_instance;
+
+namespace Inkscape {
+
+/**
+ * Keeps glyphs rasterized into alpha masks, so that text in a solid color can be drawn by
+ * masking instead of filling every glyph outline on every render.
+ *
+ * Only glyphs drawn with a device transform that is a scale and translation are rasterized.
+ * A mask is made for the scale rounded to 1/256 pixel per em, and for the translation rounded
+ * to 1/4 pixel; the whole pixels of the translation only move the mask. This places glyphs
+ * within 1/8 pixel of their exact position, so exports, which must be exact, fill the outlines.
+ *
+ * Masks are kept up to a total size limit, dropping the least recently used ones first.
+ * Fonts drop their glyphs with invalidate() when they are destroyed. All functions are
+ * thread-safe.
+ */
+class GlyphAtlas
+{
+public:
+    static GlyphAtlas &get();
+
+    /**
+     * Get the mask of a glyph filled with @a fill_rule and @a antialias under the transform
+     * @a device, from glyph to device pixel coordinates.
+     *
+     * Returns a new reference to an A8 surface, and sets @a origin to the device pixel of its
+     * top left corner. Returns nullptr if the glyph should be filled as a path instead,
+     * because it has no outline, is too large, or the transform is not a scale and translation.
+     */
+    cairo_surface_t *mask(font_instance *font, int glyph, Geom::Affine const &device,
+                          cairo_fill_rule_t fill_rule, cairo_antialias_t antialias,
+                          Geom::IntPoint &origin);
+
+    /// Drop all glyphs of @a font.
+    void invalidate(font_instance const *font);
+
+private:
+    GlyphAtlas() = default;
+
+    struct Key
+    {
+        font_instance const *font;
+        int glyph;
+        int scale_x;     ///< scale in 1/256 pixels per em
+        int scale_y;
+        int subpixel_x;  ///< fraction of the translation in 1/4 pixels
+        int subpixel_y;
+        cairo_fill_rule_t fill_rule;
+        cairo_antialias_t antialias;
+
+        bool operator==(Key const &other) const;
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(Key const &key) const;
+    };
+
+    struct Entry
+    {
+        Key key;
+        cairo_surface_t *mask;
+        Geom::IntPoint offset;  ///< position of the mask relative to the whole pixel translation
+        std::size_t size;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    std::mutex _mutex;
+    EntryList _entries;  ///< most recently used first
+    std::unordered_map<Key, EntryList::iterator, KeyHash> _index;
+    std::size_t _size = 0;  ///< total size of the masks
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_GLYPH_ATLAS_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,203 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Reduced resolution copies of bitmap images, built in the background.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/image-mipmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "display/cairo-utils.h"
+
+namespace Inkscape {
+
+namespace {
+
+// Levels are halved until both dimensions are at most this size.
+int const MIN_LEVEL_SIZE = 32;
+
+/// Make an image of half the size of @a src by averaging each 2x2 block of premultiplied
+/// ARGB32 pixels. For odd sizes, the last row and column are repeated.
+cairo_surface_t *halve(unsigned char const *src, int width, int height, int stride)
+{
+    int const w = (width + 1) / 2;
+    int const h = (height + 1) / 2;
+    cairo_surface_t *dest = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+    if (cairo_surface_status(dest) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(dest);
+        return nullptr;
+    }
+    cairo_surface_flush(dest);
+    unsigned char *data = cairo_image_surface_get_data(dest);
+    int const dest_stride = cairo_image_surface_get_stride(dest);
+
+    for (int y = 0; y < h; ++y) {
+        auto row0 = reinterpret_cast<std::uint32_t const *>(src + 2 * y * stride);
+        auto row1 = reinterpret_cast<std::uint32_t const *>(
+            src + std::min(2 * y + 1, height - 1) * stride);
+        auto out = reinterpret_cast<std::uint32_t *>(data + y * dest_stride);
+        for (int x = 0; x < w; ++x) {
+            int const x0 = 2 * x;
+            int const x1 = std::min(x0 + 1, width - 1);
+            std::uint32_t const a = row0[x0], b = row0[x1], c = row1[x0], d = row1[x1];
+            std::uint32_t result = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                std::uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff)
+                                  + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+                result |= ((sum + 2) >> 2) << shift;
+            }
+            out[x] = result;
+        }
+    }
+    cairo_surface_mark_dirty(dest);
+    return dest;
+}
+
+} // namespace
+
+/**
+ * Builds the levels of mipmaps, one mipmap at a time, on a thread of its own so that
+ * rendering is not held up by it.
+ */
+class ImageMipmap::Worker
+{
+public:
+    static Worker &get()
+    {
+        // Never destroyed, since the thread can still be running while static objects are
+        // destroyed.
+        static Worker *worker = new Worker();
+        return *worker;
+    }
+
+    void add(std::weak_ptr<ImageMipmap> mipmap)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(std::move(mipmap));
+        if (!_started) {
+            std::thread([this] { _run(); }).detach();
+            _started = true;
+        }
+        _cond.notify_one();
+    }
+
+private:
+    void _run()
+    {
+        while (true) {
+            std::weak_ptr<ImageMipmap> job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _cond.wait(lock, [this] { return !_queue.empty(); });
+                job = std::move(_queue.front());
+                _queue.pop_front();
+            }
+            // mipmaps of images which are gone by now are skipped
+            if (auto mipmap = job.lock()) {
+                mipmap->_build();
+            }
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::weak_ptr<ImageMipmap>> _queue;
+    bool _started = false;
+};
+
+std::shared_ptr<ImageMipmap>
+ImageMipmap::create(Pixbuf &pixbuf)
+{
+    std::shared_ptr<ImageMipmap> mipmap(new ImageMipmap(pixbuf));
+    Worker::get().add(mipmap);
+    return mipmap;
+}
+
+ImageMipmap::ImageMipmap(Pixbuf &pixbuf)
+    : _source(GDK_PIXBUF(g_object_ref(pixbuf.getPixbufRaw(false))))
+    , _generation(pixbuf.generation())
+{}
+
+ImageMipmap::~ImageMipmap()
+{
+    if (_source) {
+        g_object_unref(_source);
+    }
+    for (auto level : _levels) {
+        cairo_surface_destroy(level);
+    }
+}
+
+cairo_surface_t *
+ImageMipmap::level(double scale, int &halvings)
+{
+    if (scale <= 0) {
+        return nullptr;
+    }
+    // the smallest level with at least as many pixels as drawn
+    int index = static_cast<int>(std::floor(std::log2(1.0 / scale))) - 1;
+    if (index < 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_levels.empty()) {
+        return nullptr;
+    }
+    index = std::min<int>(index, _levels.size() - 1);
+    halvings = index + 1;
+    return cairo_surface_reference(_levels[index]);
+}
+
+/// Build the levels. Called on the worker thread.
+void
+ImageMipmap::_build()
+{
+    // The pixels of the source stay valid while it is referenced, even if its Pixbuf is
+    // deleted in the meantime.
+    unsigned char const *src = gdk_pixbuf_get_pixels(_source);
+    int width = gdk_pixbuf_get_width(_source);
+    int height = gdk_pixbuf_get_height(_source);
+    int stride = gdk_pixbuf_get_rowstride(_source);
+
+    std::vector<cairo_surface_t *> levels;
+    while (width > MIN_LEVEL_SIZE || height > MIN_LEVEL_SIZE) {
+        cairo_surface_t *level = halve(src, width, height, stride);
+        if (!level) {
+            break;
+        }
+        levels.push_back(level);
+        src = cairo_image_surface_get_data(level);
+        width = cairo_image_surface_get_width(level);
+        height = cairo_image_surface_get_height(level);
+        stride = cairo_image_surface_get_stride(level);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _levels = std::move(levels);
+    g_object_unref(_source);
+    _source = nullptr;
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Reduced resolution copies of bitmap images, built in the background.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_IMAGE_MIPMAP_H
+#define SEEN_INKSCAPE_DISPLAY_IMAGE_MIPMAP_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cairo.h>
+
+typedef struct _GdkPixbuf GdkPixbuf;
+
+namespace Inkscape {
+
+class Pixbuf;
+
+/**
+ * Successively halved copies of an image, so that it can be drawn at small scales by sampling
+ * the level closest to the drawn size, instead of the full resolution for every tile.
+ *
+ * The levels are built from the pixels of a Pixbuf on a worker thread, which keeps a reference
+ * to them until it is done. Until the levels are ready, level() returns nullptr and the full
+ * resolution image is drawn instead. Levels are only valid for the generation of the Pixbuf
+ * they were created for, see generation().
+ */
+class ImageMipmap
+{
+public:
+    /// Start building the levels of @a pixbuf, which must be in the cairo pixel format.
+    static std::shared_ptr<ImageMipmap> create(Pixbuf &pixbuf);
+    ~ImageMipmap();
+
+    ImageMipmap(ImageMipmap const &) = delete;
+    ImageMipmap &operator=(ImageMipmap const &) = delete;
+
+    /// Generation of the Pixbuf the levels are built from.
+    unsigned generation() const { return _generation; }
+
+    /**
+     * Get the smallest level which still has a pixel for every device pixel, when the image
+     * is drawn at @a scale device pixels per image pixel. Each level is half the size of the
+     * previous one; the number of times it was halved is stored in @a halvings.
+     * Returns a new reference, or nullptr if the full resolution image should be drawn.
+     */
+    cairo_surface_t *level(double scale, int &halvings);
+
+private:
+    class Worker;
+
+    ImageMipmap(Pixbuf &pixbuf);
+    void _build();
+
+    GdkPixbuf *_source; ///< released when the levels are built
+    unsigned const _generation;
+
+    std::mutex _mutex;
+    std::vector<cairo_surface_t *> _levels; ///< halved once, twice, ...
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_IMAGE_MIPMAP_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Marker instances rendered once and copied to the positions of the others.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/marker-sprites.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "display/cairo-utils.h"
+#include "display/drawing.h"
+#include "display/drawing-context.h"
+#include "display/drawing-item.h"
+#include "display/drawing-surface.h"
+
+namespace Inkscape {
+
+namespace {
+
+// Largest distance in pixels between where a point of an instance is drawn from a sprite and
+// where it would be rendered.
+double const TOLERANCE = 0.25;
+// Largest number of sprites kept for a shape, and of device pixels in a sprite.
+std::size_t const MAX_SPRITES = 64;
+int const SPRITE_LIMIT = 128 * 128;
+
+/// Whether drawing coordinates in @a dc line up with its device pixels.
+bool is_pixel_aligned(DrawingContext &dc)
+{
+    cairo_matrix_t matrix;
+    cairo_get_matrix(dc.raw(), &matrix);
+    int const device_scale = dc.surface()->device_scale();
+    auto whole = [device_scale] (double v) {
+        v *= device_scale;
+        return std::abs(v - std::round(v)) < 1e-6;
+    };
+    return matrix.xx == 1 && matrix.yx == 0 && matrix.xy == 0 && matrix.yy == 1 &&
+           whole(matrix.x0) && whole(matrix.y0);
+}
+
+} // namespace
+
+MarkerSprites::~MarkerSprites()
+{
+    clear();
+}
+
+bool
+MarkerSprites::render(DrawingContext &dc, DrawingItem &instance, Geom::IntRect const &area,
+                      unsigned flags)
+{
+    if (!instance.visible()) {
+        return true;
+    }
+    Geom::OptIntRect bounds = instance.visualBounds();
+    if (!bounds) {
+        return true;
+    }
+    // blending with the background can't be done beforehand
+    if (!instance.getItem() || instance.blendMode() != SP_CSS_BLEND_NORMAL ||
+        !is_pixel_aligned(dc)) {
+        return false;
+    }
+
+    Geom::Affine const ctm = instance.ctm();
+    int const device_scale = dc.surface()->device_scale();
+    RenderMode const mode = instance.drawing().renderMode();
+    bool const draft = instance.drawing().draft();
+
+    cairo_surface_t *surface = nullptr;
+    Geom::IntRect target;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &sprite : _sprites) {
+            if (sprite.marker != instance.getItem() || sprite.device_scale != device_scale ||
+                sprite.flags != flags || sprite.mode != mode || sprite.draft != draft) {
+                continue;
+            }
+            // Moving the sprite by whole pixels displaces points by the rest of the difference
+            // in translation, and by up to the radius times the difference in the linear part.
+            Geom::Point shift = ctm.translation() - sprite.ctm.translation();
+            Geom::IntPoint offset = shift.round();
+            double linear = 0.0;
+            for (int k = 0; k < 4; ++k) {
+                linear += std::abs(ctm[k] - sprite.ctm[k]);
+            }
+            double error = Geom::L2(shift - Geom::Point(offset))
+                         + linear * sprite.radius / sprite.ctm.descrim();
+            if (error <= TOLERANCE) {
+                sprite.last_used = ++_clock;
+                surface = cairo_surface_reference(sprite.surface);
+                target = sprite.area + offset;
+                break;
+            }
+        }
+
+        if (!surface) {
+            // no matching sprite, render one for this instance
+            if (ctm.isSingular() ||
+                double(bounds->width()) * bounds->height() * device_scale * device_scale
+                    > SPRITE_LIMIT) {
+                return false;
+            }
+            DrawingSurface drawn(*bounds, device_scale);
+            {
+                DrawingContext sdc(drawn);
+                instance.render(sdc, *bounds, flags);
+            }
+
+            Sprite sprite;
+            sprite.marker = instance.getItem();
+            sprite.ctm = ctm;
+            sprite.area = *bounds;
+            sprite.radius = 0.0;
+            for (unsigned c = 0; c < 4; ++c) {
+                Geom::Point corner = bounds->corner(c);
+                sprite.radius = std::max(sprite.radius, Geom::L2(corner - ctm.translation()));
+            }
+            sprite.device_scale = device_scale;
+            sprite.flags = flags;
+            sprite.mode = mode;
+            sprite.draft = draft;
+            sprite.last_used = ++_clock;
+            sprite.surface = cairo_surface_reference(drawn.raw());
+            if (_sprites.size() < MAX_SPRITES) {
+                _sprites.push_back(sprite);
+            } else {
+                auto &replaced = _sprites[_evictable(ctm, device_scale)];
+                cairo_surface_destroy(replaced.surface);
+                replaced = sprite;
+            }
+
+            surface = cairo_surface_reference(sprite.surface);
+            target = sprite.area;
+        }
+    }
+
+    if (Geom::OptIntRect visible = target & area) {
+        Inkscape::DrawingContext::Save save(dc);
+        dc.setSource(surface, target.left(), target.top());
+        dc.rectangle(*visible);
+        dc.fill();
+    }
+    cairo_surface_destroy(surface);
+    return true;
+}
+
+/**
+ * Choose the sprite to make room for a new one. Sprites rendered at another scale, as before
+ * zooming, can't be used any more and go first; otherwise the least recently used one goes.
+ * The caller must hold the lock.
+ */
+std::size_t
+MarkerSprites::_evictable(Geom::Affine const &ctm, int device_scale) const
+{
+    double const scale = ctm.descrim();
+    std::size_t result = 0;
+    for (std::size_t i = 0; i < _sprites.size(); ++i) {
+        auto const &sprite = _sprites[i];
+        if (sprite.device_scale != device_scale ||
+            std::abs(sprite.ctm.descrim() - scale) > 1e-6 * scale) {
+            return i;
+        }
+        if (sprite.last_used < _sprites[result].last_used) {
+            result = i;
+        }
+    }
+    return result;
+}
+
+void
+MarkerSprites::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &sprite : _sprites) {
+        cairo_surface_destroy(sprite.surface);
+    }
+    _sprites.clear();
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
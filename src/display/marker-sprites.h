@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Marker instances rendered once and copied to the positions of the others.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_MARKER_SPRITES_H
+#define SEEN_INKSCAPE_DISPLAY_MARKER_SPRITES_H
+
+#include <mutex>
+#include <vector>
+#include <2geom/affine.h>
+#include <2geom/int-rect.h>
+#include <cairo.h>
+
+#include "display/rendermode.h"
+
+class SPItem;
+
+namespace Inkscape {
+
+class DrawingContext;
+class DrawingItem;
+
+/**
+ * Sprites of the marker instances of a shape.
+ *
+ * Every vertex marker of a shape is a separate subtree of DrawingItems, but most of them show
+ * the same marker element with the same size and orientation, and differ only in their
+ * position. The first instance of each such kind is rendered into a sprite covering its
+ * visual bounds, which is then copied to the positions of the others, moved by whole pixels.
+ *
+ * Instances are only drawn from a sprite if that places every point of them within a quarter
+ * of a pixel of where it would be rendered; others get sprites of their own. Beyond a limit,
+ * new sprites replace those rendered at another scale, as before zooming, or else the least
+ * recently used ones. The sprites have to be cleared whenever the rendering of the marker
+ * changes. All functions are thread-safe.
+ */
+class MarkerSprites
+{
+public:
+    MarkerSprites() = default;
+    ~MarkerSprites();
+
+    MarkerSprites(MarkerSprites const &) = delete;
+    MarkerSprites &operator=(MarkerSprites const &) = delete;
+
+    /**
+     * Draw the part of the marker @a instance within @a area from a sprite.
+     * Returns false if the instance has to be rendered as usual instead.
+     */
+    bool render(DrawingContext &dc, DrawingItem &instance, Geom::IntRect const &area,
+                unsigned flags);
+
+    /// Drop all sprites.
+    void clear();
+
+private:
+    struct Sprite
+    {
+        SPItem *marker;
+        Geom::Affine ctm;   ///< of the instance the sprite was rendered from
+        Geom::IntRect area; ///< covered by the sprite, in drawing coordinates of that instance
+        double radius;      ///< largest distance of the area from the origin of the marker
+        int device_scale;
+        unsigned flags;
+        RenderMode mode;
+        bool draft;
+        unsigned long last_used; ///< value of _clock when the sprite was last drawn
+        cairo_surface_t *surface;
+    };
+
+    std::size_t _evictable(Geom::Affine const &ctm, int device_scale) const;
+
+    std::mutex _mutex;
+    std::vector<Sprite> _sprites;
+    unsigned long _clock = 0;
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_MARKER_SPRITES_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
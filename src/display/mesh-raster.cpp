@@ -0,0 +1,549 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Mesh gradients tessellated into triangles and rasterized once per transform.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/mesh-raster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <unordered_map>
+#include <2geom/rect.h>
+#include <2geom/transforms.h>
+
+#include "display/cairo-simd.h"
+#include "display/cairo-utils.h"
+#include "display/drawing-context.h"
+#include "display/drawing-surface.h"
+
+namespace Inkscape {
+
+namespace {
+
+// Items larger than this many device pixels only get an image of the area being rendered,
+// which is not kept.
+int const IMAGE_LIMIT = 1 << 22;
+// Patches are divided into cells of about this size in device pixels...
+double const CELL_SIZE = 4.0;
+// ...but into no more than this many along each side.
+int const MAX_CELLS = 64;
+
+// Positions in the 4x4 control point array of a patch of the points along its boundary,
+// in the order they appear in its path, and of the 4 interior control points; see cairo's
+// documentation of cairo_pattern_create_mesh().
+int const PATH_I[12] = { 0, 0, 0, 0, 1, 2, 3, 3, 3, 3, 2, 1 };
+int const PATH_J[12] = { 0, 1, 2, 3, 3, 3, 3, 2, 1, 0, 0, 0 };
+int const CONTROL_I[4] = { 1, 1, 2, 2 };
+int const CONTROL_J[4] = { 1, 2, 2, 1 };
+
+// Layout of the data returned by read_patches()
+int const MATRIX_SIZE = 6;
+int const PATCH_SIZE = 16 * 2 + 4 * 4;
+
+/**
+ * Read the pattern matrix of a mesh pattern, followed by the 16 control points of each patch,
+ * indexed [i][j] like cairo does, and the red, green, blue and alpha of its 4 corners.
+ */
+std::vector<double> read_patches(cairo_pattern_t *mesh)
+{
+    cairo_matrix_t m;
+    cairo_pattern_get_matrix(mesh, &m);
+    std::vector<double> data = { m.xx, m.yx, m.xy, m.yy, m.x0, m.y0 };
+
+    unsigned count = 0;
+    cairo_mesh_pattern_get_patch_count(mesh, &count);
+    data.reserve(MATRIX_SIZE + count * PATCH_SIZE);
+    for (unsigned p = 0; p < count; ++p) {
+        Geom::Point points[4][4];
+        auto set = [&] (int k, Geom::Point const &point) {
+            points[PATH_I[k % 12]][PATH_J[k % 12]] = point;
+        };
+
+        cairo_path_t *path = cairo_mesh_pattern_get_path(mesh, p);
+        int k = 0;
+        for (int d = 0; d < path->num_data; d += path->data[d].header.length) {
+            cairo_path_data_t const *item = &path->data[d];
+            auto point = [item] (int n) { return Geom::Point(item[n].point.x, item[n].point.y); };
+            switch (item->header.type) {
+                case CAIRO_PATH_MOVE_TO:
+                    k = 0;
+                    set(k, point(1));
+                    break;
+                case CAIRO_PATH_LINE_TO: {
+                    Geom::Point start = points[PATH_I[k % 12]][PATH_J[k % 12]];
+                    set(k + 1, Geom::lerp(1.0 / 3, start, point(1)));
+                    set(k + 2, Geom::lerp(2.0 / 3, start, point(1)));
+                    set(k + 3, point(1));
+                    k += 3;
+                    break;
+                }
+                case CAIRO_PATH_CURVE_TO:
+                    set(k + 1, point(1));
+                    set(k + 2, point(2));
+                    set(k + 3, point(3));
+                    k += 3;
+                    break;
+                default:
+                    break;
+            }
+        }
+        cairo_path_destroy(path);
+
+        for (int c = 0; c < 4; ++c) {
+            double x = 0, y = 0;
+            cairo_mesh_pattern_get_control_point(mesh, p, c, &x, &y);
+            points[CONTROL_I[c]][CONTROL_J[c]] = Geom::Point(x, y);
+        }
+        for (auto &row : points) {
+            for (auto &point : row) {
+                data.push_back(point[Geom::X]);
+                data.push_back(point[Geom::Y]);
+            }
+        }
+        for (int c = 0; c < 4; ++c) {
+            double r = 0, g = 0, b = 0, a = 0;
+            cairo_mesh_pattern_get_corner_color_rgba(mesh, p, c, &r, &g, &b, &a);
+            data.insert(data.end(), { r, g, b, a });
+        }
+    }
+    return data;
+}
+
+struct Vertex
+{
+    double x, y;
+    float color[4]; ///< premultiplied alpha, red, green and blue, from 0 to 255
+};
+
+/**
+ * Draw a triangle with Gouraud shading into an ARGB32 image.
+ * Pixels are drawn when their center is inside the triangle, with the left and top edges
+ * counting as inside, so triangles sharing an edge neither overlap nor leave gaps.
+ */
+void fill_triangle(Vertex const &v0, Vertex const &v1, Vertex const &v2,
+                   unsigned char *data, int stride, int width, int height)
+{
+    double const area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    if (std::abs(area) < 1e-9) {
+        return;
+    }
+    int const y0 = std::max(0, int(std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5)));
+    int const y1 = std::min(height, int(std::ceil(std::max({ v0.y, v1.y, v2.y }) - 0.5)));
+    if (y0 >= y1) {
+        return;
+    }
+
+    // change of the colors per pixel along x and y
+    float dx[4], dy[4];
+    for (int c = 0; c < 4; ++c) {
+        double e1 = v1.color[c] - v0.color[c];
+        double e2 = v2.color[c] - v0.color[c];
+        dx[c] = (e1 * (v2.y - v0.y) - e2 * (v1.y - v0.y)) / area;
+        dy[c] = (e2 * (v1.x - v0.x) - e1 * (v2.x - v0.x)) / area;
+    }
+
+    // edges from top to bottom, so that shared edges give the same intersections
+    Vertex const *edges[3][2] = { { &v0, &v1 }, { &v1, &v2 }, { &v2, &v0 } };
+    for (auto &edge : edges) {
+        if (edge[0]->y > edge[1]->y) {
+            std::swap(edge[0], edge[1]);
+        }
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        double const yc = y + 0.5;
+        double xs[2];
+        int found = 0;
+        for (auto &edge : edges) {
+            Vertex const &p = *edge[0], &q = *edge[1];
+            if (p.y <= yc && yc < q.y && found < 2) {
+                xs[found++] = p.x + (yc - p.y) * (q.x - p.x) / (q.y - p.y);
+            }
+        }
+        if (found < 2) {
+            continue;
+        }
+        int const x0 = std::max(0, int(std::ceil(std::min(xs[0], xs[1]) - 0.5)));
+        int const x1 = std::min(width, int(std::ceil(std::max(xs[0], xs[1]) - 0.5)));
+        if (x0 >= x1) {
+            continue;
+        }
+
+        float start[4];
+        for (int c = 0; c < 4; ++c) {
+            start[c] = v0.color[c] + (x0 + 0.5 - v0.x) * dx[c] + (yc - v0.y) * dy[c];
+        }
+        auto row = reinterpret_cast<guint32 *>(data + y * stride);
+        ink_span_gouraud(start, dx, row + x0, x1 - x0);
+    }
+}
+
+/// Tessellate a patch in the layout of read_patches() and draw it, after applying @a transform.
+void draw_patch(double const *patch, Geom::Affine const &transform,
+                unsigned char *data, int stride, int width, int height)
+{
+    Geom::Point points[4][4];
+    Geom::OptRect box;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            double const *p = patch + 2 * (4 * i + j);
+            points[i][j] = Geom::Point(p[0], p[1]) * transform;
+            box.expandTo(points[i][j]);
+        }
+    }
+    if (!box || !box->intersects(Geom::Rect(0, 0, width, height))) {
+        return;
+    }
+
+    // corner colors, at [0][0], [0][3], [3][3] and [3][0]
+    float corners[4][4];
+    for (int k = 0; k < 4; ++k) {
+        double const *rgba = patch + 32 + 4 * k;
+        double const alpha = rgba[3] * 255.0;
+        corners[k][0] = alpha;
+        corners[k][1] = rgba[0] * alpha;
+        corners[k][2] = rgba[1] * alpha;
+        corners[k][3] = rgba[2] * alpha;
+    }
+
+    double const extent = std::max(box->width(), box->height());
+    int const n = std::clamp(int(std::ceil(extent / CELL_SIZE)), 1, MAX_CELLS);
+
+    // Bernstein polynomials at the grid parameters
+    std::vector<double> basis(4 * (n + 1));
+    for (int k = 0; k <= n; ++k) {
+        double t = double(k) / n, s = 1.0 - t;
+        basis[4 * k + 0] = s * s * s;
+        basis[4 * k + 1] = 3 * t * s * s;
+        basis[4 * k + 2] = 3 * t * t * s;
+        basis[4 * k + 3] = t * t * t;
+    }
+
+    std::vector<Vertex> grid((n + 1) * (n + 1));
+    for (int a = 0; a <= n; ++a) {
+        double const u = double(a) / n;
+        double const *bu = &basis[4 * a];
+        for (int b = 0; b <= n; ++b) {
+            double const v = double(b) / n;
+            double const *bv = &basis[4 * b];
+            Geom::Point position(0, 0);
+            for (int i = 0; i < 4; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    position += bu[i] * bv[j] * points[i][j];
+                }
+            }
+            Vertex &vertex = grid[a * (n + 1) + b];
+            vertex.x = position[Geom::X];
+            vertex.y = position[Geom::Y];
+            for (int c = 0; c < 4; ++c) {
+                vertex.color[c] = (1 - u) * (1 - v) * corners[0][c] + (1 - u) * v * corners[1][c]
+                                + u * v * corners[2][c] + u * (1 - v) * corners[3][c];
+            }
+        }
+    }
+
+    for (int a = 0; a < n; ++a) {
+        for (int b = 0; b < n; ++b) {
+            Vertex const &v00 = grid[a * (n + 1) + b];
+            Vertex const &v01 = grid[a * (n + 1) + b + 1];
+            Vertex const &v10 = grid[(a + 1) * (n + 1) + b];
+            Vertex const &v11 = grid[(a + 1) * (n + 1) + b + 1];
+            fill_triangle(v00, v10, v11, data, stride, width, height);
+            fill_triangle(v00, v11, v01, data, stride, width, height);
+        }
+    }
+}
+
+/// Draw the patches read by read_patches() into a new image of @a area in drawing coordinates.
+cairo_surface_t *rasterize(std::vector<double> const &patches, Geom::Affine const &ctm,
+                           Geom::IntRect const &area, int device_scale)
+{
+    cairo_surface_t *image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+        area.width() * device_scale, area.height() * device_scale);
+    if (cairo_surface_status(image) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(image);
+        return nullptr;
+    }
+    cairo_surface_set_device_scale(image, device_scale, device_scale);
+    cairo_surface_flush(image);
+
+    Geom::Affine pattern(patches[0], patches[1], patches[2], patches[3], patches[4], patches[5]);
+    if (pattern.isSingular()) {
+        cairo_surface_destroy(image);
+        return nullptr;
+    }
+    // from the coordinates of the patches to the pixels of the image
+    Geom::Affine transform = pattern.inverse() * ctm * Geom::Translate(-area.min())
+                           * Geom::Scale(device_scale);
+
+    unsigned char *data = cairo_image_surface_get_data(image);
+    int const stride = cairo_image_surface_get_stride(image);
+    int const width = cairo_image_surface_get_width(image);
+    int const height = cairo_image_surface_get_height(image);
+    for (std::size_t p = MATRIX_SIZE; p + PATCH_SIZE <= patches.size(); p += PATCH_SIZE) {
+        draw_patch(&patches[p], transform, data, stride, width, height);
+    }
+    cairo_surface_mark_dirty(image);
+    return image;
+}
+
+/// Whether @a transform moves by whole device pixels and does nothing else.
+bool is_pixel_translation(Geom::Affine const &transform, int device_scale)
+{
+    double const eps = 1e-6;
+    auto whole = [&] (double v) {
+        v *= device_scale;
+        return std::abs(v - std::round(v)) < eps;
+    };
+    return std::abs(transform[0] - 1) < eps && std::abs(transform[1]) < eps &&
+           std::abs(transform[2]) < eps && std::abs(transform[3] - 1) < eps &&
+           whole(transform[4]) && whole(transform[5]);
+}
+
+/**
+ * The images kept by all mesh rasters, up to a total size limit. Each raster has at most one
+ * image, and the least recently used ones are dropped first when the limit is exceeded.
+ * Rasters only ever call into the cache, never the other way around, so it can be used while
+ * holding the lock of a raster.
+ */
+class MeshImageCache
+{
+public:
+    static MeshImageCache &get()
+    {
+        // Never destroyed, since items can still be released while static objects are destroyed.
+        static MeshImageCache *cache = new MeshImageCache();
+        return *cache;
+    }
+
+    /// Find the image of @a owner. Returns a new reference to it, or nullptr.
+    cairo_surface_t *lookup(void const *owner)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _index.find(owner);
+        if (it == _index.end()) {
+            return nullptr;
+        }
+        _entries.splice(_entries.begin(), _entries, it->second);
+        return cairo_surface_reference(it->second->image);
+    }
+
+    /// Store the image of @a owner, replacing its previous one. Takes its own reference.
+    void insert(void const *owner, cairo_surface_t *image)
+    {
+        std::size_t size = static_cast<std::size_t>(cairo_image_surface_get_stride(image))
+                         * cairo_image_surface_get_height(image);
+        std::list<Entry> evicted;
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _remove(owner, evicted);
+            if (size <= _budget) {
+                _entries.push_front({owner, cairo_surface_reference(image), size});
+                _index[owner] = _entries.begin();
+                _size += size;
+                _evict(_budget, evicted);
+            }
+        }
+
+        for (auto &entry : evicted) {
+            cairo_surface_destroy(entry.image);
+        }
+    }
+
+    /// Drop the image of @a owner.
+    void invalidate(void const *owner)
+    {
+        std::list<Entry> evicted;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _remove(owner, evicted);
+        }
+        for (auto &entry : evicted) {
+            cairo_surface_destroy(entry.image);
+        }
+    }
+
+    void setBudget(std::size_t bytes)
+    {
+        std::list<Entry> evicted;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _budget = bytes;
+            _evict(_budget, evicted);
+        }
+        for (auto &entry : evicted) {
+            cairo_surface_destroy(entry.image);
+        }
+    }
+
+private:
+    struct Entry
+    {
+        void const *owner;
+        cairo_surface_t *image;
+        std::size_t size;
+    };
+
+    MeshImageCache() = default;
+
+    // The caller must hold the lock, and destroy the images moved to @a evicted after
+    // releasing it.
+    void _remove(void const *owner, std::list<Entry> &evicted)
+    {
+        auto it = _index.find(owner);
+        if (it != _index.end()) {
+            _size -= it->second->size;
+            evicted.splice(evicted.end(), _entries, it->second);
+            _index.erase(it);
+        }
+    }
+
+    void _evict(std::size_t limit, std::list<Entry> &evicted)
+    {
+        while (_size > limit) {
+            _size -= _entries.back().size;
+            _index.erase(_entries.back().owner);
+            evicted.splice(evicted.end(), _entries, std::prev(_entries.end()));
+        }
+    }
+
+    std::mutex _mutex;
+    std::list<Entry> _entries;   ///< most recently used first
+    std::unordered_map<void const *, std::list<Entry>::iterator> _index;
+    std::size_t _size = 0;       ///< total size of the images
+    std::size_t _budget = 64 << 20;
+};
+
+} // namespace
+
+MeshRaster::~MeshRaster()
+{
+    _clear();
+}
+
+void
+MeshRaster::apply(DrawingContext &dc, Geom::Affine const &ctm, Geom::IntRect const &bounds,
+                  Geom::IntRect const &area)
+{
+    cairo_pattern_t *source = cairo_get_source(dc.raw());
+    if (cairo_pattern_get_type(source) != CAIRO_PATTERN_TYPE_MESH || ctm.isSingular()) {
+        return;
+    }
+
+    // The image is in drawing coordinates, so these have to line up with the device pixels.
+    cairo_matrix_t matrix;
+    cairo_get_matrix(dc.raw(), &matrix);
+    Geom::Affine current;
+    ink_matrix_to_2geom(current, matrix);
+    int const device_scale = dc.surface()->device_scale();
+    if (!is_pixel_translation(ctm.inverse() * current, device_scale)) {
+        return;
+    }
+
+    Geom::IntRect covered = bounds;
+    bool const keep = double(bounds.width()) * bounds.height() * device_scale * device_scale
+                    <= IMAGE_LIMIT;
+    if (!keep) {
+        Geom::OptIntRect visible = bounds & area;
+        if (!visible) {
+            return;
+        }
+        covered = *visible;
+    }
+
+    cairo_surface_t *image = nullptr;
+    Geom::IntRect image_area = covered;
+    std::vector<double> patches;
+    if (keep) {
+        // Threads rendering other tiles of the item wait here for the image, rather than
+        // drawing it too.
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &images = MeshImageCache::get();
+        if (_mesh && _ctm == ctm && _device_scale == device_scale && _area.contains(covered)) {
+            if (source != _mesh) {
+                // created again on update, but possibly with the same patches
+                patches = read_patches(source);
+                if (patches == _patches) {
+                    cairo_pattern_destroy(_mesh);
+                    _mesh = cairo_pattern_reference(source);
+                }
+            }
+            if (source == _mesh) {
+                // null if dropped to stay within the budget
+                image = images.lookup(this);
+                image_area = _area;
+            }
+        }
+        if (!image) {
+            if (patches.empty()) {
+                patches = read_patches(source);
+            }
+            _clear();
+            image = rasterize(patches, ctm, covered, device_scale);
+            if (image) {
+                images.insert(this, image);
+                _mesh = cairo_pattern_reference(source);
+                _patches = std::move(patches);
+                _ctm = ctm;
+                _device_scale = device_scale;
+                _area = covered;
+                image_area = covered;
+            }
+        }
+    } else {
+        image = rasterize(read_patches(source), ctm, covered, device_scale);
+    }
+    if (!image) {
+        return;
+    }
+
+    cairo_pattern_t *pattern = cairo_pattern_create_for_surface(image);
+    ink_cairo_pattern_set_matrix(pattern, ctm * Geom::Translate(-image_area.min()));
+    cairo_pattern_set_filter(pattern, CAIRO_FILTER_NEAREST);
+    dc.setSource(pattern);
+    cairo_pattern_destroy(pattern);
+    cairo_surface_destroy(image);
+}
+
+void
+MeshRaster::setBudget(std::size_t bytes)
+{
+    MeshImageCache::get().setBudget(bytes);
+}
+
+void
+MeshRaster::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _clear();
+}
+
+void
+MeshRaster::_clear()
+{
+    MeshImageCache::get().invalidate(this);
+    if (_mesh) {
+        cairo_pattern_destroy(_mesh);
+        _mesh = nullptr;
+    }
+    _patches.clear();
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Mesh gradients tessellated into triangles and rasterized once per transform.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_MESH_RASTER_H
+#define SEEN_INKSCAPE_DISPLAY_MESH_RASTER_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#include <2geom/affine.h>
+#include <2geom/int-rect.h>
+#include <cairo.h>
+
+namespace Inkscape {
+
+class DrawingContext;
+
+/**
+ * Replaces mesh gradient sources by images of them, kept for the item they paint.
+ *
+ * Cairo rasterizes mesh patterns each time they are used, which is slow, and rendering a shape
+ * uses its paint once for every tile. Instead, each patch is tessellated into a grid of cells
+ * a few device pixels in size, and the two triangles of each cell are drawn with Gouraud
+ * shading into an image covering the item. The image is reused as long as the patches and the
+ * transform stay the same, even if the mesh pattern itself is created again on update.
+ *
+ * Patches are drawn in order without blending, so translucent overlapping patches are not
+ * composited like cairo does. The image is only used where its pixels line up with the
+ * device pixels; otherwise the mesh pattern is left for cairo to draw.
+ * The images of all items are kept up to a shared size limit, dropping the least recently
+ * used ones first; a dropped image is drawn again the next time it is needed.
+ * All functions are thread-safe.
+ */
+class MeshRaster
+{
+public:
+    MeshRaster() = default;
+    ~MeshRaster();
+
+    MeshRaster(MeshRaster const &) = delete;
+    MeshRaster &operator=(MeshRaster const &) = delete;
+
+    /**
+     * If the source of @a dc is a mesh pattern, replace it by an image of the mesh.
+     * @param ctm Transform from the current user space of @a dc to drawing coordinates.
+     * @param bounds Area in drawing coordinates where the source can be painted.
+     * @param area Area in drawing coordinates being rendered.
+     */
+    void apply(DrawingContext &dc, Geom::Affine const &ctm, Geom::IntRect const &bounds,
+               Geom::IntRect const &area);
+
+    /// Drop the image.
+    void clear();
+
+    /// Set the limit of the total size of the images of all items, in bytes.
+    static void setBudget(std::size_t bytes);
+
+private:
+    void _clear();
+
+    std::mutex _mutex;
+    cairo_pattern_t *_mesh = nullptr;    ///< the pattern the image was last used for
+    std::vector<double> _patches;        ///< patch data of the rasterized mesh
+    Geom::Affine _ctm;
+    int _device_scale = 1;
+    Geom::IntRect _area;                 ///< area covered by the image, in drawing coordinates
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_MESH_RASTER_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -97,18 +97,10 @@ static inline cairo_operator_t get_cairo_op(SPBlendMode _blend_mode)
 
 void FilterBlend::render_cairo(FilterSlot &slot)
 {
-    cairo_surface_t *input1 = slot.getcairo(_input);
-    cairo_surface_t *input2 = slot.getcairo(_input2);
-
-    // We may need to transform input surface to correct color interpolation space. The input surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the input before converting.
-    SPColorInterpolation ci_fp  = SP_CSS_COLOR_INTERPOLATION_AUTO;
-    if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
-    }
-    set_cairo_surface_ci( input1, ci_fp );
-    set_cairo_surface_ci( input2, ci_fp );
+    // The inputs are taken in the color interpolation space of this primitive.
+    SPColorInterpolation ci_fp = get_color_interpolation();
+    cairo_surface_t *input1 = slot.getcairo(_input, ci_fp);
+    cairo_surface_t *input2 = slot.getcairo(_input2, ci_fp);
 
     // input2 is the "background" image
     // out should be ARGB32 if any of the inputs is ARGB32
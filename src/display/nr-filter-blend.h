@@ -37,6 +37,7 @@ public:
 
     void set_input(int slot) override;
     void set_input(int input, int slot) override;
+    std::vector<int> get_inputs() override { return { _input, _input2 }; }
     void set_mode(SPBlendMode mode);
 
     Glib::ustring name() override { return Glib::ustring("Blend"); }
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * The four channels of a pixel as floats, processed at once where SSE2 is available.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_NR_FILTER_CHANNELS_H
+#define SEEN_NR_FILTER_CHANNELS_H
+
+#include <algorithm>
+#include <cmath>
+#include <glib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Inkscape {
+namespace Filters {
+
+/**
+ * Four float values, usually the channels of one pixel, with the arithmetic needed by the
+ * filters which compute all channels in the same way. SSE2 is part of the baseline of
+ * x86-64, so it is used without a runtime check.
+ */
+struct Channels {
+#ifdef __SSE2__
+    __m128 v;
+
+    static Channels set1(float x) { return { _mm_set1_ps(x) }; }
+    static Channels load(float const *p) { return { _mm_loadu_ps(p) }; }
+    static Channels abs(Channels a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+    /// Unpacks an ARGB32 pixel into B, G, R, A, the order of the bytes in memory.
+    static Channels from_pixel(guint32 px) {
+        __m128i const zero = _mm_setzero_si128();
+        __m128i i = _mm_unpacklo_epi8(_mm_cvtsi32_si128(px), zero);
+        return { _mm_cvtepi32_ps(_mm_unpacklo_epi16(i, zero)) };
+    }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+
+    Channels operator+(Channels b) const { return { _mm_add_ps(v, b.v) }; }
+    Channels operator-(Channels b) const { return { _mm_sub_ps(v, b.v) }; }
+    Channels operator*(Channels b) const { return { _mm_mul_ps(v, b.v) }; }
+#else
+    float v[4];
+
+    static Channels set1(float x) { return { { x, x, x, x } }; }
+    static Channels load(float const *p) { return { { p[0], p[1], p[2], p[3] } }; }
+    static Channels abs(Channels a) {
+        return { { std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3]) } };
+    }
+    static Channels from_pixel(guint32 px) {
+        return { { float(px & 0xff), float((px >> 8) & 0xff),
+                   float((px >> 16) & 0xff), float(px >> 24) } };
+    }
+    void store(float *p) const { std::copy(v, v + 4, p); }
+
+    Channels operator+(Channels b) const {
+        return { { v[0] + b.v[0], v[1] + b.v[1], v[2] + b.v[2], v[3] + b.v[3] } };
+    }
+    Channels operator-(Channels b) const {
+        return { { v[0] - b.v[0], v[1] - b.v[1], v[2] - b.v[2], v[3] - b.v[3] } };
+    }
+    Channels operator*(Channels b) const {
+        return { { v[0] * b.v[0], v[1] * b.v[1], v[2] * b.v[2], v[3] * b.v[3] } };
+    }
+#endif
+};
+
+} /* namespace Filters */
+} /* namespace Inkscape */
+
+#endif /* SEEN_NR_FILTER_CHANNELS_H */
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -13,9 +13,11 @@
 
 #include <cmath>
 #include <algorithm>
+#include "display/cairo-simd.h"
 #include "display/cairo-templates.h"
 #include "display/cairo-utils.h"
 #include "display/nr-filter-colormatrix.h"
+#include "display/nr-filter-pointwise.h"
 #include "display/nr-filter-slot.h"
 #include <2geom/math-utils.h>
 
@@ -44,6 +46,7 @@ FilterColorMatrix::ColorMatrixMatrix::ColorMatrixMatrix(std::vector<double> cons
     for (unsigned i = limit; i < 20; ++i) {
         _v[i] = (i % 6 == 0) ? 255 : 0;
     }
+    _span = ink_span_color_matrix_supported(_v);
 }
 
 guint32 FilterColorMatrix::ColorMatrixMatrix::operator()(guint32 in) {
@@ -73,6 +76,16 @@ guint32 FilterColorMatrix::ColorMatrixMatrix::operator()(guint32 in) {
     return pxout;
 }
 
+void FilterColorMatrix::ColorMatrixMatrix::filterSpan(guint32 const *in, guint32 *out, int n)
+{
+    if (_span) {
+        ink_span_color_matrix(in, out, n, _v);
+    } else {
+        for (int i = 0; i < n; ++i) {
+            out[i] = (*this)(in[i]);
+        }
+    }
+}
 
 struct ColorMatrixSaturate {
     ColorMatrixSaturate(double v_in) {
@@ -99,39 +112,41 @@ private:
     double _v[9];
 };
 
-struct ColorMatrixHueRotate {
-    ColorMatrixHueRotate(double v) {
-        double sinhue, coshue;
-        Geom::sincos(v * M_PI/180.0, sinhue, coshue);
+FilterColorMatrix::ColorMatrixHueRotate::ColorMatrixHueRotate(double v) {
+    double sinhue, coshue;
+    Geom::sincos(v * M_PI/180.0, sinhue, coshue);
 
-        _v[0] = round((0.213 +0.787*coshue -0.213*sinhue)*255);
-        _v[1] = round((0.715 -0.715*coshue -0.715*sinhue)*255);
-        _v[2] = round((0.072 -0.072*coshue +0.928*sinhue)*255);
+    _v[0] = round((0.213 +0.787*coshue -0.213*sinhue)*255);
+    _v[1] = round((0.715 -0.715*coshue -0.715*sinhue)*255);
+    _v[2] = round((0.072 -0.072*coshue +0.928*sinhue)*255);
 
-        _v[3] = round((0.213 -0.213*coshue +0.143*sinhue)*255);
-        _v[4] = round((0.715 +0.285*coshue +0.140*sinhue)*255);
-        _v[5] = round((0.072 -0.072*coshue -0.283*sinhue)*255);
+    _v[3] = round((0.213 -0.213*coshue +0.143*sinhue)*255);
+    _v[4] = round((0.715 +0.285*coshue +0.140*sinhue)*255);
+    _v[5] = round((0.072 -0.072*coshue -0.283*sinhue)*255);
 
-        _v[6] = round((0.213 -0.213*coshue -0.787*sinhue)*255);
-        _v[7] = round((0.715 -0.715*coshue +0.715*sinhue)*255);
-        _v[8] = round((0.072 +0.928*coshue +0.072*sinhue)*255);
-    }
-    guint32 operator()(guint32 in) {
-        EXTRACT_ARGB32(in, a, r, g, b)
-        gint32 maxpx = a*255;
-        gint32 ro = r*_v[0] + g*_v[1] + b*_v[2];
-        gint32 go = r*_v[3] + g*_v[4] + b*_v[5];
-        gint32 bo = r*_v[6] + g*_v[7] + b*_v[8];
-        ro = (pxclamp(ro, 0, maxpx) + 127) / 255;
-        go = (pxclamp(go, 0, maxpx) + 127) / 255;
-        bo = (pxclamp(bo, 0, maxpx) + 127) / 255;
+    _v[6] = round((0.213 -0.213*coshue -0.787*sinhue)*255);
+    _v[7] = round((0.715 -0.715*coshue +0.715*sinhue)*255);
+    _v[8] = round((0.072 +0.928*coshue +0.072*sinhue)*255);
+}
 
-        ASSEMBLE_ARGB32(pxout, a, ro, go, bo)
-        return pxout;
-    }
-private:
-    gint32 _v[9];
-};
+guint32 FilterColorMatrix::ColorMatrixHueRotate::operator()(guint32 in) {
+    EXTRACT_ARGB32(in, a, r, g, b)
+    gint32 maxpx = a*255;
+    gint32 ro = r*_v[0] + g*_v[1] + b*_v[2];
+    gint32 go = r*_v[3] + g*_v[4] + b*_v[5];
+    gint32 bo = r*_v[6] + g*_v[7] + b*_v[8];
+    ro = (pxclamp(ro, 0, maxpx) + 127) / 255;
+    go = (pxclamp(go, 0, maxpx) + 127) / 255;
+    bo = (pxclamp(bo, 0, maxpx) + 127) / 255;
+
+    ASSEMBLE_ARGB32(pxout, a, ro, go, bo)
+    return pxout;
+}
+
+void FilterColorMatrix::ColorMatrixHueRotate::filterSpan(guint32 const *in, guint32 *out, int n)
+{
+    ink_span_hue_rotate(in, out, n, _v);
+}
 
 struct ColorMatrixLuminanceToAlpha {
     guint32 operator()(guint32 in) {
@@ -150,18 +165,11 @@ struct ColorMatrixLuminanceToAlpha {
 
 void FilterColorMatrix::render_cairo(FilterSlot &slot)
 {
-    cairo_surface_t *input = slot.getcairo(_input);
+    // The input is taken in the color interpolation space of this primitive.
+    SPColorInterpolation ci_fp = get_color_interpolation();
+    cairo_surface_t *input = slot.getcairo(_input, ci_fp);
     cairo_surface_t *out = nullptr;
 
-    // We may need to transform input surface to correct color interpolation space. The input surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the input before converting.
-    SPColorInterpolation ci_fp = SP_CSS_COLOR_INTERPOLATION_AUTO;
-    if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
-    }
-    set_cairo_surface_ci( input, ci_fp );
-
     if (type == COLORMATRIX_LUMINANCETOALPHA) {
         out = ink_cairo_surface_create_same_size(input, CAIRO_CONTENT_ALPHA);
     } else {
@@ -178,7 +186,7 @@ void FilterColorMatrix::render_cairo(FilterSlot &slot)
         ink_cairo_surface_filter(input, out, ColorMatrixSaturate(value));
         break;
     case COLORMATRIX_HUEROTATE:
-        ink_cairo_surface_filter(input, out, ColorMatrixHueRotate(value));
+        ink_cairo_surface_filter(input, out, FilterColorMatrix::ColorMatrixHueRotate(value));
         break;
     case COLORMATRIX_LUMINANCETOALPHA:
         ink_cairo_surface_filter(input, out, ColorMatrixLuminanceToAlpha());
@@ -192,6 +200,23 @@ void FilterColorMatrix::render_cairo(FilterSlot &slot)
     cairo_surface_destroy(out);
 }
 
+std::unique_ptr<FilterPixelOp> FilterColorMatrix::pixel_op(FilterSlot &, std::vector<bool> const &)
+{
+    switch (type) {
+    case COLORMATRIX_MATRIX:
+        return make_pixel_filter(FilterColorMatrix::ColorMatrixMatrix(values));
+    case COLORMATRIX_SATURATE:
+        return make_pixel_filter(ColorMatrixSaturate(value));
+    case COLORMATRIX_HUEROTATE:
+        return make_pixel_filter(FilterColorMatrix::ColorMatrixHueRotate(value));
+    case COLORMATRIX_LUMINANCETOALPHA:
+        return make_pixel_filter(ColorMatrixLuminanceToAlpha(), true);
+    case COLORMATRIX_ENDTYPE:
+    default:
+        return nullptr;
+    }
+}
+
 bool FilterColorMatrix::can_handle_affine(Geom::Affine const &)
 {
     return true;
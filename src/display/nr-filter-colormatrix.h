@@ -40,6 +40,8 @@ public:
     ~FilterColorMatrix() override;
 
     void render_cairo(FilterSlot &slot) override;
+    std::unique_ptr<FilterPixelOp> pixel_op(FilterSlot &slot,
+                                            std::vector<bool> const &alpha_inputs) override;
     bool can_handle_affine(Geom::Affine const &) override;
     double complexity(Geom::Affine const &ctm) override;
 
@@ -53,8 +55,17 @@ public:
     struct ColorMatrixMatrix {
         ColorMatrixMatrix(std::vector<double> const &values);
         guint32 operator()(guint32 in);
+        void filterSpan(guint32 const *in, guint32 *out, int n);
     private:
         gint32 _v[20];
+        bool _span; ///< whether the matrix can be applied by ink_span_color_matrix()
+    };
+    struct ColorMatrixHueRotate {
+        ColorMatrixHueRotate(double v);
+        guint32 operator()(guint32 in);
+        void filterSpan(guint32 const *in, guint32 *out, int n);
+    private:
+        gint32 _v[9];
     };
 
 private:
@@ -11,10 +11,13 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <array>
 #include <cmath>
+#include "display/cairo-simd.h"
 #include "display/cairo-templates.h"
 #include "display/cairo-utils.h"
 #include "display/nr-filter-component-transfer.h"
+#include "display/nr-filter-pointwise.h"
 #include "display/nr-filter-slot.h"
 
 namespace Inkscape {
@@ -41,6 +44,9 @@ struct UnmultiplyAlpha {
         ASSEMBLE_ARGB32(out, a, r, g, b);
         return out;
     }
+    void filterSpan(guint32 const *in, guint32 *out, int n) {
+        ink_span_unpremul_alpha(in, out, n);
+    }
 };
 
 struct MultiplyAlpha {
@@ -52,6 +58,9 @@ struct MultiplyAlpha {
         ASSEMBLE_ARGB32(out, a, r, g, b);
         return out;
     }
+    void filterSpan(guint32 const *in, guint32 *out, int n) {
+        ink_span_premul_alpha(in, out, n);
+    }
 };
 
 struct ComponentTransfer {
@@ -153,27 +162,57 @@ private:
     double _offset;
 };
 
-void FilterComponentTransfer::render_cairo(FilterSlot &slot)
-{
-    cairo_surface_t *input = slot.getcairo(_input);
-    cairo_surface_t *out = ink_cairo_surface_create_same_size(input, CAIRO_CONTENT_COLOR_ALPHA);
+/**
+ * All four transfer functions, tabulated for every component value, applied in one pass
+ * together with unpremultiplying and premultiplying alpha.
+ */
+struct ComponentTransferLUT {
+    ComponentTransferLUT() {
+        for (auto &lut : _lut) {
+            for (unsigned i = 0; i < 256; ++i) {
+                lut[i] = i;
+            }
+        }
+    }
+    template <typename Transfer>
+    void set(guint32 color, Transfer transfer) {
+        guint32 shift = color * 8;
+        for (guint32 i = 0; i < 256; ++i) {
+            _lut[color][i] = (transfer(i << shift) >> shift) & 0xff;
+        }
+    }
 
-    // We may need to transform input surface to correct color interpolation space. The input surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the input before converting.
-    SPColorInterpolation ci_fp = SP_CSS_COLOR_INTERPOLATION_AUTO;
-    if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
-        set_cairo_surface_ci(out, ci_fp );
+    guint32 operator()(guint32 in) {
+        return MultiplyAlpha()(_apply(UnmultiplyAlpha()(in)));
+    }
+    void filterSpan(guint32 const *in, guint32 *out, int n) {
+        // work in chunks which stay in the cache between the three steps
+        guint32 buf[256];
+        for (int i = 0; i < n; i += 256) {
+            int len = std::min(n - i, 256);
+            ink_span_unpremul_alpha(in + i, buf, len);
+            for (int j = 0; j < len; ++j) {
+                buf[j] = _apply(buf[j]);
+            }
+            ink_span_premul_alpha(buf, out + i, len);
+        }
     }
-    set_cairo_surface_ci( input, ci_fp );
 
-    //cairo_surface_t *outtemp = ink_cairo_surface_create_identical(out);
-    ink_cairo_surface_blit(input, out);
+private:
+    guint32 _apply(guint32 px) const {
+        return (guint32(_lut[3][px >> 24]) << 24) | (guint32(_lut[2][(px >> 16) & 0xff]) << 16) |
+               (guint32(_lut[1][(px >> 8) & 0xff]) << 8) | guint32(_lut[0][px & 0xff]);
+    }
+
+    std::array<std::array<guint8, 256>, 4> _lut; ///< indexed by Cairo component
+};
 
+static ComponentTransferLUT transfer_lut(FilterComponentTransfer const &primitive)
+{
     // We need to operate on unmultipled by alpha color values otherwise a change in alpha screws
-    // up the premultiplied by alpha r, g, b values.
-    ink_cairo_surface_filter(out, out, UnmultiplyAlpha());
+    // up the premultiplied by alpha r, g, b values. This is done by ComponentTransferLUT, which
+    // applies the transfer functions of all components at once.
+    ComponentTransferLUT transfer;
 
     // parameters: R = 0, G = 1, B = 2, A = 3
     // Cairo:      R = 2, G = 1, B = 0, A = 3
@@ -183,40 +222,55 @@ void FilterComponentTransfer::render_cairo(FilterSlot &slot)
         guint32 color = 2 - i;
         if(i==3) color = 3; // alpha
 
-        switch (type[i]) {
+        auto const &table = primitive.tableValues[i];
+        switch (primitive.type[i]) {
         case COMPONENTTRANSFER_TYPE_TABLE:
-            if(!tableValues[i].empty()) {
-              ink_cairo_surface_filter(out, out,
-                  ComponentTransferTable(color, tableValues[i]));
+            if(!table.empty()) {
+                transfer.set(color, ComponentTransferTable(color, table));
             }
             break;
         case COMPONENTTRANSFER_TYPE_DISCRETE:
-            if(!tableValues[i].empty()) {
-                ink_cairo_surface_filter(out, out,
-                    ComponentTransferDiscrete(color, tableValues[i]));
+            if(!table.empty()) {
+                transfer.set(color, ComponentTransferDiscrete(color, table));
             }
             break;
         case COMPONENTTRANSFER_TYPE_LINEAR:
-            ink_cairo_surface_filter(out, out,
-                ComponentTransferLinear(color, intercept[i], slope[i]));
+            transfer.set(color, ComponentTransferLinear(color, primitive.intercept[i],
+                                                        primitive.slope[i]));
             break;
         case COMPONENTTRANSFER_TYPE_GAMMA:
-            ink_cairo_surface_filter(out, out,
-                ComponentTransferGamma(color, amplitude[i], exponent[i], offset[i]));
+            transfer.set(color, ComponentTransferGamma(color, primitive.amplitude[i],
+                                                       primitive.exponent[i], primitive.offset[i]));
             break;
         case COMPONENTTRANSFER_TYPE_ERROR:
         case COMPONENTTRANSFER_TYPE_IDENTITY:
         default:
             break;
         }
-        //ink_cairo_surface_blit(out, outtemp);
+    }
+    return transfer;
+}
+
+void FilterComponentTransfer::render_cairo(FilterSlot &slot)
+{
+    // The input is taken in the color interpolation space of this primitive.
+    SPColorInterpolation ci_fp = get_color_interpolation();
+    cairo_surface_t *input = slot.getcairo(_input, ci_fp);
+    cairo_surface_t *out = ink_cairo_surface_create_same_size(input, CAIRO_CONTENT_COLOR_ALPHA);
+    if( _style ) {
+        set_cairo_surface_ci(out, ci_fp );
     }
 
-    ink_cairo_surface_filter(out, out, MultiplyAlpha());
+    ink_cairo_surface_filter(input, out, transfer_lut(*this));
 
     slot.set(_output, out);
     cairo_surface_destroy(out);
-    //cairo_surface_destroy(outtemp);
+}
+
+std::unique_ptr<FilterPixelOp> FilterComponentTransfer::pixel_op(FilterSlot &,
+                                                                  std::vector<bool> const &)
+{
+    return make_pixel_filter(transfer_lut(*this));
 }
 
 bool FilterComponentTransfer::can_handle_affine(Geom::Affine const &)
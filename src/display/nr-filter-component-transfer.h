@@ -37,6 +37,8 @@ public:
     ~FilterComponentTransfer() override;
 
     void render_cairo(FilterSlot &slot) override;
+    std::unique_ptr<FilterPixelOp> pixel_op(FilterSlot &slot,
+                                            std::vector<bool> const &alpha_inputs) override;
     bool can_handle_affine(Geom::Affine const &) override;
     double complexity(Geom::Affine const &ctm) override;
 
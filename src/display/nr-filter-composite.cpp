@@ -12,9 +12,11 @@
 
 #include <cmath>
 
+#include "display/cairo-simd.h"
 #include "display/cairo-templates.h"
 #include "display/cairo-utils.h"
 #include "display/nr-filter-composite.h"
+#include "display/nr-filter-pointwise.h"
 #include "display/nr-filter-slot.h"
 #include "display/nr-filter-units.h"
 
@@ -33,49 +35,43 @@ FilterPrimitive * FilterComposite::create() {
 FilterComposite::~FilterComposite()
 = default;
 
-struct ComposeArithmetic {
-    ComposeArithmetic(double k1, double k2, double k3, double k4)
-        : _k1(round(k1 * 255))
-        , _k2(round(k2 * 255*255))
-        , _k3(round(k3 * 255*255))
-        , _k4(round(k4 * 255*255*255))
-    {}
-    guint32 operator()(guint32 in1, guint32 in2) {
-        EXTRACT_ARGB32(in1, aa, ra, ga, ba)
-        EXTRACT_ARGB32(in2, ab, rb, gb, bb)
-
-        gint32 ao = _k1*aa*ab + _k2*aa + _k3*ab + _k4;
-        gint32 ro = _k1*ra*rb + _k2*ra + _k3*rb + _k4;
-        gint32 go = _k1*ga*gb + _k2*ga + _k3*gb + _k4;
-        gint32 bo = _k1*ba*bb + _k2*ba + _k3*bb + _k4;
-
-        ao = pxclamp(ao, 0, 255*255*255); // r, g and b are premultiplied, so should be clamped to the alpha channel
-        ro = (pxclamp(ro, 0, ao) + (255*255/2)) / (255*255);
-        go = (pxclamp(go, 0, ao) + (255*255/2)) / (255*255);
-        bo = (pxclamp(bo, 0, ao) + (255*255/2)) / (255*255);
-        ao = (ao + (255*255/2)) / (255*255);
-
-        ASSEMBLE_ARGB32(pxout, ao, ro, go, bo)
-        return pxout;
-    }
-private:
-    gint32 _k1, _k2, _k3, _k4;
-};
+FilterComposite::ComposeArithmetic::ComposeArithmetic(double k1, double k2, double k3, double k4)
+    : _k1(round(k1 * 255))
+    , _k2(round(k2 * 255*255))
+    , _k3(round(k3 * 255*255))
+    , _k4(round(k4 * 255*255*255))
+{}
+
+guint32 FilterComposite::ComposeArithmetic::operator()(guint32 in1, guint32 in2) {
+    EXTRACT_ARGB32(in1, aa, ra, ga, ba)
+    EXTRACT_ARGB32(in2, ab, rb, gb, bb)
+
+    gint32 ao = _k1*aa*ab + _k2*aa + _k3*ab + _k4;
+    gint32 ro = _k1*ra*rb + _k2*ra + _k3*rb + _k4;
+    gint32 go = _k1*ga*gb + _k2*ga + _k3*gb + _k4;
+    gint32 bo = _k1*ba*bb + _k2*ba + _k3*bb + _k4;
+
+    ao = pxclamp(ao, 0, 255*255*255); // r, g and b are premultiplied, so should be clamped to the alpha channel
+    ro = (pxclamp(ro, 0, ao) + (255*255/2)) / (255*255);
+    go = (pxclamp(go, 0, ao) + (255*255/2)) / (255*255);
+    bo = (pxclamp(bo, 0, ao) + (255*255/2)) / (255*255);
+    ao = (ao + (255*255/2)) / (255*255);
+
+    ASSEMBLE_ARGB32(pxout, ao, ro, go, bo)
+    return pxout;
+}
+
+void FilterComposite::ComposeArithmetic::blendSpan(guint32 const *in1, guint32 const *in2,
+                                                   guint32 *out, int n) {
+    ink_span_arithmetic(in1, in2, out, n, _k1, _k2, _k3, _k4);
+}
 
 void FilterComposite::render_cairo(FilterSlot &slot)
 {
-    cairo_surface_t *input1 = slot.getcairo(_input);
-    cairo_surface_t *input2 = slot.getcairo(_input2);
-
-    // We may need to transform input surface to correct color interpolation space. The input surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the input before converting.
-    SPColorInterpolation ci_fp  = SP_CSS_COLOR_INTERPOLATION_AUTO;
-    if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
-    }
-    set_cairo_surface_ci( input1, ci_fp );
-    set_cairo_surface_ci( input2, ci_fp );
+    // The inputs are taken in the color interpolation space of this primitive.
+    SPColorInterpolation ci_fp = get_color_interpolation();
+    cairo_surface_t *input1 = slot.getcairo(_input, ci_fp);
+    cairo_surface_t *input2 = slot.getcairo(_input2, ci_fp);
 
     cairo_surface_t *out = ink_cairo_surface_create_output(input1, input2);
     set_cairo_surface_ci(out, ci_fp );
@@ -83,11 +79,37 @@ void FilterComposite::render_cairo(FilterSlot &slot)
     Geom::Rect vp = filter_primitive_area( slot.get_units() );
     slot.set_primitive_area(_output, vp); // Needed for tiling
 
-    if (op == COMPOSITE_ARITHMETIC) {
+    // only the needed part of the result is computed
+    Geom::IntRect const needed = slot.get_needed_area();
+    int const scale = slot.get_device_scale();
+    int const w = ink_cairo_surface_get_width(out);
+    int const h = ink_cairo_surface_get_height(out);
+    Geom::IntRect const pixels(needed.left() * scale, needed.top() * scale,
+                               needed.right() * scale, needed.bottom() * scale);
+    bool const partial = pixels != Geom::IntRect(0, 0, w, h)
+        && Geom::IntRect(0, 0, w, h).contains(pixels)
+        && ink_cairo_surface_get_width(input1) == w && ink_cairo_surface_get_height(input1) == h
+        && ink_cairo_surface_get_width(input2) == w && ink_cairo_surface_get_height(input2) == h;
+
+    if (op == COMPOSITE_ARITHMETIC && !partial) {
         ink_cairo_surface_blend(input1, input2, out, ComposeArithmetic(k1, k2, k3, k4));
+    } else if (op == COMPOSITE_ARITHMETIC) {
+        cairo_surface_t *in1 = ink_cairo_surface_create_view(input1, pixels);
+        cairo_surface_t *in2 = ink_cairo_surface_create_view(input2, pixels);
+        cairo_surface_t *o = ink_cairo_surface_create_view(out, pixels);
+        ink_cairo_surface_blend(in1, in2, o, ComposeArithmetic(k1, k2, k3, k4));
+        cairo_surface_destroy(in1);
+        cairo_surface_destroy(in2);
+        cairo_surface_destroy(o);
+        cairo_surface_mark_dirty(out);
     } else {
-        ink_cairo_surface_blit(input2, out);
         cairo_t *ct = cairo_create(out);
+        cairo_rectangle(ct, needed.left(), needed.top(), needed.width(), needed.height());
+        cairo_clip(ct);
+        cairo_set_source_surface(ct, input2, 0, 0);
+        cairo_set_operator(ct, CAIRO_OPERATOR_SOURCE);
+        cairo_paint(ct);
+        cairo_set_operator(ct, CAIRO_OPERATOR_OVER);
         cairo_set_source_surface(ct, input1, 0, 0);
         switch(op) {
         case COMPOSITE_IN:
@@ -119,6 +141,20 @@ void FilterComposite::render_cairo(FilterSlot &slot)
     cairo_surface_destroy(out);
 }
 
+std::unique_ptr<FilterPixelOp> FilterComposite::pixel_op(FilterSlot &slot,
+                                                          std::vector<bool> const &alpha_inputs)
+{
+    // the other operators are left to Cairo
+    if (op != COMPOSITE_ARITHMETIC) {
+        return nullptr;
+    }
+
+    Geom::Rect vp = filter_primitive_area( slot.get_units() );
+    slot.set_primitive_area(_output, vp); // Needed for tiling
+
+    return make_pixel_blend(ComposeArithmetic(k1, k2, k3, k4), alpha_inputs[0] && alpha_inputs[1]);
+}
+
 bool FilterComposite::can_handle_affine(Geom::Affine const &)
 {
     return true;
@@ -28,17 +28,29 @@ public:
     ~FilterComposite() override;
 
     void render_cairo(FilterSlot &) override;
+    std::unique_ptr<FilterPixelOp> pixel_op(FilterSlot &slot,
+                                            std::vector<bool> const &alpha_inputs) override;
     bool can_handle_affine(Geom::Affine const &) override;
     double complexity(Geom::Affine const &ctm) override;
 
     void set_input(int input) override;
     void set_input(int input, int slot) override;
+    std::vector<int> get_inputs() override { return { _input, _input2 }; }
 
     void set_operator(FeCompositeOperator op);
     void set_arithmetic(double k1, double k2, double k3, double k4);
 
     Glib::ustring name() override { return Glib::ustring("Composite"); }
 
+    /// The arithmetic operator, with the coefficients in fixed point.
+    struct ComposeArithmetic {
+        ComposeArithmetic(double k1, double k2, double k3, double k4);
+        guint32 operator()(guint32 in1, guint32 in2);
+        void blendSpan(guint32 const *in1, guint32 const *in2, guint32 *out, int n);
+    private:
+        gint32 _k1, _k2, _k3, _k4;
+    };
+
 private:
     FeCompositeOperator op;
     double k1, k2, k3, k4;
@@ -11,9 +11,11 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <cmath>
 #include <vector>
 #include "display/cairo-templates.h"
 #include "display/cairo-utils.h"
+#include "display/nr-filter-channels.h"
 #include "display/nr-filter-convolve-matrix.h"
 #include "display/nr-filter-slot.h"
 #include "display/nr-filter-units.h"
@@ -100,6 +102,198 @@ private:
     double _bias;
 };
 
+/**
+ * Same as ConvolveMatrix, but computed a row at a time, with the four channels of each pixel
+ * in one vector and the rows divided between the threads of the dispatch pool. Kernels which
+ * are the product of a column and a row vector are applied as two one-dimensional passes.
+ *
+ * ConvolveMatrix aligns the kernel with the top left corner of the image where it extends
+ * past the top or left edge, so those pixels are left to it; this function computes the
+ * pixels starting at (targetX, targetY), where both agree, up to rounding.
+ */
+template <PreserveAlphaMode preserve_alpha>
+void convolve_rows(cairo_surface_t *input, cairo_surface_t *out, int targetX, int targetY,
+                   int orderX, int orderY, double divisor, double bias,
+                   std::vector<double> const &kernel)
+{
+    // rows given to each thread at once
+    int const BAND = 32;
+    // pixels computed at once, so that their sums do not wait for each other
+    int const UNROLL = 4;
+
+    cairo_surface_flush(input);
+    int w = cairo_image_surface_get_width(input);
+    int h = cairo_image_surface_get_height(input);
+    int stridein = cairo_image_surface_get_stride(input);
+    int strideout = cairo_image_surface_get_stride(out);
+    bool alpha_only = cairo_image_surface_get_format(input) == CAIRO_FORMAT_A8;
+    unsigned char *in_data = cairo_image_surface_get_data(input);
+    unsigned char *out_data = cairo_image_surface_get_data(out);
+
+    // the matrix is given rotated 180 degrees
+    std::vector<float> k(kernel.size());
+    for (std::size_t i = 0; i < kernel.size(); ++i) {
+        k[kernel.size() - 1 - i] = kernel[i] / divisor;
+    }
+
+    // A kernel of rank one is the product of its row and column through the largest element.
+    std::size_t pivot = 0;
+    for (std::size_t i = 0; i < k.size(); ++i) {
+        if (std::fabs(k[i]) > std::fabs(k[pivot])) pivot = i;
+    }
+    int const pi = pivot / orderX, pj = pivot % orderX;
+    std::vector<float> column(orderY), row(orderX);
+    bool separable = orderX > 1 && orderY > 1 && k[pivot] != 0;
+    if (separable) {
+        for (int j = 0; j < orderX; ++j) {
+            row[j] = k[pi * orderX + j];
+        }
+        for (int i = 0; i < orderY; ++i) {
+            column[i] = k[i * orderX + pj] / k[pivot];
+        }
+        float const tolerance = 1e-5f * std::fabs(k[pivot]);
+        for (int i = 0; i < orderY && separable; ++i) {
+            for (int j = 0; j < orderX; ++j) {
+                if (std::fabs(k[i * orderX + j] - column[i] * row[j]) > tolerance) {
+                    separable = false;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Converted rows are kept in a ring of orderY rows, padded with transparent black so that
+    // pixel x of the result depends on pixels x to x + orderX - 1 of the padded row.
+    // For separable kernels the ring holds the rows convolved with the row vector instead.
+    int const pw = w + orderX - 1 + UNROLL;
+    int const ring_width = separable ? w + UNROLL : pw;
+    std::size_t const thread_size = std::size_t(orderY) * ring_width + pw;
+
+    auto pool = Inkscape::get_global_dispatch_pool();
+    std::vector<Channels> buffers(thread_size * pool->size());
+
+    std::vector<Channels> kv(k.size()), row_v(orderX), column_v(orderY);
+    for (std::size_t i = 0; i < k.size(); ++i) kv[i] = Channels::set1(k[i]);
+    for (int j = 0; j < orderX; ++j) row_v[j] = Channels::set1(row[j]);
+    for (int i = 0; i < orderY; ++i) column_v[i] = Channels::set1(column[i]);
+
+    auto convert = [&] (int y, Channels *dst) {
+        std::fill(dst, dst + pw, Channels::set1(0.0f));
+        unsigned char const *src = in_data + y * stridein;
+        for (int x = 0; x < w; ++x) {
+            guint32 px = alpha_only ? guint32(src[x]) << 24 : reinterpret_cast<guint32 const *>(src)[x];
+            dst[x + targetX] = Channels::from_pixel(px);
+        }
+    };
+
+    // Rounds like ConvolveMatrix does, except for the sign of exact halves below zero,
+    // which are clamped to zero anyway.
+    auto round_clamp = [] (float v, gint32 high) {
+        return pxclamp(v < 0 ? 0 : gint32(v + 0.5f), 0, high);
+    };
+
+    auto process = [&] (int band, int thread) {
+        Channels *ring = buffers.data() + thread * thread_size;
+        Channels *padded = ring + std::size_t(orderY) * ring_width;
+        std::vector<int> ring_rows(orderY, -1);
+        std::vector<Channels const *> src(orderY);
+        Channels sums[UNROLL];
+
+        // Returns input row y, converted and possibly convolved with the row vector.
+        auto get_row = [&] (int y) -> Channels const * {
+            Channels *dst = ring + std::size_t(y % orderY) * ring_width;
+            if (ring_rows[y % orderY] == y) {
+                return dst;
+            }
+            ring_rows[y % orderY] = y;
+            if (!separable) {
+                convert(y, dst);
+                return dst;
+            }
+            convert(y, padded);
+            for (int x = 0; x < w; x += UNROLL) {
+                Channels sum[UNROLL] = {};
+                for (int j = 0; j < orderX; ++j) {
+                    for (int u = 0; u < UNROLL; ++u) {
+                        sum[u] = sum[u] + row_v[j] * padded[x + j + u];
+                    }
+                }
+                std::copy(sum, sum + std::min(UNROLL, w - x), dst + x);
+            }
+            return dst;
+        };
+
+        int y_end = std::min(h, (band + 1) * BAND);
+        for (int y = std::max(band * BAND, targetY); y < y_end; ++y) {
+            // rows past the bottom edge are transparent black
+            int rows = std::min(orderY, h - (y - targetY));
+            for (int i = 0; i < rows; ++i) {
+                src[i] = get_row(y - targetY + i);
+            }
+
+            unsigned char const *in_row = in_data + y * stridein;
+            unsigned char *out_row = out_data + y * strideout;
+            for (int x = targetX; x < w; ++x) {
+                if ((x - targetX) % UNROLL == 0) {
+                    Channels acc[UNROLL] = {};
+                    for (int i = 0; i < rows; ++i) {
+                        if (separable) {
+                            for (int u = 0; u < UNROLL; ++u) {
+                                acc[u] = acc[u] + column_v[i] * src[i][x + u];
+                            }
+                            continue;
+                        }
+                        Channels const *kr = kv.data() + i * orderX;
+                        Channels const *sr = src[i] + x;
+                        for (int j = 0; j < orderX; ++j) {
+                            for (int u = 0; u < UNROLL; ++u) {
+                                acc[u] = acc[u] + kr[j] * sr[j + u];
+                            }
+                        }
+                    }
+                    std::copy(acc, acc + UNROLL, sums);
+                }
+                Channels sum = sums[(x - targetX) % UNROLL];
+
+                float c[4];
+                sum.store(c);
+                float suma;
+                if (preserve_alpha == PRESERVE_ALPHA) {
+                    suma = alpha_only ? in_row[x] : reinterpret_cast<guint32 const *>(in_row)[x] >> 24;
+                } else {
+                    suma = c[3] + bias * 255;
+                }
+                guint32 ao = round_clamp(suma, 255);
+                if (alpha_only) {
+                    out_row[x] = ao;
+                    continue;
+                }
+                guint32 ro = round_clamp(c[2] + ao * bias, ao);
+                guint32 go = round_clamp(c[1] + ao * bias, ao);
+                guint32 bo = round_clamp(c[0] + ao * bias, ao);
+                ASSEMBLE_ARGB32(pxout, ao,ro,go,bo);
+                reinterpret_cast<guint32 *>(out_row)[x] = pxout;
+            }
+        }
+    };
+
+    int bands = (h + BAND - 1) / BAND;
+    if (w * h > PARALLEL_THRESHOLD) {
+        pool->dispatch(bands, process);
+    } else {
+        for (int i = 0; i < bands; ++i) {
+            process(i, 0);
+        }
+    }
+
+    // The pixels where the kernel extends past the top or left edge.
+    cairo_rectangle_t top = { 0, 0, double(w), double(std::min(targetY, h)) };
+    cairo_rectangle_t left = { 0, double(std::min(targetY, h)), double(std::min(targetX, w)), double(h) };
+    ConvolveMatrix<preserve_alpha> synth(input, targetX, targetY, orderX, orderY, divisor, bias, kernel);
+    ink_cairo_surface_synthesize(out, top, synth);
+    ink_cairo_surface_synthesize(out, left, synth);
+}
+
 void FilterConvolveMatrix::render_cairo(FilterSlot &slot)
 {
     static bool bias_warning = false;
@@ -118,18 +312,13 @@ void FilterConvolveMatrix::render_cairo(FilterSlot &slot)
         return;
     }
 
-    cairo_surface_t *input = slot.getcairo(_input);
+    // The input is taken in the color interpolation space of this primitive.
+    SPColorInterpolation ci_fp = get_color_interpolation();
+    cairo_surface_t *input = slot.getcairo(_input, ci_fp);
     cairo_surface_t *out = ink_cairo_surface_create_identical(input);
-
-    // We may need to transform input surface to correct color interpolation space. The input surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the input before converting.
-    SPColorInterpolation ci_fp = SP_CSS_COLOR_INTERPOLATION_AUTO;
     if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
         set_cairo_surface_ci(out, ci_fp);
     }
-    set_cairo_surface_ci( input, ci_fp );
 
     if (bias!=0 && !bias_warning) {
         g_warning("It is unknown whether Inkscape's implementation of bias in feConvolveMatrix "
@@ -163,13 +352,13 @@ void FilterConvolveMatrix::render_cairo(FilterSlot &slot)
     if (preserveAlpha) {
         //convolve2D<true>(out_data, in_data, width, height, &kernel.front(), orderX, orderY,
         //    targetX, targetY, bias);
-        ink_cairo_surface_synthesize(out, ConvolveMatrix<PRESERVE_ALPHA>(input,
-            targetX, targetY, orderX, orderY, divisor, bias, kernelMatrix));
+        convolve_rows<PRESERVE_ALPHA>(input, out, targetX, targetY, orderX, orderY,
+            divisor, bias, kernelMatrix);
     } else {
         //convolve2D<false>(out_data, in_data, width, height, &kernel.front(), orderX, orderY,
         //    targetX, targetY, bias);
-        ink_cairo_surface_synthesize(out, ConvolveMatrix<NO_PRESERVE_ALPHA>(input,
-            targetX, targetY, orderX, orderY, divisor, bias, kernelMatrix));
+        convolve_rows<NO_PRESERVE_ALPHA>(input, out, targetX, targetY, orderX, orderY,
+            divisor, bias, kernelMatrix);
     }
 
     slot.set(_output, out);
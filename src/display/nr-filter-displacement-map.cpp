@@ -73,19 +73,12 @@ private:
 void FilterDisplacementMap::render_cairo(FilterSlot &slot)
 {
     cairo_surface_t *texture = slot.getcairo(_input);
-    cairo_surface_t *map = slot.getcairo(_input2);
     cairo_surface_t *out = ink_cairo_surface_create_identical(texture);
     // color_interpolation_filters for out same as texture. See spec.
     copy_cairo_surface_ci( texture, out );
 
-    // We may need to transform map surface to correct color interpolation space. The map surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the map before converting.
-    SPColorInterpolation ci_fp = SP_CSS_COLOR_INTERPOLATION_AUTO;
-    if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
-    }
-    set_cairo_surface_ci( map, ci_fp );
+    // The map is taken in the color interpolation space of this primitive.
+    cairo_surface_t *map = slot.getcairo(_input2, get_color_interpolation());
 
     Geom::Affine trans = slot.get_units().get_matrix_primitiveunits2pb();
 
@@ -33,6 +33,7 @@ public:
 
     void set_input(int slot) override;
     void set_input(int input, int slot) override;
+    std::vector<int> get_inputs() override { return { _input, _input2 }; }
     virtual void set_scale(double s);
     virtual void set_channel_selector(int s, FilterDisplacementMapChannelSelector channel);
 
@@ -31,6 +31,7 @@ public:
     bool can_handle_affine(Geom::Affine const &) override;
     double complexity(Geom::Affine const &ctm) override;
     bool uses_background() override { return false; }
+    std::vector<int> get_inputs() override { return {}; }
     
     virtual void set_opacity(double o);
     virtual void set_color(guint32 c);
@@ -22,11 +22,10 @@
 #include <cstdlib>
 #include <glib.h>
 #include <limits>
-#if HAVE_OPENMP
-#include <omp.h>
-#endif //HAVE_OPENMP
+#include <vector>
 
 #include "display/cairo-utils.h"
+#include "display/dispatch-pool.h"
 #include "display/nr-filter-primitive.h"
 #include "display/nr-filter-gaussian.h"
 #include "display/nr-filter-types.h"
@@ -51,6 +50,11 @@
 // Bill Triggs, Michael Sdika
 // IEEE Transactions on Signal Processing, Volume 54, Number 5 - may 2006
 
+// Box filtering method based on:
+// P. Gwosdek, S. Grewenig, A. Bruhn, J. Weickert, Theoretical Foundations of Gaussian
+// Convolution by Extended Box Filtering, in: Scale Space and Variational Methods in Computer
+// Vision, LNCS 6667, Springer, 2011, 447-458.
+
 // Number of IIR filter coefficients used. Currently only 3 is supported.
 // "Recursive Gaussian Derivative Filters" says this is enough though (and
 // some testing indeed shows that the quality doesn't improve much if larger
@@ -297,7 +301,7 @@ static void
 filter2D_IIR(PT *const dest, int const dstr1, int const dstr2,
              PT const *const src, int const sstr1, int const sstr2,
              int const n1, int const n2, IIRValue const b[N+1], double const M[N*N],
-             IIRValue *const tmpdata[], int const num_threads)
+             IIRValue *const tmpdata[], Inkscape::DispatchPool &pool)
 {
     assert(src && dest);
 
@@ -309,16 +313,7 @@ filter2D_IIR(PT *const dest, int const dstr1, int const dstr2,
     #define PREMUL_ALPHA_LOOP for(unsigned int c=1; c<PC; ++c)
 #endif
 
-INK_UNUSED(num_threads); // to suppress unused argument compiler warning
-#if HAVE_OPENMP
-#pragma omp parallel for num_threads(num_threads)
-#endif // HAVE_OPENMP
-    for ( int c2 = 0 ; c2 < n2 ; c2++ ) {
-#if HAVE_OPENMP
-        unsigned int tid = omp_get_thread_num();
-#else
-        unsigned int tid = 0;
-#endif // HAVE_OPENMP
+    pool.dispatch(n2, [&](int c2, int tid) {
         // corresponding line in the source and output buffer
         PT const * srcimg = src  + c2*sstr2;
         PT       * dstimg = dest + c2*dstr2 + n1*dstr1;
@@ -364,7 +359,7 @@ INK_UNUSED(num_threads); // to suppress unused argument compiler warning
                 for(unsigned int c=0; c<PC; c++) dstimg[c] = clip_round_cast<PT>(v[0][c]);
             }
         }
-    }
+    });
 }
 
 // Filters over 1st dimension
@@ -374,18 +369,13 @@ template<typename PT, unsigned int PC>
 static void
 filter2D_FIR(PT *const dst, int const dstr1, int const dstr2,
              PT const *const src, int const sstr1, int const sstr2,
-             int const n1, int const n2, FIRValue const *const kernel, int const scr_len, int const num_threads)
+             int const n1, int const n2, FIRValue const *const kernel, int const scr_len, Inkscape::DispatchPool &pool)
 {
     assert(src && dst);
 
-    // Past pixels seen (to enable in-place operation)
-    PT history[scr_len+1][PC];
-
-INK_UNUSED(num_threads); // suppresses unused argument compiler warning
-#if HAVE_OPENMP
-#pragma omp parallel for num_threads(num_threads) private(history)
-#endif // HAVE_OPENMP
-    for ( int c2 = 0 ; c2 < n2 ; c2++ ) {
+    pool.dispatch(n2, [&](int c2, int) {
+        // Past pixels seen (to enable in-place operation)
+        PT history[scr_len+1][PC];
 
         // corresponding line in the source buffer
         int const src_line = c2 * sstr2;
@@ -472,12 +462,12 @@ INK_UNUSED(num_threads); // suppresses unused argument compiler warning
                 }
             }
         }
-    }
+    });
 }
 
 static void
 gaussian_pass_IIR(Geom::Dim2 d, double deviation, cairo_surface_t *src, cairo_surface_t *dest,
-    IIRValue **tmpdata, int num_threads)
+    IIRValue **tmpdata, Inkscape::DispatchPool &pool)
 {
     // Filter variables
     IIRValue b[N+1];  // scaling coefficient + filter coefficients (can be 10.21 fixed point)
@@ -507,13 +497,13 @@ gaussian_pass_IIR(Geom::Dim2 d, double deviation, cairo_surface_t *src, cairo_su
         filter2D_IIR<unsigned char,1,false>(
             cairo_image_surface_get_data(dest), d == Geom::X ? 1 : stride, d == Geom::X ? stride : 1,
             cairo_image_surface_get_data(src),  d == Geom::X ? 1 : stride, d == Geom::X ? stride : 1,
-            w, h, b, M, tmpdata, num_threads);
+            w, h, b, M, tmpdata, pool);
         break;
     case CAIRO_FORMAT_ARGB32: ///< Premultiplied 8 bit RGBA
         filter2D_IIR<unsigned char,4,true>(
             cairo_image_surface_get_data(dest), d == Geom::X ? 4 : stride, d == Geom::X ? stride : 4,
             cairo_image_surface_get_data(src),  d == Geom::X ? 4 : stride, d == Geom::X ? stride : 4,
-            w, h, b, M, tmpdata, num_threads);
+            w, h, b, M, tmpdata, pool);
         break;
     default:
         g_warning("gaussian_pass_IIR: unsupported image format");
@@ -522,7 +512,7 @@ gaussian_pass_IIR(Geom::Dim2 d, double deviation, cairo_surface_t *src, cairo_su
 
 static void
 gaussian_pass_FIR(Geom::Dim2 d, double deviation, cairo_surface_t *src, cairo_surface_t *dest,
-    int num_threads)
+    Inkscape::DispatchPool &pool)
 {
     int scr_len = _effect_area_scr(deviation);
     // Filter kernel for x direction
@@ -540,34 +530,165 @@ gaussian_pass_FIR(Geom::Dim2 d, double deviation, cairo_surface_t *src, cairo_su
         filter2D_FIR<unsigned char,1>(
             cairo_image_surface_get_data(dest), d == Geom::X ? 1 : stride, d == Geom::X ? stride : 1,
             cairo_image_surface_get_data(src),  d == Geom::X ? 1 : stride, d == Geom::X ? stride : 1,
-            w, h, &kernel[0], scr_len, num_threads);
+            w, h, &kernel[0], scr_len, pool);
         break;
     case CAIRO_FORMAT_ARGB32: ///< Premultiplied 8 bit RGBA
         filter2D_FIR<unsigned char,4>(
             cairo_image_surface_get_data(dest), d == Geom::X ? 4 : stride, d == Geom::X ? stride : 4,
             cairo_image_surface_get_data(src),  d == Geom::X ? 4 : stride, d == Geom::X ? stride : 4,
-            w, h, &kernel[0], scr_len, num_threads);
+            w, h, &kernel[0], scr_len, pool);
         break;
     default:
         g_warning("gaussian_pass_FIR: unsupported image format");
     };
 }
 
-void FilterGaussian::render_cairo(FilterSlot &slot)
+// Number of pixels in a strip of columns processed at once by the vertical box filter
+static int const BOX_STRIP = 64;
+
+// Box filter with fractional weights at both ends ("extended box filter")
+struct BoxFilter {
+    int r;           // radius of the box
+    guint32 w;       // weight of the pixels within the box, 16.16 fixed point
+    guint32 w_end;   // weight of the two pixels just outside of it
+};
+
+// Three passes of the returned filter have exactly the variance of the Gaussian.
+static BoxFilter
+make_box_filter(double deviation)
 {
-    cairo_surface_t *in = slot.getcairo(_input);
-    if (!(in && ink_cairo_surface_get_width(in) && ink_cairo_surface_get_height(in))) {
+    double const var = deviation * deviation / 3;
+    int const r = static_cast<int>(std::floor(0.5 * std::sqrt(12 * var + 1) - 0.5));
+    double const alpha = (2*r + 1) * (r * (r + 1) - 3 * var) / (6 * (var - sqr(r + 1)));
+    double const width = 2*r + 1 + 2*alpha;
+
+    BoxFilter f;
+    f.r = r;
+    // The weights must add up to exactly one, or flat areas would change color.
+    f.w = static_cast<guint32>(65536 / width) & ~1u;
+    f.w_end = (65536 - (2*r + 1) * f.w) / 2;
+    return f;
+}
+
+// One box filter pass over n elements made of `lanes` consecutive bytes, such as the channels
+// of a pixel or the pixels of a row, with consecutive elements sstride and dstride bytes apart.
+// Like the IIR and FIR filters, the edge pixels are repeated beyond the ends.
+// The source, destination and sums must not overlap. With LANES other than 0, the number of
+// lanes is known at compile time, so that the compiler can vectorize the loops over the lanes
+// without runtime checks.
+template <int LANES>
+static void
+box_blur_pass(guint8 const *__restrict src, int sstride, guint8 *__restrict dst, int dstride,
+              int n, int lanes, BoxFilter const &f, guint32 *__restrict sum)
+{
+    int const nl = LANES ? LANES : lanes;
+    auto at = [=] (int i) { return src + std::clamp(i, 0, n - 1) * sstride; };
+
+    std::fill_n(sum, nl, 0);
+    for (int i = -f.r; i <= f.r; ++i) {
+        guint8 const *__restrict p = at(i);
+        for (int l = 0; l < nl; ++l) {
+            sum[l] += p[l];
+        }
+    }
+
+    guint32 const w = f.w;
+    guint32 const w_end = f.w_end;
+    for (int i = 0; i < n; ++i) {
+        guint8 const *__restrict before = at(i - f.r - 1);
+        guint8 const *__restrict after = at(i + f.r + 1);
+        guint8 const *__restrict first = at(i - f.r);
+        guint8 *__restrict out = dst + i * dstride;
+        for (int l = 0; l < nl; ++l) {
+            out[l] = (sum[l] * w + (before[l] + after[l]) * w_end + 0x8000) >> 16;
+            sum[l] += after[l] - first[l];
+        }
+    }
+}
+
+// Three box filter passes from src to dst through tmp1 and tmp2, which hold n elements each.
+template <int LANES>
+static void
+box_blur_passes(guint8 const *src, int sstride, guint8 *dst, int dstride, int n, int lanes,
+                BoxFilter const &f, guint8 *tmp1, guint8 *tmp2, guint32 *sum)
+{
+    box_blur_pass<LANES>(src,  sstride, tmp1, lanes,   n, lanes, f, sum);
+    box_blur_pass<LANES>(tmp1, lanes,   tmp2, lanes,   n, lanes, f, sum);
+    box_blur_pass<LANES>(tmp2, lanes,   dst,  dstride, n, lanes, f, sum);
+}
+
+// Approximate Gaussian blur with three box filter passes, in place.
+// Rows are filtered with the channels of each pixel processed together, and columns are
+// filtered in strips, processing the pixels of a row of the strip together.
+static void
+gaussian_pass_box(Geom::Dim2 d, double deviation, cairo_surface_t *surface,
+    Inkscape::DispatchPool &pool)
+{
+    int bpp;
+    switch (cairo_image_surface_get_format(surface)) {
+    case CAIRO_FORMAT_A8:
+        bpp = 1;
+        break;
+    case CAIRO_FORMAT_ARGB32:
+        bpp = 4;
+        break;
+    default:
+        g_warning("gaussian_pass_box: unsupported image format");
         return;
     }
 
-    // We may need to transform input surface to correct color interpolation space. The input surface
-    // might be used as input to another primitive but it is likely that all the primitives in a given
-    // filter use the same color interpolation space so we don't copy the input before converting.
-    SPColorInterpolation ci_fp = SP_CSS_COLOR_INTERPOLATION_AUTO;
-    if( _style ) {
-        ci_fp = (SPColorInterpolation)_style->color_interpolation_filters.computed;
+    BoxFilter const f = make_box_filter(deviation);
+    int stride = cairo_image_surface_get_stride(surface);
+    int w = cairo_image_surface_get_width(surface);
+    int h = cairo_image_surface_get_height(surface);
+    guint8 *data = cairo_image_surface_get_data(surface);
+
+    // The buffers of the intermediate passes are allocated once for every thread.
+    if (d == Geom::X) {
+        std::size_t const size = 2 * std::size_t(w) * bpp;
+        std::vector<guint8> buffers(pool.size() * size);
+        pool.dispatch(h, [&] (int y, int thread) {
+            guint32 sum[4];
+            guint8 *row = data + y * stride;
+            guint8 *tmp1 = buffers.data() + thread * size;
+            guint8 *tmp2 = tmp1 + w * bpp;
+            if (bpp == 4) {
+                box_blur_passes<4>(row, 4, row, 4, w, 4, f, tmp1, tmp2, sum);
+            } else {
+                box_blur_passes<1>(row, 1, row, 1, w, 1, f, tmp1, tmp2, sum);
+            }
+        });
+    } else {
+        int strips = (w + BOX_STRIP - 1) / BOX_STRIP;
+        std::size_t const size = 2 * std::size_t(h) * BOX_STRIP * bpp;
+        std::vector<guint8> buffers(pool.size() * size);
+        pool.dispatch(strips, [&] (int s, int thread) {
+            int x = s * BOX_STRIP;
+            int lanes = std::min(BOX_STRIP, w - x) * bpp;
+            guint32 sum[BOX_STRIP * 4];
+            guint8 *column = data + x * bpp;
+            guint8 *tmp1 = buffers.data() + thread * size;
+            guint8 *tmp2 = tmp1 + h * lanes;
+            if (lanes == BOX_STRIP * 4) {
+                box_blur_passes<BOX_STRIP * 4>(column, stride, column, stride, h, lanes, f, tmp1, tmp2, sum);
+            } else if (lanes == BOX_STRIP) {
+                box_blur_passes<BOX_STRIP>(column, stride, column, stride, h, lanes, f, tmp1, tmp2, sum);
+            } else {
+                // the last, narrower strip
+                box_blur_passes<0>(column, stride, column, stride, h, lanes, f, tmp1, tmp2, sum);
+            }
+        });
+    }
+}
+
+void FilterGaussian::render_cairo(FilterSlot &slot)
+{
+    // The input is taken in the color interpolation space of this primitive.
+    SPColorInterpolation ci_fp = get_color_interpolation();
+    cairo_surface_t *in = slot.getcairo(_input, ci_fp);
+    if (!(in && ink_cairo_surface_get_width(in) && ink_cairo_surface_get_height(in))) {
+        return;
     }
-    set_cairo_surface_ci( in, ci_fp );
 
     // zero deviation = no change in output
     if (_deviation_x <= 0 && _deviation_y <= 0) {
@@ -595,6 +716,31 @@ void FilterGaussian::render_cairo(FilterSlot &slot)
 
     int device_scale = slot.get_device_scale();
 
+    // Only the needed part of the result is computed, from the part of the input within reach
+    // of the blur. The margin includes a step of the downsampled surface, for rounding.
+    int quality = slot.get_blurquality();
+    Geom::IntRect const whole(0, 0, ink_cairo_surface_get_width(in) / device_scale,
+                              ink_cairo_surface_get_height(in) / device_scale);
+    Geom::IntRect crop = slot.get_needed_area();
+    crop.expandBy(_effect_area_scr(deviation_x_orig)
+                      + (1 << _effect_subsample_step_log2(deviation_x_orig * device_scale, quality)),
+                  _effect_area_scr(deviation_y_orig)
+                      + (1 << _effect_subsample_step_log2(deviation_y_orig * device_scale, quality)));
+    Geom::OptIntRect reach = Geom::intersect(crop, whole);
+    cairo_surface_t *cropped = nullptr;
+    if (reach && *reach != whole) {
+        crop = *reach;
+        cropped = ink_cairo_surface_create_similar(in, cairo_surface_get_content(in),
+                                                   crop.width(), crop.height());
+        copy_cairo_surface_ci(in, cropped);
+        cairo_t *ct = cairo_create(cropped);
+        cairo_set_source_surface(ct, in, -crop.left(), -crop.top());
+        cairo_set_operator(ct, CAIRO_OPERATOR_SOURCE);
+        cairo_paint(ct);
+        cairo_destroy(ct);
+        in = cropped;
+    }
+
     deviation_x_orig *= device_scale;
     deviation_y_orig *= device_scale;
 
@@ -608,14 +754,9 @@ void FilterGaussian::render_cairo(FilterSlot &slot)
             bytes_per_pixel = 4; break;
     }
 
-#if HAVE_OPENMP
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    int threads = prefs->getIntLimited("/options/threading/numthreads", omp_get_num_procs(), 1, 256);
-#else
-    int threads = 1;
-#endif
+    auto pool = Inkscape::get_global_dispatch_pool();
+    int threads = pool->size();
 
-    int quality = slot.get_blurquality();
     int x_step = 1 << _effect_subsample_step_log2(deviation_x_orig, quality);
     int y_step = 1 << _effect_subsample_step_log2(deviation_y_orig, quality);
     bool resampling = x_step > 1 || y_step > 1;
@@ -633,8 +774,10 @@ void FilterGaussian::render_cairo(FilterSlot &slot)
     // so there's a good chance that it's not optimal.
     // Whatever you do, don't go below 1 (and preferably not even below 2), as
     // the IIR filter gets unstable there.
-    bool use_IIR_x = deviation_x > 3;
-    bool use_IIR_y = deviation_y > 3;
+    // The lower quality settings use the box filter, which is fastest for any deviation.
+    bool use_box = quality <= BLUR_QUALITY_WORSE;
+    bool use_IIR_x = !use_box && deviation_x > 3;
+    bool use_IIR_y = !use_box && deviation_y > 3;
 
     // Temporary storage for IIR filter
     // NOTE: This can be eliminated, but it reduces the precision a bit
@@ -650,7 +793,7 @@ void FilterGaussian::render_cairo(FilterSlot &slot)
     if (resampling) {
         // Divide by device scale as w_downsampled is in pixels while
         // cairo_surface_create_similar() uses device units.
-        downsampled = cairo_surface_create_similar(in, cairo_surface_get_content(in),
+        downsampled = ink_cairo_surface_create_similar(in, cairo_surface_get_content(in),
             w_downsampled/device_scale, h_downsampled/device_scale);
         cairo_t *ct = cairo_create(downsampled);
         cairo_scale(ct, static_cast<double>(w_downsampled)/w_orig, static_cast<double>(h_downsampled)/h_orig);
@@ -663,18 +806,22 @@ void FilterGaussian::render_cairo(FilterSlot &slot)
     cairo_surface_flush(downsampled);
 
     if (scr_len_x > 0) {
-        if (use_IIR_x) {
-            gaussian_pass_IIR(Geom::X, deviation_x, downsampled, downsampled, tmpdata, threads);
+        if (use_box) {
+            gaussian_pass_box(Geom::X, deviation_x, downsampled, *pool);
+        } else if (use_IIR_x) {
+            gaussian_pass_IIR(Geom::X, deviation_x, downsampled, downsampled, tmpdata, *pool);
         } else {
-            gaussian_pass_FIR(Geom::X, deviation_x, downsampled, downsampled, threads);
+            gaussian_pass_FIR(Geom::X, deviation_x, downsampled, downsampled, *pool);
         }
     }
 
     if (scr_len_y > 0) {
-        if (use_IIR_y) {
-            gaussian_pass_IIR(Geom::Y, deviation_y, downsampled, downsampled, tmpdata, threads);
+        if (use_box) {
+            gaussian_pass_box(Geom::Y, deviation_y, downsampled, *pool);
+        } else if (use_IIR_y) {
+            gaussian_pass_IIR(Geom::Y, deviation_y, downsampled, downsampled, tmpdata, *pool);
         } else {
-            gaussian_pass_FIR(Geom::Y, deviation_y, downsampled, downsampled, threads);
+            gaussian_pass_FIR(Geom::Y, deviation_y, downsampled, downsampled, *pool);
         }
     }
 
@@ -686,26 +833,37 @@ void FilterGaussian::render_cairo(FilterSlot &slot)
     }
 
     cairo_surface_mark_dirty(downsampled);
+    cairo_surface_t *result = downsampled;
     if (resampling) {
-        cairo_surface_t *upsampled = cairo_surface_create_similar(downsampled, cairo_surface_get_content(downsampled),
+        cairo_surface_t *upsampled = ink_cairo_surface_create_similar(downsampled, cairo_surface_get_content(downsampled),
             w_orig/device_scale, h_orig/device_scale);
         cairo_t *ct = cairo_create(upsampled);
         cairo_scale(ct, static_cast<double>(w_orig)/w_downsampled, static_cast<double>(h_orig)/h_downsampled);
         cairo_set_source_surface(ct, downsampled, 0, 0);
         cairo_paint(ct);
         cairo_destroy(ct);
-
-        set_cairo_surface_ci( upsampled, ci_fp );
-
-        slot.set(_output, upsampled);
-        cairo_surface_destroy(upsampled);
         cairo_surface_destroy(downsampled);
-    } else {
-        set_cairo_surface_ci( downsampled, ci_fp );
+        result = upsampled;
+    }
 
-        slot.set(_output, downsampled);
-        cairo_surface_destroy(downsampled);
+    if (cropped) {
+        // the rest of the result is not needed, and left transparent
+        cairo_surface_t *full = ink_cairo_surface_create_similar(result, cairo_surface_get_content(result),
+            whole.width(), whole.height());
+        cairo_t *ct = cairo_create(full);
+        cairo_set_source_surface(ct, result, crop.left(), crop.top());
+        cairo_set_operator(ct, CAIRO_OPERATOR_SOURCE);
+        cairo_paint(ct);
+        cairo_destroy(ct);
+        cairo_surface_destroy(result);
+        cairo_surface_destroy(cropped);
+        result = full;
     }
+
+    set_cairo_surface_ci( result, ci_fp );
+
+    slot.set(_output, result);
+    cairo_surface_destroy(result);
 }
 
 void FilterGaussian::area_enlarge(Geom::IntRect &area, Geom::Affine const &trans)
@@ -23,10 +23,31 @@
 #include "display/nr-filter-units.h"
 #include "enums.h"
 #include <glibmm/fileutils.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace Inkscape {
 namespace Filters {
 
+namespace {
+
+/// The lock held while @a item is shown in a temporary drawing, one per referenced element.
+std::mutex &element_mutex(SPItem const *item)
+{
+    static std::mutex map_mutex;
+    static std::unordered_map<SPItem const *, std::unique_ptr<std::mutex>> mutexes;
+
+    std::lock_guard<std::mutex> lock(map_mutex);
+    auto &mutex = mutexes[item];
+    if (!mutex) {
+        mutex = std::make_unique<std::mutex>();
+    }
+    return *mutex;
+}
+
+} // namespace
+
 FilterImage::FilterImage()
     : SVGElem(nullptr)
     , document(nullptr)
@@ -92,6 +113,9 @@ void FilterImage::render_cairo(FilterSlot &slot)
         //       like the one for DrawingItems
         document->ensureUpToDate();
 
+        // Showing the element changes its list of views, so it is shown by one thread at a time.
+        std::lock_guard<std::mutex> lock(element_mutex(SVGElem));
+
         Drawing drawing;
         Geom::OptRect optarea = SVGElem->visualBounds();
         if (!optarea) return;
@@ -143,38 +167,42 @@ void FilterImage::render_cairo(FilterSlot &slot)
     }
 
     // External image, like <image>
-    if (!image && !broken_ref) {
-        std::cout << "  External image" << std::endl;
-        broken_ref = true;
-
-        /* TODO: If feImageHref is absolute, then use that (preferably handling the
-         * case that it's not a file URI).  Otherwise, go up the tree looking
-         * for an xml:base attribute, and use that as the base URI for resolving
-         * the relative feImageHref URI.  Otherwise, if document->base is valid,
-         * then use that as the base URI.  Otherwise, use feImageHref directly
-         * (i.e. interpreting it as relative to our current working directory).
-         * (See http://www.w3.org/TR/xmlbase/#resolution .) */
-        gchar *fullname = feImageHref;
-        if ( !g_file_test( fullname, G_FILE_TEST_EXISTS ) ) {
-            // Try to load from relative position combined with document base
-            if( document ) {
-                fullname = g_build_filename( document->getDocumentBase(), feImageHref, nullptr );
+    // The image is loaded once per primitive; afterwards it is only read.
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!image && !broken_ref) {
+            std::cout << "  External image" << std::endl;
+            broken_ref = true;
+
+            /* TODO: If feImageHref is absolute, then use that (preferably handling the
+             * case that it's not a file URI).  Otherwise, go up the tree looking
+             * for an xml:base attribute, and use that as the base URI for resolving
+             * the relative feImageHref URI.  Otherwise, if document->base is valid,
+             * then use that as the base URI.  Otherwise, use feImageHref directly
+             * (i.e. interpreting it as relative to our current working directory).
+             * (See http://www.w3.org/TR/xmlbase/#resolution .) */
+            gchar *fullname = feImageHref;
+            if ( !g_file_test( fullname, G_FILE_TEST_EXISTS ) ) {
+                // Try to load from relative position combined with document base
+                if( document ) {
+                    fullname = g_build_filename( document->getDocumentBase(), feImageHref, nullptr );
+                }
             }
-        }
-        if ( !g_file_test( fullname, G_FILE_TEST_EXISTS ) ) {
-            // Should display Broken Image png.
-            g_warning("FilterImage::render: Can not find: %s", feImageHref  );
-            return;
-        }
-        image = Inkscape::Pixbuf::create_from_file(fullname);
-        if( fullname != feImageHref ) g_free( fullname );
+            if ( !g_file_test( fullname, G_FILE_TEST_EXISTS ) ) {
+                // Should display Broken Image png.
+                g_warning("FilterImage::render: Can not find: %s", feImageHref  );
+                return;
+            }
+            image = Inkscape::Pixbuf::create_from_file(fullname);
+            if( fullname != feImageHref ) g_free( fullname );
 
-        if ( !image ) {
-            g_warning("FilterImage::render: failed to load image: %s", feImageHref);
-            return;
-        }
+            if ( !image ) {
+                g_warning("FilterImage::render: failed to load image: %s", feImageHref);
+                return;
+            }
 
-        broken_ref = false;
+            broken_ref = false;
+        }
     }
 
     if (broken_ref) {
@@ -13,6 +13,8 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <mutex>
+
 #include "display/nr-filter-primitive.h"
 
 class SPDocument;
@@ -33,6 +35,9 @@ public:
     void render_cairo(FilterSlot &slot) override;
     bool can_handle_affine(Geom::Affine const &) override;
     double complexity(Geom::Affine const &ctm) override;
+    std::vector<int> get_inputs() override { return {}; }
+    // rendered elements can change without the filter being rebuilt
+    bool can_cache() override { return !from_element; }
 
     void set_document( SPDocument *document );
     void set_href(char const *href);
@@ -49,6 +54,7 @@ private:
     Inkscape::Pixbuf *image;
     unsigned int aspect_align, aspect_clip;
     bool broken_ref;
+    std::mutex _mutex; ///< guards loading the image, which happens while rendering
 };
 
 } /* namespace Filters */
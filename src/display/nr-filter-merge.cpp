@@ -61,9 +61,7 @@ void FilterMerge::render_cairo(FilterSlot &slot)
     cairo_t *out_ct = cairo_create(out);
 
     for (int & i : _input_image) {
-        cairo_surface_t *in = slot.getcairo(i);
-
-        set_cairo_surface_ci( in, ci_fp );
+        cairo_surface_t *in = slot.getcairo(i, ci_fp);
         cairo_set_source_surface(out_ct, in, 0, 0);
         cairo_paint(out_ct);
     }
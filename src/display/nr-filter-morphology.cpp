@@ -16,8 +16,14 @@
 
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 #include <deque>
 #include <functional>
+#include <type_traits>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "display/cairo-templates.h"
 #include "display/cairo-utils.h"
 #include "display/nr-filter-morphology.h"
@@ -69,14 +75,8 @@ void morphologicalFilter1D(cairo_surface_t * const input, cairo_surface_t * cons
     int ri = round(radius); // TODO: Support fractional radii?
     int wi = 2*ri+1;
 
-    #if HAVE_OPENMP
     int limit = w * h;
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    int numOfThreads = prefs->getIntLimited("/options/threading/numthreads", omp_get_num_procs(), 1, 256);
-    (void) numOfThreads; // suppress unused variable warning
-    #pragma omp parallel for if(limit > OPENMP_THRESHOLD) num_threads(numOfThreads)
-    #endif // HAVE_OPENMP
-    for (int i = 0; i < h; ++i) {
+    Inkscape::dispatch_threshold(h, limit > PARALLEL_THRESHOLD, [&](int i, int) {
         // TODO: Store position and value in one 32 bit integer? 24 bits should be enough for a position, it would be quite strange to have an image with a width/height of more than 16 million(!).
         std::deque< std::pair<int,unsigned char> > vals[BPP]; // In my tests it was actually slightly faster to allocate it here than allocate it once for all threads and retrieving the correct set based on the thread id.
 
@@ -155,13 +155,179 @@ void morphologicalFilter1D(cairo_surface_t * const input, cairo_surface_t * cons
             }
             if (axis == Geom::Y) out_p += strideout - BPP;
         }
+    });
+
+    cairo_surface_mark_dirty(out);
+}
+
+#ifdef __SSE2__
+
+/* Same as morphologicalFilter1D(), which serves as the reference, using the algorithm due to:
+ * Marcel van Herk (1992), "A fast algorithm for local minimum and maximum filters on rectangular
+ * and octagonal kernels", and Joseph Gil, Michael Werman (1993), "Computing 2-D min, median, and
+ * max filters".
+ * The padded line is split into blocks as long as the window. Every window covers a suffix of
+ * one block and a prefix of the next, so with the running extremes of both taken in advance,
+ * each output takes three operations regardless of the radius.
+ * Several lines are processed at once, with all channels of their pixels side by side in one
+ * SSE2 vector. The buffers are allocated once for every thread.
+ */
+template <typename Comparison, Geom::Dim2 axis, int BPP>
+void morphologicalFilterVHGW(cairo_surface_t * const input, cairo_surface_t * const out, double radius) {
+    int const LINES = 16 / BPP; // lines processed at once
+    bool const dilate = std::is_same<Comparison, std::greater<unsigned char>>::value;
+
+    int w = cairo_image_surface_get_width(out);
+    int h = cairo_image_surface_get_height(out);
+    if (axis == Geom::Y) std::swap(w,h);
+
+    if (h < LINES) {
+        morphologicalFilter1D<Comparison, axis, BPP>(input, out, radius);
+        return;
+    }
+
+    int stridein = cairo_image_surface_get_stride(input);
+    int strideout = cairo_image_surface_get_stride(out);
+
+    unsigned char *in_data = cairo_image_surface_get_data(input);
+    unsigned char *out_data = cairo_image_surface_get_data(out);
+
+    // A window wider than the line covers all of it and the padding after it for every
+    // output, so larger radii give the same result.
+    int ri = std::min<int>(round(radius), w);
+    int wi = 2*ri+1;
+    int len = w + 2*ri; // length of the padded line
+
+    // Beyond the end of the line the image is transparent black, like in the reference.
+    // Before the start it has no effect.
+    __m128i const left_pad = _mm_set1_epi8(dilate ? 0 : -1);
+    __m128i const right_pad = _mm_setzero_si128();
+    auto extreme = [dilate] (__m128i a, __m128i b) {
+        return dilate ? _mm_max_epu8(a, b) : _mm_min_epu8(a, b);
+    };
+
+    // Pixel j of the lines starting at 'first'. Along the y axis the lines are adjacent
+    // columns, so their pixels are contiguous.
+    auto load = [&] (int first, int j) {
+        if (axis == Geom::Y) {
+            return _mm_loadu_si128(reinterpret_cast<__m128i const *>(in_data + j * stridein + first * BPP));
+        }
+        alignas(16) unsigned char px[16];
+        for (int l = 0; l < LINES; ++l) {
+            std::memcpy(px + l * BPP, in_data + (first + l) * stridein + j * BPP, BPP);
+        }
+        return _mm_load_si128(reinterpret_cast<__m128i const *>(px));
+    };
+    auto store = [&] (int first, int j, __m128i v) {
+        if (axis == Geom::Y) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out_data + j * strideout + first * BPP), v);
+            return;
+        }
+        alignas(16) unsigned char px[16];
+        _mm_store_si128(reinterpret_cast<__m128i *>(px), v);
+        for (int l = 0; l < LINES; ++l) {
+            std::memcpy(out_data + (first + l) * strideout + j * BPP, px + l * BPP, BPP);
+        }
+    };
+
+    auto pool = Inkscape::get_global_dispatch_pool();
+    std::vector<__m128i> buffers(std::size_t(pool->size()) * 2 * len);
+
+    // processes the lines from 'first' to first + LINES
+    auto process = [&] (int first, int thread) {
+        __m128i *prefix = buffers.data() + std::size_t(thread) * 2 * len;
+        __m128i *suffix = prefix + len;
+
+        for (int k = 0; k < len; ++k) {
+            int j = k - ri;
+            suffix[k] = j < 0 ? left_pad : j < w ? load(first, j) : right_pad;
+        }
+        for (int start = 0; start < len; start += wi) {
+            int end = std::min(start + wi, len);
+            prefix[start] = suffix[start];
+            for (int k = start + 1; k < end; ++k) {
+                prefix[k] = extreme(prefix[k - 1], suffix[k]);
+            }
+            for (int k = end - 2; k >= start; --k) {
+                suffix[k] = extreme(suffix[k], suffix[k + 1]);
+            }
+        }
+        for (int j = 0; j < w; ++j) {
+            store(first, j, extreme(suffix[j], prefix[j + 2*ri]));
+        }
+    };
+
+    int batches = h / LINES;
+    if (w * h > PARALLEL_THRESHOLD) {
+        pool->dispatch(batches, [&] (int batch, int thread) {
+            process(batch * LINES, thread);
+        });
+    } else {
+        for (int i = 0; i < batches; ++i) {
+            process(i * LINES, 0);
+        }
+    }
+    // The remaining lines are processed with the last lines before them, after the batches
+    // running in parallel are done, since they write these lines too.
+    if (h % LINES != 0) {
+        process(h - LINES, 0);
     }
 
     cairo_surface_mark_dirty(out);
 }
 
+#endif
+
+template <typename Comparison, Geom::Dim2 axis, int BPP>
+void morphologicalFilter(cairo_surface_t * const input, cairo_surface_t * const out, double radius) {
+#ifdef __SSE2__
+    morphologicalFilterVHGW<Comparison, axis, BPP>(input, out, radius);
+#else
+    morphologicalFilter1D<Comparison, axis, BPP>(input, out, radius);
+#endif
+}
+
+template <Geom::Dim2 axis, int BPP>
+void morphologyPass(cairo_surface_t *in, cairo_surface_t *out, FilterMorphologyOperator op,
+                    double radius, bool reference)
+{
+    if (op == MORPHOLOGY_OPERATOR_DILATE) {
+        if (reference) {
+            morphologicalFilter1D<std::greater<unsigned char>, axis, BPP>(in, out, radius);
+        } else {
+            morphologicalFilter<std::greater<unsigned char>, axis, BPP>(in, out, radius);
+        }
+    } else {
+        if (reference) {
+            morphologicalFilter1D<std::less<unsigned char>, axis, BPP>(in, out, radius);
+        } else {
+            morphologicalFilter<std::less<unsigned char>, axis, BPP>(in, out, radius);
+        }
+    }
+}
+
 } // end anonymous namespace
 
+void morphology_pass(cairo_surface_t *in, cairo_surface_t *out, FilterMorphologyOperator op,
+                     Geom::Dim2 axis, double radius, bool reference)
+{
+    cairo_surface_flush(in);
+    bool const alpha = cairo_image_surface_get_format(in) == CAIRO_FORMAT_A8;
+    if (axis == Geom::X) {
+        if (alpha) {
+            morphologyPass<Geom::X, 1>(in, out, op, radius, reference);
+        } else {
+            morphologyPass<Geom::X, 4>(in, out, op, radius, reference);
+        }
+    } else {
+        if (alpha) {
+            morphologyPass<Geom::Y, 1>(in, out, op, radius, reference);
+        } else {
+            morphologyPass<Geom::Y, 4>(in, out, op, radius, reference);
+        }
+    }
+}
+
 void FilterMorphology::render_cairo(FilterSlot &slot)
 {
     cairo_surface_t *input = slot.getcairo(_input);
@@ -179,42 +345,16 @@ void FilterMorphology::render_cairo(FilterSlot &slot)
     Geom::Affine p2pb = slot.get_units().get_matrix_primitiveunits2pb();
     double xr = fabs(xradius * p2pb.expansionX()) * device_scale;
     double yr = fabs(yradius * p2pb.expansionY()) * device_scale;
-    int bpp = cairo_image_surface_get_format(input) == CAIRO_FORMAT_A8 ? 1 : 4;
 
     cairo_surface_t *interm = ink_cairo_surface_create_identical(input);
-
-    if (Operator == MORPHOLOGY_OPERATOR_DILATE) {
-        if (bpp == 1) {
-            morphologicalFilter1D< std::greater<unsigned char>, Geom::X, 1 >(input, interm, xr);
-        } else {
-            morphologicalFilter1D< std::greater<unsigned char>, Geom::X, 4 >(input, interm, xr);
-        }
-    } else {
-        if (bpp == 1) {
-            morphologicalFilter1D< std::less<unsigned char>, Geom::X, 1 >(input, interm, xr);
-        } else {
-            morphologicalFilter1D< std::less<unsigned char>, Geom::X, 4 >(input, interm, xr);
-        }
-    }
+    morphology_pass(input, interm, Operator, Geom::X, xr);
 
     cairo_surface_t *out = ink_cairo_surface_create_identical(interm);
 
     // color_interpolation_filters for out same as input. See spec (DisplacementMap).
     copy_cairo_surface_ci(input, out);
 
-    if (Operator == MORPHOLOGY_OPERATOR_DILATE) {
-        if (bpp == 1) {
-            morphologicalFilter1D< std::greater<unsigned char>, Geom::Y, 1 >(interm, out, yr);
-        } else {
-            morphologicalFilter1D< std::greater<unsigned char>, Geom::Y, 4 >(interm, out, yr);
-        }
-    } else {
-        if (bpp == 1) {
-            morphologicalFilter1D< std::less<unsigned char>, Geom::Y, 1 >(interm, out, yr);
-        } else {
-            morphologicalFilter1D< std::less<unsigned char>, Geom::Y, 4 >(interm, out, yr);
-        }
-    }
+    morphology_pass(interm, out, Operator, Geom::Y, yr);
 
     cairo_surface_destroy(interm);
 
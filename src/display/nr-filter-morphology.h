@@ -15,6 +15,10 @@
 
 #include "display/nr-filter-primitive.h"
 
+extern "C" {
+typedef struct _cairo_surface cairo_surface_t;
+}
+
 namespace Inkscape {
 namespace Filters {
 
@@ -48,6 +52,14 @@ private:
     double yradius;
 };
 
+/**
+ * One pass of erosion or dilation along @a axis, with a radius in pixels, from the ARGB32 or A8
+ * image surface @a in to @a out, which has the same size and format. With @a reference, the
+ * simpler and slower algorithm is used, which the faster one must match.
+ */
+void morphology_pass(cairo_surface_t *in, cairo_surface_t *out, FilterMorphologyOperator op,
+                     Geom::Dim2 axis, double radius, bool reference = false);
+
 } /* namespace Filters */
 } /* namespace Inkscape */
 
@@ -47,6 +47,9 @@ void FilterOffset::render_cairo(FilterSlot &slot)
     double x = dx * p2pb.expansionX();
     double y = dy * p2pb.expansionY();
 
+    Geom::IntRect needed = slot.get_needed_area();
+    cairo_rectangle(ct, needed.left(), needed.top(), needed.width(), needed.height());
+    cairo_clip(ct);
     cairo_set_source_surface(ct, in, x, y);
     cairo_paint(ct);
     cairo_destroy(ct);
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Per-pixel computations of filter primitives, which can be chained in one pass.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/nr-filter-pointwise.h"
+
+#include <algorithm>
+#include <glib.h>
+
+#include "display/cairo-utils.h"
+#include "display/dispatch-pool.h"
+
+namespace Inkscape {
+namespace Filters {
+
+void FilterPixelChain::append(std::unique_ptr<FilterPixelOp> op, SPColorInterpolation ci,
+                              std::vector<int> sources)
+{
+    g_assert(sources.size() <= MAX_INPUTS);
+    g_assert(!_steps.empty()
+             || std::find(sources.begin(), sources.end(), PREVIOUS) == sources.end());
+    _steps.push_back({ std::move(op), ci, std::move(sources) });
+}
+
+/// Converts pixels between color spaces where set_cairo_surface_ci() would.
+static void convert_ci(guint32 *px, int n, SPColorInterpolation from, SPColorInterpolation to)
+{
+    auto const SRGB = SP_CSS_COLOR_INTERPOLATION_SRGB;
+    auto const LINEARRGB = SP_CSS_COLOR_INTERPOLATION_LINEARRGB;
+    if (from == SRGB && to == LINEARRGB) {
+        ink_pixels_srgb_to_linear(px, n);
+    } else if (from == LINEARRGB && to == SRGB) {
+        ink_pixels_linear_to_srgb(px, n);
+    }
+}
+
+cairo_surface_t *FilterPixelChain::render(std::vector<cairo_surface_t *> const &inputs) const
+{
+    // rows given to each thread at once
+    int const BAND = 32;
+    // pixels passed through all the steps at once, so that they stay in the cache
+    int const CHUNK = 256;
+
+    g_assert(!_steps.empty() && !inputs.empty());
+
+    for (auto input : inputs) {
+        cairo_surface_flush(input);
+    }
+
+    Step const &last = _steps.back();
+    bool const alpha_out = last.op->alpha_only();
+    cairo_surface_t *out = ink_cairo_surface_create_same_size(
+        inputs[0], alpha_out ? CAIRO_CONTENT_ALPHA : CAIRO_CONTENT_COLOR_ALPHA);
+    if (!alpha_out) {
+        set_cairo_surface_ci(out, last.ci);
+    }
+    cairo_surface_flush(out);
+
+    int const w = cairo_image_surface_get_width(out);
+    int const h = cairo_image_surface_get_height(out);
+    int const strideout = cairo_image_surface_get_stride(out);
+    unsigned char *const out_data = cairo_image_surface_get_data(out);
+
+    struct Input
+    {
+        unsigned char const *data;
+        int stride;
+        bool alpha_only;
+    };
+    std::vector<Input> in_data;
+    for (auto input : inputs) {
+        in_data.push_back({ cairo_image_surface_get_data(input),
+                            cairo_image_surface_get_stride(input),
+                            cairo_image_surface_get_format(input) == CAIRO_FORMAT_A8 });
+    }
+
+    // Each thread has two buffers for the results of the steps, and one for each alpha-only
+    // input, whose pixels are expanded to ARGB32.
+    std::size_t const thread_size = std::size_t(2 + inputs.size()) * CHUNK;
+    auto pool = Inkscape::get_global_dispatch_pool();
+    std::vector<guint32> buffers(thread_size * pool->size());
+
+    auto process = [&] (int band, int thread) {
+        guint32 *results[2] = { buffers.data() + thread * thread_size,
+                                buffers.data() + thread * thread_size + CHUNK };
+        std::vector<guint32 const *> rows(inputs.size());
+
+        int y_end = std::min(h, (band + 1) * BAND);
+        for (int y = band * BAND; y < y_end; ++y) {
+            guint32 *out_row = reinterpret_cast<guint32 *>(out_data + y * strideout);
+
+            for (int x = 0; x < w; x += CHUNK) {
+                int const n = std::min(CHUNK, w - x);
+
+                for (std::size_t i = 0; i < inputs.size(); ++i) {
+                    unsigned char const *row = in_data[i].data + y * in_data[i].stride;
+                    if (in_data[i].alpha_only) {
+                        guint32 *expanded = results[0] + (2 + i) * CHUNK;
+                        for (int k = 0; k < n; ++k) {
+                            expanded[k] = guint32(row[x + k]) << 24;
+                        }
+                        rows[i] = expanded;
+                    } else {
+                        rows[i] = reinterpret_cast<guint32 const *>(row) + x;
+                    }
+                }
+
+                guint32 *result = nullptr;
+                bool result_alpha = false;
+                SPColorInterpolation result_ci = SP_CSS_COLOR_INTERPOLATION_AUTO;
+                for (auto const &step : _steps) {
+                    if (result && !result_alpha) {
+                        convert_ci(result, n, result_ci, step.ci);
+                    }
+
+                    guint32 const *in[MAX_INPUTS];
+                    for (std::size_t k = 0; k < step.sources.size(); ++k) {
+                        in[k] = step.sources[k] == PREVIOUS ? result : rows[step.sources[k]];
+                    }
+
+                    guint32 *dst = result == results[0] ? results[1] : results[0];
+                    if (&step == &last && !alpha_out) {
+                        dst = out_row + x;
+                    }
+                    step.op->apply(in, dst, n);
+
+                    result = dst;
+                    result_alpha = step.op->alpha_only();
+                    result_ci = step.ci;
+                    if (result_alpha) {
+                        // the value stored in an alpha-only surface
+                        for (int k = 0; k < n; ++k) {
+                            result[k] &= 0xff000000;
+                        }
+                    }
+                }
+
+                if (alpha_out) {
+                    unsigned char *out_px = out_data + y * strideout + x;
+                    for (int k = 0; k < n; ++k) {
+                        out_px[k] = result[k] >> 24;
+                    }
+                }
+            }
+        }
+    };
+
+    int bands = (h + BAND - 1) / BAND;
+    if (w * h > PARALLEL_THRESHOLD) {
+        pool->dispatch(bands, process);
+    } else {
+        for (int i = 0; i < bands; ++i) {
+            process(i, 0);
+        }
+    }
+    cairo_surface_mark_dirty(out);
+    return out;
+}
+
+} /* namespace Filters */
+} /* namespace Inkscape */
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
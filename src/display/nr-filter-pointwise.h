@@ -0,0 +1,144 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Per-pixel computations of filter primitives, which can be chained in one pass.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_NR_FILTER_POINTWISE_H
+#define SEEN_NR_FILTER_POINTWISE_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include <cairo.h>
+
+#include "display/cairo-templates.h"
+#include "style-enums.h"
+
+namespace Inkscape {
+namespace Filters {
+
+/**
+ * The computation of a filter primitive whose result at each pixel only depends on the same
+ * pixel of its inputs. Pixels are premultiplied ARGB32; the pixels of alpha-only surfaces
+ * have their value in the alpha byte and zero color bytes, as with ink_cairo_surface_filter().
+ */
+class FilterPixelOp
+{
+public:
+    explicit FilterPixelOp(bool alpha_only) : _alpha_only(alpha_only) {}
+    virtual ~FilterPixelOp() = default;
+
+    /// Computes n pixels of the result from the pixels of the inputs, given in the order
+    /// of FilterPrimitive::get_inputs(). The output does not overlap the inputs.
+    virtual void apply(guint32 const *const *in, guint32 *out, int n) = 0;
+
+    /// Whether the primitive stores its result in an alpha-only surface.
+    bool alpha_only() const { return _alpha_only; }
+
+private:
+    bool _alpha_only;
+};
+
+/// A functor used with ink_cairo_surface_filter(), as a FilterPixelOp.
+template <typename Filter>
+class FilterPixelFilter : public FilterPixelOp
+{
+public:
+    FilterPixelFilter(Filter filter, bool alpha_only)
+        : FilterPixelOp(alpha_only)
+        , _filter(std::move(filter))
+    {}
+    void apply(guint32 const *const *in, guint32 *out, int n) override {
+        ink_filter_span(_filter, in[0], out, n);
+    }
+
+private:
+    Filter _filter;
+};
+
+/// A functor used with ink_cairo_surface_blend(), as a FilterPixelOp.
+template <typename Blend>
+class FilterPixelBlend : public FilterPixelOp
+{
+public:
+    FilterPixelBlend(Blend blend, bool alpha_only)
+        : FilterPixelOp(alpha_only)
+        , _blend(std::move(blend))
+    {}
+    void apply(guint32 const *const *in, guint32 *out, int n) override {
+        ink_blend_span(_blend, in[0], in[1], out, n);
+    }
+
+private:
+    Blend _blend;
+};
+
+template <typename Filter>
+std::unique_ptr<FilterPixelOp> make_pixel_filter(Filter filter, bool alpha_only = false)
+{
+    return std::make_unique<FilterPixelFilter<Filter>>(std::move(filter), alpha_only);
+}
+
+template <typename Blend>
+std::unique_ptr<FilterPixelOp> make_pixel_blend(Blend blend, bool alpha_only = false)
+{
+    return std::make_unique<FilterPixelBlend<Blend>>(std::move(blend), alpha_only);
+}
+
+/**
+ * A run of filter primitives, each reading the result of the one before it, rendered in one
+ * pass over the image without storing the intermediate results.
+ */
+class FilterPixelChain
+{
+public:
+    /// Source of an input which is the result of the previous step.
+    static constexpr int PREVIOUS = -1;
+    /// Largest number of inputs of a step.
+    static constexpr std::size_t MAX_INPUTS = 4;
+
+    /**
+     * Appends a step computed by @a op in the color space @a ci. @a sources gives the inputs
+     * of the step: PREVIOUS, or an index into the surfaces passed to render().
+     */
+    void append(std::unique_ptr<FilterPixelOp> op, SPColorInterpolation ci,
+                std::vector<int> sources);
+
+    std::size_t size() const { return _steps.size(); }
+
+    /**
+     * Renders the result of the last step into a new surface. The inputs must be image
+     * surfaces of the same size, already in the color space of the steps reading them.
+     * The intermediate results are converted between color spaces like set_cairo_surface_ci()
+     * would convert them.
+     */
+    cairo_surface_t *render(std::vector<cairo_surface_t *> const &inputs) const;
+
+private:
+    struct Step
+    {
+        std::unique_ptr<FilterPixelOp> op;
+        SPColorInterpolation ci;
+        std::vector<int> sources;
+    };
+    std::vector<Step> _steps;
+};
+
+} /* namespace Filters */
+} /* namespace Inkscape */
+
+#endif /* SEEN_NR_FILTER_POINTWISE_H */
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
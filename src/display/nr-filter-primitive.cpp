@@ -68,6 +68,14 @@ void FilterPrimitive::area_enlarge(Geom::IntRect &/*area*/, Geom::Affine const &
     // This doesn't need to do anything by default
 }
 
+SPColorInterpolation FilterPrimitive::get_color_interpolation() const
+{
+    if (!_style) {
+        return SP_CSS_COLOR_INTERPOLATION_AUTO;
+    }
+    return (SPColorInterpolation)_style->color_interpolation_filters.computed;
+}
+
 void FilterPrimitive::set_input(int slot) {
     set_input(0, slot);
 }
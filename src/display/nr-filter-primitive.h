@@ -14,10 +14,13 @@
 
 #include <2geom/forward.h>
 #include <2geom/rect.h>
+#include <memory>
+#include <vector>
 
 #include <glibmm/ustring.h>
 
 #include "display/nr-filter-types.h"
+#include "style-enums.h"
 #include "svg/svg-length.h"
 
 class SPStyle;
@@ -25,6 +28,7 @@ class SPStyle;
 namespace Inkscape {
 namespace Filters {
 
+class FilterPixelOp;
 class FilterSlot;
 class FilterUnits;
 
@@ -35,8 +39,44 @@ public:
 
     virtual void render_cairo(FilterSlot &slot);
     virtual int render(FilterSlot & /*slot*/, FilterUnits const & /*units*/) { return 0; } // pure virtual?
+
+    /**
+     * Enlarges an area of the result of this primitive to the area of its inputs
+     * needed to render it, in pixels. @a m is the transform from user space to pixels.
+     */
     virtual void area_enlarge(Geom::IntRect &area, Geom::Affine const &m);
 
+    /**
+     * Returns the slots whose contents are used to render this primitive.
+     * NR_FILTER_SLOT_NOT_SET stands for the result of the previous primitive.
+     */
+    virtual std::vector<int> get_inputs() { return { _input }; }
+
+    /**
+     * Returns whether the result only depends on the inputs, the parameters of this primitive
+     * and the filter units, so that it can be reused as long as these do not change.
+     */
+    virtual bool can_cache() { return true; }
+
+    /// Returns the slot the result is written to, or NR_FILTER_SLOT_NOT_SET for an unnamed slot.
+    int get_output() const { return _output; }
+
+    /**
+     * Returns the computation of this primitive as a function of single pixels of its inputs,
+     * if it has one, so that chains of such primitives can be rendered in one pass (see
+     * Filter::render()). @a alpha_inputs tells which inputs are alpha-only surfaces.
+     * Changes to the slot that render_cairo() makes besides setting the result, such as
+     * setting the primitive area, are made here instead.
+     */
+    virtual std::unique_ptr<FilterPixelOp> pixel_op(FilterSlot & /*slot*/,
+                                                    std::vector<bool> const & /*alpha_inputs*/)
+    {
+        return nullptr;
+    }
+
+    /// Returns the color space the primitive works in, from color-interpolation-filters.
+    SPColorInterpolation get_color_interpolation() const;
+
     /**
      * Sets the input slot number 'slot' to be used as input in rendering
      * filter primitive 'primitive'
@@ -22,6 +22,7 @@
 #include "display/nr-filter-gaussian.h"
 #include "display/nr-filter-slot.h"
 #include "display/nr-filter-units.h"
+#include "display/surface-pool.h"
 
 namespace Inkscape {
 namespace Filters {
@@ -62,6 +63,9 @@ FilterSlot::~FilterSlot()
     for (auto & _slot : _slots) {
         cairo_surface_destroy(_slot.second);
     }
+    for (auto &converted : _converted) {
+        cairo_surface_destroy(converted.second);
+    }
 }
 
 cairo_surface_t *FilterSlot::getcairo(int slot_nr)
@@ -118,7 +122,7 @@ cairo_surface_t *FilterSlot::getcairo(int slot_nr)
 
     if (s == _slots.end()) {
         // create empty surface
-        cairo_surface_t *empty = cairo_surface_create_similar(
+        cairo_surface_t *empty = ink_cairo_surface_create_similar(
             _source_graphic, cairo_surface_get_content(_source_graphic),
             _slot_w, _slot_h);
         _set_internal(slot_nr, empty);
@@ -128,6 +132,40 @@ cairo_surface_t *FilterSlot::getcairo(int slot_nr)
     return s->second;
 }
 
+cairo_surface_t *FilterSlot::getcairo(int slot_nr, SPColorInterpolation ci)
+{
+    if (slot_nr == NR_FILTER_SLOT_NOT_SET)
+        slot_nr = _last_out;
+
+    cairo_surface_t *s = getcairo(slot_nr);
+    if (cairo_surface_get_content(s) == CAIRO_CONTENT_ALPHA) {
+        return s;
+    }
+
+    SPColorInterpolation const ci_in = get_cairo_surface_ci(s);
+    bool const convert =
+        (ci_in == SP_CSS_COLOR_INTERPOLATION_SRGB && ci == SP_CSS_COLOR_INTERPOLATION_LINEARRGB) ||
+        (ci_in == SP_CSS_COLOR_INTERPOLATION_LINEARRGB && ci == SP_CSS_COLOR_INTERPOLATION_SRGB);
+    if (!convert) {
+        // only changes the tag
+        set_cairo_surface_ci(s, ci);
+        return s;
+    }
+
+    SlotMap::iterator c = _converted.find(slot_nr);
+    if (c != _converted.end() && get_cairo_surface_ci(c->second) != ci) {
+        cairo_surface_destroy(c->second);
+        _converted.erase(c);
+        c = _converted.end();
+    }
+    if (c == _converted.end()) {
+        cairo_surface_t *copy = ink_cairo_surface_copy(s);
+        set_cairo_surface_ci(copy, ci);
+        c = _converted.emplace(slot_nr, copy).first;
+    }
+    return c->second;
+}
+
 cairo_surface_t *FilterSlot::_get_transformed_source_graphic()
 {
     Geom::Affine trans = _units.get_matrix_display2pb();
@@ -137,7 +175,7 @@ cairo_surface_t *FilterSlot::_get_transformed_source_graphic()
         return _source_graphic;
     }
 
-    cairo_surface_t *tsg = cairo_surface_create_similar(
+    cairo_surface_t *tsg = ink_cairo_surface_create_similar(
         _source_graphic, cairo_surface_get_content(_source_graphic),
         _slot_w, _slot_h);
     cairo_t *tsg_ct = cairo_create(tsg);
@@ -161,7 +199,7 @@ cairo_surface_t *FilterSlot::_get_transformed_background()
 
     if (_background_ct) {
         cairo_surface_t *bg = cairo_get_group_target(_background_ct);
-        tbg = cairo_surface_create_similar(
+        tbg = ink_cairo_surface_create_similar(
             bg, cairo_surface_get_content(bg),
             _slot_w, _slot_h);
         cairo_t *tbg_ct = cairo_create(tbg);
@@ -174,7 +212,7 @@ cairo_surface_t *FilterSlot::_get_transformed_background()
         cairo_paint(tbg_ct);
         cairo_destroy(tbg_ct);
     } else {
-        tbg = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, _slot_w, _slot_h);
+        tbg = Inkscape::SurfacePool::get().create(CAIRO_FORMAT_ARGB32, _slot_w, _slot_h);
     }
 
     return tbg;
@@ -190,7 +228,7 @@ cairo_surface_t *FilterSlot::get_result(int res)
         return result;
     }
 
-    cairo_surface_t *r = cairo_surface_create_similar(_source_graphic,
+    cairo_surface_t *r = ink_cairo_surface_create_similar(_source_graphic,
         cairo_surface_get_content(_source_graphic),
         _source_graphic_area.width(),
         _source_graphic_area.height());
@@ -218,6 +256,11 @@ void FilterSlot::_set_internal(int slot_nr, cairo_surface_t *surface)
     if (s != _slots.end()) {
         cairo_surface_destroy(s->second);
     }
+    SlotMap::iterator c = _converted.find(slot_nr);
+    if (c != _converted.end()) {
+        cairo_surface_destroy(c->second);
+        _converted.erase(c);
+    }
 
     _slots[slot_nr] = surface;
 }
@@ -286,6 +329,20 @@ Geom::Rect FilterSlot::get_slot_area() const {
     return r;
 }
 
+void FilterSlot::set_needed_area(Geom::OptIntRect const &area) {
+    _needed_area = area;
+}
+
+Geom::IntRect FilterSlot::get_needed_area() const {
+    Geom::IntRect const slot(0, 0, _slot_w, _slot_h);
+    // Slot pixels only correspond to display pixels when the slots are not transformed.
+    if (!_needed_area || !_units.get_matrix_display2pb().isTranslation()) {
+        return slot;
+    }
+    Geom::OptIntRect needed = Geom::intersect(*_needed_area - _source_graphic_area.min(), slot);
+    return needed ? *needed : slot;
+}
+
 } /* namespace Filters */
 } /* namespace Inkscape */
 
@@ -18,6 +18,7 @@
 #include <map>
 #include "display/nr-filter-types.h"
 #include "display/nr-filter-units.h"
+#include "style-enums.h"
 
 extern "C" {
 typedef struct _cairo cairo_t;
@@ -47,6 +48,16 @@ public:
      */
     cairo_surface_t *getcairo(int slot);
 
+    /** Returns the pixblock in specified slot, in the color space @a ci.
+     * When its pixels need to be converted, the pixblock in the slot is left as it is
+     * and a converted copy is returned, which is kept until the slot is set again.
+     * This way each result is converted at most once, and never converted back
+     * and forth between sRGB and linearRGB, which would lose precision.
+     * The pixblocks still have 8 bits per component, so a single conversion of dark
+     * sRGB colors to linearRGB merges some of their levels.
+     */
+    cairo_surface_t *getcairo(int slot, SPColorInterpolation ci);
+
     /** Sets or re-sets the pixblock associated with given slot.
      * If there was a pixblock already assigned with this slot,
      * that pixblock is destroyed.
@@ -82,9 +93,19 @@ public:
     FilterUnits const &get_units() const { return _units; }
     Geom::Rect get_slot_area() const;
 
+    /** Sets the area of the result of the next primitive which is needed, in display
+     * coordinates. An empty area means that all of it is needed. */
+    void set_needed_area(Geom::OptIntRect const &area);
+
+    /** Returns the needed area of the result of the primitive being rendered, in the
+     * coordinates of the slot surfaces without the device scale. Primitives may leave
+     * the rest of their result undefined. */
+    Geom::IntRect get_needed_area() const;
+
 private:
     typedef std::map<int, cairo_surface_t *> SlotMap;
     SlotMap _slots;
+    SlotMap _converted; ///< slot contents converted to the other color space
 
     // We need to keep track of the primitive area as this is needed in feTile
     typedef std::map<int, Geom::Rect> PrimitiveAreaMap;
@@ -101,6 +122,7 @@ private:
     cairo_t *_background_ct;
     Geom::IntRect _source_graphic_area;
     Geom::IntRect _background_area; ///< needed to extract background
+    Geom::OptIntRect _needed_area;
     FilterUnits const &_units;
     int _last_out;
     FilterQuality filterquality;
@@ -71,8 +71,8 @@ void FilterTile::render_cairo(FilterSlot &slot)
         Geom::Point shift = sa.min() - tt.min(); 
 
         // Create feTile tile surface
-        cairo_surface_t *tile = cairo_surface_create_similar(in, cairo_surface_get_content(in),
-                                                             tt.width(), tt.height());
+        cairo_surface_t *tile = ink_cairo_surface_create_similar(in, cairo_surface_get_content(in),
+                                                                 tt.width(), tt.height());
         cairo_t *ct_tile = cairo_create(tile);
         cairo_set_source_surface(ct_tile, in, shift[Geom::X], shift[Geom::Y]);
         cairo_paint(ct_tile);
@@ -21,10 +21,18 @@
 #include "display/cairo-templates.h"
 #include "display/cairo-utils.h"
 #include "display/nr-filter.h"
+#include "display/nr-filter-channels.h"
 #include "display/nr-filter-turbulence.h"
 #include "display/nr-filter-units.h"
 #include "display/nr-filter-utils.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <list>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <vector>
 
 namespace Inkscape {
 namespace Filters{
@@ -65,15 +73,16 @@ public:
             for (i = 0; i < BSize; ++i) {
                 _latticeSelector[i] = i;
 
+                double gx, gy;
                 do {
-                  _gradient[i][k][0] = static_cast<double>(_random() % (BSize*2) - BSize) / BSize;
-                  _gradient[i][k][1] = static_cast<double>(_random() % (BSize*2) - BSize) / BSize;
-                } while(_gradient[i][k][0] == 0 && _gradient[i][k][1] == 0);
+                  gx = static_cast<double>(_random() % (BSize*2) - BSize) / BSize;
+                  gy = static_cast<double>(_random() % (BSize*2) - BSize) / BSize;
+                } while(gx == 0 && gy == 0);
 
                 // normalize gradient
-                double s = hypot(_gradient[i][k][0], _gradient[i][k][1]);
-                _gradient[i][k][0] /= s;
-                _gradient[i][k][1] /= s;
+                double s = hypot(gx, gy);
+                _gradient[i][0][k] = gx / s;
+                _gradient[i][1][k] = gy / s;
             }
         }
         while (--i) {
@@ -88,8 +97,8 @@ public:
             _latticeSelector[BSize + i] = _latticeSelector[i];
 
             for(int k = 0; k < 4; ++k) {
-                _gradient[BSize + i][k][0] = _gradient[i][k][0];
-                _gradient[BSize + i][k][1] = _gradient[i][k][1];
+                _gradient[BSize + i][0][k] = _gradient[i][0][k];
+                _gradient[BSize + i][1][k] = _gradient[i][1][k];
             }
         }
 
@@ -119,28 +128,32 @@ public:
         _inited = true;
     }
 
+    /**
+     * The lattice position is computed in double precision, since the coordinates grow
+     * large at higher octaves. The noise itself is computed in single precision, for all
+     * four channels at once.
+     */
     G_GNUC_PURE
     guint32 turbulencePixel(Geom::Point const &p) const {
         int wrapx = _wrapx, wrapy = _wrapy, wrapw = _wrapw, wraph = _wraph;
 
-        double pixel[4];
         double x = p[Geom::X] * _baseFreq[Geom::X];
         double y = p[Geom::Y] * _baseFreq[Geom::Y];
-        double ratio = 1.0;
+        float ratio = 1.0f;
 
-        for (double & k : pixel)
-            k = 0.0;
+        // channel numbering: R=0, G=1, B=2, A=3
+        Channels pixel = Channels::set1(0.0f);
 
         for(int octave = 0; octave < _octaves; ++octave)
         {
             double tx = x + PerlinOffset;
             double bx = floor(tx);
-            double rx0 = tx - bx, rx1 = rx0 - 1.0;
+            float rx0 = tx - bx, rx1 = rx0 - 1.0f;
             int bx0 = bx, bx1 = bx0 + 1;
 
             double ty = y + PerlinOffset;
             double by = floor(ty);
-            double ry0 = ty - by, ry1 = ry0 - 1.0;
+            float ry0 = ty - by, ry1 = ry0 - 1.0f;
             int by0 = by, by1 = by0 + 1;
 
             if (_stitchTiles) {
@@ -161,30 +174,19 @@ public:
             int b10 = _latticeSelector[j + by0];
             int b11 = _latticeSelector[j + by1];
 
-            double sx = _scurve(rx0);
-            double sy = _scurve(ry0);
-
-            double result[4];
-            // channel numbering: R=0, G=1, B=2, A=3
-            for (int k = 0; k < 4; ++k) {
-                double const *qxa = _gradient[b00][k];
-                double const *qxb = _gradient[b10][k];
-                double a = _lerp(sx, rx0 * qxa[0] + ry0 * qxa[1],
-                                     rx1 * qxb[0] + ry0 * qxb[1]);
-                double const *qya = _gradient[b01][k];
-                double const *qyb = _gradient[b11][k];
-                double b = _lerp(sx, rx0 * qya[0] + ry1 * qya[1],
-                                     rx1 * qyb[0] + ry1 * qyb[1]);
-                result[k] = _lerp(sy, a, b);
-            }
+            Channels sx = Channels::set1(_scurve(rx0));
+            Channels sy = Channels::set1(_scurve(ry0));
+            Channels vrx0 = Channels::set1(rx0), vrx1 = Channels::set1(rx1);
+            Channels vry0 = Channels::set1(ry0), vry1 = Channels::set1(ry1);
+
+            Channels a = _lerp(sx, _dot(b00, vrx0, vry0), _dot(b10, vrx1, vry0));
+            Channels b = _lerp(sx, _dot(b01, vrx0, vry1), _dot(b11, vrx1, vry1));
+            Channels result = _lerp(sy, a, b);
 
-            if (_fractalnoise) {
-                for (int k = 0; k < 4; ++k)
-                    pixel[k] += result[k] / ratio;
-            } else {
-                for (int k = 0; k < 4; ++k)
-                    pixel[k] += fabs(result[k]) / ratio;
+            if (!_fractalnoise) {
+                result = Channels::abs(result);
             }
+            pixel = pixel + result * Channels::set1(1.0f / ratio);
 
             x *= 2;
             y *= 2;
@@ -201,27 +203,21 @@ public:
             }
         }
 
+        float c[4];
         if (_fractalnoise) {
-            guint32 r = CLAMP_D_TO_U8((pixel[0]*255.0 + 255.0) / 2);
-            guint32 g = CLAMP_D_TO_U8((pixel[1]*255.0 + 255.0) / 2);
-            guint32 b = CLAMP_D_TO_U8((pixel[2]*255.0 + 255.0) / 2);
-            guint32 a = CLAMP_D_TO_U8((pixel[3]*255.0 + 255.0) / 2);
-            r = premul_alpha(r, a);
-            g = premul_alpha(g, a);
-            b = premul_alpha(b, a);
-            ASSEMBLE_ARGB32(pxout, a,r,g,b);
-            return pxout;
+            (pixel * Channels::set1(127.5f) + Channels::set1(127.5f)).store(c);
         } else {
-            guint32 r = CLAMP_D_TO_U8(pixel[0]*255.0);
-            guint32 g = CLAMP_D_TO_U8(pixel[1]*255.0);
-            guint32 b = CLAMP_D_TO_U8(pixel[2]*255.0);
-            guint32 a = CLAMP_D_TO_U8(pixel[3]*255.0);
-            r = premul_alpha(r, a);
-            g = premul_alpha(g, a);
-            b = premul_alpha(b, a);
-            ASSEMBLE_ARGB32(pxout, a,r,g,b);
-            return pxout;
+            (pixel * Channels::set1(255.0f)).store(c);
         }
+        guint32 r = CLAMP_D_TO_U8(c[0]);
+        guint32 g = CLAMP_D_TO_U8(c[1]);
+        guint32 b = CLAMP_D_TO_U8(c[2]);
+        guint32 a = CLAMP_D_TO_U8(c[3]);
+        r = premul_alpha(r, a);
+        g = premul_alpha(g, a);
+        b = premul_alpha(b, a);
+        ASSEMBLE_ARGB32(pxout, a,r,g,b);
+        return pxout;
     }
 
     //G_GNUC_PURE
@@ -269,12 +265,16 @@ private:
         if (_seed <= 0) _seed += RAND_m;
         return _seed;
     }
-    static inline double _scurve(double t) {
-        return t * t * (3.0 - 2.0*t);
+    static inline float _scurve(float t) {
+        return t * t * (3.0f - 2.0f*t);
     }
-    static inline double _lerp(double t, double a, double b) {
+    static inline Channels _lerp(Channels t, Channels a, Channels b) {
         return a + t * (b-a);
     }
+    /// Dot product of the gradients at a lattice point with the offset from it.
+    inline Channels _dot(int point, Channels rx, Channels ry) const {
+        return rx * Channels::load(_gradient[point][0]) + ry * Channels::load(_gradient[point][1]);
+    }
 
     // random number generator constants
     static long const
@@ -292,7 +292,7 @@ private:
     Geom::Rect _tile;
     Geom::Point _baseFreq;
     int _latticeSelector[2*BSize + 2];
-    double _gradient[2*BSize + 2][4][2];
+    float _gradient[2*BSize + 2][2][4]; ///< x and y components for each channel
     long _seed;
     int _octaves;
     bool _stitchTiles;
@@ -357,23 +357,119 @@ void FilterTurbulence::set_updated(bool /*u*/)
 {
 }
 
-struct Turbulence {
-    Turbulence(TurbulenceGenerator const &gen, Geom::Affine const &trans, int x0, int y0)
-        : _gen(gen)
-        , _trans(trans)
-        , _x0(x0), _y0(y0)
-    {}
-    guint32 operator()(int x, int y) {
-        Geom::Point point(x + _x0, y + _y0);
-        point *= _trans;
-        return _gen.turbulencePixel(point);
+/**
+ * Tiles of rendered noise, shared by all turbulence primitives. Documents often use the
+ * same texture filter on many objects, which then render the same noise. Tiles are
+ * aligned to the pixel grid of the filter slots and are dropped least recently used
+ * first when the cache grows too large.
+ */
+class NoiseTileCache
+{
+public:
+    static int const TILE_SIZE = 64;
+
+    /// Generator parameters, transform from pixels to primitive units, and tile position.
+    using Key = std::array<double, 18>;
+    using Tile = std::vector<guint32>;
+
+    static NoiseTileCache &get()
+    {
+        static NoiseTileCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<Tile const> find(Key const &key)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _index.find(key);
+        if (it == _index.end()) {
+            return nullptr;
+        }
+        _tiles.splice(_tiles.begin(), _tiles, it->second);
+        return it->second->second;
+    }
+
+    void insert(Key const &key, std::shared_ptr<Tile const> tile)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_index.count(key)) {
+            return;
+        }
+        _tiles.emplace_front(key, std::move(tile));
+        _index[key] = _tiles.begin();
+        while (_tiles.size() > MAX_TILES) {
+            _index.erase(_tiles.back().first);
+            _tiles.pop_back();
+        }
     }
+
 private:
-    TurbulenceGenerator const &_gen;
-    Geom::Affine _trans;
-    int _x0, _y0;
+    /// 32 MiB of tiles
+    static std::size_t const MAX_TILES = (32 << 20) / (TILE_SIZE * TILE_SIZE * 4);
+
+    using Entry = std::pair<Key, std::shared_ptr<Tile const>>;
+
+    std::mutex _mutex;
+    std::list<Entry> _tiles; ///< most recently used first
+    std::map<Key, std::list<Entry>::iterator> _index;
 };
 
+static int floor_div(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * Fills @a surface with noise, where the pixel at (x, y) shows the noise at
+ * (x + x0, y + y0) * trans. The noise is taken from the tile cache where possible.
+ */
+static void render_noise(cairo_surface_t *surface, TurbulenceGenerator const &gen,
+                         Geom::Affine const &trans, int x0, int y0, NoiseTileCache::Key key)
+{
+    int const T = NoiseTileCache::TILE_SIZE;
+
+    cairo_surface_flush(surface);
+    int w = cairo_image_surface_get_width(surface);
+    int h = cairo_image_surface_get_height(surface);
+    int stride = cairo_image_surface_get_stride(surface) / 4;
+    guint32 *data = reinterpret_cast<guint32*>(cairo_image_surface_get_data(surface));
+
+    int tx0 = floor_div(x0, T), tx1 = floor_div(x0 + w - 1, T);
+    int ty0 = floor_div(y0, T), ty1 = floor_div(y0 + h - 1, T);
+    int ntx = tx1 - tx0 + 1;
+    int nty = ty1 - ty0 + 1;
+
+    auto &cache = NoiseTileCache::get();
+    Inkscape::dispatch_threshold(ntx * nty, w * h > PARALLEL_THRESHOLD, [&](int i, int) {
+        int tx = (tx0 + i % ntx) * T;
+        int ty = (ty0 + i / ntx) * T;
+        NoiseTileCache::Key tile_key = key;
+        tile_key[16] = tx;
+        tile_key[17] = ty;
+
+        auto tile = cache.find(tile_key);
+        if (!tile) {
+            auto rendered = std::make_shared<NoiseTileCache::Tile>(T * T);
+            for (int y = 0; y < T; ++y) {
+                for (int x = 0; x < T; ++x) {
+                    (*rendered)[y * T + x] = gen.turbulencePixel(Geom::Point(tx + x, ty + y) * trans);
+                }
+            }
+            cache.insert(tile_key, rendered);
+            tile = std::move(rendered);
+        }
+
+        int left = std::max(tx, x0), right = std::min(tx + T, x0 + w);
+        int top = std::max(ty, y0), bottom = std::min(ty + T, y0 + h);
+        for (int y = top; y < bottom; ++y) {
+            guint32 const *row = tile->data() + (y - ty) * T;
+            std::copy(row + left - tx, row + right - tx, data + (y - y0) * stride + left - x0);
+        }
+    });
+
+    cairo_surface_mark_dirty(surface);
+}
+
 void FilterTurbulence::render_cairo(FilterSlot &slot)
 {
     cairo_surface_t *input = slot.getcairo(_input);
@@ -389,7 +485,7 @@ void FilterTurbulence::render_cairo(FilterSlot &slot)
     cairo_surface_get_device_scale(input, &x_scale, &y_scale);
     int width  = ceil(cairo_image_surface_get_width( input)/x_scale/x_scale);
     int height = ceil(cairo_image_surface_get_height(input)/y_scale/y_scale);
-    cairo_surface_t *temp = cairo_surface_create_similar (input, CAIRO_CONTENT_COLOR_ALPHA, width, height);
+    cairo_surface_t *temp = ink_cairo_surface_create_similar(input, CAIRO_CONTENT_COLOR_ALPHA, width, height);
     cairo_surface_set_device_scale( temp, 1, 1 );
 
     // color_interpolation_filter is determined by CSS value (see spec. Turbulence).
@@ -397,19 +493,32 @@ void FilterTurbulence::render_cairo(FilterSlot &slot)
         set_cairo_surface_ci(out, (SPColorInterpolation)_style->color_interpolation_filters.computed );
     }
 
-    if (!gen->ready()) {
-        Geom::Point ta(fTileX, fTileY);
-        Geom::Point tb(fTileX + fTileWidth, fTileY + fTileHeight);
-        gen->init(seed, Geom::Rect(ta, tb),
-            Geom::Point(XbaseFrequency, YbaseFrequency), stitchTiles,
-            type == TURBULENCE_FRACTALNOISE, numOctaves);
+    {
+        // The generator may be initialized from several render threads at once.
+        static std::mutex init_mutex;
+        std::lock_guard<std::mutex> lock(init_mutex);
+        if (!gen->ready()) {
+            Geom::Point ta(fTileX, fTileY);
+            Geom::Point tb(fTileX + fTileWidth, fTileY + fTileHeight);
+            gen->init(seed, Geom::Rect(ta, tb),
+                Geom::Point(XbaseFrequency, YbaseFrequency), stitchTiles,
+                type == TURBULENCE_FRACTALNOISE, numOctaves);
+        }
     }
 
     Geom::Affine unit_trans = slot.get_units().get_matrix_primitiveunits2pb().inverse();
     Geom::Rect slot_area = slot.get_slot_area();
-    double x0 = slot_area.min()[Geom::X];
-    double y0 = slot_area.min()[Geom::Y];
-    ink_cairo_surface_synthesize(temp, Turbulence(*gen, unit_trans, x0, y0));
+    int x0 = slot_area.min()[Geom::X];
+    int y0 = slot_area.min()[Geom::Y];
+
+    NoiseTileCache::Key key = {
+        seed, XbaseFrequency, YbaseFrequency, double(numOctaves),
+        double(stitchTiles), double(type == TURBULENCE_FRACTALNOISE),
+        fTileX, fTileY, fTileWidth, fTileHeight,
+        unit_trans[0], unit_trans[1], unit_trans[2], unit_trans[3], unit_trans[4], unit_trans[5],
+        0, 0
+    };
+    render_noise(temp, *gen, unit_trans, x0, y0, key);
 
     // cairo_surface_write_to_png( temp, "turbulence0.png" );
 
@@ -48,6 +48,7 @@ public:
     void render_cairo(FilterSlot &slot) override;
     double complexity(Geom::Affine const &ctm) override;
     bool uses_background() override { return false; }
+    std::vector<int> get_inputs() override { return {}; }
 
     void set_baseFrequency(int axis, double freq);
     void set_numOctaves(int num);
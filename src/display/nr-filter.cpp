@@ -11,16 +11,20 @@
  */
 
 #include <glib.h>
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <map>
 #include <string>
 #include <cairo.h>
 
 #include "display/nr-filter.h"
+#include "display/nr-filter-pointwise.h"
 #include "display/nr-filter-primitive.h"
 #include "display/nr-filter-slot.h"
 #include "display/nr-filter-types.h"
 #include "display/nr-filter-units.h"
+#include "display/render-profiler.h"
 
 #include "display/nr-filter-blend.h"
 #include "display/nr-filter-composite.h"
@@ -95,10 +99,12 @@ Filter::~Filter()
 }
 
 
-int Filter::render(Inkscape::DrawingItem const *item, DrawingContext &graphic, DrawingContext *bgdc)
+int Filter::render(Inkscape::DrawingItem const *item, DrawingContext &graphic, DrawingContext *bgdc,
+                   Geom::IntRect const &result_area)
 {
     // std::cout << "Filter::render() for: " << const_cast<Inkscape::DrawingItem *>(item)->name() << std::endl;
     // std::cout << "  graphic drawing_scale: " << graphic.surface()->device_scale() << std::endl;
+    RenderProfiler::Scope profile(RenderProfiler::FILTER, item);
 
     if (_primitive.empty()) {
         // when no primitives are defined, clear source graphic
@@ -108,9 +114,7 @@ int Filter::render(Inkscape::DrawingItem const *item, DrawingContext &graphic, D
         graphic.setOperator(CAIRO_OPERATOR_OVER);
         return 1;
     }
-    Inkscape::Preferences *prefs = Inkscape::Preferences::get();
-    item->drawing().setFilterQuality(prefs->getInt("/options/filterquality/value", 0));
-    item->drawing().setBlurQuality(prefs->getInt("/options/blurquality/value", 0));
+    // The quality settings are refreshed from preferences in Drawing::update().
     FilterQuality const filterquality = (FilterQuality)item->drawing().filterQuality();
     int const blurquality = item->drawing().blurQuality();
 
@@ -157,8 +161,91 @@ int Filter::render(Inkscape::DrawingItem const *item, DrawingContext &graphic, D
     slot.set_blurquality(blurquality);
     slot.set_device_scale(graphic.surface()->device_scale());
 
-    for (auto & i : _primitive) {
-        i->render_cairo(slot);
+    // Each primitive only computes the area of its result needed for the part of the filter
+    // result which is used, and primitives whose results do not contribute are skipped.
+    Geom::IntRect area = graphic.targetLogicalBounds().roundOutwards();
+    Geom::OptIntRect output_area = Geom::intersect(area, result_area);
+    if (!output_area) {
+        output_area = area;
+    }
+    Geom::OptIntRect source_area;
+    std::vector<Geom::OptIntRect> needed = _needed_areas(*output_area, trans, source_area);
+
+    // Results which do not depend on the item are taken from the cache. They can only be
+    // cut out of a larger area when the slots are aligned with the display pixels.
+    std::vector<bool> kept;
+    std::vector<bool> constant = _constant_primitives(needed, kept);
+    std::map<std::size_t, std::pair<cairo_surface_t *, Geom::Rect>> cached;
+    Geom::Affine const display2pb = units.get_matrix_display2pb();
+    bool use_cache = display2pb.isTranslation()
+        && std::find(kept.begin(), kept.end(), true) != kept.end();
+    if (use_cache) {
+        int const device_scale = graphic.surface()->device_scale();
+        std::lock_guard<std::mutex> lock(_cache.mutex);
+        if (!_cache.valid || !_cache.area.contains(area) || _cache.ctm != trans
+            || _cache.display2pb != display2pb || _cache.item_bbox != item->itemBounds()
+            || _cache.filterquality != filterquality || _cache.blurquality != blurquality
+            || _cache.device_scale != device_scale)
+        {
+            _cache.ctm = trans;
+            _cache.display2pb = display2pb;
+            _cache.item_bbox = item->itemBounds();
+            _cache.filterquality = filterquality;
+            _cache.blurquality = blurquality;
+            _cache.device_scale = device_scale;
+            _fill_cache(item, units, area, needed, constant, kept);
+        }
+
+        // only the results used for this area are copied, since each copy is handed to the slot
+        Geom::IntPoint offset = area.min() - _cache.area.min();
+        for (auto &result : _cache.results) {
+            if (!needed[result.first]) continue;
+            cairo_surface_t *s = result.second;
+            cairo_surface_t *out = ink_cairo_surface_create_similar(
+                s, cairo_surface_get_content(s), area.width(), area.height());
+            copy_cairo_surface_ci(s, out);
+            cairo_t *ct = cairo_create(out);
+            cairo_set_source_surface(ct, s, -offset[X], -offset[Y]);
+            cairo_set_operator(ct, CAIRO_OPERATOR_SOURCE);
+            cairo_paint(ct);
+            cairo_destroy(ct);
+            cached[result.first] = { out, _cache.primitive_areas[result.first] };
+        }
+    }
+
+    // Runs of per-pixel primitives are rendered together, without intermediate surfaces.
+    std::vector<std::vector<int>> inputs, producers;
+    std::vector<int> consumers = _consumers(needed, inputs, producers);
+    std::vector<bool> rendered(_primitive.size());
+    for (std::size_t i = 0; i < _primitive.size(); ++i) {
+        rendered[i] = needed[i] && !(use_cache && constant[i]);
+    }
+
+    for (std::size_t i = 0; i < _primitive.size(); ++i) {
+        if (!needed[i]) continue;
+        if (use_cache && constant[i]) {
+            auto it = cached.find(i);
+            if (it != cached.end()) {
+                int const output = _primitive[i]->get_output();
+                slot.set(output, it->second.first);
+                slot.set_primitive_area(output, it->second.second);
+                cairo_surface_destroy(it->second.first);
+                cached.erase(it);
+            }
+            continue;
+        }
+        slot.set_needed_area(needed[i]);
+        std::size_t const chained = _render_pixel_chain(slot, item, i, rendered, inputs,
+                                                        producers, consumers);
+        if (chained > 0) {
+            i += chained - 1;
+            continue;
+        }
+        RenderProfiler::Scope profile_primitive(RenderProfiler::PRIMITIVE, item, _primitive[i]);
+        _primitive[i]->render_cairo(slot);
+    }
+    for (auto &unused : cached) {
+        cairo_surface_destroy(unused.second.first);
     }
 
     Geom::Point origin = graphic.targetLogicalBounds().min();
@@ -185,9 +272,10 @@ void Filter::set_primitive_units(SPFilterUnits unit) {
 }
 
 void Filter::area_enlarge(Geom::IntRect &bbox, Inkscape::DrawingItem const *item) const {
-    for (auto i : _primitive) {
-        if (i) i->area_enlarge(bbox, item->ctm());
-    }
+    Geom::OptIntRect source_area;
+    _needed_areas(bbox, item->ctm(), source_area);
+    // the filter output is drawn over the input, so it must be covered too
+    bbox.unionWith(source_area);
 
 /*
   TODO: something. See images at the bottom of filters.svg with medium-low
@@ -222,6 +310,320 @@ void Filter::area_enlarge(Geom::IntRect &bbox, Inkscape::DrawingItem const *item
 */
 }
 
+/**
+ * Resolves unset slots the same way FilterSlot does during rendering. Returns the input
+ * and output slots of every primitive, and the slot of the filter result.
+ */
+int Filter::_resolve_slots(std::vector<std::vector<int>> &inputs, std::vector<int> &outputs) const
+{
+    std::size_t const n = _primitive.size();
+    inputs.assign(n, {});
+    outputs.assign(n, NR_FILTER_SLOT_NOT_SET);
+
+    int last_out = NR_FILTER_SOURCEGRAPHIC;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!_primitive[i]) continue;
+        inputs[i] = _primitive[i]->get_inputs();
+        for (int &input : inputs[i]) {
+            if (input == NR_FILTER_SLOT_NOT_SET) {
+                input = last_out;
+            }
+        }
+        int output = _primitive[i]->get_output();
+        outputs[i] = output == NR_FILTER_SLOT_NOT_SET ? NR_FILTER_UNNAMED_SLOT : output;
+        last_out = outputs[i];
+    }
+    return _output_slot == NR_FILTER_SLOT_NOT_SET ? last_out : _output_slot;
+}
+
+/**
+ * Propagates @a area of the filter result backwards through the primitives, returning
+ * the area of the result of each primitive needed to render it. Primitives whose results
+ * are not used get an empty area. The union of the areas needed from the source graphic
+ * and the background is returned in @a source_area.
+ */
+std::vector<Geom::OptIntRect>
+Filter::_needed_areas(Geom::IntRect const &area, Geom::Affine const &m, Geom::OptIntRect &source_area) const
+{
+    std::size_t const n = _primitive.size();
+    std::vector<std::vector<int>> inputs;
+    std::vector<int> outputs;
+    int const output_slot = _resolve_slots(inputs, outputs);
+
+    // Area of each slot needed by the primitives processed so far, walking backwards.
+    std::map<int, Geom::OptIntRect> slot_areas;
+    slot_areas[output_slot] = area;
+
+    std::vector<Geom::OptIntRect> result(n);
+    for (std::size_t i = n; i-- > 0; ) {
+        if (!_primitive[i]) continue;
+        auto it = slot_areas.find(outputs[i]);
+        if (it == slot_areas.end() || !it->second) continue;
+
+        // earlier writers of this slot are only read by the primitives before this one
+        result[i] = it->second;
+        slot_areas.erase(it);
+
+        Geom::IntRect input_area = *result[i];
+        _primitive[i]->area_enlarge(input_area, m);
+        for (int input : inputs[i]) {
+            slot_areas[input].unionWith(input_area);
+        }
+    }
+
+    source_area = Geom::OptIntRect();
+    for (int slot : { NR_FILTER_SOURCEGRAPHIC, NR_FILTER_SOURCEALPHA,
+                      NR_FILTER_BACKGROUNDIMAGE, NR_FILTER_BACKGROUNDALPHA }) {
+        auto it = slot_areas.find(slot);
+        if (it != slot_areas.end()) {
+            source_area.unionWith(it->second);
+        }
+    }
+    return result;
+}
+
+/**
+ * Returns which of the @a needed primitives have results that do not depend on the filtered
+ * item, i.e. on the source graphic, the background or the paint. Of these, the ones whose
+ * results are read by other primitives or form the filter result are marked in @a kept.
+ */
+std::vector<bool>
+Filter::_constant_primitives(std::vector<Geom::OptIntRect> const &needed, std::vector<bool> &kept) const
+{
+    std::size_t const n = _primitive.size();
+    std::vector<std::vector<int>> inputs;
+    std::vector<int> outputs;
+    int const output_slot = _resolve_slots(inputs, outputs);
+
+    std::vector<bool> constant(n, false);
+    kept.assign(n, false);
+
+    // The primitive which last wrote each slot. Slots never written to are either
+    // provided by the item, or empty.
+    std::map<int, std::size_t> producers;
+    auto is_constant = [&] (int slot) {
+        auto it = producers.find(slot);
+        if (it != producers.end()) {
+            return bool(constant[it->second]);
+        }
+        return slot >= 0 || slot == NR_FILTER_UNNAMED_SLOT;
+    };
+
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!_primitive[i] || !needed[i]) continue;
+        constant[i] = _primitive[i]->can_cache();
+        for (int input : inputs[i]) {
+            constant[i] = constant[i] && is_constant(input);
+        }
+        if (!constant[i]) {
+            for (int input : inputs[i]) {
+                auto it = producers.find(input);
+                if (it != producers.end() && constant[it->second]) {
+                    kept[it->second] = true;
+                }
+            }
+        }
+        producers[outputs[i]] = i;
+    }
+
+    auto it = producers.find(output_slot);
+    if (it != producers.end() && constant[it->second]) {
+        kept[it->second] = true;
+    }
+    return constant;
+}
+
+/**
+ * Finds where the results of the @a needed primitives go. Returns the only primitive which reads
+ * the result of each primitive, or -1 if there are several, none, or the result is the filter
+ * output. The input slots of each primitive are returned in @a inputs, and the primitives which
+ * produce them in @a producers, where -1 stands for a slot not written by any primitive.
+ */
+std::vector<int> Filter::_consumers(std::vector<Geom::OptIntRect> const &needed,
+                                    std::vector<std::vector<int>> &inputs,
+                                    std::vector<std::vector<int>> &producers) const
+{
+    int const NONE = -1;
+    int const SEVERAL = -2;
+
+    std::size_t const n = _primitive.size();
+    std::vector<int> outputs;
+    int const output_slot = _resolve_slots(inputs, outputs);
+
+    std::vector<int> consumers(n, NONE);
+    producers.assign(n, {});
+    std::map<int, std::size_t> writers;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!_primitive[i] || !needed[i]) continue;
+        for (int input : inputs[i]) {
+            auto it = writers.find(input);
+            int const producer = it != writers.end() ? int(it->second) : -1;
+            producers[i].push_back(producer);
+            if (producer >= 0 && consumers[producer] != int(i)) {
+                consumers[producer] = consumers[producer] == NONE ? int(i) : SEVERAL;
+            }
+        }
+        writers[outputs[i]] = i;
+    }
+
+    auto it = writers.find(output_slot);
+    if (it != writers.end()) {
+        consumers[it->second] = SEVERAL;
+    }
+    for (int &consumer : consumers) {
+        if (consumer == SEVERAL) {
+            consumer = NONE;
+        }
+    }
+    return consumers;
+}
+
+/**
+ * Renders the longest run of primitives starting at @a begin which compute each pixel from the
+ * same pixel of their inputs, and each read the result of the one before, which nothing else
+ * reads. The intermediate results are never stored. Returns the number of primitives rendered,
+ * or 0 when there is no such run of at least two primitives.
+ */
+std::size_t Filter::_render_pixel_chain(FilterSlot &slot, Inkscape::DrawingItem const *item,
+                                        std::size_t begin,
+                                        std::vector<bool> const &rendered,
+                                        std::vector<std::vector<int>> const &inputs,
+                                        std::vector<std::vector<int>> const &producers,
+                                        std::vector<int> const &consumers) const
+{
+    if (begin + 1 >= _primitive.size() || consumers[begin] != int(begin + 1)) {
+        return 0;
+    }
+
+    FilterPixelChain chain;
+    std::vector<cairo_surface_t *> surfaces;
+    // the index of the surface of each input slot in each color space it is used in
+    std::map<std::pair<int, SPColorInterpolation>, int> external;
+    bool previous_alpha = false;
+
+    auto same_size = [&] (cairo_surface_t *s) {
+        if (cairo_surface_get_type(s) != CAIRO_SURFACE_TYPE_IMAGE) {
+            return false;
+        }
+        if (surfaces.empty()) {
+            return true;
+        }
+        cairo_surface_t *first = surfaces.front();
+        return cairo_image_surface_get_width(s) == cairo_image_surface_get_width(first)
+            && cairo_image_surface_get_height(s) == cairo_image_surface_get_height(first);
+    };
+
+    for (std::size_t i = begin; i < _primitive.size() && rendered[i]; ++i) {
+        if (i > begin && consumers[i - 1] != int(i)) break;
+        if (inputs[i].size() > FilterPixelChain::MAX_INPUTS) break;
+
+        SPColorInterpolation const ci = _primitive[i]->get_color_interpolation();
+        std::vector<int> sources;
+        std::vector<bool> alpha;
+        bool usable = true;
+        for (std::size_t k = 0; k < inputs[i].size(); ++k) {
+            if (i > begin && producers[i][k] == int(i - 1)) {
+                sources.push_back(FilterPixelChain::PREVIOUS);
+                alpha.push_back(previous_alpha);
+                continue;
+            }
+
+            auto key = std::make_pair(inputs[i][k], ci);
+            auto it = external.find(key);
+            if (it == external.end()) {
+                cairo_surface_t *s = slot.getcairo(key.first, ci);
+                if (!same_size(s)) {
+                    usable = false;
+                    break;
+                }
+                it = external.emplace(key, int(surfaces.size())).first;
+                surfaces.push_back(s);
+            }
+
+            cairo_surface_t *s = surfaces[it->second];
+            sources.push_back(it->second);
+            alpha.push_back(cairo_surface_get_content(s) == CAIRO_CONTENT_ALPHA);
+        }
+        if (!usable) break;
+
+        auto op = _primitive[i]->pixel_op(slot, alpha);
+        if (!op) break;
+        previous_alpha = op->alpha_only();
+        chain.append(std::move(op), ci, std::move(sources));
+    }
+
+    if (chain.size() < 2) {
+        return 0;
+    }
+
+    // the time of the primitives can't be told apart, so it is recorded for the whole chain
+    RenderProfiler::Scope profile(RenderProfiler::PRIMITIVE, item, &_primitive[begin],
+                                  chain.size());
+    cairo_surface_t *out = chain.render(surfaces);
+    slot.set(_primitive[begin + chain.size() - 1]->get_output(), out);
+    cairo_surface_destroy(out);
+    return chain.size();
+}
+
+void Filter::_clear_cache()
+{
+    std::lock_guard<std::mutex> lock(_cache.mutex);
+    for (auto &result : _cache.results) {
+        cairo_surface_destroy(result.second);
+    }
+    _cache.results.clear();
+    _cache.primitive_areas.clear();
+    _cache.valid = false;
+}
+
+/**
+ * Renders the constant primitives into the cache, over the visible part of the item
+ * as well as @a area, unless that part is too large. Must be called with the cache locked
+ * and the key of the cache already set.
+ */
+void Filter::_fill_cache(Inkscape::DrawingItem const *item, FilterUnits const &units,
+                         Geom::IntRect const &area, std::vector<Geom::OptIntRect> const &needed,
+                         std::vector<bool> const &constant, std::vector<bool> const &kept)
+{
+    // larger areas are rendered a tile at a time
+    double const CACHE_MAX_AREA = 2048.0 * 2048.0;
+
+    for (auto &result : _cache.results) {
+        cairo_surface_destroy(result.second);
+    }
+    _cache.results.clear();
+    _cache.primitive_areas.clear();
+
+    _cache.area = area;
+    Geom::OptIntRect visible = item->visualBounds() & item->drawing().cacheLimit();
+    if (visible) {
+        visible->unionWith(area);
+        if (double(visible->width()) * visible->height() <= CACHE_MAX_AREA) {
+            _cache.area = *visible;
+        }
+    }
+
+    DrawingSurface surface(_cache.area, _cache.device_scale);
+    DrawingContext dc(surface);
+    FilterSlot slot(const_cast<Inkscape::DrawingItem*>(item), nullptr, dc, units);
+    slot.set_quality((FilterQuality)_cache.filterquality);
+    slot.set_blurquality(_cache.blurquality);
+    slot.set_device_scale(_cache.device_scale);
+
+    for (std::size_t i = 0; i < _primitive.size(); ++i) {
+        if (!constant[i]) continue;
+        _primitive[i]->render_cairo(slot);
+        if (kept[i]) {
+            int const output = _primitive[i]->get_output();
+            cairo_surface_t *result = slot.getcairo(output);
+            cairo_surface_reference(result);
+            _cache.results[i] = result;
+            _cache.primitive_areas[i] = slot.get_primitive_area(output);
+        }
+    }
+    _cache.valid = true;
+}
+
 Geom::OptRect Filter::filter_effect_area(Geom::OptRect const &bbox)
 {
     Geom::Point minp, maxp;
@@ -232,34 +634,39 @@ Geom::OptRect Filter::filter_effect_area(Geom::OptRect const &bbox)
         double len_y = bbox ? bbox->height() : 0;
         /* TODO: fetch somehow the object ex and em lengths */
 
-        // Update for em, ex, and % values
-        _region_x.update(12, 6, len_x);
-        _region_y.update(12, 6, len_y);
-        _region_width.update(12, 6, len_x);
-        _region_height.update(12, 6, len_y);
+        // Update for em, ex, and % values. Work on copies, since this is also
+        // called during rendering, which must not modify the filter.
+        SVGLength region_x = _region_x;
+        SVGLength region_y = _region_y;
+        SVGLength region_width = _region_width;
+        SVGLength region_height = _region_height;
+        region_x.update(12, 6, len_x);
+        region_y.update(12, 6, len_y);
+        region_width.update(12, 6, len_x);
+        region_height.update(12, 6, len_y);
 
         if (!bbox) return Geom::OptRect();
 
-        if (_region_x.unit == SVGLength::PERCENT) {
-            minp[X] = bbox->left() + _region_x.computed;
+        if (region_x.unit == SVGLength::PERCENT) {
+            minp[X] = bbox->left() + region_x.computed;
         } else {
-            minp[X] = bbox->left() + _region_x.computed * len_x;
+            minp[X] = bbox->left() + region_x.computed * len_x;
         }
-        if (_region_width.unit == SVGLength::PERCENT) {
-            maxp[X] = minp[X] + _region_width.computed;
+        if (region_width.unit == SVGLength::PERCENT) {
+            maxp[X] = minp[X] + region_width.computed;
         } else {
-            maxp[X] = minp[X] + _region_width.computed * len_x;
+            maxp[X] = minp[X] + region_width.computed * len_x;
         }
 
-        if (_region_y.unit == SVGLength::PERCENT) {
-            minp[Y] = bbox->top() + _region_y.computed;
+        if (region_y.unit == SVGLength::PERCENT) {
+            minp[Y] = bbox->top() + region_y.computed;
         } else {
-            minp[Y] = bbox->top() + _region_y.computed * len_y;
+            minp[Y] = bbox->top() + region_y.computed * len_y;
         }
-        if (_region_height.unit == SVGLength::PERCENT) {
-            maxp[Y] = minp[Y] + _region_height.computed;
+        if (region_height.unit == SVGLength::PERCENT) {
+            maxp[Y] = minp[Y] + region_height.computed;
         } else {
-            maxp[Y] = minp[Y] + _region_height.computed * len_y;
+            maxp[Y] = minp[Y] + region_height.computed * len_y;
         }
     } else if (_filter_units == SP_FILTER_UNITS_USERSPACEONUSE) {
         // Region already set in sp-filter.cpp
@@ -378,6 +785,7 @@ void Filter::clear_primitives()
         delete i;
     }
     _primitive.clear();
+    _clear_cache();
 }
 
 void Filter::set_x(SVGLength const &length)
@@ -15,6 +15,9 @@
 
 //#include "display/nr-arena-item.h"
 #include <cairo.h>
+#include <map>
+#include <mutex>
+#include <vector>
 #include "display/nr-filter-primitive.h"
 #include "display/nr-filter-types.h"
 #include "svg/svg-length.h"
@@ -33,8 +36,11 @@ public:
      * backing @a graphic, modify the contents of the surface backing @a graphic to represent
      * the results of filter rendering. @a bgarea and @a area specify bounding boxes
      * of both surfaces in world coordinates; Cairo contexts are assumed to be in default state
-     * (0,0 = surface origin, no path, OVER operator) */
-    int render(Inkscape::DrawingItem const *item, DrawingContext &graphic, DrawingContext *bgdc);
+     * (0,0 = surface origin, no path, OVER operator).
+     * Only the part of the result within @a area is computed; the rest of the surface
+     * is left undefined. */
+    int render(Inkscape::DrawingItem const *item, DrawingContext &graphic, DrawingContext *bgdc,
+               Geom::IntRect const &area);
 
     /**
      * Creates a new filter primitive under this filter object.
@@ -148,7 +154,8 @@ public:
      * outside the rendered area.
      * When this function returns, area contains the area that needs
      * to be rendered so that after filtering, the original area is
-     * drawn correctly.
+     * drawn correctly. Only the primitives contributing to the filter
+     * result are taken into account.
      */
     void area_enlarge(Geom::IntRect &area, Inkscape::DrawingItem const *item) const;
     /**
@@ -198,8 +205,47 @@ private:
     SPFilterUnits _filter_units;
     SPFilterUnits _primitive_units;
 
+    /**
+     * Results of the primitives which do not depend on the filtered item, kept between
+     * renders. They cover an area larger than the rendered one, so that different tiles
+     * of the item can be cut out of them.
+     */
+    struct ResultCache
+    {
+        std::mutex mutex;
+        bool valid = false;
+        Geom::Affine ctm;
+        Geom::Affine display2pb;
+        Geom::OptRect item_bbox;
+        int filterquality = 0;
+        int blurquality = 0;
+        int device_scale = 0;
+        Geom::IntRect area;  ///< area covered by the results, in display pixels
+        std::map<std::size_t, cairo_surface_t *> results;    ///< by primitive index
+        std::map<std::size_t, Geom::Rect> primitive_areas;  ///< by primitive index
+    };
+    ResultCache _cache;
+
     void _create_constructor_table();
     void _common_init();
+    int _resolve_slots(std::vector<std::vector<int>> &inputs, std::vector<int> &outputs) const;
+    std::vector<Geom::OptIntRect> _needed_areas(Geom::IntRect const &area, Geom::Affine const &m,
+                                                Geom::OptIntRect &source_area) const;
+    std::vector<bool> _constant_primitives(std::vector<Geom::OptIntRect> const &needed,
+                                           std::vector<bool> &kept) const;
+    std::vector<int> _consumers(std::vector<Geom::OptIntRect> const &needed,
+                                std::vector<std::vector<int>> &inputs,
+                                std::vector<std::vector<int>> &producers) const;
+    std::size_t _render_pixel_chain(FilterSlot &slot, Inkscape::DrawingItem const *item,
+                                    std::size_t begin,
+                                    std::vector<bool> const &rendered,
+                                    std::vector<std::vector<int>> const &inputs,
+                                    std::vector<std::vector<int>> const &producers,
+                                    std::vector<int> const &consumers) const;
+    void _clear_cache();
+    void _fill_cache(Inkscape::DrawingItem const *item, FilterUnits const &units,
+                     Geom::IntRect const &area, std::vector<Geom::OptIntRect> const &needed,
+                     std::vector<bool> const &constant, std::vector<bool> const &kept);
     int _resolution_limit(FilterQuality const quality) const;
     std::pair<double,double> _filter_resolution(Geom::Rect const &area,
                                                 Geom::Affine const &trans,
@@ -10,8 +10,12 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
+#include "display/cairo-templates.h"
+#include "display/dispatch-pool.h"
 #include "display/nr-light.h"
 #include "display/nr-3dutils.h"
 #include "object/filters/distantlight.h"
@@ -30,16 +34,18 @@ DistantLight::DistantLight(SPFeDistantLight *light, guint32 lighting_color) {
 
 DistantLight::~DistantLight() = default;
 
-void DistantLight::light_vector(NR::Fvector &v) {
-    v[X_3D] = std::cos(azimuth)*std::cos(elevation);
-    v[Y_3D] = std::sin(azimuth)*std::cos(elevation);
-    v[Z_3D] = std::sin(elevation);
-} 
+static void set_color(InkLighting &l, guint32 color) {
+    l.color[LIGHT_RED] = SP_RGBA32_R_U(color);
+    l.color[LIGHT_GREEN] = SP_RGBA32_G_U(color);
+    l.color[LIGHT_BLUE] = SP_RGBA32_B_U(color);
+}
 
-void DistantLight::light_components(NR::Fvector &lc) {
-    lc[LIGHT_RED] = SP_RGBA32_R_U(color);
-    lc[LIGHT_GREEN] = SP_RGBA32_G_U(color);
-    lc[LIGHT_BLUE] = SP_RGBA32_B_U(color);
+void DistantLight::lighting(InkLighting &l) const {
+    l.type = InkLighting::DISTANT;
+    l.direction[X_3D] = std::cos(azimuth)*std::cos(elevation);
+    l.direction[Y_3D] = std::sin(azimuth)*std::cos(elevation);
+    l.direction[Z_3D] = std::sin(elevation);
+    set_color(l, color);
 }
 
 PointLight::PointLight(SPFePointLight *light, guint32 lighting_color, const Geom::Affine &trans, int device_scale) {
@@ -52,17 +58,12 @@ PointLight::PointLight(SPFePointLight *light, guint32 lighting_color, const Geom
 
 PointLight::~PointLight() = default;
 
-void PointLight::light_vector(NR::Fvector &v, double x, double y, double z) {
-    v[X_3D] = l_x - x;
-    v[Y_3D] = l_y - y;
-    v[Z_3D] = l_z - z;
-    NR::normalize_vector(v);
-} 
-
-void PointLight::light_components(NR::Fvector &lc) {
-    lc[LIGHT_RED] = SP_RGBA32_R_U(color);
-    lc[LIGHT_GREEN] = SP_RGBA32_G_U(color);
-    lc[LIGHT_BLUE] = SP_RGBA32_B_U(color);
+void PointLight::lighting(InkLighting &l, double x0, double y0) const {
+    l.type = InkLighting::POINT;
+    l.position[X_3D] = l_x - x0;
+    l.position[Y_3D] = l_y - y0;
+    l.position[Z_3D] = l_z;
+    set_color(l, color);
 }
 
 SpotLight::SpotLight(SPFeSpotLight *light, guint32 lighting_color, const Geom::Affine &trans, int device_scale) {
@@ -87,22 +88,102 @@ SpotLight::SpotLight(SPFeSpotLight *light, guint32 lighting_color, const Geom::A
 
 SpotLight::~SpotLight() = default;
 
-void SpotLight::light_vector(NR::Fvector &v, double x, double y, double z) {
-    v[X_3D] = l_x - x;
-    v[Y_3D] = l_y - y;
-    v[Z_3D] = l_z - z;
-    NR::normalize_vector(v);
-} 
-
-void SpotLight::light_components(NR::Fvector &lc, const NR::Fvector &L) {
-    double spmod = (-1) * NR::scalar_product(L, S);
-    if (spmod <= cos_lca)
-        spmod = 0;
-    else
-        spmod = std::pow(spmod, speExp);
-    lc[LIGHT_RED] = spmod * SP_RGBA32_R_U(color);
-    lc[LIGHT_GREEN] = spmod * SP_RGBA32_G_U(color);
-    lc[LIGHT_BLUE] = spmod * SP_RGBA32_B_U(color);
+void SpotLight::lighting(InkLighting &l, double x0, double y0) const {
+    l.type = InkLighting::SPOT;
+    l.position[X_3D] = l_x - x0;
+    l.position[Y_3D] = l_y - y0;
+    l.position[Z_3D] = l_z;
+    for (int i = 0; i < 3; i++) {
+        l.spot_axis[i] = S[i];
+    }
+    l.spot_cos_cone = cos_lca;
+    l.spot_exponent = speExp;
+    set_color(l, color);
+}
+
+void render_lighting(cairo_surface_t *input, cairo_surface_t *out, InkLighting const &l,
+                     bool specular)
+{
+    // rows given to each thread at once
+    int const BAND = 32;
+
+    SurfaceSynth synth(input);
+    cairo_surface_flush(out);
+    int w = cairo_image_surface_get_width(input);
+    int h = cairo_image_surface_get_height(input);
+    int stridein = cairo_image_surface_get_stride(input);
+    int strideout = cairo_image_surface_get_stride(out);
+    bool alpha_only = cairo_image_surface_get_format(input) == CAIRO_FORMAT_A8;
+    unsigned char const *in_data = cairo_image_surface_get_data(input);
+    unsigned char *out_data = cairo_image_surface_get_data(out);
+
+    // Each thread converts the alpha of the rows of a band and the row on either side
+    // of it to floats, and keeps the normals of one row.
+    std::size_t const thread_size = std::size_t(BAND + 5) * w;
+    auto pool = Inkscape::get_global_dispatch_pool();
+    std::vector<float> buffers(thread_size * pool->size());
+
+    auto process = [&] (int band, int thread) {
+        float *alpha = buffers.data() + thread * thread_size;
+        float *nx = alpha + std::size_t(BAND + 2) * w;
+        float *ny = nx + w;
+        float *nz = ny + w;
+
+        int y_begin = band * BAND;
+        int y_end = std::min(h, y_begin + BAND);
+        int first = std::max(0, y_begin - 1);
+        int last = std::min(h - 1, y_end);
+        for (int y = first; y <= last; ++y) {
+            unsigned char const *src = in_data + y * stridein;
+            float *dst = alpha + std::size_t(y - first) * w;
+            if (alpha_only) {
+                std::copy(src, src + w, dst);
+            } else {
+                for (int x = 0; x < w; ++x) {
+                    dst[x] = reinterpret_cast<guint32 const *>(src)[x] >> 24;
+                }
+            }
+        }
+
+        for (int y = y_begin; y < y_end; ++y) {
+            float const *row = alpha + std::size_t(y - first) * w;
+
+            // The Sobel kernels are cut at the edges; those normals come from SurfaceSynth.
+            auto edge_normal = [&] (int x) {
+                NR::Fvector n = synth.surfaceNormalAt(x, y, l.surface_scale);
+                nx[x] = n[X_3D];
+                ny[x] = n[Y_3D];
+                nz[x] = n[Z_3D];
+            };
+            if (y == 0 || y == h - 1 || w <= 2) {
+                for (int x = 0; x < w; ++x) {
+                    edge_normal(x);
+                }
+            } else {
+                ink_span_surface_normals(row - w + 1, row + 1, row + w + 1, w - 2, l.surface_scale,
+                                         nx + 1, ny + 1, nz + 1);
+                edge_normal(0);
+                edge_normal(w - 1);
+            }
+
+            guint32 *out_row = reinterpret_cast<guint32 *>(out_data + y * strideout);
+            if (specular) {
+                ink_span_specular_lighting(l, 0, y, row, nx, ny, nz, out_row, w);
+            } else {
+                ink_span_diffuse_lighting(l, 0, y, row, nx, ny, nz, out_row, w);
+            }
+        }
+    };
+
+    int bands = (h + BAND - 1) / BAND;
+    if (w * h > PARALLEL_THRESHOLD) {
+        pool->dispatch(bands, process);
+    } else {
+        for (int i = 0; i < bands; ++i) {
+            process(i, 0);
+        }
+    }
+    cairo_surface_mark_dirty(out);
 }
 
 } /* namespace Filters */
@@ -13,20 +13,20 @@
 /** \file
  * These classes provide tools to compute interesting objects relative to light
  * sources. Each class provides a constructor converting information contained
- * in a sp light object into information useful in the current setting, a
- * method to get the light vector (at a given point) and a method to get the
- * light color components (at a given point).
+ * in a sp light object into information useful in the current setting, and a
+ * method describing the light to the lighting span kernels.
  */
 
 #include <2geom/forward.h>
 
+#include "display/cairo-simd.h"
 #include "display/nr-3dutils.h"
 #include "display/nr-light-types.h"
 
 class SPFeDistantLight;
 class SPFePointLight;
 class SPFeSpotLight;
-typedef unsigned int guint32;
+typedef struct _cairo_surface cairo_surface_t;
 
 namespace Inkscape {
 namespace Filters {
@@ -49,18 +49,11 @@ class DistantLight {
         virtual ~DistantLight();
 
         /**
-         * Computes the light vector of the distant light
+         * Sets the light source and color of the lighting parameters
          *
-         * \param v a Fvector reference where we store the result
+         * \param l the parameters where we store the result
          */
-        void light_vector(NR::Fvector &v);
-
-        /**
-         * Computes the light components of the distant light
-         *
-         * \param lc a Fvector reference where we store the result, X=R, Y=G, Z=B
-         */
-        void light_components(NR::Fvector &lc);
+        void lighting(InkLighting &l) const;
 
     private:
         guint32 color;
@@ -83,23 +76,14 @@ class PointLight {
         PointLight(SPFePointLight *light, guint32 lighting_color, const Geom::Affine &trans, int device_scale = 1);
         virtual ~PointLight();
         /**
-         * Computes the light vector of the distant light at point (x,y,z).
-         * x, y and z are given in the arena_item coordinate, they are used as
-         * is
+         * Sets the light source and color of the lighting parameters, with
+         * the position relative to the rendered surface
          *
-         * \param v a Fvector reference where we store the result
-         * \param x x coordinate of the current point
-         * \param y y coordinate of the current point
-         * \param z z coordinate of the current point
+         * \param l the parameters where we store the result
+         * \param x0 x coordinate of the surface origin
+         * \param y0 y coordinate of the surface origin
          */
-        void light_vector(NR::Fvector &v, double x, double y, double z);
-
-        /**
-         * Computes the light components of the distant light
-         *
-         * \param lc a Fvector reference where we store the result, X=R, Y=G, Z=B
-         */
-        void light_components(NR::Fvector &lc);
+        void lighting(InkLighting &l, double x0, double y0) const;
 
     private:
         guint32 color;
@@ -125,25 +109,14 @@ class SpotLight {
         virtual ~SpotLight();
 
         /**
-         * Computes the light vector of the distant light at point (x,y,z).
-         * x, y and z are given in the arena_item coordinate, they are used as
-         * is
-         *
-         * \param v a Fvector reference where we store the result
-         * \param x x coordinate of the current point
-         * \param y y coordinate of the current point
-         * \param z z coordinate of the current point
-         */
-        void light_vector(NR::Fvector &v, double x, double y, double z);
-
-        /**
-         * Computes the light components of the distant light at the current
-         * point. We only need the light vector to compute these
+         * Sets the light source and color of the lighting parameters, with
+         * the position relative to the rendered surface
          *
-         * \param lc a Fvector reference where we store the result, X=R, Y=G, Z=B
-         * \param L the light vector of the current point
+         * \param l the parameters where we store the result
+         * \param x0 x coordinate of the surface origin
+         * \param y0 y coordinate of the surface origin
          */
-        void light_components(NR::Fvector &lc, const NR::Fvector &L);
+        void lighting(InkLighting &l, double x0, double y0) const;
 
     private:
         guint32 color;
@@ -157,6 +130,13 @@ class SpotLight {
                    //the spot point at
 };
 
+/**
+ * Renders feDiffuseLighting, or feSpecularLighting if specular is true, from the alpha
+ * channel of input into out, an ARGB32 surface of the same size, a row at a time.
+ * Positions in the parameters are relative to the surfaces.
+ */
+void render_lighting(cairo_surface_t *input, cairo_surface_t *out, InkLighting const &l,
+                     bool specular);
 
 } /* namespace Filters */
 } /* namespace Inkscape */
@@ -10,12 +10,15 @@
  * Released under GNU GPL v2+, read the file 'COPYING' for more information.
  */
 
+#include <mutex>
+
 #include "display/nr-style.h"
 #include "style.h"
 
 #include "display/drawing-context.h"
 #include "display/drawing-pattern.h"
 
+#include "object/sp-mesh-gradient.h"
 #include "object/sp-paint-server.h"
 
 void NRStyle::Paint::clear()
@@ -41,6 +44,13 @@ void NRStyle::Paint::set(SPPaintServer *ps)
         type = PAINT_SERVER;
         server = ps;
         sp_object_ref(server, nullptr);
+
+        // Build the stops now, so that creating the pattern while rendering only reads them.
+        if (auto mesh = dynamic_cast<SPMeshGradient *>(server)) {
+            mesh->ensureArray();
+        } else if (auto gradient = dynamic_cast<SPGradient *>(server)) {
+            gradient->ensureVector();
+        }
     }
 }
 
@@ -355,24 +365,28 @@ cairo_pattern_t* NRStyle::preparePaint(Inkscape::DrawingContext &dc, Geom::OptRe
 
 bool NRStyle::prepareFill(Inkscape::DrawingContext &dc, Geom::OptRect const &paintbox, Inkscape::DrawingPattern *pattern)
 {
+    std::lock_guard<std::mutex> lock(paint_mutex);
     if (!fill_pattern) fill_pattern = preparePaint(dc, paintbox, pattern, fill);
     return fill_pattern != nullptr;
 }
 
 bool NRStyle::prepareStroke(Inkscape::DrawingContext &dc, Geom::OptRect const &paintbox, Inkscape::DrawingPattern *pattern)
 {
+    std::lock_guard<std::mutex> lock(paint_mutex);
     if (!stroke_pattern) stroke_pattern = preparePaint(dc, paintbox, pattern, stroke);
     return stroke_pattern != nullptr;
 }
 
 bool NRStyle::prepareTextDecorationFill(Inkscape::DrawingContext &dc, Geom::OptRect const &paintbox, Inkscape::DrawingPattern *pattern)
 {
+    std::lock_guard<std::mutex> lock(paint_mutex);
     if (!text_decoration_fill_pattern) text_decoration_fill_pattern = preparePaint(dc, paintbox, pattern, text_decoration_fill);
     return text_decoration_fill_pattern != nullptr;
 }
 
 bool NRStyle::prepareTextDecorationStroke(Inkscape::DrawingContext &dc, Geom::OptRect const &paintbox, Inkscape::DrawingPattern *pattern)
 {
+    std::lock_guard<std::mutex> lock(paint_mutex);
     if (!text_decoration_stroke_pattern) text_decoration_stroke_pattern = preparePaint(dc, paintbox, pattern, text_decoration_stroke);
     return text_decoration_stroke_pattern != nullptr;
 }
@@ -15,6 +15,7 @@
 #define SEEN_INKSCAPE_DISPLAY_NR_ARENA_STYLE_H
 
 #include <cairo.h>
+#include <mutex>
 #include <2geom/rect.h>
 #include "color.h"
 
@@ -81,6 +82,7 @@ struct NRStyle {
     cairo_pattern_t *stroke_pattern;
     cairo_pattern_t *text_decoration_fill_pattern;
     cairo_pattern_t *text_decoration_stroke_pattern;
+    std::mutex paint_mutex; ///< guards the lazy creation of the patterns above by render threads
 
     enum PaintOrderType {
         PAINT_ORDER_NORMAL,
@@ -0,0 +1,226 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Outlines of shapes collected during outline mode rendering and stroked together.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/outline-batch.h"
+
+#include <memory>
+#include <2geom/bezier-curve.h>
+#include <2geom/elliptical-arc.h>
+#include <2geom/pathvector.h>
+#include <2geom/sbasis-to-bezier.h>
+
+#include "display/cairo-utils.h"
+#include "display/drawing-context.h"
+
+namespace Inkscape {
+
+namespace {
+
+// Line width of outlines, in the units of the transform the batch was started with.
+double const LINE_WIDTH = 0.5;
+// Segments spanning less than this in device space are merged with the following ones.
+double const MIN_EXTENT = 0.25;
+
+Geom::Affine current_transform(DrawingContext &dc)
+{
+    cairo_matrix_t ctm;
+    cairo_get_matrix(dc.raw(), &ctm);
+    Geom::Affine result;
+    ink_matrix_to_2geom(result, ctm);
+    return result;
+}
+
+} // namespace
+
+OutlineBatch::OutlineBatch(DrawingContext &dc, Geom::IntRect const &area)
+{
+    Geom::Affine base = current_transform(dc);
+    _line_width = LINE_WIDTH * base.descrim();
+    _view = Geom::Rect(area) * base;
+    _view.expandBy(_line_width + 1);
+}
+
+void
+OutlineBatch::addPath(DrawingContext &dc, Geom::PathVector const &pathv,
+                      Geom::Affine const &transform, guint32 rgba)
+{
+    _layer = nullptr;
+    for (auto &layer : _layers) {
+        if (layer.rgba == rgba) {
+            _layer = &layer;
+            break;
+        }
+    }
+    if (!_layer) {
+        _layers.push_back({ rgba, {} });
+        _layer = &_layers.back();
+    }
+
+    Geom::Affine to_device = transform * current_transform(dc);
+    for (auto const &path : pathv) {
+        if (path.empty()) {
+            continue;
+        }
+        Geom::Point initial = path.initialPoint() * to_device;
+        _pen = initial;
+        _pen_up = true;
+        _culled = false;
+
+        for (auto cit = path.begin(); cit != path.end_open(); ++cit) {
+            _addCurve(*cit, to_device);
+        }
+
+        if (path.closed() && !_pen_up) {
+            if (_culled) {
+                // the move after the left out part started a new subpath
+                _addSegment(CAIRO_PATH_LINE_TO, {initial});
+            } else {
+                _add(CAIRO_PATH_CLOSE_PATH, {});
+            }
+        }
+    }
+}
+
+void
+OutlineBatch::flush(DrawingContext &dc)
+{
+    Inkscape::DrawingContext::Save save(dc);
+    cairo_identity_matrix(dc.raw());
+    dc.setLineWidth(_line_width);
+    dc.setTolerance(0.5); // low quality, but good enough for outline mode
+
+    for (auto &layer : _layers) {
+        if (layer.data.empty()) {
+            continue;
+        }
+        cairo_path_t path;
+        path.status = CAIRO_STATUS_SUCCESS;
+        path.data = layer.data.data();
+        path.num_data = layer.data.size();
+
+        dc.newPath();
+        cairo_append_path(dc.raw(), &path);
+        dc.setSource(layer.rgba);
+        dc.stroke();
+    }
+    _layers.clear();
+}
+
+/// Add a curve, converted to cairo path data like CairoPath::_addCurve() does.
+void
+OutlineBatch::_addCurve(Geom::Curve const &c, Geom::Affine const &transform)
+{
+    unsigned order = 0;
+    if (auto b = dynamic_cast<Geom::BezierCurve const *>(&c)) {
+        order = b->order();
+    }
+
+    switch (order) {
+    case 1:
+        _addSegment(CAIRO_PATH_LINE_TO, {c.finalPoint() * transform});
+        break;
+    case 2: {
+        auto const &q = static_cast<Geom::QuadraticBezier const &>(c);
+        Geom::Point q0 = q[0] * transform;
+        Geom::Point q1 = q[1] * transform;
+        Geom::Point q2 = q[2] * transform;
+        // degree-elevate to cubic Bezier, since Cairo doesn't do quadratic Beziers
+        Geom::Point b1 = q0 + (2./3) * (q1 - q0);
+        Geom::Point b2 = b1 + (1./3) * (q2 - q0);
+        _addSegment(CAIRO_PATH_CURVE_TO, {b1, b2, q2});
+        break;
+    }
+    case 3: {
+        auto const &cb = static_cast<Geom::CubicBezier const &>(c);
+        _addSegment(CAIRO_PATH_CURVE_TO,
+                    {cb[1] * transform, cb[2] * transform, cb[3] * transform});
+        break;
+    }
+    default: {
+        auto arc = dynamic_cast<Geom::EllipticalArc const *>(&c);
+        if (arc && arc->isChord()) {
+            _addSegment(CAIRO_PATH_LINE_TO, {c.finalPoint() * transform});
+            break;
+        }
+        // approximate in device space, so that the tolerance is in pixels
+        std::unique_ptr<Geom::Curve> transformed(c.transformed(transform));
+        for (auto const &iter : Geom::cubicbezierpath_from_sbasis(transformed->toSBasis(), 0.1)) {
+            _addCurve(iter, Geom::identity());
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * Add a segment from _pen to the last of @a points, leaving it out if it is outside of the
+ * rendered area, and merging it into a line if it is shorter than a fraction of a pixel.
+ */
+void
+OutlineBatch::_addSegment(cairo_path_data_type_t type, std::initializer_list<Geom::Point> points)
+{
+    Geom::Point const start = _pen;
+    Geom::Point const end = *(points.end() - 1);
+    _pen = end;
+
+    Geom::Rect swept(start, end);
+    for (auto const &p : points) {
+        swept.expandTo(p);
+    }
+    if (!swept.intersects(_view)) {
+        _pen_up = true;
+        _culled = true;
+        return;
+    }
+
+    bool tiny = swept.width() < MIN_EXTENT && swept.height() < MIN_EXTENT;
+    if (tiny && !_pen_up && Geom::L2sq(end - _current) < MIN_EXTENT * MIN_EXTENT) {
+        // the next segment continues from _current, which is close enough
+        return;
+    }
+
+    if (_pen_up) {
+        _add(CAIRO_PATH_MOVE_TO, {start});
+        _pen_up = false;
+    }
+    if (tiny) {
+        _add(CAIRO_PATH_LINE_TO, {end});
+    } else {
+        _add(type, points);
+    }
+    _current = end;
+}
+
+void
+OutlineBatch::_add(cairo_path_data_type_t type, std::initializer_list<Geom::Point> points)
+{
+    cairo_path_data_t header;
+    header.header.type = type;
+    header.header.length = points.size() + 1;
+    _layer->data.push_back(header);
+    for (auto const &p : points) {
+        cairo_path_data_t point;
+        point.point.x = p[Geom::X];
+        point.point.y = p[Geom::Y];
+        _layer->data.push_back(point);
+    }
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
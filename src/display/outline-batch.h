@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Outlines of shapes collected during outline mode rendering and stroked together.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_OUTLINE_BATCH_H
+#define SEEN_INKSCAPE_DISPLAY_OUTLINE_BATCH_H
+
+#include <initializer_list>
+#include <vector>
+#include <2geom/affine.h>
+#include <2geom/forward.h>
+#include <2geom/int-rect.h>
+#include <2geom/rect.h>
+#include <cairo.h>
+
+typedef unsigned int guint32;
+
+namespace Inkscape {
+
+class DrawingContext;
+
+/**
+ * Collects the outlines drawn while rendering an area in outline mode, so that all outlines
+ * of one color are stroked with a single call instead of one per shape.
+ *
+ * The outlines are stored in device space. Parts of paths outside of the rendered area are
+ * left out, and runs of segments shorter than a fraction of a pixel are merged into one
+ * line, which keeps the combined paths small for documents with very many nodes.
+ *
+ * Items which draw in outline mode without the batch, like text and images, flush it
+ * before drawing, so that the outlines keep the stacking order of the items.
+ */
+class OutlineBatch
+{
+public:
+    /// Start collecting the outlines of @a area, in the coordinates of the current transform.
+    OutlineBatch(DrawingContext &dc, Geom::IntRect const &area);
+
+    /// Add the outline of @a pathv, given in coordinates which @a transform maps to those of
+    /// the current transform of @a dc.
+    void addPath(DrawingContext &dc, Geom::PathVector const &pathv,
+                 Geom::Affine const &transform, guint32 rgba);
+
+    /// Stroke the collected outlines, in the order their colors were first used.
+    void flush(DrawingContext &dc);
+
+private:
+    struct Layer
+    {
+        guint32 rgba;
+        std::vector<cairo_path_data_t> data;
+    };
+
+    void _addCurve(Geom::Curve const &c, Geom::Affine const &transform);
+    void _addSegment(cairo_path_data_type_t type, std::initializer_list<Geom::Point> points);
+    void _add(cairo_path_data_type_t type, std::initializer_list<Geom::Point> points);
+
+    std::vector<Layer> _layers;
+    Geom::Rect _view;    ///< rendered area in device space, with a margin for the line width
+    double _line_width;  ///< in device space
+
+    // State of the path being added
+    Layer *_layer = nullptr;
+    Geom::Point _pen;      ///< end of the last added segment
+    Geom::Point _current;  ///< last point put in the path
+    bool _pen_up = true;   ///< whether the path has to continue with a move to _pen
+    bool _culled = false;  ///< whether segments of the current subpath were left out
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_OUTLINE_BATCH_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Cache of rendered pattern tiles, shared by all items painted with the same pattern.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/pattern-tile-cache.h"
+
+#include <cmath>
+
+namespace Inkscape {
+
+namespace {
+
+// Number of tile resolutions per doubling of the scale.
+double const SCALE_STEPS = 4.0;
+
+} // namespace
+
+bool
+PatternTileCache::Key::operator==(Key const &other) const
+{
+    return owner == other.owner && tile == other.tile && content == other.content
+        && resolution == other.resolution && opacity == other.opacity;
+}
+
+PatternTileCache &
+PatternTileCache::get()
+{
+    // Never destroyed, since patterns can still be released while static objects are destroyed.
+    static PatternTileCache *cache = new PatternTileCache();
+    return *cache;
+}
+
+double
+PatternTileCache::quantizeScale(double scale)
+{
+    if (!(scale > 0) || !std::isfinite(scale)) {
+        return scale;
+    }
+    return std::exp2(std::ceil(std::log2(scale) * SCALE_STEPS) / SCALE_STEPS);
+}
+
+cairo_surface_t *
+PatternTileCache::lookup(Key const &key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        if (it->key == key) {
+            _entries.splice(_entries.begin(), _entries, it);
+            return cairo_surface_reference(it->tile);
+        }
+    }
+    return nullptr;
+}
+
+void
+PatternTileCache::insert(Key const &key, cairo_surface_t *tile)
+{
+    std::size_t size = static_cast<std::size_t>(cairo_image_surface_get_stride(tile))
+                     * cairo_image_surface_get_height(tile);
+    std::list<Entry> evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (size > _budget) {
+            return;
+        }
+        for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->key == key) {
+                // rendered by another thread in the meantime
+                evicted.splice(evicted.end(), _entries, it);
+                _size -= it->size;
+                break;
+            }
+        }
+        _entries.push_front({key, cairo_surface_reference(tile), size});
+        _size += size;
+        evicted.splice(evicted.end(), _evict(_budget));
+    }
+
+    for (auto &entry : evicted) {
+        cairo_surface_destroy(entry.tile);
+    }
+}
+
+void
+PatternTileCache::invalidate(void const *owner)
+{
+    std::list<Entry> evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _entries.begin(); it != _entries.end();) {
+            auto next = std::next(it);
+            if (it->key.owner == owner) {
+                _size -= it->size;
+                evicted.splice(evicted.end(), _entries, it);
+            }
+            it = next;
+        }
+    }
+
+    for (auto &entry : evicted) {
+        cairo_surface_destroy(entry.tile);
+    }
+}
+
+void
+PatternTileCache::setBudget(std::size_t bytes)
+{
+    std::list<Entry> evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _budget = bytes;
+        evicted = _evict(_budget);
+    }
+
+    for (auto &entry : evicted) {
+        cairo_surface_destroy(entry.tile);
+    }
+}
+
+/// Remove the least recently used tiles until their total size is within @a limit.
+/// The caller must hold the lock, and destroy the returned tiles after releasing it.
+std::list<PatternTileCache::Entry>
+PatternTileCache::_evict(std::size_t limit)
+{
+    std::list<Entry> evicted;
+    while (_size > limit) {
+        _size -= _entries.back().size;
+        evicted.splice(evicted.begin(), _entries, std::prev(_entries.end()));
+    }
+    return evicted;
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Cache of rendered pattern tiles, shared by all items painted with the same pattern.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_PATTERN_TILE_CACHE_H
+#define SEEN_INKSCAPE_DISPLAY_PATTERN_TILE_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <2geom/affine.h>
+#include <2geom/int-point.h>
+#include <2geom/rect.h>
+#include <cairo.h>
+
+namespace Inkscape {
+
+/**
+ * Keeps the rendered tiles of patterns and hatches for reuse.
+ *
+ * Every item painted with a pattern used to render its own copy of the tile, and render it
+ * again after every update and zoom change. Tiles are now looked up by the pattern they belong
+ * to and everything else they depend on, so items with the same pattern share one tile.
+ * The tile resolution is rounded up to one of four steps per doubling of the scale (see
+ * quantizeScale()), so tiles also stay valid while zooming within a step.
+ *
+ * The owner of the tiles must call invalidate() when its contents change or it is destroyed.
+ * Tiles are kept up to a total size limit, dropping the least recently used ones first.
+ * All functions are thread-safe.
+ */
+class PatternTileCache
+{
+public:
+    struct Key
+    {
+        void const *owner;         ///< the pattern the tile belongs to
+        Geom::Rect tile;           ///< tile rectangle in pattern space
+        Geom::Affine content;      ///< transform from the contents to pattern space
+        Geom::IntPoint resolution; ///< size of the tile in pixels
+        double opacity;
+
+        bool operator==(Key const &other) const;
+    };
+
+    static PatternTileCache &get();
+
+    /// Round a scale up to the next of the steps at which tiles are rendered.
+    static double quantizeScale(double scale);
+
+    /// Find the tile for @a key. Returns a new reference to it, or nullptr.
+    cairo_surface_t *lookup(Key const &key);
+    /// Store the tile for @a key. The cache takes its own reference to @a tile.
+    void insert(Key const &key, cairo_surface_t *tile);
+    /// Drop all tiles of @a owner.
+    void invalidate(void const *owner);
+    /// Set the limit of the total size of the tiles, in bytes.
+    void setBudget(std::size_t bytes);
+
+private:
+    PatternTileCache() = default;
+
+    struct Entry
+    {
+        Key key;
+        cairo_surface_t *tile;
+        std::size_t size;
+    };
+
+    std::list<Entry> _evict(std::size_t limit);
+
+    std::mutex _mutex;
+    std::list<Entry> _entries;   ///< most recently used first
+    std::size_t _size = 0;       ///< total size of the tiles
+    std::size_t _budget = 16 << 20;
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_PATTERN_TILE_CACHE_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Opt-in timing of rendering, attributed to the objects being rendered.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/render-profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <glibmm/ustring.h>
+
+#include "display/drawing-item.h"
+#include "display/nr-filter-primitive.h"
+#include "object/sp-item.h"
+#include "xml/node.h"
+
+namespace Inkscape {
+
+namespace {
+
+// Events beyond this many are only counted, to keep long recordings within bounds.
+std::size_t const EVENT_LIMIT = 1 << 20;
+
+char const *const KIND_NAMES[] = { "frame", "render", "update", "filter", "primitive" };
+
+// Innermost scope being timed on this thread.
+thread_local RenderProfiler::Scope *current_scope = nullptr;
+
+int thread_index()
+{
+    static std::atomic<int> next{ 0 };
+    thread_local int const index = next++;
+    return index;
+}
+
+std::string item_id(DrawingItem const *item)
+{
+    SPItem const *object = item ? item->getItem() : nullptr;
+    if (object && object->getId()) {
+        return object->getId();
+    }
+    // objects without an id are told apart by their element name and address
+    std::string name = object && object->getRepr() ? object->getRepr()->name() : "(no object)";
+    char address[32];
+    std::snprintf(address, sizeof(address), " %p",
+                  object ? static_cast<void const *>(object) : static_cast<void const *>(item));
+    return name + address;
+}
+
+void write_json_string(std::ostream &out, std::string const &str)
+{
+    out << '"';
+    for (char c : str) {
+        switch (c) {
+            case '"':  out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out << escaped;
+                } else {
+                    out << c;
+                }
+                break;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+RenderProfiler::Scope::Scope(Kind kind, DrawingItem const *item,
+                             Filters::FilterPrimitive *primitive)
+    : _kind(kind)
+    , _item(item)
+    , _primitives(&_primitive)
+    , _count(primitive ? 1 : 0)
+    , _primitive(primitive)
+{
+    _begin();
+}
+
+RenderProfiler::Scope::Scope(Kind kind, DrawingItem const *item,
+                             Filters::FilterPrimitive *const *chain, std::size_t length)
+    : _kind(kind)
+    , _item(item)
+    , _primitives(chain)
+    , _count(length)
+    , _primitive(nullptr)
+{
+    _begin();
+}
+
+void
+RenderProfiler::Scope::_begin()
+{
+    if (!RenderProfiler::get().enabled()) {
+        return;
+    }
+    _active = true;
+    _parent = current_scope;
+    current_scope = this;
+    _start = std::chrono::steady_clock::now();
+}
+
+RenderProfiler::Scope::~Scope()
+{
+    if (!_active) {
+        return;
+    }
+    auto end = std::chrono::steady_clock::now();
+    current_scope = _parent;
+
+    auto &profiler = RenderProfiler::get();
+    double start = profiler._microseconds(_start);
+    double duration = profiler._microseconds(end) - start;
+    if (_parent) {
+        _parent->_nested += duration;
+    }
+
+    std::string id = item_id(_item);
+    Event event{ _kind, id, start, duration, thread_index(), 0, 0, 0 };
+    for (std::size_t k = 0; k < _count; ++k) {
+        event.name += (k == 0 ? ": " : " + ") + _primitives[k]->name().raw();
+    }
+    profiler._record(std::move(event), id, duration - _nested);
+}
+
+RenderProfiler::RenderProfiler()
+    : _epoch(std::chrono::steady_clock::now())
+{}
+
+RenderProfiler &
+RenderProfiler::get()
+{
+    // Never destroyed, since rendering threads can still be running while static objects are
+    // destroyed.
+    static RenderProfiler *profiler = new RenderProfiler();
+    return *profiler;
+}
+
+void
+RenderProfiler::setEnabled(bool enabled)
+{
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void
+RenderProfiler::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _events.clear();
+    _objects.clear();
+    _dropped = 0;
+}
+
+void
+RenderProfiler::beginFrame()
+{
+    _frame_start = std::chrono::steady_clock::now();
+    _tiles = 0;
+    _cache_hits = 0;
+    _cache_misses = 0;
+}
+
+void
+RenderProfiler::endFrame()
+{
+    if (!enabled()) {
+        return;
+    }
+    double start = _microseconds(_frame_start);
+    double duration = _microseconds(std::chrono::steady_clock::now()) - start;
+    _record({ FRAME, "frame", start, duration, thread_index(), _tiles, _cache_hits, _cache_misses },
+            std::string(), duration);
+}
+
+void
+RenderProfiler::countTile()
+{
+    if (enabled()) {
+        ++_tiles;
+    }
+}
+
+void
+RenderProfiler::countCache(bool hit)
+{
+    if (enabled()) {
+        ++(hit ? _cache_hits : _cache_misses);
+    }
+}
+
+std::vector<RenderProfiler::ObjectStats>
+RenderProfiler::slowestObjects(std::size_t count, SortKey key) const
+{
+    std::vector<ObjectStats> result;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        result.reserve(_objects.size());
+        for (auto const &object : _objects) {
+            result.push_back(object.second);
+        }
+    }
+
+    auto value = [key] (ObjectStats const &stats) {
+        switch (key) {
+            case SORT_RENDER: return stats.render;
+            case SORT_UPDATE: return stats.update;
+            case SORT_FILTER: return stats.filter;
+            case SORT_COUNT:  return double(stats.count);
+            case SORT_TOTAL:
+            default:          return stats.total();
+        }
+    };
+    std::sort(result.begin(), result.end(), [&] (ObjectStats const &a, ObjectStats const &b) {
+        return value(a) > value(b);
+    });
+    if (result.size() > count) {
+        result.resize(count);
+    }
+    return result;
+}
+
+void
+RenderProfiler::writeTrace(std::ostream &out, std::size_t count) const
+{
+    auto slowest = slowestObjects(count);
+
+    auto const flags = out.flags();
+    auto const precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (auto const &event : _events) {
+        out << (first ? "\n" : ",\n") << "{\"name\":";
+        write_json_string(out, event.name);
+        out << ",\"cat\":\"" << KIND_NAMES[event.kind] << "\",\"ph\":\"X\""
+            << ",\"ts\":" << event.start << ",\"dur\":" << event.duration
+            << ",\"pid\":1,\"tid\":" << event.thread;
+        if (event.kind == FRAME) {
+            out << ",\"args\":{\"tiles\":" << event.tiles << ",\"cacheHits\":" << event.cache_hits
+                << ",\"cacheMisses\":" << event.cache_misses << "}";
+        }
+        out << "}";
+        first = false;
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":" << _dropped << "}";
+
+    out << ",\"slowestObjects\":[";
+    first = true;
+    for (auto const &stats : slowest) {
+        out << (first ? "\n" : ",\n") << "{\"id\":";
+        write_json_string(out, stats.id);
+        out << ",\"total\":" << stats.total() << ",\"render\":" << stats.render
+            << ",\"update\":" << stats.update << ",\"filter\":" << stats.filter
+            << ",\"count\":" << stats.count << "}";
+        first = false;
+    }
+    out << "\n]}\n";
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+double
+RenderProfiler::_microseconds(std::chrono::steady_clock::time_point time) const
+{
+    return std::chrono::duration<double, std::micro>(time - _epoch).count();
+}
+
+void
+RenderProfiler::_record(Event event, std::string const &id, double self)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (event.kind != FRAME) {
+        auto &stats = _objects[id];
+        stats.id = id;
+        switch (event.kind) {
+            case RENDER:
+                stats.render += self;
+                ++stats.count;
+                break;
+            case UPDATE:
+                stats.update += self;
+                break;
+            default:
+                stats.filter += self;
+                break;
+        }
+    }
+    if (_events.size() < EVENT_LIMIT) {
+        _events.push_back(std::move(event));
+    } else {
+        ++_dropped;
+    }
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Opt-in timing of rendering, attributed to the objects being rendered.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_RENDER_PROFILER_H
+#define SEEN_INKSCAPE_DISPLAY_RENDER_PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Inkscape {
+
+class DrawingItem;
+
+namespace Filters {
+class FilterPrimitive;
+} // namespace Filters
+
+/**
+ * Records how long rendering takes, per frame and per object, while it is enabled.
+ *
+ * The time spent rendering and updating each DrawingItem, and running its filter primitives,
+ * is recorded with Scope objects. The time of nested scopes is subtracted, so each object is
+ * only charged for its own work. Objects are identified by the id of their SPItem, or by its
+ * element name and address if it has none.
+ *
+ * The frames are marked by the canvas, which also counts the tiles it paints; item cache hits
+ * and misses are counted while rendering. Everything recorded can be written out as a trace in
+ * the Chrome trace event format, which also lists the slowest objects.
+ *
+ * When disabled, scopes only check a flag. All functions are thread-safe.
+ */
+class RenderProfiler
+{
+public:
+    enum Kind
+    {
+        FRAME,
+        RENDER,
+        UPDATE,
+        FILTER,
+        PRIMITIVE
+    };
+
+    /// Times spent on one object, in microseconds.
+    struct ObjectStats
+    {
+        std::string id;
+        double render = 0.0;
+        double update = 0.0;
+        double filter = 0.0;  ///< including filter primitives
+        unsigned count = 0;   ///< number of times the object was rendered
+
+        double total() const { return render + update + filter; }
+    };
+
+    enum SortKey
+    {
+        SORT_TOTAL,
+        SORT_RENDER,
+        SORT_UPDATE,
+        SORT_FILTER,
+        SORT_COUNT
+    };
+
+    /// Times the lifetime of the object as an event of @a kind for @a item.
+    class Scope
+    {
+    public:
+        Scope(Kind kind, DrawingItem const *item,
+              Filters::FilterPrimitive *primitive = nullptr);
+        /// Times the @a length primitives starting at @a chain, rendered together in one pass,
+        /// as one event named after all of them.
+        Scope(Kind kind, DrawingItem const *item, Filters::FilterPrimitive *const *chain,
+              std::size_t length);
+        ~Scope();
+
+        Scope(Scope const &) = delete;
+        Scope &operator=(Scope const &) = delete;
+
+    private:
+        void _begin();
+
+        Kind _kind;
+        DrawingItem const *_item;
+        Filters::FilterPrimitive *const *_primitives;
+        std::size_t _count;
+        Filters::FilterPrimitive *_primitive;  ///< storage for a single primitive
+        bool _active = false;
+        Scope *_parent = nullptr;
+        std::chrono::steady_clock::time_point _start;
+        double _nested = 0.0;  ///< time of the nested scopes, in microseconds
+    };
+
+    /// Marks a frame for the lifetime of the object.
+    class Frame
+    {
+    public:
+        Frame() { RenderProfiler::get().beginFrame(); }
+        ~Frame() { RenderProfiler::get().endFrame(); }
+
+        Frame(Frame const &) = delete;
+        Frame &operator=(Frame const &) = delete;
+    };
+
+    static RenderProfiler &get();
+
+    bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    /// Forget everything recorded so far.
+    void reset();
+
+    /// Mark the start and end of a frame. Frames can't be nested.
+    void beginFrame();
+    void endFrame();
+
+    void countTile();
+    void countCache(bool hit);
+
+    /// Get up to @a count objects with the most time spent on them, sorted by @a key.
+    std::vector<ObjectStats> slowestObjects(std::size_t count, SortKey key = SORT_TOTAL) const;
+
+    /// Write the recorded events as a trace in the Chrome trace event format (JSON), with the
+    /// @a count slowest objects in an additional "slowestObjects" array.
+    void writeTrace(std::ostream &out, std::size_t count = 100) const;
+
+private:
+    RenderProfiler();
+
+    struct Event
+    {
+        Kind kind;
+        std::string name;
+        double start;     ///< in microseconds since the profiler was created
+        double duration;  ///< in microseconds
+        int thread;
+        // frame statistics
+        unsigned tiles;
+        unsigned cache_hits;
+        unsigned cache_misses;
+    };
+
+    double _microseconds(std::chrono::steady_clock::time_point time) const;
+    void _record(Event event, std::string const &id, double self);
+
+    std::atomic<bool> _enabled{ false };
+    std::chrono::steady_clock::time_point const _epoch;
+
+    mutable std::mutex _mutex;
+    std::vector<Event> _events;
+    std::size_t _dropped = 0;  ///< number of events not recorded because of the limit
+    std::unordered_map<std::string, ObjectStats> _objects;
+
+    std::chrono::steady_clock::time_point _frame_start;
+    std::atomic<unsigned> _tiles{ 0 };
+    std::atomic<unsigned> _cache_hits{ 0 };
+    std::atomic<unsigned> _cache_misses{ 0 };
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_RENDER_PROFILER_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
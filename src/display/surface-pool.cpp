@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Pool of image surface memory, reused by surfaces of similar size.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#include "display/surface-pool.h"
+
+#include <cstring>
+#include <vector>
+#include <glib.h>
+
+namespace Inkscape {
+
+namespace {
+
+// Maximum total size of the unused buffers kept in the pool.
+std::size_t const POOL_LIMIT = 64 << 20;
+// Smaller surfaces come from the regular heap anyway, so there is little to gain by pooling them.
+std::size_t const POOL_MIN_SIZE = 64 << 10;
+
+cairo_user_data_key_t pool_buffer_key;
+
+} // namespace
+
+SurfacePool &
+SurfacePool::get()
+{
+    // Never destroyed, since surfaces can still be released while static objects are destroyed.
+    static SurfacePool *pool = new SurfacePool();
+    return *pool;
+}
+
+cairo_surface_t *
+SurfacePool::create(cairo_format_t format, int width, int height)
+{
+    int stride = cairo_format_stride_for_width(format, width);
+    std::size_t used = static_cast<std::size_t>(stride) * height;
+    if (stride <= 0 || height <= 0 || used < POOL_MIN_SIZE || used > POOL_LIMIT) {
+        return cairo_image_surface_create(format, width, height);
+    }
+
+    Buffer *buffer = _acquire(_sizeClass(used), used);
+    cairo_surface_t *surface =
+        cairo_image_surface_create_for_data(buffer->data, format, width, height, stride);
+    if (cairo_surface_set_user_data(surface, &pool_buffer_key, buffer, &SurfacePool::_release)
+        != CAIRO_STATUS_SUCCESS)
+    {
+        // error surface
+        _release(buffer);
+    }
+    return surface;
+}
+
+/// Round up to 1, 1.25, 1.5 or 1.75 times a power of two.
+std::size_t
+SurfacePool::_sizeClass(std::size_t size)
+{
+    std::size_t step = 1;
+    while (step * 8 < size) {
+        step *= 2;
+    }
+    return (size + step - 1) / step * step;
+}
+
+/// Take a free buffer of the given size class, or allocate a new one; the first @a used bytes are cleared.
+SurfacePool::Buffer *
+SurfacePool::_acquire(std::size_t size, std::size_t used)
+{
+    Buffer *buffer = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto it = _free.begin(); it != _free.end(); ++it) {
+            if ((*it)->size == size) {
+                buffer = *it;
+                _free.erase(it);
+                _free_size -= size;
+                break;
+            }
+        }
+    }
+
+    if (buffer) {
+        std::memset(buffer->data, 0, used);
+        return buffer;
+    }
+
+    // freshly mapped memory is already zeroed, so this does not touch it
+    auto data = static_cast<unsigned char *>(g_malloc0(size));
+    return new Buffer{size, data};
+}
+
+/// Destroy notification of pooled surfaces.
+void
+SurfacePool::_release(void *data)
+{
+    auto buffer = static_cast<Buffer *>(data);
+    auto &pool = get();
+    std::vector<Buffer *> evicted;
+
+    {
+        std::lock_guard<std::mutex> lock(pool._mutex);
+        pool._free.push_front(buffer);
+        pool._free_size += buffer->size;
+        while (pool._free_size > POOL_LIMIT) {
+            evicted.push_back(pool._free.back());
+            pool._free_size -= pool._free.back()->size;
+            pool._free.pop_back();
+        }
+    }
+
+    for (auto b : evicted) {
+        g_free(b->data);
+        delete b;
+    }
+}
+
+} // namespace Inkscape
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/**
+ * @file
+ * Pool of image surface memory, reused by surfaces of similar size.
+ *//*
+ * Copyright (C) 2021 Authors
+ * Released under GNU GPL v2+, read the file 'COPYING' for more information.
+ */
+
+#ifndef SEEN_INKSCAPE_DISPLAY_SURFACE_POOL_H
+#define SEEN_INKSCAPE_DISPLAY_SURFACE_POOL_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <cairo.h>
+
+namespace Inkscape {
+
+/**
+ * Keeps the pixel buffers of destroyed image surfaces for reuse by new ones.
+ *
+ * Filters, caches and intermediate group surfaces allocate and free large surfaces of the
+ * same few sizes on every render. Reusing their memory avoids the cost of mapping fresh
+ * pages from the system and faulting them in.
+ *
+ * Buffer sizes are rounded up to size classes, four per power of two, so a buffer can be
+ * reused by any surface of up to the same size class. Free buffers are kept up to a total
+ * size limit, dropping the least recently used ones first. All functions are thread-safe.
+ */
+class SurfacePool
+{
+public:
+    static SurfacePool &get();
+
+    /**
+     * Create an image surface with memory from the pool. It behaves exactly like one created
+     * by cairo_image_surface_create(), including being cleared to transparent black, and
+     * returns its memory to the pool when destroyed.
+     */
+    cairo_surface_t *create(cairo_format_t format, int width, int height);
+
+private:
+    SurfacePool() = default;
+
+    struct Buffer
+    {
+        std::size_t size;
+        unsigned char *data;
+    };
+
+    static std::size_t _sizeClass(std::size_t size);
+    static void _release(void *buffer);
+
+    Buffer *_acquire(std::size_t size, std::size_t used);
+
+    std::mutex _mutex;
+    std::list<Buffer *> _free;   ///< unused buffers, most recently used first
+    std::size_t _free_size = 0;  ///< total size of unused buffers
+};
+
+} // namespace Inkscape
+
+#endif // SEEN_INKSCAPE_DISPLAY_SURFACE_POOL_H
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :
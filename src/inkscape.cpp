@@ -38,6 +38,8 @@
 #include "debug/simple-event.h"
 #include "debug/event-tracker.h"
 
+#include "display/dispatch-pool.h"
+
 #include "io/resource.h"
 #include "io/sys.h"
 
@@ -251,6 +253,9 @@ Application::Application(bool use_gui) :
         });
     }
 
+    /* Size the rendering thread pool from the preferences, before any rendering starts */
+    Inkscape::init_global_dispatch_pool();
+
     /* Initialize font factory */
     font_factory *factory = font_factory::Default();
     if (prefs->getBool("/options/font/use_fontsdir_system", true)) {
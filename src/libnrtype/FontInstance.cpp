@@ -38,6 +38,7 @@
 #include "libnrtype/font-instance.h"
 
 #include "display/cairo-utils.h"  // Inkscape::Pixbuf
+#include "display/glyph-atlas.h"
 
 #ifndef USE_PANGO_WIN32
 /*
@@ -127,6 +128,8 @@ font_instance::font_instance()
 
 font_instance::~font_instance()
 {
+    Inkscape::GlyphAtlas::get().invalidate(this);
+
     if ( parent ) {
         parent->UnrefFace(this);
         parent = nullptr;
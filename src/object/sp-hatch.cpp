@@ -30,6 +30,7 @@
 #include "display/drawing-surface.h"
 #include "display/drawing.h"
 #include "display/drawing-pattern.h"
+#include "display/pattern-tile-cache.h"
 
 #include "sp-defs.h"
 #include "sp-hatch-path.h"
@@ -107,6 +108,8 @@ void SPHatch::release()
         ref = nullptr;
     }
 
+    Inkscape::PatternTileCache::get().invalidate(this);
+
     SPPaintServer::release();
 }
 
@@ -314,6 +317,9 @@ void SPHatch::update(SPCtx* ctx, unsigned int flags)
 
 void SPHatch::modified(unsigned int flags)
 {
+    // The rendered tiles are shared by all views, so drop them on any change.
+    Inkscape::PatternTileCache::get().invalidate(this);
+
     if (flags & SP_OBJECT_MODIFIED_FLAG) {
         flags |= SP_OBJECT_PARENT_MODIFIED_FLAG;
     }
@@ -649,6 +655,7 @@ void SPHatch::_updateView(View &view)
     view.arenaitem->setStyle(style);
     view.arenaitem->setOverflow(info.overflow_initial_transform, info.overflow_steps,
                                 info.overflow_step_transform);
+    view.arenaitem->setTileOwner(this);
 }
 
 SPHatch::RenderInfo SPHatch::_calculateRenderInfo(View const &view) const
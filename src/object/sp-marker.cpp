@@ -465,6 +465,8 @@ sp_marker_show_instance ( SPMarker *marker, Inkscape::DrawingItem *parent,
         if (view->items[pos]) {
             /* fixme: Position (Lauris) */
             parent->prependChild(view->items[pos]);
+            // lets the shape tell instances of different markers apart
+            view->items[pos]->setItem(marker);
             Inkscape::DrawingGroup *g = dynamic_cast<Inkscape::DrawingGroup *>(view->items[pos]);
             if (g) g->setChildTransform(marker->c2p);
         }
@@ -35,6 +35,7 @@
 #include "display/drawing-surface.h"
 #include "display/drawing.h"
 #include "display/drawing-group.h"
+#include "display/pattern-tile-cache.h"
 
 #include "svg/svg.h"
 
@@ -96,6 +97,8 @@ void SPPattern::release()
         this->ref = nullptr;
     }
 
+    Inkscape::PatternTileCache::get().invalidate(this);
+
     SPPaintServer::release();
 }
 
@@ -257,6 +260,9 @@ void SPPattern::update(SPCtx *ctx, unsigned int flags)
 
 void SPPattern::modified(unsigned int flags)
 {
+    // Changes of the children and of referenced patterns also end up here.
+    Inkscape::PatternTileCache::get().invalidate(this);
+
     if (flags & SP_OBJECT_MODIFIED_FLAG) {
         flags |= SP_OBJECT_PARENT_MODIFIED_FLAG;
     }
@@ -538,22 +544,6 @@ cairo_pattern_t *SPPattern::pattern_new(cairo_t *base_ct, Geom::OptRect const &b
         return cairo_pattern_create_rgba(0, 0, 0, 0);
     }
 
-    /* Create drawing for rendering */
-    Inkscape::Drawing drawing;
-    unsigned int dkey = SPItem::display_key_new(1);
-    Inkscape::DrawingGroup *root = new Inkscape::DrawingGroup(drawing);
-    drawing.setRoot(root);
-
-    for (auto& child: shown->children) {
-        if (SP_IS_ITEM(&child)) {
-            // for each item in pattern, show it on our drawing, add to the group,
-            // and connect to the release signal in case the item gets deleted
-            Inkscape::DrawingItem *cai;
-            cai = SP_ITEM(&child)->invoke_show(drawing, dkey, SP_ITEM_SHOW_DISPLAY);
-            root->appendChild(cai);
-        }
-    }
-
     //                 ****** Geometry ******
     //
     // * "width" and "height" determine tile size.
@@ -616,47 +606,79 @@ cairo_pattern_t *SPPattern::pattern_new(cairo_t *base_ct, Geom::OptRect const &b
     //       to find the optimum tile size for rendering
     // c is number of pixels in buffer x and y.
     // Scale factor of 1.1 is too small... see bug #1251039
-    Geom::Point c(pattern_tile.dimensions() * ps2user.descrim() * full.descrim() * 2.0);
+    // The scale is rounded up to the steps of the tile cache, so that the tile can be reused
+    // after small zoom changes.
+    double scale = ps2user.descrim() * full.descrim() * 2.0;
+    scale = Inkscape::PatternTileCache::quantizeScale(scale);
+    Geom::IntPoint resolution = (pattern_tile.dimensions() * scale).ceil();
 
     // Create drawing surface with size of pattern tile (in pattern space) but with number of pixels
-    // based on required resolution (c).
-    Inkscape::DrawingSurface pattern_surface(pattern_tile, c.ceil());
-    Inkscape::DrawingContext dc(pattern_surface);
-
-    pattern_tile *= pattern_surface.drawingTransform();
-    Geom::IntRect one_tile = pattern_tile.roundOutwards();
+    // based on required resolution.
+    Inkscape::DrawingSurface pattern_surface(pattern_tile, resolution);
+    Geom::IntRect one_tile = (pattern_tile * pattern_surface.drawingTransform()).roundOutwards();
+
+    // The tile is shared by all items using this pattern with the same geometry.
+    auto &tile_cache = Inkscape::PatternTileCache::get();
+    Inkscape::PatternTileCache::Key key{ this, pattern_tile, content2ps, resolution, opacity };
+    cairo_surface_t *tile = tile_cache.lookup(key);
+
+    if (!tile) {
+        /* Create drawing for rendering */
+        Inkscape::Drawing drawing;
+        // The tile may be rendered for an export, which must not use glyph masks; this drawing
+        // doesn't know, and the tile is cached for all uses.
+        drawing.setGlyphAtlas(false);
+        unsigned int dkey = SPItem::display_key_new(1);
+        Inkscape::DrawingGroup *root = new Inkscape::DrawingGroup(drawing);
+        drawing.setRoot(root);
+
+        for (auto& child: shown->children) {
+            if (SP_IS_ITEM(&child)) {
+                // for each item in pattern, show it on our drawing, add to the group,
+                // and connect to the release signal in case the item gets deleted
+                Inkscape::DrawingItem *cai;
+                cai = SP_ITEM(&child)->invoke_show(drawing, dkey, SP_ITEM_SHOW_DISPLAY);
+                root->appendChild(cai);
+            }
+        }
 
-    // Render pattern.
-    if (needs_opacity) {
-        dc.pushGroup(); // this group is for pattern + opacity
-    }
+        Inkscape::DrawingContext dc(pattern_surface);
 
-    // TODO: make sure there are no leaks.
-    dc.transform(pattern_surface.drawingTransform().inverse());
-    root->setTransform(content2ps * pattern_surface.drawingTransform());
-    drawing.update();
+        // Render pattern.
+        if (needs_opacity) {
+            dc.pushGroup(); // this group is for pattern + opacity
+        }
 
-    // Render drawing to pattern_surface via drawing context, this calls root->render
-    // which is really DrawingItem->render().
-    drawing.render(dc, one_tile);
-    for (auto& child: shown->children) {
-        if (SP_IS_ITEM(&child)) {
-            SP_ITEM(&child)->invoke_hide(dkey);
+        // TODO: make sure there are no leaks.
+        dc.transform(pattern_surface.drawingTransform().inverse());
+        root->setTransform(content2ps * pattern_surface.drawingTransform());
+        drawing.update();
+
+        // Render drawing to pattern_surface via drawing context, this calls root->render
+        // which is really DrawingItem->render().
+        drawing.render(dc, one_tile);
+        for (auto& child: shown->children) {
+            if (SP_IS_ITEM(&child)) {
+                SP_ITEM(&child)->invoke_hide(dkey);
+            }
         }
-    }
 
-    // Uncomment to debug
-    // cairo_surface_t* raw = pattern_surface.raw();
-    // std::cout << "  cairo_surface (sp-pattern): "
-    //           << " width: "  << cairo_image_surface_get_width( raw )
-    //           << " height: " << cairo_image_surface_get_height( raw )
-    //           << std::endl;
-    // std::string filename = "sp-pattern-" + (std::string)getId() + ".png";
-    // cairo_surface_write_to_png( pattern_surface.raw(), filename.c_str() );
+        // Uncomment to debug
+        // cairo_surface_t* raw = pattern_surface.raw();
+        // std::cout << "  cairo_surface (sp-pattern): "
+        //           << " width: "  << cairo_image_surface_get_width( raw )
+        //           << " height: " << cairo_image_surface_get_height( raw )
+        //           << std::endl;
+        // std::string filename = "sp-pattern-" + (std::string)getId() + ".png";
+        // cairo_surface_write_to_png( pattern_surface.raw(), filename.c_str() );
+
+        if (needs_opacity) {
+            dc.popGroupToSource(); // pop raw pattern
+            dc.paint(opacity);     // apply opacity
+        }
 
-    if (needs_opacity) {
-        dc.popGroupToSource(); // pop raw pattern
-        dc.paint(opacity);     // apply opacity
+        tile = cairo_surface_reference(pattern_surface.raw());
+        tile_cache.insert(key, tile);
     }
 
     // Apply transformation to user space. Also compensate for oversampling.
@@ -671,7 +693,8 @@ cairo_pattern_t *SPPattern::pattern_new(cairo_t *base_ct, Geom::OptRect const &b
     int n = raw_transform[5] / h;
     raw_transform *= Geom::Translate( -m*w, -n*h );
 
-    cairo_pattern_t *cp = cairo_pattern_create_for_surface(pattern_surface.raw());
+    cairo_pattern_t *cp = cairo_pattern_create_for_surface(tile);
+    cairo_surface_destroy(tile);
     ink_cairo_pattern_set_matrix(cp, raw_transform);
     cairo_pattern_set_extend(cp, CAIRO_EXTEND_REPEAT);
 
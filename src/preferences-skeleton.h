@@ -242,7 +242,7 @@ static char const preferences_skeleton[] =
 
   <group id="options"
      rotationlock="1">
-    <group id="renderingcache" size="512" />
+    <group id="renderingcache" size="512" glyphs="1" />
     <group id="useoldpdfexporter" value="0" />
     <group id="highlightoriginal" value="1" />
     <group id="relinkclonesonduplicate" value="0" />
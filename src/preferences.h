@@ -20,6 +20,8 @@
 #include <glibmm/ustring.h>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -148,7 +150,7 @@ public:
          *
          * @return If false, the default value will be returned by the getters.
          */
-        bool isValid() const { return _value != nullptr; }
+        bool isValid() const { return _raw() != nullptr; }
 
         /**
          * Interpret the preference as a Boolean value.
@@ -255,9 +257,16 @@ public:
         Entry(Glib::ustring path, void const *v)
             : _pref_path(std::move(path))
             , _value(v) {}
+        Entry(Glib::ustring path, std::optional<Glib::ustring> v)
+            : _pref_path(std::move(path))
+            , _value_copy(std::move(v)) {}
+
+        /// The raw value, from the copy if this entry owns one.
+        void const *_raw() const { return _value_copy ? _value_copy->c_str() : _value; }
 
         Glib::ustring _pref_path;
         void const *_value = nullptr;
+        std::optional<Glib::ustring> _value_copy; ///< value of entries from getEntry(), copied from the cache
 
         mutable bool value_bool = false;
         mutable int value_int = 0;
@@ -635,7 +644,7 @@ private:
     ~Preferences();
     void _loadDefaults();
     void _load();
-    void _getRawValue(Glib::ustring const &path, gchar const *&result);
+    std::optional<Glib::ustring> _getRawValue(Glib::ustring const &path);
     void _setRawValue(Glib::ustring const &path, Glib::ustring const &value);
     void _reportError(Glib::ustring const &, Glib::ustring const &);
     void _keySplit(Glib::ustring const &pref_path, Glib::ustring &node_key, Glib::ustring &attr_key);
@@ -651,6 +660,9 @@ private:
     bool _hasError = false; ///< Indication that some error has occurred;
     bool _initialized = false; ///< Is this instance fully initialized? Caching should be avoided before.
     std::unordered_map<std::string, Glib::ustring> cachedRawValue;
+    /// Guards cachedRawValue, so that several render threads can read preferences at once.
+    /// Preferences are only written on the main thread, which waits while render threads run.
+    std::mutex _cache_mutex;
 
     /// Wrapper class for XML node observers
     class PrefNodeObserver;
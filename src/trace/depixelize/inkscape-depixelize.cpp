@@ -28,6 +28,7 @@
 #include "object/sp-path.h"
 
 #include "display/cairo-templates.h"
+#include "display/dispatch-pool.h"
 
 #include <svg/path-string.h>
 #include <svg/svg.h>
@@ -68,13 +69,7 @@ DepixelizeTracingEngine::DepixelizeTracingEngine(TraceType traceType, double cur
     params->sparsePixelsRadius = sparsePixels;
     params->sparsePixelsMultiplier = sparseMultiplier;
     params->optimize = optimize;
-    params->nthreads = Inkscape::Preferences::get()->getIntLimited("/options/threading/numthreads",
-#ifdef HAVE_OPENMP
-                                                                   omp_get_num_procs(),
-#else
-                                                                   1,
-#endif // HAVE_OPENMP
-                                                                   1, 256);
+    params->nthreads = Inkscape::get_global_dispatch_pool()->size();
 }
 
 DepixelizeTracingEngine::~DepixelizeTracingEngine() { delete params; }
@@ -2639,6 +2639,14 @@ void InkscapePreferences::initPageRendering()
     _filter_multi_threaded.init("/options/threading/numthreads", 1.0, 8.0, 1.0, 2.0, 4.0, true, false);
     _page_rendering.add_line( false, _("Number of _Threads:"), _filter_multi_threaded, "", _("Configure number of processors/threads to use when rendering filters"), false, reset_icon());
 
+    // canvas rendering threads
+    _canvas_render_threads.init("/options/rendering/render_threads", 1.0, 256.0, 1.0, 2.0, 1.0, true, false);
+    _page_rendering.add_line( false, _("Canvas rendering threads:"), _canvas_render_threads, "", _("Number of threads used to render the drawing on the canvas; with more than one, several parts of the canvas are rendered at the same time"), false);
+
+    // progressive refinement
+    _canvas_progressive_refinement.init(_("Draft rendering while moving the view"), "/options/rendering/progressive_refinement", true);
+    _page_rendering.add_line( false, "", _canvas_progressive_refinement, "", _("While panning and zooming, first render newly visible parts of the canvas quickly without filters, then refine them starting near the mouse"));
+
     // rendering cache
     _rendering_cache_size.init("/options/renderingcache/size", 0.0, 4096.0, 1.0, 32.0, 64.0, true, false);
     _page_rendering.add_line( false, _("Rendering _cache size:"), _rendering_cache_size, C_("mebibyte (2^20 bytes) abbreviation","MiB"), _("Set the amount of memory per document which can be used to store rendered parts of the drawing for later reuse; set to zero to disable caching"), false);
@@ -2788,6 +2796,8 @@ void InkscapePreferences::initPageRendering()
     add_devmode_line(_("Framecheck"), _canvas_debug_framecheck, "", _("Print profiling data of selected operations to a file"));
     _canvas_debug_logging.init("", "/options/rendering/debug_logging", false);
     add_devmode_line(_("Logging"), _canvas_debug_logging, "", _("Log certain events to the console"));
+    _canvas_debug_profile.init("", "/options/rendering/debug_profile", false);
+    add_devmode_line(_("Profile rendering"), _canvas_debug_profile, "", _("Record the time spent on each object while rendering; when turned off, the profile is written to render-profile.json in the temporary directory as a Chrome trace"));
     _canvas_debug_slow_redraw.init("", "/options/rendering/debug_slow_redraw", false);
     add_devmode_line(_("Slow redraw"), _canvas_debug_slow_redraw, "", _("Introduce a fixed delay for each tile"));
     _canvas_debug_slow_redraw_time.init("/options/rendering/debug_slow_redraw_time", 0.0, 1000000.0, 1.0, 0.0, 50.0, true, false);
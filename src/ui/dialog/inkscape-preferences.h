@@ -330,6 +330,8 @@ protected:
     UI::Widget::PrefCheckButton _mask_ungrouping;
 
     UI::Widget::PrefSpinButton  _filter_multi_threaded;
+    UI::Widget::PrefSpinButton  _canvas_render_threads;
+    UI::Widget::PrefCheckButton _canvas_progressive_refinement;
     UI::Widget::PrefSpinButton  _rendering_cache_size;
     UI::Widget::PrefSpinButton  _rendering_tile_multiplier;
     UI::Widget::PrefSpinButton  _rendering_xray_radius;
@@ -361,6 +363,7 @@ protected:
     UI::Widget::PrefSpinButton  _canvas_coarsener_min_fullness;
     UI::Widget::PrefCheckButton _canvas_debug_framecheck;
     UI::Widget::PrefCheckButton _canvas_debug_logging;
+    UI::Widget::PrefCheckButton _canvas_debug_profile;
     UI::Widget::PrefCheckButton _canvas_debug_slow_redraw;
     UI::Widget::PrefSpinButton  _canvas_debug_slow_redraw_time;
     UI::Widget::PrefCheckButton _canvas_debug_show_redraw;
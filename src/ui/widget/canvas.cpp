@@ -11,10 +11,12 @@
  */
 
 #include <iostream> // Logging
+#include <fstream> // Profiling
 #include <algorithm> // Sort
 #include <set> // Coarsener
 
 #include <glibmm/i18n.h>
+#include <glibmm/miscutils.h>
 
 #include <2geom/rect.h>
 
@@ -27,7 +29,11 @@
 #include "preferences.h"
 
 #include "display/cairo-utils.h"     // Checkerboard background
+#include "display/dispatch-pool.h"   // Multithreaded rendering
 #include "display/drawing.h"
+#include "display/drawing-context.h"
+#include "display/drawing-surface.h"
+#include "display/render-profiler.h"
 #include "display/control/canvas-item-group.h"
 #include "display/control/snap-indicator.h"
 
@@ -60,6 +66,14 @@
  *   * paint_rect_internal() Which paints the rectangle using paint_single_buffer(). It renders onto a Cairo
  *                           surface "backing_store". After a piece is rendered there is a call to:
  *
+ *                           (After the view has moved, the newly exposed area of a drawing with filters is first
+ *                           painted at draft quality, at half resolution and without filters, and then refined at
+ *                           full quality outwards from the mouse.)
+ *
+ *                           (If multithreaded rendering is enabled, rectangles are collected into batches and
+ *                           handed to paint_rect_batch() instead, which renders the drawing for all of them on
+ *                           the render pool before painting each one with paint_rect_internal().)
+ *
  *   * queue_draw_area() A Gtk function for marking areas of the window as needing a repaint, which when
  *                       the time is right calls:
  *
@@ -119,6 +133,8 @@ struct Prefs
     Pref<int>    coarsener_min_size       = Pref<int>   ("/options/rendering/coarsener_min_size", 200, 0, 1000);
     Pref<int>    coarsener_glue_size      = Pref<int>   ("/options/rendering/coarsener_glue_size", 80, 0, 1000);
     Pref<double> coarsener_min_fullness   = Pref<double>("/options/rendering/coarsener_min_fullness", 0.3, 0.0, 1.0);
+    Pref<int>    render_threads           = Pref<int>   ("/options/rendering/render_threads", 1, 1, 256);
+    Pref<bool>   progressive_refinement   = Pref<bool>  ("/options/rendering/progressive_refinement", true);
 
     // Debug switches
     Pref<bool>   debug_framecheck         = Pref<bool>  ("/options/rendering/debug_framecheck");
@@ -131,6 +147,7 @@ struct Prefs
     Pref<bool>   debug_show_clean         = Pref<bool>  ("/options/rendering/debug_show_clean");
     Pref<bool>   debug_disable_redraw     = Pref<bool>  ("/options/rendering/debug_disable_redraw");
     Pref<bool>   debug_sticky_decoupled   = Pref<bool>  ("/options/rendering/debug_sticky_decoupled");
+    Pref<bool>   debug_profile            = Pref<bool>  ("/options/rendering/debug_profile");
 
     // Developer mode
     Pref<bool> devmode = Pref<bool>("/options/rendering/devmode");
@@ -158,6 +175,7 @@ void Prefs::set_devmode(bool on)
     debug_show_clean.set_enabled(on);
     debug_disable_redraw.set_enabled(on);
     debug_sticky_decoupled.set_enabled(on);
+    debug_profile.set_enabled(on);
 }
 
 /*
@@ -479,13 +497,27 @@ public:
     bool solid_background; // Whether the last background set is solid.
     bool need_outline_store() const {return q->_split_mode != Inkscape::SplitMode::NORMAL || q->_render_mode == Inkscape::RenderMode::OUTLINE_OVERLAY;}
 
+    // Progressive refinement. After the view has moved, dirty regions are painted at draft quality first, then refined.
+    bool refine_pending = false; // Whether the view has moved since the last completed redraw.
+    Cairo::RefPtr<Cairo::Region> draft_region = Cairo::Region::create(); // The region of the store painted at draft quality, which still needs refining.
+    Cairo::RefPtr<Cairo::Region> painted_region() const; // The region of the store with content to show, either clean or draft.
+
     // Drawing
     bool on_idle();
-    void paint_rect_internal(Geom::IntRect const &rect);
-    void paint_single_buffer(Geom::IntRect const &paint_rect, Cairo::RefPtr<Cairo::ImageSurface> const &store, bool is_backing_store, bool outline_overlay_pass);
+    void paint_rect_internal(Geom::IntRect const &rect, bool draft = false, Cairo::RefPtr<Cairo::ImageSurface> const &drawing = {}, Cairo::RefPtr<Cairo::ImageSurface> const &outline_drawing = {});
+    void paint_single_buffer(Geom::IntRect const &paint_rect, Cairo::RefPtr<Cairo::ImageSurface> const &store, bool is_backing_store, bool outline_overlay_pass, Cairo::RefPtr<Cairo::ImageSurface> const &drawing = {});
     std::optional<Geom::Dim2> old_bisector(const Geom::IntRect &rect);
     std::optional<Geom::Dim2> new_bisector(const Geom::IntRect &rect);
 
+    // Multithreaded rendering. The drawing is rendered for a batch of rectangles at once by the render pool, then composited into the stores on the main thread.
+    std::unique_ptr<Inkscape::DispatchPool> render_pool; // Null if rendering on the main thread only.
+    void update_render_pool();
+    void paint_rect_batch(std::vector<Geom::IntRect> const &rects, bool draft = false);
+    Cairo::RefPtr<Cairo::ImageSurface> render_drawing(Geom::IntRect const &rect, bool draft = false);
+
+    // Render profiling. Enabled by the debug_profile preference; the profile is written out when it is disabled again.
+    void update_profiler();
+
     // Trivial overload of GtkWidget function.
     void queue_draw_area(Geom::IntRect &rect);
 
@@ -531,11 +563,17 @@ Canvas::Canvas()
     d->prefs.debug_show_clean.action = [=] {queue_draw();};
     d->prefs.debug_disable_redraw.action = [=] {d->add_idle();};
     d->prefs.debug_sticky_decoupled.action = [=] {d->add_idle();};
+    d->prefs.debug_profile.action = [=] {d->update_profiler();};
+    d->update_profiler();
     d->prefs.update_strategy.action = [=] {d->updater = make_updater(d->prefs.update_strategy, std::move(d->updater->clean_region));};
     d->prefs.outline_overlay_opacity.action = [=] {queue_draw();};
     d->prefs.softproof.action = [=] {redraw_all();};
     d->prefs.displayprofile.action = [=] {redraw_all();};
     d->prefs.imageoutlinemode.action = [=] {redraw_all();};
+    d->prefs.render_threads.action = [=] {d->update_render_pool();};
+
+    // Render pool
+    d->update_render_pool();
 
     // Cavas item root
     _canvas_item_root = new Inkscape::CanvasItemGroup(nullptr);
@@ -1476,6 +1514,7 @@ Canvas::redraw_all()
         return;
     }
     d->updater->reset(); // Empty region (i.e. everything is dirty).
+    d->draft_region = Cairo::Region::create();
     d->add_idle();
     if (d->prefs.debug_show_unclean) queue_draw();
 }
@@ -1508,6 +1547,7 @@ Canvas::redraw_area(int x0, int y0, int x1, int y1)
 
     auto rect = Geom::IntRect::from_xywh(x0, y0, x1 - x0, y1 - y0);
     d->updater->mark_dirty(rect);
+    d->draft_region->subtract(geom_to_cairo(rect));
     d->add_idle();
     if (d->prefs.debug_show_unclean) queue_draw();
 }
@@ -1803,6 +1843,9 @@ Canvas::on_draw(const Cairo::RefPtr<::Cairo::Context> &cr)
             // Turn off anti-aliasing for huge performance gains. Only applies to this compositing step.
             cr->set_antialias(Cairo::ANTIALIAS_NONE);
 
+            // The store also shows the parts painted at draft quality.
+            auto const painted_region = d->painted_region();
+
             // Blit background to complement of both clean regions, if solid (and therefore not already drawn).
             if (is_backing_store && d->solid_background) {
                 if (d->prefs.debug_framecheck) f = FrameCheck::Event("composite", 2);
@@ -1811,7 +1854,7 @@ Canvas::on_draw(const Cairo::RefPtr<::Cairo::Context> &cr)
                 cr->rectangle(0, 0, get_allocation().get_width(), get_allocation().get_height());
                 cr->translate(-_pos.x(), -_pos.y());
                 cr->transform(geom_to_cairo(_affine * d->_store_affine.inverse()));
-                region_to_path(cr, d->updater->clean_region);
+                region_to_path(cr, painted_region);
                 cr->transform(geom_to_cairo(d->_store_affine * d->_snapshot_affine.inverse()));
                 region_to_path(cr, d->_snapshot_clean_region);
                 cr->clip();
@@ -1829,7 +1872,7 @@ Canvas::on_draw(const Cairo::RefPtr<::Cairo::Context> &cr)
             cr->rectangle(0, 0, get_allocation().get_width(), get_allocation().get_height());
             cr->translate(-_pos.x(), -_pos.y());
             cr->transform(geom_to_cairo(_affine * d->_store_affine.inverse()));
-            region_to_path(cr, d->updater->clean_region);
+            region_to_path(cr, painted_region);
             cr->clip();
             cr->transform(geom_to_cairo(d->_store_affine * d->_snapshot_affine.inverse()));
             region_to_path(cr, d->_snapshot_clean_region);
@@ -1845,12 +1888,12 @@ Canvas::on_draw(const Cairo::RefPtr<::Cairo::Context> &cr)
             }
             cr->restore();
 
-            // Draw transformed store, clipped to clean region.
+            // Draw transformed store, clipped to painted region.
             if (d->prefs.debug_framecheck) f = FrameCheck::Event("composite", 0);
             cr->save();
             cr->translate(-_pos.x(), -_pos.y());
             cr->transform(geom_to_cairo(_affine * d->_store_affine.inverse()));
-            region_to_path(cr, d->updater->clean_region);
+            region_to_path(cr, painted_region);
             cr->clip();
             cr->set_source(store, d->_store_rect.left(), d->_store_rect.top());
             cr->set_operator(is_backing_store && d->solid_background ? Cairo::OPERATOR_SOURCE : Cairo::OPERATOR_OVER);
@@ -2252,6 +2295,7 @@ bool
 CanvasPrivate::on_idle()
 {
     framecheck_whole_function(this)
+    Inkscape::RenderProfiler::Frame profile_frame;
 
     assert(q->_canvas_item_root);
 
@@ -2290,6 +2334,8 @@ CanvasPrivate::on_idle()
             cr->paint();
         }
         updater->reset();
+        draft_region = Cairo::Region::create();
+        refine_pending = true;
         if (prefs.debug_show_unclean) q->queue_draw();
     };
 
@@ -2361,6 +2407,8 @@ CanvasPrivate::on_idle()
         }
 
         updater->intersect(_store_rect);
+        draft_region->intersect(geom_to_cairo(_store_rect));
+        refine_pending = true;
         if (prefs.debug_show_unclean) q->queue_draw();
     };
 
@@ -2369,7 +2417,7 @@ CanvasPrivate::on_idle()
         std::swap(_snapshot_store, _backing_store); // This will re-use the old snapshot store later if possible.
         _snapshot_rect = _store_rect;
         _snapshot_affine = _store_affine;
-        _snapshot_clean_region = updater->clean_region->copy();
+        _snapshot_clean_region = painted_region();
 
         // Do the same for the outline store
         std::swap(_snapshot_outline_store, _outline_store);
@@ -2478,10 +2526,25 @@ CanvasPrivate::on_idle()
 
     // Begin processing redraws.
     auto start_time = g_get_monotonic_time();
+    bool drafted = false;
     while (true) {
         // Get the clean region for the next redraw as reported by the updater.
         auto clean_region = updater->get_next_clean_region();
 
+        // If the view has moved, first paint the visible rectangle at draft quality, considering the parts already painted
+        // at draft quality as clean, and only then refine it. (Drafts leave out filters, so are only worth it with filters.)
+        bool draft = false;
+        if (prefs.progressive_refinement && refine_pending && !drafted && visible_rect &&
+            q->_drawing->renderFilters() && q->_drawing->hasFilters())
+        {
+            auto shown_region = clean_region->copy();
+            shown_region->do_union(draft_region);
+            if (shown_region->contains_rectangle(geom_to_cairo(*visible_rect)) != Cairo::REGION_OVERLAP_IN) {
+                clean_region = shown_region;
+                draft = true;
+            }
+        }
+
         // Get the region to paint, which is the visible rectangle minus the clean region (both subregions of store).
         Cairo::RefPtr<Cairo::Region> paint_region;
         if (visible_rect) {
@@ -2510,6 +2573,9 @@ CanvasPrivate::on_idle()
         };
         std::make_heap(rects.begin(), rects.end(), cmp);
 
+        // Rectangles waiting to be painted by the render pool.
+        std::vector<Geom::IntRect> batch;
+
         // Process rectangles until none left or timed out.
         while (!rects.empty()) {
             // Extract the closest rectangle to the mouse.
@@ -2543,8 +2609,19 @@ CanvasPrivate::on_idle()
                 continue;
             }
 
-            // Paint the rectangle.
-            paint_rect_internal(rect);
+            // Paint the rectangle, or when multithreaded, paint a batch of rectangles once there are enough for every thread.
+            if (render_pool) {
+                batch.emplace_back(rect);
+                if ((int)batch.size() < render_pool->size() && !rects.empty()) {
+                    continue;
+                }
+                paint_rect_batch(batch, draft);
+                batch.clear();
+            } else if (draft) {
+                paint_rect_batch({ rect }, draft);
+            } else {
+                paint_rect_internal(rect, draft);
+            }
 
             // Check for timeout.
             auto now = g_get_monotonic_time();
@@ -2557,10 +2634,22 @@ CanvasPrivate::on_idle()
             }
         }
 
+        // Paint any rectangles left over after culling.
+        if (!batch.empty()) {
+            paint_rect_batch(batch, draft);
+        }
+
+        // Finished the draft, so go on to refine it.
+        if (draft) {
+            drafted = true;
+            continue;
+        }
+
         // Report the redraw as finished. Exit if there's no more redraws to process.
         bool keep_going = updater->report_finished();
         if (!keep_going) break;
     }
+    refine_pending = false;
 
     // Finished drawing. Handle transitions out of decoupled mode, by checking if we need to do a final redraw at the correct affine.
     if (decoupled_mode) {
@@ -2589,24 +2678,159 @@ CanvasPrivate::on_idle()
     }
 }
 
+Cairo::RefPtr<Cairo::Region>
+CanvasPrivate::painted_region() const
+{
+    auto result = updater->clean_region->copy();
+    result->do_union(draft_region);
+    return result;
+}
+
+void
+CanvasPrivate::update_profiler()
+{
+    auto &profiler = Inkscape::RenderProfiler::get();
+    if (prefs.debug_profile == profiler.enabled()) {
+        return;
+    }
+
+    if (prefs.debug_profile) {
+        profiler.reset();
+        profiler.setEnabled(true);
+        return;
+    }
+
+    // Write out the profile, and print the slowest objects to the console.
+    profiler.setEnabled(false);
+    auto path = Glib::build_filename(Glib::get_tmp_dir(), "render-profile.json");
+    std::ofstream file(path, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+    if (!file) {
+        std::cerr << "failed to create render profile " << path << std::endl;
+        return;
+    }
+    profiler.writeTrace(file);
+    std::cout << "Render profile written to " << path << std::endl;
+    std::cout << "Slowest objects (total, render, update and filter time in us, number of renders):" << std::endl;
+    for (auto const &stats : profiler.slowestObjects(10)) {
+        std::cout << "  " << stats.id << ": " << stats.total() << ", " << stats.render << ", "
+                  << stats.update << ", " << stats.filter << ", " << stats.count << std::endl;
+    }
+}
+
+void
+CanvasPrivate::update_render_pool()
+{
+    int threads = prefs.render_threads;
+    if (threads > 1) {
+        render_pool = std::make_unique<Inkscape::DispatchPool>(threads);
+    } else {
+        render_pool.reset();
+    }
+}
+
 void
-CanvasPrivate::paint_rect_internal(Geom::IntRect const &rect)
+CanvasPrivate::paint_rect_batch(std::vector<Geom::IntRect> const &rects, bool draft)
+{
+    if (!q->_canvas_item_root->is_visible()) {
+        for (auto &rect : rects) {
+            paint_rect_internal(rect, draft);
+        }
+        return;
+    }
+
+    // Render the drawing for all rectangles on the render pool, if there is one.
+    // The drawing is updated beforehand, so that the render threads only read from it.
+    auto render_all = [&, this] (std::vector<Cairo::RefPtr<Cairo::ImageSurface>> &results, bool draft) {
+        q->_drawing->update();
+        results.resize(rects.size());
+        if (render_pool) {
+            render_pool->dispatch(rects.size(), [&, this] (int i, int) {
+                results[i] = render_drawing(rects[i], draft);
+            });
+        } else {
+            for (int i = 0; i < (int)rects.size(); i++) {
+                results[i] = render_drawing(rects[i], draft);
+            }
+        }
+    };
+
+    // The color mode is applied once the drawings are composited over the page background.
+    std::vector<Cairo::RefPtr<Cairo::ImageSurface>> drawings, outline_drawings;
+    q->_drawing->setColorMode(Inkscape::ColorMode::NORMAL);
+    q->_drawing->setDraft(draft);
+    render_all(drawings, draft);
+    q->_drawing->setDraft(false);
+
+    if (_outline_store) {
+        q->_drawing->setRenderMode(Inkscape::RenderMode::OUTLINE);
+        render_all(outline_drawings, false);
+        q->_drawing->setRenderMode(q->_render_mode);
+    }
+
+    // Paint the rectangles on the main thread, using the rendered drawings.
+    for (int i = 0; i < (int)rects.size(); i++) {
+        paint_rect_internal(rects[i], draft, drawings[i], _outline_store ? outline_drawings[i] : Cairo::RefPtr<Cairo::ImageSurface>());
+    }
+}
+
+// Called from the render threads, or on the main thread when drafting without a render pool.
+Cairo::RefPtr<Cairo::ImageSurface>
+CanvasPrivate::render_drawing(Geom::IntRect const &rect, bool draft)
+{
+    auto surface = Cairo::ImageSurface::create(Cairo::FORMAT_ARGB32, rect.width() * _device_scale, rect.height() * _device_scale);
+    cairo_surface_set_device_scale(surface->cobj(), _device_scale, _device_scale); // No C++ API!
+
+    if (draft) {
+        // Render drafts at half resolution, since their cost grows with the number of pixels, then scale them up.
+        auto half = Geom::IntPoint((rect.width() + 1) / 2, (rect.height() + 1) / 2);
+        Inkscape::DrawingSurface draft_surface(Geom::Rect(rect), half, _device_scale);
+        {
+            Inkscape::DrawingContext dc(draft_surface);
+            q->_drawing->render(dc, rect);
+        }
+
+        auto cr = Cairo::Context::create(surface);
+        cr->scale((double)rect.width() / half.x(), (double)rect.height() / half.y());
+        cairo_set_source_surface(cr->cobj(), draft_surface.raw(), 0, 0); // No C++ API!
+        cairo_pattern_set_extend(cairo_get_source(cr->cobj()), CAIRO_EXTEND_PAD); // Avoid fading at the edges.
+        cr->set_operator(Cairo::OPERATOR_SOURCE);
+        cr->paint();
+    } else {
+        Inkscape::DrawingContext dc(surface->cobj(), rect.min());
+        q->_drawing->render(dc, rect);
+    }
+    surface->flush();
+
+    return surface;
+}
+
+void
+CanvasPrivate::paint_rect_internal(Geom::IntRect const &rect, bool draft, Cairo::RefPtr<Cairo::ImageSurface> const &drawing, Cairo::RefPtr<Cairo::ImageSurface> const &outline_drawing)
 {
     // Paint the rectangle.
     q->_drawing->setColorMode(q->_color_mode);
-    paint_single_buffer(rect, _backing_store, true, false);
+    q->_drawing->setDraft(draft);
+    paint_single_buffer(rect, _backing_store, true, false, drawing);
+    q->_drawing->setDraft(false);
 
     if (_outline_store) {
         q->_drawing->setRenderMode(Inkscape::RenderMode::OUTLINE);
-        paint_single_buffer(rect, _outline_store, false, q->_render_mode == Inkscape::RenderMode::OUTLINE_OVERLAY);
+        paint_single_buffer(rect, _outline_store, false, q->_render_mode == Inkscape::RenderMode::OUTLINE_OVERLAY, outline_drawing);
         q->_drawing->setRenderMode(q->_render_mode); // Leave the drawing in the requested render mode.
     }
 
     // Introduce an artificial delay for each rectangle.
     if (prefs.debug_slow_redraw) g_usleep(prefs.debug_slow_redraw_time);
 
-    // Mark the rectangle as clean.
-    updater->mark_clean(rect);
+    Inkscape::RenderProfiler::get().countTile();
+
+    // Mark the rectangle as clean, or as still needing refinement if it was only drafted.
+    if (draft) {
+        draft_region->do_union(geom_to_cairo(rect));
+    } else {
+        updater->mark_clean(rect);
+        draft_region->subtract(geom_to_cairo(rect));
+    }
 
     // Mark the screen dirty.
     if (!decoupled_mode) {
@@ -2641,7 +2865,7 @@ CanvasPrivate::paint_rect_internal(Geom::IntRect const &rect)
 }
 
 void
-CanvasPrivate::paint_single_buffer(Geom::IntRect const &paint_rect, const Cairo::RefPtr<Cairo::ImageSurface> &store, bool is_backing_store, bool outline_overlay_pass)
+CanvasPrivate::paint_single_buffer(Geom::IntRect const &paint_rect, const Cairo::RefPtr<Cairo::ImageSurface> &store, bool is_backing_store, bool outline_overlay_pass, Cairo::RefPtr<Cairo::ImageSurface> const &drawing)
 {
     // Make sure the following code does not go outside of store's data.
     assert(store);
@@ -2686,7 +2910,7 @@ CanvasPrivate::paint_single_buffer(Geom::IntRect const &paint_rect, const Cairo:
 
     // Render drawing on top of background.
     if (q->_canvas_item_root->is_visible()) {
-        auto buf = Inkscape::CanvasItemBuffer{ paint_rect, _device_scale, outline_overlay_pass, cr };
+        auto buf = Inkscape::CanvasItemBuffer{ paint_rect, _device_scale, outline_overlay_pass, cr, drawing };
         q->_canvas_item_root->render(&buf);
     }
 
@@ -1,6 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 /** @file
- * Tests for classes like Pixbuf from cairo-utils
+ * Tests for classes like Pixbuf from cairo-utils, and for the pixel span kernels
  *//*
  * Authors: see git history
  *
@@ -9,8 +9,18 @@
  * Released under GNU GPL version 2 or later, read the file 'COPYING' for more information
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
 #include <gtest/gtest.h>
+#include <src/display/cairo-simd.h>
 #include <src/display/cairo-utils.h>
+#include <src/display/nr-filter-colormatrix.h>
+#include <src/display/nr-filter-composite.h>
 #include <src/inkscape.h>
 
 
@@ -48,4 +58,395 @@ TEST_F(PixbufTest, creatingFromSvgUriWithoutViewboxOrWidthAndHeightReturnsNull)
     double default_dpi = 96.0;
 
     ASSERT_EQ(Inkscape::Pixbuf::create_from_data_uri(uri_data.c_str(), default_dpi), nullptr);
-}
\ No newline at end of file
+}
+
+/*
+ * The pointwise span kernels of every instruction set must give exactly the results of the
+ * per-pixel filter functors they replace. The other vector kernels must give the results of
+ * the scalar ones, which are the reference, for spans of any length; the lighting and Gouraud
+ * kernels compute in single precision and may round a few values differently, by one level
+ * at most.
+ */
+class SpanKernelTest : public ::testing::Test {
+  protected:
+    void SetUp() override
+    {
+        best = ink_span_isa();
+    }
+    void TearDown() override
+    {
+        ink_span_set_isa(best.c_str());
+    }
+
+    /**
+     * For each vector version the processor supports, call @a run with 0 using the scalar
+     * kernels and with 1 using the vector ones, then @a check the results.
+     */
+    template <typename Run, typename Check>
+    void compare(Run const &run, Check const &check)
+    {
+        for (auto isa : { "SSE2", "AVX2" }) {
+            if (!ink_span_set_isa(isa)) continue;
+            SCOPED_TRACE(isa);
+            ink_span_set_isa("scalar");
+            run(0);
+            ink_span_set_isa(isa);
+            run(1);
+            check();
+        }
+    }
+
+    static void expect_close(std::vector<guint32> const &expected, std::vector<guint32> const &result)
+    {
+        ASSERT_EQ(expected.size(), result.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            for (int shift = 0; shift < 32; shift += 8) {
+                int e = (expected[i] >> shift) & 0xff;
+                int r = (result[i] >> shift) & 0xff;
+                EXPECT_LE(std::abs(e - r), 1) << "pixel " << i << " of " << expected.size()
+                                              << ", bits " << shift;
+            }
+        }
+    }
+
+    /// Call @a run once with the kernels of every instruction set the processor supports.
+    template <typename Run>
+    void each_isa(Run const &run)
+    {
+        for (auto isa : { "scalar", "SSE2", "AVX2" }) {
+            if (!ink_span_set_isa(isa)) continue;
+            SCOPED_TRACE(isa);
+            run();
+        }
+    }
+
+    /// Random pixels, with the color channels not above alpha if @a premultiplied is set.
+    /// Fully transparent and opaque pixels are included.
+    std::vector<guint32> random_pixels(int n, bool premultiplied)
+    {
+        std::uniform_int_distribution<guint32> byte(0, 255);
+        std::vector<guint32> v(n);
+        for (int i = 0; i < n; ++i) {
+            guint32 a = i % 7 == 0 ? 0 : i % 7 == 1 ? 255 : byte(rng);
+            guint32 c[3];
+            for (auto &x : c) {
+                x = premultiplied ? byte(rng) * a / 255 : byte(rng);
+            }
+            v[i] = (a << 24) | (c[0] << 16) | (c[1] << 8) | c[2];
+        }
+        return v;
+    }
+
+    std::vector<float> random_floats(int n, float min, float max)
+    {
+        std::uniform_real_distribution<float> dist(min, max);
+        std::vector<float> v(n);
+        for (auto &x : v) {
+            x = dist(rng);
+        }
+        return v;
+    }
+
+    std::string best;
+    std::mt19937 rng{1};
+};
+
+// spans shorter and longer than the vectors, with every possible number of leftover pixels
+static int const SPAN_LENGTHS[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 37, 64 };
+
+TEST_F(SpanKernelTest, PremultiplyMatchesFunctor)
+{
+    for (int n : SPAN_LENGTHS) {
+        auto in = random_pixels(n, false);
+        std::vector<guint32> expected(n), result(n);
+        for (int i = 0; i < n; ++i) {
+            EXTRACT_ARGB32(in[i], a, r, g, b)
+            ASSEMBLE_ARGB32(px, a, premul_alpha(r, a), premul_alpha(g, a), premul_alpha(b, a))
+            expected[i] = px;
+        }
+        each_isa([&] {
+            ink_span_premul_alpha(in.data(), result.data(), n);
+            EXPECT_EQ(expected, result) << n << " pixels";
+        });
+    }
+}
+
+TEST_F(SpanKernelTest, UnpremultiplyMatchesFunctor)
+{
+    // the division is done in floating point, so check every color and alpha
+    std::vector<guint32> all;
+    for (guint32 a = 0; a < 256; ++a) {
+        for (guint32 c = 0; c < 256; ++c) {
+            all.push_back((a << 24) | (c << 16) | ((255 - c) << 8) | (c * a / 255));
+        }
+    }
+    std::vector<std::vector<guint32>> inputs = { all };
+    for (int n : SPAN_LENGTHS) {
+        inputs.push_back(random_pixels(n, true));
+    }
+
+    for (auto const &in : inputs) {
+        int n = in.size();
+        std::vector<guint32> expected(n), result(n);
+        for (int i = 0; i < n; ++i) {
+            EXTRACT_ARGB32(in[i], a, r, g, b)
+            if (a == 0) {
+                expected[i] = in[i];
+                continue;
+            }
+            ASSEMBLE_ARGB32(px, a, unpremul_alpha(r, a), unpremul_alpha(g, a), unpremul_alpha(b, a))
+            expected[i] = px;
+        }
+        each_isa([&] {
+            ink_span_unpremul_alpha(in.data(), result.data(), n);
+            EXPECT_EQ(expected, result) << n << " pixels";
+        });
+    }
+}
+
+TEST_F(SpanKernelTest, ColorMatrixMatchesFunctor)
+{
+    std::vector<std::vector<double>> matrices = {
+        { 1, 0, 0, 0, 0,  0, 1, 0, 0, 0,  0, 0, 1, 0, 0,  0, 0, 0, 1, 0 },
+        { 0.3, 0.59, 0.11, 0, 0,  0.3, 0.59, 0.11, 0, 0,  0.3, 0.59, 0.11, 0, 0,  0, 0, 0, 1, 0 },
+        { -1, 0, 0, 0, 1,  0, -1, 0, 0, 1,  0, 0, -1, 0, 1,  0, 0, 0, 0.5, 0.25 },
+    };
+    std::uniform_real_distribution<double> value(-2.0, 2.0);
+    for (int k = 0; k < 3; ++k) {
+        std::vector<double> random(20);
+        for (auto &v : random) {
+            v = value(rng);
+        }
+        matrices.push_back(random);
+    }
+
+    for (auto const &values : matrices) {
+        Inkscape::Filters::FilterColorMatrix::ColorMatrixMatrix matrix(values);
+        for (int n : SPAN_LENGTHS) {
+            auto in = random_pixels(n, true);
+            std::vector<guint32> expected(n), result(n);
+            for (int i = 0; i < n; ++i) {
+                expected[i] = matrix(in[i]);
+            }
+            each_isa([&] {
+                matrix.filterSpan(in.data(), result.data(), n);
+                EXPECT_EQ(expected, result) << n << " pixels";
+            });
+        }
+    }
+}
+
+TEST_F(SpanKernelTest, HueRotateMatchesFunctor)
+{
+    for (double angle : { 0.0, 37.0, 90.0, 200.0, -75.0 }) {
+        Inkscape::Filters::FilterColorMatrix::ColorMatrixHueRotate rotate(angle);
+        for (int n : SPAN_LENGTHS) {
+            auto in = random_pixels(n, true);
+            std::vector<guint32> expected(n), result(n);
+            for (int i = 0; i < n; ++i) {
+                expected[i] = rotate(in[i]);
+            }
+            each_isa([&] {
+                rotate.filterSpan(in.data(), result.data(), n);
+                EXPECT_EQ(expected, result) << "angle " << angle << ", " << n << " pixels";
+            });
+        }
+    }
+}
+
+TEST_F(SpanKernelTest, ArithmeticMatchesFunctor)
+{
+    double const coefficients[][4] = {
+        { 0, 1, 1, 0 },
+        { 1, 0, 0, 0 },
+        { 0.5, -0.3, 1.2, 0.1 },
+        { -1, 2, 2, -0.5 },
+        { 0.25, 0.5, -0.75, 1 },
+    };
+    for (auto const &k : coefficients) {
+        Inkscape::Filters::FilterComposite::ComposeArithmetic arithmetic(k[0], k[1], k[2], k[3]);
+        for (int n : SPAN_LENGTHS) {
+            auto in1 = random_pixels(n, true);
+            auto in2 = random_pixels(n, true);
+            std::vector<guint32> expected(n), result(n);
+            for (int i = 0; i < n; ++i) {
+                expected[i] = arithmetic(in1[i], in2[i]);
+            }
+            each_isa([&] {
+                arithmetic.blendSpan(in1.data(), in2.data(), result.data(), n);
+                EXPECT_EQ(expected, result) << "k1 " << k[0] << ", " << n << " pixels";
+            });
+        }
+    }
+}
+
+/// Convert a color component in [0, 255] like the tables of the color space conversions.
+static guint32 convert_component(guint32 c, bool to_linear)
+{
+    double v = c / 255.0;
+    if (to_linear) {
+        v = v < 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    } else {
+        v = v < 0.0031308 ? v * 12.92 : std::pow(v, 1.0 / 2.4) * 1.055 - 0.055;
+    }
+    return std::clamp<long>(std::lround(v * 255.0), 0, 255);
+}
+
+TEST_F(SpanKernelTest, ColorSpaceConversionMatchesFunctor)
+{
+    for (bool to_linear : { true, false }) {
+        for (int n : SPAN_LENGTHS) {
+            auto in = random_pixels(n, true);
+            std::vector<guint32> expected(n);
+            for (int i = 0; i < n; ++i) {
+                EXTRACT_ARGB32(in[i], a, r, g, b)
+                if (a != 0) {
+                    r = premul_alpha(convert_component(unpremul_alpha(r, a), to_linear), a);
+                    g = premul_alpha(convert_component(unpremul_alpha(g, a), to_linear), a);
+                    b = premul_alpha(convert_component(unpremul_alpha(b, a), to_linear), a);
+                }
+                ASSEMBLE_ARGB32(px, a, r, g, b)
+                expected[i] = px;
+            }
+            each_isa([&] {
+                auto result = in;
+                if (to_linear) {
+                    ink_pixels_srgb_to_linear(result.data(), n);
+                } else {
+                    ink_pixels_linear_to_srgb(result.data(), n);
+                }
+                EXPECT_EQ(expected, result) << (to_linear ? "to linear, " : "to sRGB, ")
+                                            << n << " pixels";
+            });
+        }
+    }
+}
+
+/*
+ * Filter intermediates in linearRGB are stored with 8 bits per component, so a conversion to
+ * linearRGB and back merges dark sRGB levels. This pins down how many survive; a more precise
+ * intermediate format would keep more of them. Further round trips lose nothing more, which
+ * is why each input is converted only once.
+ */
+TEST(ColorSpaceTest, LinearRoundTripLosesDarkLevels)
+{
+    std::vector<guint32> px(256);
+    for (guint32 c = 0; c < 256; ++c) {
+        px[c] = 0xff000000 | (c << 16) | (c << 8) | c;
+    }
+    auto round_trip = [] (std::vector<guint32> v) {
+        ink_pixels_srgb_to_linear(v.data(), v.size());
+        ink_pixels_linear_to_srgb(v.data(), v.size());
+        return v;
+    };
+    auto once = round_trip(px);
+    std::set<guint32> levels(once.begin(), once.end());
+    std::set<guint32> dark_levels(once.begin(), once.begin() + 64);
+    EXPECT_EQ(levels.size(), 183u);
+    EXPECT_EQ(dark_levels.size(), 14u);
+    EXPECT_EQ(once[0], px[0]);
+    EXPECT_EQ(once[255], px[255]);
+    EXPECT_EQ(round_trip(once), once);
+}
+
+static std::vector<InkLighting> test_lights()
+{
+    InkLighting light = {};
+    light.color[0] = 255.0f;
+    light.color[1] = 128.0f;
+    light.color[2] = 30.0f;
+    light.surface_scale = 3.0f;
+    light.constant = 1.2f;
+    light.exponent = 7.5f;
+
+    std::vector<InkLighting> lights;
+    light.type = InkLighting::DISTANT;
+    light.direction[0] = 0.48f;
+    light.direction[1] = -0.6f;
+    light.direction[2] = 0.64f;
+    lights.push_back(light);
+
+    light.type = InkLighting::POINT;
+    light.position[0] = 20.0f;
+    light.position[1] = -10.0f;
+    light.position[2] = 40.0f;
+    lights.push_back(light);
+
+    light.type = InkLighting::SPOT;
+    light.spot_axis[0] = -0.267f;
+    light.spot_axis[1] = 0.535f;
+    light.spot_axis[2] = -0.802f;
+    light.spot_cos_cone = 0.2f;
+    light.spot_exponent = 3.3f;
+    lights.push_back(light);
+    return lights;
+}
+
+TEST_F(SpanKernelTest, SurfaceNormalsMatchScalar)
+{
+    for (int n : SPAN_LENGTHS) {
+        // the normals read one element before and after the span
+        auto above = random_floats(n + 2, 0.0f, 255.0f);
+        auto row = random_floats(n + 2, 0.0f, 255.0f);
+        auto below = random_floats(n + 2, 0.0f, 255.0f);
+        std::vector<float> nx[2], ny[2], nz[2];
+        compare([&] (int k) {
+            nx[k].resize(n);
+            ny[k].resize(n);
+            nz[k].resize(n);
+            ink_span_surface_normals(above.data() + 1, row.data() + 1, below.data() + 1, n, 2.5f,
+                                     nx[k].data(), ny[k].data(), nz[k].data());
+        }, [&] {
+            for (int i = 0; i < n; ++i) {
+                EXPECT_NEAR(nx[0][i], nx[1][i], 1e-6f);
+                EXPECT_NEAR(ny[0][i], ny[1][i], 1e-6f);
+                EXPECT_NEAR(nz[0][i], nz[1][i], 1e-6f);
+            }
+        });
+    }
+}
+
+TEST_F(SpanKernelTest, LightingMatchesScalar)
+{
+    for (auto const &light : test_lights()) {
+        for (int n : SPAN_LENGTHS) {
+            auto alpha = random_floats(n, 0.0f, 255.0f);
+            std::vector<float> nx(n), ny(n), nz(n);
+            auto above = random_floats(n + 2, 0.0f, 255.0f);
+            auto below = random_floats(n + 2, 0.0f, 255.0f);
+            auto row = random_floats(n + 2, 0.0f, 255.0f);
+            ink_span_set_isa("scalar");
+            ink_span_surface_normals(above.data() + 1, row.data() + 1, below.data() + 1, n,
+                                     light.surface_scale, nx.data(), ny.data(), nz.data());
+
+            std::vector<guint32> diffuse[2], specular[2];
+            compare([&] (int k) {
+                diffuse[k].resize(n);
+                specular[k].resize(n);
+                ink_span_diffuse_lighting(light, 3, 7, alpha.data(), nx.data(), ny.data(),
+                                          nz.data(), diffuse[k].data(), n);
+                ink_span_specular_lighting(light, 3, 7, alpha.data(), nx.data(), ny.data(),
+                                           nz.data(), specular[k].data(), n);
+            }, [&] {
+                expect_close(diffuse[0], diffuse[1]);
+                expect_close(specular[0], specular[1]);
+            });
+        }
+    }
+}
+
+TEST_F(SpanKernelTest, GouraudMatchesScalar)
+{
+    for (int n : SPAN_LENGTHS) {
+        // values outside [0, 255] are clamped
+        auto start = random_floats(4, -20.0f, 275.0f);
+        auto step = random_floats(4, -6.0f, 6.0f);
+        std::vector<guint32> out[2];
+        compare([&] (int k) {
+            out[k].resize(n);
+            ink_span_gouraud(start.data(), step.data(), out[k].data(), n);
+        }, [&] {
+            expect_close(out[0], out[1]);
+        });
+    }
+}
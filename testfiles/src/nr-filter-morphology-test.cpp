@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/** @file
+ * Tests for the feMorphology renderer
+ *//*
+ * Authors: see git history
+ *
+ * Copyright (C) 2021 Authors
+ *
+ * Released under GNU GPL version 2 or later, read the file 'COPYING' for more information
+ */
+
+#include <cairo.h>
+#include <cstring>
+#include <random>
+#include <gtest/gtest.h>
+#include <2geom/coord.h>
+#include <src/display/nr-filter-morphology.h>
+
+using namespace Inkscape::Filters;
+
+namespace {
+
+cairo_surface_t *random_surface(cairo_format_t format, int w, int h, std::mt19937 &rng)
+{
+    cairo_surface_t *s = cairo_image_surface_create(format, w, h);
+    int stride = cairo_image_surface_get_stride(s);
+    unsigned char *data = cairo_image_surface_get_data(s);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int i = 0; i < stride * h; ++i) {
+        data[i] = byte(rng);
+    }
+    cairo_surface_mark_dirty(s);
+    return s;
+}
+
+bool same_pixels(cairo_surface_t *a, cairo_surface_t *b)
+{
+    cairo_surface_flush(a);
+    cairo_surface_flush(b);
+    int w = cairo_image_surface_get_width(a);
+    int h = cairo_image_surface_get_height(a);
+    int bpp = cairo_image_surface_get_format(a) == CAIRO_FORMAT_A8 ? 1 : 4;
+    int stride = cairo_image_surface_get_stride(a);
+    for (int y = 0; y < h; ++y) {
+        if (std::memcmp(cairo_image_surface_get_data(a) + y * stride,
+                        cairo_image_surface_get_data(b) + y * stride, w * bpp) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// The fast algorithm processes several lines at once, so sizes which are not multiples of
+// that number and radii wider than the image are included. Images above PARALLEL_THRESHOLD
+// pixels are processed in parallel, with a partial last batch done separately.
+TEST(FilterMorphologyTest, FastPassMatchesReference)
+{
+    std::mt19937 rng(42);
+    for (auto format : { CAIRO_FORMAT_A8, CAIRO_FORMAT_ARGB32 }) {
+        for (int w : { 1, 3, 17, 64, 101 }) {
+            for (int h : { 1, 4, 5, 17, 31, 37 }) {
+                for (double radius : { 0.4, 1.0, 3.0, 100.0 }) {
+                    for (auto op : { MORPHOLOGY_OPERATOR_ERODE, MORPHOLOGY_OPERATOR_DILATE }) {
+                        for (auto axis : { Geom::X, Geom::Y }) {
+                            cairo_surface_t *in = random_surface(format, w, h, rng);
+                            cairo_surface_t *expected = cairo_image_surface_create(format, w, h);
+                            cairo_surface_t *result = cairo_image_surface_create(format, w, h);
+
+                            morphology_pass(in, expected, op, axis, radius, true);
+                            morphology_pass(in, result, op, axis, radius);
+                            EXPECT_TRUE(same_pixels(expected, result))
+                                << "format " << format << ", " << w << "x" << h << ", radius "
+                                << radius << ", operator " << op << ", axis " << axis;
+
+                            cairo_surface_destroy(in);
+                            cairo_surface_destroy(expected);
+                            cairo_surface_destroy(result);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/*
+  Local Variables:
+  mode:c++
+  c-file-style:"stroustrup"
+  c-file-offsets:((innamespace . 0)(inline-open . 0)(case-label . +))
+  indent-tabs-mode:nil
+  fill-column:99
+  End:
+*/
+// vim: filetype=cpp:expandtab:shiftwidth=4:tabstop=8:softtabstop=4:fileencoding=utf-8:textwidth=99 :